@@ -17,13 +17,17 @@ struct EX_PageHdr {
 	int numrecs;
 };
 
+// fewest blocks of work memory a sort or merge join can run with
+#define EX_MIN_WORK_MEM 3
+
 // loads into a file maintaining a fill factor
 class EX_Loader {
 public:
 	EX_Loader(PF_Manager &pfm);
 	~EX_Loader();
+	// temp makes the file a temporary file of the PF_Manager
 	RC Create(char *fileName, float ff, int recsize, bool makeIndex, 
-														int attrLength);
+											int attrLength, bool temp = false);
 	RC PutRec(char* data);
 	RC Close();
 private:
@@ -66,13 +70,18 @@ private:
 // Sorter class - creates sorted files, used by operators
 ////////////////////////////////////////////////////////////
 
+// The scratch pages of the sorter come out of grant, which decides how
+// long the sorted runs are and how many of them are merged at once
 class EX_Sorter {
 public:
-	EX_Sorter(PF_Manager &pfm, QL_Op &scan, int attrIndex);
+	EX_Sorter(PF_Manager &pfm, QL_Op &scan, int attrIndex, 
+												PF_MemGrant &grant);
 	~EX_Sorter();
-	RC sort(const char *fileName, float ff, bool makeIndex);
+	// the sorted runs are temporary files; so is the sorted file if temp
+	RC sort(const char *fileName, float ff, bool makeIndex, bool temp);
 private:
 	PF_Manager *pfm;
+	PF_MemGrant *grant;
 	QL_Op *scan;
 	int attrIndex;
 	AttrType attrType;
@@ -90,10 +99,9 @@ private:
 	// fills buffer with records read from scan. returns the allocated pages
 	RC fillBuffer(std::vector<char*> &pages, std::vector<int> &numrecs);
 	RC createSortedChunk(const char* fileName, int chunkNum, float ff, 
-		std::vector<char*> &pages, std::vector<int> &numrecs);
+		std::vector<char*> &pages, std::vector<int> &numrecs, bool temp);
 	int findIndex(std::vector<char*> &pages, std::vector<int> &numrecs, 
 		std::vector<int> &index);
-	int pagesToReserve(QL_Op* node);
 	void cleanUp(std::vector<char*> &pages, std::vector<int> &numrecs);
 };
 
@@ -101,18 +109,18 @@ private:
 // Utility class for Buffer IO
 /////////////////////////////////////////////////////
 
+// holds at most as many pages of records as grant has blocks
 class BufferIterator {
 public:
-	BufferIterator(PF_Manager *pfm, int recsize, int bufferSize);
+	BufferIterator(PF_MemGrant *grant, int recsize);
 	~BufferIterator();
 	RC Clear();
 	RC PutRec(std::vector<char> &rec);
 	int Size();
 	char* GetRec(int i);
 private:
-	PF_Manager *pfm;
+	PF_MemGrant *grant;
 	int recsize;
-	int bufferSize;
 	int pagecap;
 	int numrecs;
 	int currPage;
@@ -133,16 +141,20 @@ public:
 	RC Next(std::vector<char> &rec);
 	RC Reset();
 	RC Close();
+	// blocks of work memory to ask for, 0 for the whole pool
+	void setWorkMem(int numPages);
 private:
 	bool isOpen;
 	bool isEmpty;
 	int attrIndex;
+	int workMem;
+	PF_MemGrant grant;
 	int recsize;
 	bool deleteAtClose;
 	char* fileName;
 	PF_Manager* pfm;
 	EX_Scanner* scanner;
-	void gen_random(char* s, const int len);
+	static int numTempFiles;
 };
 
 // Assumes that child give records in increasing order of the join
@@ -156,8 +168,13 @@ public:
 	RC Next(std::vector<char> &rec);
 	RC Reset();
 	RC Close();
+	// blocks of work memory to ask for, 0 for the whole pool
+	void setWorkMem(int numPages);
 private:
 	bool isOpen;
+	PF_Manager *pfm;
+	int workMem;
+	PF_MemGrant grant;
 	std::vector<char> leftrec;
 	std::vector<char> rightrec;
 	int leftRecSize;
@@ -184,9 +201,11 @@ public:
 	void pushSort(QL_Op* &root);
 	void doSortedScans(QL_Op* &root);
 	void mergeProjections(QL_Op* &root);
+	void grantWorkMem(QL_Op* root);
 private:
 	PF_Manager *pfm;
 	bool okToSort(QL_Op* root);
+	void findWorkMemOps(QL_Op* root, std::vector<QL_Op*> &ops);
 };
 
 
@@ -59,15 +59,26 @@ EX_Loader::~EX_Loader() {
 }
 
 RC EX_Loader::Create(char *fileName, float ff, int recsize, 
-		bool makeIndex, int attrLength) {
+		bool makeIndex, int attrLength, bool temp) {
 	RC WARN = 504, ERR = -504;
 	if (isOpen) return WARN;
 	this->ff = ff;
 	this->recsize = recsize;
-	this->capacity = (PF_PAGE_SIZE - sizeof(EX_PageHdr)) / recsize;
-	if (recsize > PF_PAGE_SIZE - (int) sizeof(EX_PageHdr)) return WARN;
-	EX_ErrorForward(pfm->CreateFile(fileName));
-	EX_ErrorForward(pfm->OpenFile(fileName, fh));
+	// the pages of sorted runs are read back into buffer blocks, so they
+	// must be the size of a block
+	int blockSize, pageSize;
+	EX_ErrorForward(pfm->GetBlockSize(blockSize));
+	if (temp) EX_ErrorForward(pfm->CreateTempFile(fileName, blockSize));
+	else EX_ErrorForward(pfm->CreateFile(fileName, blockSize));
+	// sorted files are derived from the relations, so are not logged
+	EX_ErrorForward(pfm->OpenFile(fileName, fh, PF_IO_UNLOGGED));
+	EX_ErrorForward(fh.GetPageSize(pageSize));
+	this->capacity = (pageSize - sizeof(EX_PageHdr)) / recsize;
+	if (recsize > pageSize - (int) sizeof(EX_PageHdr)) {
+		pfm->CloseFile(fh);
+		pfm->DestroyFile(fileName);
+		return WARN;
+	}
 	isOpen = true;
 	this->makeIndex = makeIndex;
 	this->attrLength = attrLength;
@@ -92,9 +103,9 @@ RC EX_Loader::PutRec(char *data) {
 	if (!isOpen) return WARN;
 	if (recsInCurrPage == 0) {
 		// allocate a new page
-		EX_ErrorForward(fh.AllocatePage(ph));
+		EX_ErrorForward(fh.AllocatePage(ph, TEMP));
 	} else {
-		EX_ErrorForward(fh.GetThisPage(currPage, ph));
+		EX_ErrorForward(fh.GetThisPage(currPage, ph, TEMP));
 	}
 	char *contents;
 	EX_ErrorForward(ph.GetData(contents));
@@ -136,10 +147,10 @@ RC EX_Scanner::Open(const char* fileName, int startPage,
 	RC WARN = 507, ERR = -507;
 	if (isOpen) return WARN;
 	this->recsize = recsize;
-	EX_ErrorForward(pfm->OpenFile(fileName, fh));
+	EX_ErrorForward(pfm->OpenFile(fileName, fh, PF_IO_UNLOGGED));
 	isOpen = true;
 	if (startPage < 0) {
-		currPage = (goRight) ? 0 : fh.hdr.numPages - 1;
+		currPage = (goRight) ? 0 : fh.pHdr->numPages - 1;
 	} else {
 		currPage = startPage;
 	}
@@ -154,14 +165,14 @@ RC EX_Scanner::Next(vector<char> &rec) {
 	if (!isOpen) return WARN;
 	// check for end of file
 	if ((currPage < 0 && increment < 0) ||
-		(currPage == fh.hdr.numPages && increment > 0)) {
+		(currPage == fh.pHdr->numPages && increment > 0)) {
 		return QL_EOF;
 	}
 	rec.resize(recsize);
 	// get the current page and read its data
 	char *contents;
 	PF_PageHandle ph;
-	EX_ErrorForward(fh.GetThisPage(currPage, ph));
+	EX_ErrorForward(fh.GetThisPage(currPage, ph, TEMP));
 	EX_ErrorForward(ph.GetData(contents));
 	EX_PageHdr *pHdr = (EX_PageHdr*) contents;
 	if (currSlot == -1) {
@@ -204,13 +215,13 @@ RC EX_Scanner::NextBlock(char *block, int &numrecs) {
 	if (!isOpen) return WARN;
 	// check for end of file
 	if ((currPage < 0 && increment < 0) ||
-		(currPage == fh.hdr.numPages && increment > 0)) {
+		(currPage == fh.pHdr->numPages && increment > 0)) {
 		return QL_EOF;
 	}
 	// get the current page and read its data
 	char *contents;
 	PF_PageHandle ph;
-	EX_ErrorForward(fh.GetThisPage(currPage, ph));
+	EX_ErrorForward(fh.GetThisPage(currPage, ph, TEMP));
 	EX_ErrorForward(ph.GetData(contents));
 	EX_PageHdr *pHdr = (EX_PageHdr*) contents;
 	numrecs = pHdr->numrecs;
@@ -231,10 +242,12 @@ RC EX_Scanner::NextBlock(char *block, int &numrecs) {
 
 /* Sorts the tuples output by scan based on the attribute attrIndex
 	in ascending order. The sorted file is stored in the file named
-	fileName.
+	fileName. Scratch pages come out of grant.
 */
-EX_Sorter::EX_Sorter(PF_Manager &pfm, QL_Op &scan, int attrIndex) {
+EX_Sorter::EX_Sorter(PF_Manager &pfm, QL_Op &scan, int attrIndex, 
+												PF_MemGrant &grant) {
 	this->pfm = &pfm;
+	this->grant = &grant;
 	this->scan = &scan;
 	this->attrIndex = attrIndex;
 	DataAttrInfo info = scan.attributes[attrIndex];
@@ -244,7 +257,7 @@ EX_Sorter::EX_Sorter(PF_Manager &pfm, QL_Op &scan, int attrIndex) {
 	this->recsize = scan.attributes.back().offset + 
 							scan.attributes.back().attrLength;
 	this->recsPerPage = PF_PAGE_SIZE / (this->recsize);
-	this->bufferSize = PF_BUFFER_SIZE - pagesToReserve(&scan);
+	this->bufferSize = grant.GetNumPages();
 	this->buffer = new char[this->recsize];
 	this->seenEOF = false;
 }
@@ -253,7 +266,8 @@ EX_Sorter::~EX_Sorter() {
 	delete[] buffer;
 }
 
-RC EX_Sorter::sort(const char *fileName, float ff, bool makeIndex) {
+RC EX_Sorter::sort(const char *fileName, float ff, bool makeIndex, 
+																bool temp) {
 	RC WARN = 501, ERR = -501;
    	// open the scan
 	EX_ErrorForward(scan->Open());
@@ -263,9 +277,12 @@ RC EX_Sorter::sort(const char *fileName, float ff, bool makeIndex) {
    	if (pages.size() == 0) return QL_EOF;
    	int chunkNum = 0;
    	queue<int> fileq;
+   	// a run that holds all the records is the sorted file already
+   	bool lastIsTemp = true;
    	while (rc == OK_RC) {
+   		if (chunkNum == 0 && seenEOF) lastIsTemp = temp;
    		EX_ErrorForward(createSortedChunk(fileName, chunkNum, 1.0,
-    			pages, numrecs));
+    			pages, numrecs, lastIsTemp));
    		fileq.push(chunkNum);
     	chunkNum++;
     	cleanUp(pages, numrecs);
@@ -276,30 +293,31 @@ RC EX_Sorter::sort(const char *fileName, float ff, bool makeIndex) {
 	EX_ErrorForward(scan->Close());
 	cleanUp(pages, numrecs);
 	// now merge the sorted chunks
-	// use all except one buffer page to read the chunks. This
-	// page will be used to read a new block when a page from a 
-	// file is exhausted
-	int buffSize = PF_BUFFER_SIZE - 1;
+	// read one block of each chunk into a page of the grant; the
+	// merged file is written through the buffer pool
+	int buffSize = bufferSize;
 	vector<EX_Scanner*> scanners;
 	vector<int> chunkIndices;
-	while (fileq.size() > 1) {
+	// a single run that is temporary when the sorted file must not be
+	// is copied by one more pass
+	while (fileq.size() > 1 || lastIsTemp != temp) {
 		// merge files from the front of the queue and enqueue
 		// the result at the back
 		scanners.clear();
 		pages.clear();
 		numrecs.clear();
-		char temp[3*MAXNAME];
+		char name[3*MAXNAME];
 		int qsize = fileq.size();
 		// open scan on files and read one page from each file
 		for (int i = 0; i < min(qsize, buffSize); i++) {
 			EX_Scanner* scn = new EX_Scanner(*pfm);
-			sprintf(temp, "_%s.%d", fileName, fileq.front());
+			sprintf(name, "_%s.%d", fileName, fileq.front());
 			chunkIndices.push_back(fileq.front());
 			fileq.pop();
-			EX_ErrorForward(scn->Open(temp, 0, true, recsize));
+			EX_ErrorForward(scn->Open(name, 0, true, recsize));
 			char *buffpage;
 			int num;
-			EX_ErrorForward(pfm->AllocateBlock(buffpage));
+			EX_ErrorForward(grant->AllocateBlock(buffpage));
 			EX_ErrorForward(scn->NextBlock(buffpage, num));
 			pages.push_back(buffpage);
 			numrecs.push_back(num);
@@ -307,12 +325,13 @@ RC EX_Sorter::sort(const char *fileName, float ff, bool makeIndex) {
 		}
 		// merge blocks and output to a merged file
 		EX_Loader loader(*pfm);
-		sprintf(temp, "_%s.%d", fileName, chunkNum);
+		sprintf(name, "_%s.%d", fileName, chunkNum);
 		fileq.push(chunkNum);
 		chunkNum++;
 		float fillFactor = (qsize > buffSize) ? 1.0 : ff;
-		EX_ErrorForward(loader.Create(temp, fillFactor, recsize, 
-							makeIndex && qsize <= buffSize, attrLength));
+		lastIsTemp = temp || qsize > buffSize;
+		EX_ErrorForward(loader.Create(name, fillFactor, recsize, 
+				makeIndex && qsize <= buffSize, attrLength, lastIsTemp));
 		vector<int> index(scanners.size(), 0);
 		unsigned int exhaustedCount = 0;
 		RC rc;
@@ -336,18 +355,17 @@ RC EX_Sorter::sort(const char *fileName, float ff, bool makeIndex) {
 		for (unsigned int i = 0; i < scanners.size(); i++) {
 			EX_ErrorForward(scanners[i]->Close());
 			delete scanners[i];
-			char temp[3 * MAXNAME];
-			sprintf(temp, "_%s.%d", fileName, chunkIndices[i]);
-			if (unlink(temp) != 0) return WARN;
+			sprintf(name, "_%s.%d", fileName, chunkIndices[i]);
+			EX_ErrorForward(pfm->DestroyFile(name));
 		}
 		chunkIndices.clear();
 		EX_ErrorForward(loader.Close());
 	}
 	// now there is exactly one file in the fileq, rename it to desired file
 	// rename the chunk file to fileName
-	char temp[3 * MAXNAME];
-	sprintf(temp, "_%s.%d", fileName, fileq.front());
-	if (rename(temp, fileName) != 0) return WARN;
+	char name[3 * MAXNAME];
+	sprintf(name, "_%s.%d", fileName, fileq.front());
+	EX_ErrorForward(pfm->RenameFile(name, fileName));
 	// verify the sorted file 
 	// DataAttrInfo* attrs = &(scan->attributes[0]);
 	// Printer p(attrs, scan->attributes.size());
@@ -418,27 +436,6 @@ void EX_Sorter::exch(char* v, char* w) {
 	memcpy(w, buffer, recsize);
 }
 
-/*  Find the number of pages to be reserved for relation access. 
-	The remaining buffer pages can be used for sorting
-*/
-int EX_Sorter::pagesToReserve(QL_Op* node) {
-	if (node == 0) return 0;
-	int numpages = 0;
-	if (node->opType >= 0) {
-		auto unode = (QL_UnaryOp*) node;
-		if (node->opType == RM_LEAF) {
-			numpages = 1;
-		} else if (node->opType == IX_LEAF) {
-			numpages = 2;
-		}
-		return numpages + pagesToReserve(unode->child);
-	} else {
-		auto bnode = (QL_BinaryOp*) node;
-		return pagesToReserve(bnode->lchild) + pagesToReserve(bnode->rchild);
-	}
-	return 0;
-}
-
 /*	Fill buffer pages with data read from the operator. scan must be
 	opened before calling this method
 */
@@ -451,9 +448,8 @@ RC EX_Sorter::fillBuffer(vector<char*> &pages, vector<int> &numrecs) {
 		if (seenEOF) break;
 		// allocate a new scan page
 		char *page;
-		rc = pfm->AllocateBlock(page);
+		rc = grant->AllocateBlock(page);
 		if (rc != OK_RC) {
-			pfm->DisposeBlock(page);
 			cleanUp(pages, numrecs);
 			return rc;
 		}
@@ -467,7 +463,7 @@ RC EX_Sorter::fillBuffer(vector<char*> &pages, vector<int> &numrecs) {
 				break;
 			} else if (rc != OK_RC) {
 				// dispose scratch pages and return error
-				pfm->DisposeBlock(page);
+				grant->DisposeBlock(page);
 				cleanUp(pages, numrecs);
 				return rc;
 			} else {
@@ -478,7 +474,7 @@ RC EX_Sorter::fillBuffer(vector<char*> &pages, vector<int> &numrecs) {
 		}
 		// at this point rc can be QL_EOF or OK_RC
 		if (num == 0) {
-			pfm->DisposeBlock(page);
+			grant->DisposeBlock(page);
 			// no record was read
 			if (pn == 0) return QL_EOF;
 		} else {
@@ -495,7 +491,7 @@ RC EX_Sorter::fillBuffer(vector<char*> &pages, vector<int> &numrecs) {
 void EX_Sorter::cleanUp(vector<char*> &pages, vector<int> &numrecs) {
 	for (unsigned int k = 0; k < pages.size(); k++) {
 		// dont need to forward error because one has already occured
-		pfm->DisposeBlock(pages[k]);
+		grant->DisposeBlock(pages[k]);
 	}
 	pages.clear();
 	numrecs.clear();
@@ -525,14 +521,14 @@ int EX_Sorter::findIndex(vector<char*> &pages, vector<int> &numrecs,
 
 
 RC EX_Sorter::createSortedChunk(const char *fileName, int chunkNum, float ff, 
-					vector<char*> &pages, vector<int> &numrecs) {
+					vector<char*> &pages, vector<int> &numrecs, bool temp) {
 	// allocate a new file
 	RC WARN = 503, ERR = -503;
 	if (pages.size() == 0) return OK_RC;
 	EX_Loader loader(*pfm);
 	vector<char> fname(3*MAXNAME);
 	sprintf(&fname[0], "_%s.%d", fileName, chunkNum);
-	EX_ErrorForward(loader.Create(&fname[0], ff, recsize, false, 0));
+	EX_ErrorForward(loader.Create(&fname[0], ff, recsize, false, 0, temp));
 	vector<int> index(pages.size(), 0);
 	int idx = findIndex(pages, numrecs, index);
 	while (idx >= 0) {
@@ -548,11 +544,10 @@ RC EX_Sorter::createSortedChunk(const char *fileName, int chunkNum, float ff,
 // Utility class for Buffer IO
 //////////////////////////////////////////////////////
 
-BufferIterator::BufferIterator(PF_Manager *pfm, int recsize, int bufferSize) {
-	this->pfm = pfm;
+BufferIterator::BufferIterator(PF_MemGrant *grant, int recsize) {
+	this->grant = grant;
 	this->recsize = recsize;
 	this->pagecap = PF_PAGE_SIZE / recsize;
-	this->bufferSize = bufferSize;
 	this->numrecs = 0;
 	this->currPage = 0;
 	this->currSlot = 0;
@@ -565,7 +560,7 @@ BufferIterator::~BufferIterator() {
 RC BufferIterator::Clear() {
 	RC WARN = 512, ERR = -512;
 	for (unsigned int i = 0; i < pages.size(); i++) {
-		EX_ErrorForward(pfm->DisposeBlock(pages[i]));
+		EX_ErrorForward(grant->DisposeBlock(pages[i]));
 	}
 	pages.clear();
 	currPage = 0;
@@ -577,9 +572,9 @@ RC BufferIterator::Clear() {
 RC BufferIterator::PutRec(vector<char> &rec) {
 	RC WARN = 512, ERR = -512;
 	if (currSlot == 0) {
-		if (currPage == bufferSize) return WARN;
+		if (currPage == grant->GetNumPages()) return WARN;
 		char *page;
-		EX_ErrorForward(pfm->AllocateBlock(page));
+		EX_ErrorForward(grant->AllocateBlock(page));
 		pages.push_back(page);
 	}
 	// put the record in the current (page, slot)
@@ -609,6 +604,8 @@ char* BufferIterator::GetRec(int i) {
 
 /* Operator used in joins or ORDER BY queries */
 
+int EX_Sort::numTempFiles = 0;
+
 EX_Sort::EX_Sort(PF_Manager* pfm, QL_Op &child, int attrIndex) {
 	this->attributes = child.attributes;
 	this->child = &child;
@@ -618,12 +615,10 @@ EX_Sort::EX_Sort(PF_Manager* pfm, QL_Op &child, int attrIndex) {
 	this->isEmpty = false;
 	deleteAtClose = (child.opType != RM_LEAF);
 	if (deleteAtClose) {
-		// generate a unique fileName
+		// the sorted file is a temporary file, its name need only be
+		// unique among those of the PF_Manager
 		fileName = new char[21];
-		gen_random(fileName, 20);
-		while (access(fileName, F_OK) == 0) {
-			gen_random(fileName, 2*MAXNAME);
-		}
+		sprintf(fileName, "sort.%d", numTempFiles++);
  	} else {
 		// use relname.attrname.sorted
 		fileName = new char[2*MAXNAME + 10];
@@ -633,6 +628,7 @@ EX_Sort::EX_Sort(PF_Manager* pfm, QL_Op &child, int attrIndex) {
 	this->attrIndex = attrIndex;
 	this->recsize = attributes.back().attrLength + attributes.back().offset;
 	this->pfm = pfm;
+	this->workMem = 0;
 	this->scanner = new EX_Scanner(*pfm);
 	// change indexNo of all attributes
 	for (unsigned int i = 0; i < this->attributes.size(); i++) {
@@ -658,9 +654,14 @@ RC EX_Sort::Open() {
 	RC WARN = 511, ERR = -511;
 	RC rc = OK_RC;
 	if (deleteAtClose || access(fileName, F_OK) != 0) {
-		// create the sorted file
-		EX_Sorter sorter(*pfm, *child, attrIndex);
-		rc = sorter.sort(fileName, 1.0, !deleteAtClose);
+		// create the sorted file in work memory that is given back
+		// as soon as the file is written
+		int numPages = workMem;
+		if (numPages == 0) pfm->GetWorkMemSize(numPages);
+		EX_ErrorForward(pfm->GrantWorkMem(numPages, EX_MIN_WORK_MEM, grant));
+		EX_Sorter sorter(*pfm, *child, attrIndex, grant);
+		rc = sorter.sort(fileName, 1.0, !deleteAtClose, deleteAtClose);
+		grant.Release();
 		if (rc != OK_RC && rc != QL_EOF) EX_ErrorForward(rc);
 	}
 	// open the file for scan
@@ -679,31 +680,23 @@ RC EX_Sort::Next(vector<char> &rec) {
 	return scanner->Next(rec);
 }
 
+void EX_Sort::setWorkMem(int numPages) {
+	workMem = numPages;
+}
+
 RC EX_Sort::Reset() {
 	return scanner->Reset();
 }
 
 RC EX_Sort::Close() {
 	if (isEmpty) return OK_RC;
+	RC WARN = 511, ERR = -511;
+	EX_ErrorForward(scanner->Close());
 	if (deleteAtClose) {
 		// delete the file
-		unlink(fileName);
+		EX_ErrorForward(pfm->DestroyFile(fileName));
 	}
-	return scanner->Close();
-}
-
-void EX_Sort::gen_random(char *s, const int len) {
-    srand(time(0));
-    for (int i = 0; i < len; ++i) {
-        int randomChar = rand()%(26+26+10);
-        if (randomChar < 26)
-            s[i] = 'a' + randomChar;
-        else if (randomChar < 26+26)
-            s[i] = 'A' + randomChar - 26;
-        else
-            s[i] = '0' + randomChar - 26 - 26;
-    }
-    s[len] = 0;
+	return OK_RC;
 }
 
 
@@ -719,6 +712,8 @@ EX_MergeJoin::EX_MergeJoin(PF_Manager *pfm, QL_Op &left, QL_Op &right,
 	left.parent = this;
 	right.parent = this;
 	isOpen = false;
+	this->pfm = pfm;
+	this->workMem = 0;
 	int lindex = QL_Manager::findAttr(cond->lhsAttr.relName, 
 				cond->lhsAttr.attrName, lchild->attributes);
 	int rindex = QL_Manager::findAttr(cond->rhsAttr.relName, 
@@ -746,9 +741,9 @@ EX_MergeJoin::EX_MergeJoin(PF_Manager *pfm, QL_Op &left, QL_Op &right,
 	for (unsigned int i = 0; i < attributes.size(); i++) {
 		attributes[i].indexNo = -1;
 	}
-	// 2 for reading sorted relations and one for results
-	int bufferSize = PF_BUFFER_SIZE - 3;
-	this->buffit = new BufferIterator(pfm, rightRecSize, bufferSize);
+	// buffers the right records with equal join attributes, in the
+	// work memory granted at Open
+	this->buffit = new BufferIterator(&grant, rightRecSize);
 	opType = MERGE_JOIN;
 	desc << "MERGE JOIN ON " << "";
 }
@@ -764,6 +759,9 @@ RC EX_MergeJoin::Open() {
 	if (isOpen) return WARN;
 	QL_ErrorForward(lchild->Open());
 	QL_ErrorForward(rchild->Open());
+	int numPages = workMem;
+	if (numPages == 0) pfm->GetWorkMemSize(numPages);
+	EX_ErrorForward(pfm->GrantWorkMem(numPages, 1, grant));
 	isOpen = true;
 	leftrec.clear();
 	rightrec.clear();
@@ -850,9 +848,14 @@ RC EX_MergeJoin::Close() {
 	EX_ErrorForward(lchild->Close());
 	EX_ErrorForward(rchild->Close());
 	EX_ErrorForward(buffit->Clear());
+	EX_ErrorForward(grant.Release());
 	return OK_RC;
 }
 
+void EX_MergeJoin::setWorkMem(int numPages) {
+	workMem = numPages;
+}
+
 bool EX_MergeJoin::less(char* v, char *w) {
 	return QL_Manager::lt_op((void*) (v + lattr.offset), 
 		(void*) (w + rattr.offset),	lattr.attrLength, rattr.attrLength, 
@@ -965,6 +968,36 @@ void EX_Optimizer::pushSort(QL_Op* &root) {
 	}
 }
 
+/*	Divide the work_mem pool among the sort and merge join operators
+	of the tree, so that all of them can hold their memory at once
+*/
+void EX_Optimizer::grantWorkMem(QL_Op* root) {
+	vector<QL_Op*> ops;
+	findWorkMemOps(root, ops);
+	if (ops.empty()) return;
+	int poolSize;
+	pfm->GetWorkMemSize(poolSize);
+	int share = max(poolSize / (int) ops.size(), EX_MIN_WORK_MEM);
+	for (unsigned int i = 0; i < ops.size(); i++) {
+		if (ops[i]->opType == SORT) ((EX_Sort*) ops[i])->setWorkMem(share);
+		else ((EX_MergeJoin*) ops[i])->setWorkMem(share);
+	}
+}
+
+void EX_Optimizer::findWorkMemOps(QL_Op* root, vector<QL_Op*> &ops) {
+	if (!root) return;
+	if (root->opType < 0) {
+		auto bin = (QL_BinaryOp*) root;
+		findWorkMemOps(bin->lchild, ops);
+		findWorkMemOps(bin->rchild, ops);
+	} else {
+		auto uop = (QL_UnaryOp*) root;
+		findWorkMemOps(uop->child, ops);
+	}
+	if (root->opType == SORT || root->opType == MERGE_JOIN) 
+		ops.push_back(root);
+}
+
 /*	Look for equality attribute conditions over cross product
 	operators and replace cross product by merge join op and push
 	sort between itself and its children. The previous optimization
@@ -18,6 +18,7 @@
 #include "sm.h"
 #include "ql.h"
 
+extern PF_Manager *pPfm;
 extern SM_Manager *pSmm;
 extern QL_Manager *pQlm;
 
@@ -261,6 +262,11 @@ RC interp(NODE *n)
          break;
    }
 
+   /* make the changes of the command durable with one log sync */
+   RC commitval = pPfm->Commit();
+   if (errval == 0)
+      errval = commitval;
+
    return (errval);
 }
 
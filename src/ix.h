@@ -51,7 +51,9 @@ private:
     IX_FileHdr fHdr;
     int bHeaderChanged;
     RID last_deleted;
-    void buffer(void *ptr, char* buff) const;
+    // comparison kernels for the keys, by operator (see predicate.h)
+    bool (*kernels[GE_OP + 1])(const void *attr1, const void *attr2,
+                               int length);
     bool eq_op(void* attr1, void* attr2) const;
     bool ne_op(void* attr1, void* attr2) const;
     bool lt_op(void* attr1, void* attr2) const;
@@ -111,17 +113,10 @@ private:
     int overflow_index;
     CompOp comp_op;
     
-    // pointer to a member function
-    bool (IX_IndexScan::*comp)(void* attr);
-    
-    // Functions for comparison
+    // comparison kernel of the scan (a PredKernel, see predicate.h)
+    bool (*comp)(const void *attr, const void *value, int length);
+
     void buffer(void *ptr, char* buff);
-    bool no_op(void* attr);
-    bool eq_op(void* attr);
-    bool lt_op(void* attr);
-    bool gt_op(void* attr);
-    bool le_op(void* attr);
-    bool ge_op(void* attr);
 };
 
 //
@@ -132,22 +127,25 @@ public:
     IX_Manager(PF_Manager &pfm);
     ~IX_Manager();
 
-    // Create a new Index
+    // Create a new Index.  pageSize is passed on to
+    // PF_Manager::CreateFile (0 for the "page_size" setting)
     RC CreateIndex(const char *fileName, int indexNo,
-                   AttrType attrType, int attrLength);
+                   AttrType attrType, int attrLength, int pageSize = 0);
 
     // Destroy and Index
     RC DestroyIndex(const char *fileName, int indexNo);
 
-    // Open an Index
+    // Open an Index.  ioMode is passed on to PF_Manager::OpenFile; an
+    // index opened PF_IO_MMAP can only be scanned
     RC OpenIndex(const char *fileName, int indexNo,
-                 IX_IndexHandle &indexHandle);
+                 IX_IndexHandle &indexHandle, int ioMode = PF_IO_DEFAULT);
 
     // Close an Index
     RC CloseIndex(IX_IndexHandle &indexHandle);
 private:
     PF_Manager *pf_manager;
-    int numKeysPerPage(int key_size, int pointer_size, int header);
+    int numKeysPerPage(int key_size, int pointer_size, int header,
+                       int page_size);
 };
 
 //
@@ -11,23 +11,11 @@ using namespace std;
 /* macro for writing comparison operators
 	This occurs in the body of the function having signature
 	bool IX_IndexHandle::xx_op(void* attr1, void* attr2)
-	where xx = eq, lt, gt etc.
+	where xx = eq, lt, gt etc. The keys are compared in place by the
+	kernel picked for the key type when the index was opened
 */
-#define IX_operator(expr) do { \
-    char attr_value1[fHdr.attrLength+1];\
-    buffer(attr1, attr_value1);\
-    char attr_value2[fHdr.attrLength+1];\
-    buffer(attr2, attr_value2);\
-    switch (fHdr.attrType) { \
-        case INT:\
-        	return *((int*) attr_value1) expr *((int*) attr_value2);\
-        case FLOAT: \
-        	return *((float*) attr_value1) expr *((float*) attr_value2);\
-        case STRING: \
-        	return string(attr_value1) expr string(attr_value2);\
-        default: return 1 == 0;\
-    }\
-}while(0)
+#define IX_operator(op) \
+	return kernels[op](attr1, attr2, fHdr.attrLength)
 
 
 
@@ -58,7 +46,7 @@ RC IX_IndexHandle::InsertEntry(void *pData, const RID &rid) {
 	if (fHdr.root_pnum < 0) {
 		// no root exists, create a root
 		// declared as a leaf
-		pf_fh.AllocatePage(root_handle);
+		pf_fh.AllocatePage(root_handle, HOT_METADATA);
 		char* newdata;
 		PageNum newpnum;
 		IX_ErrorForward(root_handle.GetPageNum(newpnum));
@@ -72,7 +60,7 @@ RC IX_IndexHandle::InsertEntry(void *pData, const RID &rid) {
 		pHdr->right_pnum = IX_SENTINEL;
 		pHdr->type = LEAF;
 	} else {
-		pf_fh.GetThisPage(fHdr.root_pnum, root_handle);
+		pf_fh.GetThisPage(fHdr.root_pnum, root_handle, HOT_METADATA);
 	}
 	// insert into the root
 	int newpage;
@@ -88,7 +76,7 @@ RC IX_IndexHandle::InsertEntry(void *pData, const RID &rid) {
 	else {
 		// create a new root
 		PF_PageHandle new_root;
-		pf_fh.AllocatePage(new_root);
+		pf_fh.AllocatePage(new_root, HOT_METADATA);
 		char *newdata, *keys, *pointers;
 		PageNum newpnum;
 		IX_ErrorForward(new_root.GetPageNum(newpnum));
@@ -126,7 +114,8 @@ RC IX_IndexHandle::DeleteEntry(void *pData, const RID &rid) {
 	// get the root page
 	PF_PageHandle root_handle;
 	int numKeys;
-	IX_ErrorForward(pf_fh.GetThisPage(fHdr.root_pnum, root_handle));
+	IX_ErrorForward(pf_fh.GetThisPage(fHdr.root_pnum, root_handle,
+		HOT_METADATA));
 	WARN = IX_REC_NOT_FOUND;
 	IX_ErrorForward(treeDelete(root_handle, pData, rid, numKeys));
 	WARN = IX_DELETE_WARN;
@@ -378,7 +367,9 @@ RC IX_IndexHandle::overflowDelete(PF_PageHandle &ph, const RID& rid, int& numKey
 			int nextpnum = pHdr->next_page;
 			IX_ErrorForward(pf_fh.GetThisPage(nextpnum, nextph));
 			IX_ErrorForward(nextph.GetData(nextdata));
-			memcpy(data, nextdata, PF_PAGE_SIZE);
+			int psize;
+			IX_ErrorForward(pf_fh.GetPageSize(psize));
+			memcpy(data, nextdata, psize);
 			pf_fh.DisposePage(nextpnum);
 		}
 		// header automatically got updated as everything was copied
@@ -387,32 +378,25 @@ RC IX_IndexHandle::overflowDelete(PF_PageHandle &ph, const RID& rid, int& numKey
 	return OK_RC;
 }
 
-// copies the contents into char array and null terminates it
-void IX_IndexHandle::buffer(void *ptr, char* buff) const{
-    buff[fHdr.attrLength] = '\0';
-    memcpy(buff, ptr, fHdr.attrLength);
-    return;
-}
-
 
 // operators for comparison
 bool IX_IndexHandle::eq_op(void* attr1, void* attr2) const{
-	IX_operator(==);
+	IX_operator(EQ_OP);
 }
 bool IX_IndexHandle::ne_op(void* attr1, void* attr2) const{
-	IX_operator(!=);
+	IX_operator(NE_OP);
 }
 bool IX_IndexHandle::lt_op(void* attr1, void* attr2) const{
-	IX_operator(<);
+	IX_operator(LT_OP);
 }
 bool IX_IndexHandle::gt_op(void* attr1, void* attr2) const{
-	IX_operator(>);
+	IX_operator(GT_OP);
 }
 bool IX_IndexHandle::le_op(void* attr1, void* attr2) const{
-	IX_operator(<=);	
+	IX_operator(LE_OP);	
 }
 bool IX_IndexHandle::ge_op(void* attr1, void* attr2) const{
-	IX_operator(>=);
+	IX_operator(GE_OP);
 }
 
 /*  Sets res to the index of the first key >= query. Sets it
@@ -4,28 +4,10 @@
 #include <cmath>
 #include "ix.h"
 #include "ix_internal.h"
+#include "predicate.h"
 
 using namespace std;
 
-/* macro for writing comparison operators
-    This occurs in the body of the function having signature
-    bool IX_IndexScan::xx_op(void* attr)
-    where xx = eq, lt, gt etc.
-*/
-#define IX_indexscan_operator(expr) do { \
-    char attr_value[fHdr.attrLength+1];\
-    buffer(attr, attr_value);\
-    switch (fHdr.attrType) { \
-        case INT:\
-            return *((int*) attr_value) expr *((int*) query_value);\
-        case FLOAT: \
-            return *((float*) attr_value) expr *((float*) query_value);\
-        case STRING: \
-            return string(attr_value) expr string(query_value);\
-        default: return 1 == 1;\
-    }\
-}while(0)
-
 IX_IndexScan::IX_IndexScan() {
     bIsOpen = 0;
     leaf_index = 0;
@@ -55,37 +37,19 @@ RC IX_IndexScan::OpenScan(const IX_IndexHandle &indexHandle,
     query_value = new char[fHdr.attrLength + 1];
     if (value) buffer(value, query_value);
     pin_hint = pinHint;
-    switch (compOp) {
-        case NO_OP:
-            comp = &IX_IndexScan::no_op;
-            break;
-        case EQ_OP:
-            comp = &IX_IndexScan::eq_op;
-            break;
-        case LT_OP:
-            comp = &IX_IndexScan::lt_op;
-            break;
-        case GT_OP:
-            comp = &IX_IndexScan::gt_op;
-            break;
-        case LE_OP:
-            comp = &IX_IndexScan::le_op;
-            break;
-        case GE_OP:
-            comp = &IX_IndexScan::ge_op;
-            break;
-        default:
-            return IX_SCAN_INVALID_OPERATOR;
-            break;
-    }
+    comp = PredGetKernel(fHdr.attrType, compOp);
+    if (comp == NULL) return IX_SCAN_INVALID_OPERATOR;
     // seek to the first leaf page
     int pnum = fHdr.root_pnum;
     if (pnum == IX_SENTINEL) return IX_EOF;
     PF_PageHandle ph;
     char *data;
 
+    // the root is kept in the buffer as metadata
+    ClientHint hint = HOT_METADATA;
     do {
-        IX_ErrorForward(pf_fh->GetThisPage(pnum, ph));
+        IX_ErrorForward(pf_fh->GetThisPage(pnum, ph, hint));
+        hint = pin_hint;
         IX_ErrorForward(ph.GetData(data));
         IX_InternalHdr *pHdr = (IX_InternalHdr*) data;
         if (pHdr->type == LEAF) break;
@@ -124,7 +88,7 @@ RC IX_IndexScan::OpenScan(const IX_IndexHandle &indexHandle,
     char *pointers = keys + fHdr.attrLength * fHdr.leaf_capacity;
     found = false;
     for (int i = 0; i < pHdr->num_keys; i++) {
-        if ((this->*comp)(keys + i * fHdr.attrLength)) {
+        if (comp(keys + i * fHdr.attrLength, query_value, fHdr.attrLength)) {
             found = true;
             leaf_index = i;
             break;
@@ -173,7 +137,7 @@ RC IX_IndexScan::GetNextEntry(RID &rid) {
             overflow_index--;
         }
         // get the overflow page
-        IX_ErrorForward(pf_fh->GetThisPage(current_overflow, ph));
+        IX_ErrorForward(pf_fh->GetThisPage(current_overflow, ph, pin_hint));
         int to_unpin = current_overflow;
         char *data;
         IX_ErrorForward(ph.GetData(data));
@@ -210,7 +174,7 @@ RC IX_IndexScan::GetNextEntry(RID &rid) {
             leaf_index--;
         }
         // get the current leaf page
-        IX_ErrorForward(pf_fh->GetThisPage(current_leaf, ph));
+        IX_ErrorForward(pf_fh->GetThisPage(current_leaf, ph, pin_hint));
         int to_unpin = current_leaf;
         char *data;
         IX_ErrorForward(ph.GetData(data));
@@ -218,7 +182,8 @@ RC IX_IndexScan::GetNextEntry(RID &rid) {
         next_leaf = pHdr->right_pnum;
         char* keys = data + sizeof(IX_LeafHdr);
         char* rids = keys + fHdr.attrLength * fHdr.leaf_capacity;
-        if (!(this->*comp)(keys + leaf_index * fHdr.attrLength)) {
+        if (!comp(keys + leaf_index * fHdr.attrLength, query_value,
+                fHdr.attrLength)) {
             // unpin page and raise eof
             IX_ErrorForward(pf_fh->UnpinPage(to_unpin));
             return IX_EOF;
@@ -275,23 +240,3 @@ void IX_IndexScan::buffer(void *ptr, char* buff) {
     memcpy(buff, ptr, fHdr.attrLength);
     return;
 }
-
-// operators for comparison
-bool IX_IndexScan::no_op(void* attr) {
-    return true;
-}
-bool IX_IndexScan::eq_op(void* attr) {
-    IX_indexscan_operator(==);
-}
-bool IX_IndexScan::lt_op(void* attr) {
-    IX_indexscan_operator(<);
-}
-bool IX_IndexScan::gt_op(void* attr) {
-    IX_indexscan_operator(>);
-}
-bool IX_IndexScan::le_op(void* attr) {
-    IX_indexscan_operator(<=);
-}
-bool IX_IndexScan::ge_op(void* attr) {
-    IX_indexscan_operator(>=);
-}
\ No newline at end of file
@@ -4,6 +4,7 @@
 // #include <cmath>
 #include "ix.h"
 #include "ix_internal.h"
+#include "predicate.h"
 
 using namespace std;
 
@@ -28,7 +29,7 @@ IX_Manager::~IX_Manager() {
     8. Close the file
 */
 RC IX_Manager::CreateIndex(const char *fileName, int indexNo,
-    AttrType attrType, int attrLength) {
+    AttrType attrType, int attrLength, int pageSize) {
 	// define default errors to be forwarded
 	RC WARN = IX_MANAGER_CREATE_WARN, ERR = IX_MANAGER_CREATE_ERR;
     // check validity of inputs
@@ -43,11 +44,14 @@ RC IX_Manager::CreateIndex(const char *fileName, int indexNo,
     // create the file
     char fname[MAXNAME + 10];
     sprintf(fname, "%s.%d", fileName, indexNo);
-    IX_ErrorForward(pf_manager->CreateFile(fname));
+    IX_ErrorForward(pf_manager->CreateFile(fname, pageSize));
     // define a file handle and page handles to open the file
     PF_FileHandle fh;
     PF_PageHandle header;
     IX_ErrorForward(pf_manager->OpenFile(fname, fh));
+    // the fanout depends on the page size of the file
+    int psize;
+    IX_ErrorForward(fh.GetPageSize(psize));
     IX_ErrorForward(fh.AllocatePage(header));
     // get the assigned page number
     PageNum header_pnum;
@@ -60,11 +64,12 @@ RC IX_Manager::CreateIndex(const char *fileName, int indexNo,
     fHdr.attrLength = attrLength;
     fHdr.root_pnum = -1;
     fHdr.leaf_capacity =  numKeysPerPage(attrLength, sizeof(RID), 
-    						sizeof(IX_LeafHdr));
+    						sizeof(IX_LeafHdr), psize);
     fHdr.internal_capacity = numKeysPerPage(attrLength, sizeof(PageNum), 
-    						sizeof(IX_InternalHdr));
+    						sizeof(IX_InternalHdr), psize);
     // overflow page has only RIDs
-    fHdr.overflow_capacity = numKeysPerPage(0, sizeof(RID), sizeof(PageNum));
+    fHdr.overflow_capacity = numKeysPerPage(0, sizeof(RID), sizeof(PageNum),
+                            psize);
     fHdr.header_pnum = header_pnum;
     fHdr.attrType = attrType;
     memcpy(contents, &fHdr, sizeof(IX_FileHdr));
@@ -101,7 +106,7 @@ RC IX_Manager::DestroyIndex(const char *fileName, int indexNo) {
     6. Unpin the PF page handle  
 */
 RC IX_Manager::OpenIndex(const char *fileName, int indexNo,
-    IX_IndexHandle &indexHandle) {
+    IX_IndexHandle &indexHandle, int ioMode) {
 	RC WARN = IX_MANAGER_OPEN_WARN, ERR = IX_MANAGER_OPEN_ERR; // used by macro
     if (indexHandle.bIsOpen) {
         IX_ErrorForward(1); // Positive number for warning
@@ -109,13 +114,17 @@ RC IX_Manager::OpenIndex(const char *fileName, int indexNo,
     if (!fileName) return IX_NULL_FILENAME;
     char fname[MAXNAME + 10];
     sprintf(fname, "%s.%d", fileName, indexNo);
-    IX_ErrorForward(pf_manager->OpenFile(fname, indexHandle.pf_fh));
+    IX_ErrorForward(pf_manager->OpenFile(fname, indexHandle.pf_fh, ioMode));
     PF_PageHandle header;
     // First page is the header page 
     IX_ErrorForward(indexHandle.pf_fh.GetFirstPage(header));
     char *data;
     IX_ErrorForward(header.GetData(data));
     memcpy(&indexHandle.fHdr, data, sizeof(IX_FileHdr));
+    // pick the comparison kernels for the key type
+    for (int op = NO_OP; op <= GE_OP; op++)
+        indexHandle.kernels[op] = PredGetKernel(indexHandle.fHdr.attrType,
+                                                (CompOp) op);
     // get the assigned page number
     PageNum header_pnum;
     IX_ErrorForward(header.GetPageNum(header_pnum));
@@ -160,9 +169,10 @@ RC IX_Manager::CloseIndex(IX_IndexHandle &indexHandle) {
 	page contains a page header, x keys and (x+1) pointers. This 
 	function calculates the maximum possible value of x.
 */
-int IX_Manager::numKeysPerPage(int key_size, int pointer_size, int header) {
+int IX_Manager::numKeysPerPage(int key_size, int pointer_size, int header,
+        int page_size) {
     int num = 0;
-    int effective_psize = PF_PAGE_SIZE - header;
+    int effective_psize = page_size - header;
     while (num * (key_size + pointer_size) <= effective_psize) num++;
     return num - 1;
 }
\ No newline at end of file
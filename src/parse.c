@@ -86,6 +86,7 @@
 #include <sys/types.h>
 #include <cstdlib>
 #include <unistd.h>
+#include <mutex>    // for statistics.h, before printer.h defines min
 #include "redbase.h"
 #include "parser_internal.h"
 #include "pf.h"     // for PF_PrintError
@@ -111,6 +112,10 @@ void yyrestart(FILE*);
 // This is defined within the pf_buffermgr.cc
 extern StatisticsMgr *pStatisticsMgr;
 
+// These are defined within pf_statistics.cc
+void PF_PrintIOStats();
+void PF_ResetIOStats();
+
 #endif    // PF_STATS
 
 /*
@@ -1558,6 +1563,8 @@ yyreduce:
          cout << "Statistics\n";
          cout << "----------\n";
          pStatisticsMgr->Print();
+         cout << "\n";
+         PF_PrintIOStats();
       #else
          cout << "Statitisics not compiled.\n";
       #endif
@@ -1572,6 +1579,7 @@ yyreduce:
       #ifdef PF_STATS
          cout << "Statistics reset.\n";
          pStatisticsMgr->Reset();
+         PF_ResetIOStats();
       #else
          cout << "Statitisics not compiled.\n";
       #endif
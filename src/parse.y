@@ -21,6 +21,7 @@
 #include <sys/types.h>
 #include <cstdlib>
 #include <unistd.h>
+#include <mutex>    // for statistics.h, before printer.h defines min
 #include "redbase.h"
 #include "parser_internal.h"
 #include "pf.h"     // for PF_PrintError
@@ -46,6 +47,10 @@ void yyrestart(FILE*);
 // This is defined within the pf_buffermgr.cc
 extern StatisticsMgr *pStatisticsMgr;
 
+// These are defined within pf_statistics.cc
+void PF_PrintIOStats();
+void PF_ResetIOStats();
+
 #endif    // PF_STATS
 
 /*
@@ -272,6 +277,8 @@ statistics
          cout << "Statistics\n";
          cout << "----------\n";
          pStatisticsMgr->Print();
+         cout << "\n";
+         PF_PrintIOStats();
       #else
          cout << "Statitisics not compiled.\n";
       #endif
@@ -282,6 +289,7 @@ statistics
       #ifdef PF_STATS
          cout << "Statistics reset.\n";
          pStatisticsMgr->Reset();
+         PF_ResetIOStats();
       #else
          cout << "Statitisics not compiled.\n";
       #endif
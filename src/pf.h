@@ -16,6 +16,7 @@
 #ifndef PF_H
 #define PF_H
 
+#include <memory>
 #include "redbase.h"
 
 //
@@ -32,9 +33,17 @@ typedef int PageNum;
 //
 const int PF_PAGE_SIZE = 4096 - sizeof(int);
 // const int PF_PAGE_SIZE = 60; // use for debugging
+
+// Files may be created with larger pages (see PF_Manager::CreateFile).
+// Page sizes on disk are powers of two between these two; the usable
+// part of a page is sizeof(int) less, as above.
+const int PF_MIN_DISK_PAGE_SIZE = 4096;
+const int PF_MAX_DISK_PAGE_SIZE = 65536;
 //
 // PF_PageHandle: PF page interface
 //
+class PF_Latch;
+
 class PF_PageHandle {
    friend class PF_FileHandle;
 public:
@@ -49,23 +58,44 @@ public:
    RC GetData     (char *&pData) const;           // Set pData to point to
                                                   // the page contents
    RC GetPageNum  (PageNum &pageNum) const;       // Return the page number
+
+   // Latch the page shared (to read it) or exclusive (to change it),
+   // and release the latch.  Only needed when several threads use the
+   // same pages.  Release the latch before unpinning the page; a latch
+   // still held when the handle is destroyed, assigned to or set to
+   // another page is released then.
+   RC LatchShared    ();
+   RC LatchExclusive ();
+   RC Unlatch        ();
 private:
+   // Refer to a page, unlatched, releasing any latch held before
+   void SetPage (PageNum pageNum, char *pPageData, PF_Latch *pLatch);
+
    int  pageNum;                                  // page number
    char *pPageData;                               // pointer to page data
+   PF_Latch *pLatch;                              // latch of the page
+   int  latchMode;                                // latch held, if any
 };
 
 //
 // PF_FileHdr: Header structure for files
 //
 struct PF_FileHdr {
-   int firstFree;     // first free page in the linked list
+   int firstFree;     // first free page in the linked list (not used
+                      // once the file has a used-page map)
    int numPages;      // # of pages in the file
+   int pageSize;      // size of a page on disk (0 in older files: 4096)
+   int bUsedMap;      // TRUE if the used-page map is kept (0 in older files)
+   int firstMapPage;  // first page holding more of the map, if any
 };
 
 //
 // PF_FileHandle: PF File interface
 //
 class PF_BufferMgr;
+struct PF_UsedMap;
+struct PF_WarmList;
+struct PF_TempFiles;
 
 class PF_FileHandle {
    friend class PF_Manager;
@@ -80,39 +110,161 @@ public:
    // Overload =
    PF_FileHandle& operator=(const PF_FileHandle &fileHandle);
 
+   // The pages are asked for with a ClientHint (see redbase.h) that
+   // tells the buffer manager how they will be used
+
    // Get the first page
-   RC GetFirstPage(PF_PageHandle &pageHandle) const;
+   RC GetFirstPage(PF_PageHandle &pageHandle,
+                   ClientHint hint = NO_HINT) const;
    // Get the next page after current
-   RC GetNextPage (PageNum current, PF_PageHandle &pageHandle) const;
+   RC GetNextPage (PageNum current, PF_PageHandle &pageHandle,
+                   ClientHint hint = NO_HINT) const;
    // Get a specific page
-   RC GetThisPage (PageNum pageNum, PF_PageHandle &pageHandle) const;
+   RC GetThisPage (PageNum pageNum, PF_PageHandle &pageHandle,
+                   ClientHint hint = NO_HINT) const;
    // Get the last page
-   RC GetLastPage(PF_PageHandle &pageHandle) const;
+   RC GetLastPage(PF_PageHandle &pageHandle,
+                  ClientHint hint = NO_HINT) const;
    // Get the prev page after current
-   RC GetPrevPage (PageNum current, PF_PageHandle &pageHandle) const;
+   RC GetPrevPage (PageNum current, PF_PageHandle &pageHandle,
+                   ClientHint hint = NO_HINT) const;
+
+   // Allocate a new page
+   RC AllocatePage(PF_PageHandle &pageHandle, ClientHint hint = NO_HINT);
 
-   RC AllocatePage(PF_PageHandle &pageHandle);    // Allocate a new page
+   // Allocate numPages pages with consecutive numbers, which lie one
+   // after the other on disk.  The pages are zeroed and not pinned;
+   // firstPage is set to the number of the first one.
+   RC AllocatePages(int numPages, PageNum &firstPage);
    RC DisposePage (PageNum pageNum);              // Dispose of a page
    RC MarkDirty   (PageNum pageNum) const;        // Mark page as dirty
    RC UnpinPage   (PageNum pageNum) const;        // Unpin the page
 
+   // Mark a pinned page dirty, having changed length bytes of its data
+   // at offset.  For a logged file (see PF_Manager::OpenLog) only those
+   // bytes are logged, where MarkDirty has the whole page logged.
+   RC LogChange   (PageNum pageNum, int offset, int length) const;
+
    // Flush pages from buffer pool.  Will write dirty pages to disk.
+   // The changes to a logged file are logged instead, and its pages
+   // stay in the buffer.
    RC FlushPages  () const;
 
-   // Force a page or pages to disk (but do not remove from the buffer pool)
+   // Force a page or pages to disk (but do not remove from the buffer
+   // pool).  The changes to a logged file are logged instead.
    RC ForcePages  (PageNum pageNum=ALL_PAGES) const;
 
+   // Return the number of bytes of data on each page of the file,
+   // PF_PAGE_SIZE unless the file was created with larger pages
+   RC GetPageSize (int &pageSize) const;
+
 private:
 
    // IsValidPageNum will return TRUE if page number is valid and FALSE
    // otherwise
    int IsValidPageNum (PageNum pageNum) const;
 
+   // Note an access to pageNum and start readahead if the file is being
+   // read sequentially
+   void ReadAhead (PageNum pageNum, ClientHint hint) const;
+
+   // Write the file header back to the file.  GetHdrPage fills a
+   // header page; LogPages logs the header and pages of a logged file.
+   RC WriteHdr    () const;
+   void GetHdrPage(char *pBuf) const;
+   RC LogPages    () const;
+
+   // Point pageHandle into the mapping of a file opened PF_IO_MMAP
+   RC GetMappedPage(PageNum pageNum, PF_PageHandle &pageHandle) const;
+
+   // Used-page map.  ReadMap loads it when the file is opened, given the
+   // header page; WriteMap puts the changed map pages in the buffer.
+   RC ReadMap     (const char *pHdrPage);
+   RC WriteMap    () const;
+   int IsUsedPage (PageNum pageNum) const;        // TRUE if allocated
+   void SetUsed   (PageNum pageNum, int bUsed);   // Set the bit of a page
+   PageNum FindFreePage () const;                 // -1 if there is none
+   PageNum FindFreeRun  (int numPages) const;     // see AllocatePages
+   RC AddMapPage  ();                             // Grow the map by a page
+
+   // Get a buffer frame for a free or new page without reading it
+   RC NewPage     (PageNum pageNum, char **ppPageBuf, PF_Latch **ppLatch,
+                   ClientHint hint);
+
+   // Make room on disk for the first numPages pages of the file
+   void Preallocate (PageNum numPages);
+
    PF_BufferMgr *pBufferMgr;                      // pointer to buffer manager
-   PF_FileHdr hdr;                                // file header
+   std::shared_ptr<PF_FileHdr> pHdr;              // file header
    int bFileOpen;                                 // file open flag
    int bHdrChanged;                               // dirty flag for file hdr
    int unixfd;                                    // OS file descriptor
+   int bDirectIO;                                 // TRUE if opened O_DIRECT
+   int bMapped;                                   // TRUE if opened PF_IO_MMAP
+   std::shared_ptr<char> pMap;                    // mapping of the file
+   long mapSize;                                  // length of the mapping
+   std::shared_ptr<PF_UsedMap> pUsedMap;          // used-page map
+   PF_TempFiles *pTempFiles;                      // set for a temporary file
+   int extentPages;                               // pages to grow the file by
+   PageNum extentEnd;                             // pages with room on disk
+   int logId;                                     // id in the write-ahead
+                                                  // log, -1 if not logged
+
+   // Sequential access detection.  These change on every page access,
+   // which is a const operation, hence mutable.
+   mutable PageNum raNextPage;                    // next page if sequential
+   mutable int raRunLength;                       // sequential pages so far
+   mutable PageNum raHorizon;                     // readahead asked up to here
+};
+
+//
+// I/O modes for PF_Manager::OpenFile
+//
+#define PF_IO_DEFAULT      0      // as the "direct_io" setting says
+#define PF_IO_BUFFERED     1      // through the operating system cache
+#define PF_IO_DIRECT       2      // around it (O_DIRECT), if the file
+                                  // system allows
+#define PF_IO_MMAP         3      // read only, straight from a memory
+                                  // mapping of the file
+#define PF_IO_UNLOGGED     4      // or'ed in: keep the file out of the
+                                  // write-ahead log
+
+//
+// PF_MemGrant: work memory granted to one query operator
+//
+// Operators that need scratch memory (sorts, joins) ask the PF_Manager
+// for a grant and take their blocks from it, rather than from the buffer
+// pool.  Grants come out of the "work_mem" pool, which is kept apart from
+// the buffer, so that operators neither push out cached pages nor fail
+// for want of frames.  The blocks are GetBlockSize bytes, like those of
+// the buffer.
+//
+class PF_MemBroker;
+class PF_LogMgr;
+struct PF_KeptFiles;
+
+class PF_MemGrant {
+   friend class PF_MemBroker;
+public:
+   PF_MemGrant  ();                              // Constructor
+   ~PF_MemGrant ();                              // Destructor, releases
+
+   int GetNumPages () const;                      // Blocks granted
+
+   RC AllocateBlock (char *&buffer);              // PF_NOBUF when all of
+                                                  // the grant is in use
+   RC DisposeBlock  (char *buffer);
+
+   // Give the grant back to the pool.  Blocks not yet disposed of are
+   // lost to the grant (PF_PAGEPINNED).
+   RC Release       ();
+private:
+   PF_MemGrant (const PF_MemGrant &);             // Not copyable
+   PF_MemGrant &operator= (const PF_MemGrant &);
+
+   PF_MemBroker *pBroker;                         // NULL if not granted
+   int numPages;                                  // blocks granted
+   int numUsed;                                   // blocks allocated
 };
 
 //
@@ -122,11 +274,23 @@ class PF_Manager {
 public:
    PF_Manager    ();                              // Constructor
    ~PF_Manager   ();                              // Destructor
-   RC CreateFile    (const char *fileName);       // Create a new file
+   // Create a new file.  pageSize is the size of its pages on disk, or
+   // 0 for the "page_size" setting
+   RC CreateFile    (const char *fileName, int pageSize = 0);
    RC DestroyFile   (const char *fileName);       // Delete a file
 
+   // Create a temporary file, for sort runs and other intermediate
+   // results.  It is known by fileName to this PF_Manager only and is
+   // opened, closed and destroyed like any other file, but is never seen
+   // in a directory: its pages are kept in memory as long as the
+   // "temp_mem" setting allows.  It is gone when the program ends.
+   RC CreateTempFile(const char *fileName, int pageSize = 0);
+   // Rename a file, or a temporary file to another temporary name
+   RC RenameFile    (const char *oldName, const char *newName);
+
    // Open and close file methods
-   RC OpenFile      (const char *fileName, PF_FileHandle &fileHandle);
+   RC OpenFile      (const char *fileName, PF_FileHandle &fileHandle,
+                     int ioMode = PF_IO_DEFAULT);
    RC CloseFile     (PF_FileHandle &fileHandle);
 
    // Three methods that manipulate the buffer manager.  The calls are
@@ -136,6 +300,16 @@ public:
    RC PrintBuffer   ();
    RC ResizeBuffer  (int iNewSize);
 
+   // Return the number of pages in the buffer pool
+   RC GetBufferSize (int &numPages) const;
+
+   // Buffer dumps (pf_bufdump.cc).  DumpBuffer writes the list of pages
+   // in the buffer to fileName, along with the pages files held when
+   // they were last closed.  RestoreBuffer reads such a list back and
+   // brings the pages in the background, each file's as it is opened.
+   RC DumpBuffer    (const char *fileName);
+   RC RestoreBuffer (const char *fileName);
+
    // Three Methods for manipulating raw memory buffers.  These memory
    // locations are handled by the buffer manager, but are not
    // associated with a particular file.  These should be used if you
@@ -155,10 +329,54 @@ public:
    // Dispose of a memory chunk managed by the buffer manager.
    RC DisposeBlock  (char *buffer);
 
+   // Work memory for query operators (pf_membroker.cc).  GrantWorkMem
+   // grants up to numPages blocks of the "work_mem" pool, and no fewer
+   // than minPages (PF_NOBUF if the pool has not that many left).
+   // GetWorkMemSize returns the size of the pool.
+   RC GrantWorkMem  (int numPages, int minPages, PF_MemGrant &grant);
+   RC GetWorkMemSize(int &numPages) const;
+
+   // Write-ahead log (pf_logmgr.cc).  OpenLog first redoes the changes
+   // a log of that name was left with, then logs the changes to the
+   // files opened from then on, except temporary files and those opened
+   // PF_IO_MMAP or PF_IO_UNLOGGED.  The pages of logged files are not
+   // written when they are flushed, forced or closed, only when they are
+   // replaced in the buffer or the log is closed.  Commit logs the
+   // pages changed since their last record and makes the log durable,
+   // with one sync for all the changes.  CloseLog writes the files out
+   // and empties the log.  Nothing is logged if the "wal" setting is off.
+   RC OpenLog       (const char *fileName);
+   RC CloseLog      ();
+   RC Commit        ();
+
 private:
+   // Remember the pages of a file in the buffer as it is closed, and
+   // bring back the dumped pages of a file as it is opened
+   void NoteClose   (const PF_FileHandle &fileHandle);
+   void NoteOpen    (const char *fileName, const PF_FileHandle &fileHandle);
+
+   // Keep a logged file open as it is closed, and write back and close
+   // a kept file for real (see PF_KeptFiles)
+   RC KeepFile      (PF_FileHandle &fileHandle);
+   RC WriteBack     (const char *fileName);
+   // Write the dirty pages of the kept files, leaving them open
+   RC ForceKeptFiles();
+
    PF_BufferMgr *pBufferMgr;                      // page-buffer manager
+   PF_WarmList  *pWarmList;                       // pages for buffer dumps
+   PF_MemBroker *pMemBroker;                      // work memory pool
+   PF_TempFiles *pTempFiles;                      // temporary files
+   PF_LogMgr    *pLog;                            // write-ahead log
+   PF_KeptFiles *pKeptFiles;                      // logged files kept open
 };
 
+//
+// Read run-time settings (such as "buffer_size") from a configuration
+// file.  Must be called before the PF_Manager is constructed for the
+// settings to take effect.
+//
+RC PF_LoadConfig(const char *fileName);
+
 //
 // Print-error function and PF return code defines
 //
@@ -173,7 +391,11 @@ void PF_PrintError(RC rc);
 #define PF_PAGEUNPINNED    (START_PF_WARN + 6) // page already unpinned
 #define PF_EOF             (START_PF_WARN + 7) // end of file
 #define PF_TOOSMALL        (START_PF_WARN + 8) // Resize buffer too small
-#define PF_LASTWARN        PF_TOOSMALL
+#define PF_LATCHED         (START_PF_WARN + 9) // page already latched
+#define PF_NOTLATCHED      (START_PF_WARN + 10) // page is not latched
+#define PF_READONLY        (START_PF_WARN + 11) // file opened read only
+#define PF_BADPAGESIZE     (START_PF_WARN + 12) // page size not allowed
+#define PF_LASTWARN        PF_BADPAGESIZE
 
 #define PF_NOMEM           (START_PF_ERR - 0)  // no memory
 #define PF_NOBUF           (START_PF_ERR - 1)  // no buffer space
@@ -0,0 +1,163 @@
+//
+// File:        pf_arena.cc
+// Description: PF_Arena class implementation
+//
+
+#include <sys/mman.h>
+#include "pf_arena.h"
+
+#ifndef MAP_HUGETLB
+#define MAP_HUGETLB 0
+#endif
+
+//
+// RoundUp
+//
+// Desc: Internal.  Round n up to a multiple of PF_HUGE_PAGE_SIZE
+//
+static size_t RoundUp(size_t n)
+{
+   return ((n + PF_HUGE_PAGE_SIZE - 1) / PF_HUGE_PAGE_SIZE * PF_HUGE_PAGE_SIZE);
+}
+
+//
+// PF_Arena
+//
+// Desc: Constructor.  The arena holds no memory until Reserve is called.
+//
+PF_Arena::PF_Arena()
+{
+   base = NULL;
+   reserved = mapped = 0;
+   bHugePages = TRUE;
+}
+
+//
+// ~PF_Arena
+//
+// Desc: Destructor.  Gives back the whole range.
+//
+PF_Arena::~PF_Arena()
+{
+   if (base != NULL)
+      munmap(base, reserved);
+}
+
+//
+// Reserve
+//
+// Desc: Reserve the address range of the arena.  Nothing is usable until
+//       Resize is called.  If the system will not reserve maxBytes (for
+//       example under a ulimit -v), half as much is tried, down to
+//       minBytes.
+// In:   maxBytes - largest size the arena may grow to
+//       minBytes - smallest reservation that will do
+//       _bHugePages - FALSE to use normal pages only
+// Ret:  PF_NOMEM if the range cannot be reserved
+//
+RC PF_Arena::Reserve(size_t maxBytes, size_t minBytes, int _bHugePages)
+{
+   bHugePages = _bHugePages;
+   maxBytes = RoundUp(maxBytes);
+   minBytes = RoundUp(minBytes > 0 ? minBytes : 1);
+
+   // Ask for one huge page more than needed so that the range can be
+   // aligned
+   void *p;
+   for (reserved = maxBytes; ; reserved = RoundUp(reserved / 2)) {
+      if (reserved < minBytes)
+         reserved = minBytes;
+      p = mmap(NULL, reserved + PF_HUGE_PAGE_SIZE, PROT_NONE,
+               MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+      if (p != MAP_FAILED || reserved == minBytes)
+         break;
+   }
+   if (p == MAP_FAILED)
+      return (PF_NOMEM);
+
+   // Trim the range to an aligned one
+   char *start = (char *)p;
+   base = (char *)RoundUp((size_t)start);
+   if (base > start)
+      munmap(start, base - start);
+   munmap(base + reserved, start + PF_HUGE_PAGE_SIZE - base);
+
+   // Return ok
+   return (0);
+}
+
+//
+// Resize
+//
+// Desc: Map memory into the arena, or give it back, so that exactly the
+//       first numBytes (rounded up to a huge page) are usable.  New
+//       memory reads as zeroes.
+// In:   numBytes - bytes needed
+// Ret:  PF_NOMEM if the memory cannot be had
+//
+RC PF_Arena::Resize(size_t numBytes)
+{
+   size_t newMapped = RoundUp(numBytes);
+
+   if (newMapped > reserved)
+      return (PF_NOMEM);
+
+   if (newMapped < mapped) {
+      // Replace the tail by reserved, unbacked address space
+      if (mmap(base + newMapped, mapped - newMapped, PROT_NONE,
+               MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_NORESERVE,
+               -1, 0) == MAP_FAILED)
+         return (PF_NOMEM);
+      chunkHugeTLB.resize(newMapped / PF_HUGE_PAGE_SIZE);
+   }
+   else if (newMapped > mapped) {
+      size_t length = newMapped - mapped;
+      int bHugeTLB = FALSE;
+
+      // Explicit huge pages fail unless the administrator has set some
+      // aside, in which case fall back to normal pages, and ask for them
+      // to be merged into transparent huge pages
+      if (bHugePages && MAP_HUGETLB &&
+            mmap(base + mapped, length, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_HUGETLB,
+                 -1, 0) != MAP_FAILED)
+         bHugeTLB = TRUE;
+      else {
+         if (mmap(base + mapped, length, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0)
+               == MAP_FAILED)
+            return (PF_NOMEM);
+#ifdef MADV_HUGEPAGE
+         if (bHugePages)
+            madvise(base + mapped, length, MADV_HUGEPAGE);
+#endif
+      }
+      chunkHugeTLB.resize(newMapped / PF_HUGE_PAGE_SIZE, bHugeTLB);
+   }
+
+   mapped = newMapped;
+
+   // Return ok
+   return (0);
+}
+
+//
+// Backing
+//
+// Desc: Describe the pages behind the arena
+// Ret:  description
+//
+const char *PF_Arena::Backing() const
+{
+   int numHugeTLB = 0;
+   for (size_t i = 0; i < chunkHugeTLB.size(); i++)
+      numHugeTLB += chunkHugeTLB[i];
+
+   if (numHugeTLB == (int)chunkHugeTLB.size() && numHugeTLB > 0)
+      return ("explicit huge pages");
+   if (!bHugePages)
+      return ("normal pages");
+   if (numHugeTLB == 0)
+      return ("transparent huge pages");
+   return ("explicit and transparent huge pages");
+}
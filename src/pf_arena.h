@@ -0,0 +1,62 @@
+//
+// File:        pf_arena.h
+// Description: PF_Arena class interface
+//
+// The frames of the buffer pool are carved out of one contiguous region
+// of memory.  The whole address range the pool could ever grow to is
+// reserved once, without backing memory, and is aligned on a huge page
+// boundary.  Memory is mapped into the front of the range as the pool
+// grows and given back as it shrinks, so the frames never move.
+//
+// Each part of the region is mapped with explicit huge pages (hugetlbfs)
+// if the system has some to spare, and otherwise with normal pages that
+// the kernel is asked to back with transparent huge pages.  Setting
+// "huge_pages" (see pf_config.cc) to "off" asks for normal pages only.
+//
+
+#ifndef PF_ARENA_H
+#define PF_ARENA_H
+
+#include <cstddef>
+#include <vector>
+#include "pf_internal.h"
+
+//
+// Defines
+//
+#define PF_HUGE_PAGE_SIZE  (2 << 20)   // Alignment and mapping granularity
+
+//
+// PF_Arena - contiguous, huge page aligned memory for the buffer frames
+//
+class PF_Arena {
+public:
+    PF_Arena  ();                               // Constructor
+    ~PF_Arena ();                               // Destructor
+
+    // Reserve address space for up to maxBytes (less if the system
+    // refuses, but at least minBytes)
+    RC   Reserve  (size_t maxBytes, size_t minBytes, int bHugePages);
+
+    // Make the first numBytes of the arena usable.  Memory beyond them
+    // is given back.  Memory kept keeps its contents.
+    RC   Resize   (size_t numBytes);
+
+    char   *Base     () const { return (base); }
+    size_t Reserved  () const { return (reserved); }
+
+    // How the memory of the arena is backed, for PrintBuffer
+    const char *Backing () const;
+
+private:
+    char   *base;                               // start of the range
+    size_t reserved;                            // bytes of address space
+    size_t mapped;                              // bytes usable, from base
+    int    bHugePages;                          // FALSE if "huge_pages=off"
+
+    // For each PF_HUGE_PAGE_SIZE chunk mapped, TRUE if it is on explicit
+    // huge pages
+    std::vector<char> chunkHugeTLB;
+};
+
+#endif
@@ -0,0 +1,659 @@
+//
+// File:        pf_bench.cc
+// Description: Benchmark of the PF buffer manager
+//
+// Replays page reference traces against the buffer pool once for every
+// replacement policy and reports the hit ratio of each.  The traces mix
+// the access patterns of the layers above PF:
+//
+//    scan+lookup  point lookups on a small hot set (the catalogs and the
+//                 upper levels of the indexes) interleaved with full
+//                 scans of a relation larger than the buffer
+//    zipf         skewed random lookups over the whole file
+//    loop         repeated scans of a file slightly larger than the
+//                 buffer
+//
+// For scan+lookup the hit ratio of the lookups alone is given as well,
+// since that is what a scan-resistant policy protects.  Readahead is
+// turned off for these runs so that only the policy is measured.
+//
+// It then times full scans of the file, with the file dropped from the
+// operating system cache first, with and without readahead, through the
+// buffer pool with buffered and with direct I/O, and straight from a
+// memory mapping of the file (PF_IO_MMAP).  It counts
+// how many dirty pages random updates had to write in the foreground,
+// with and without the background writer.
+//
+// Last, 1, 2, 4, ... threads up to the number of cores (at least 4)
+// share the buffer, each with its own copy of the file handle.  They
+// read random pages under a shared latch and update one in eight under
+// an exclusive latch.  Once over a working set that fits in the buffer,
+// which measures how GetPage scales, and once over the whole file, which
+// adds misses and replacement.  The updates increment a counter on the
+// page, and the counters are checked afterwards to add up to the number
+// of updates made.
+//
+// The PF layer must be compiled with -DPF_STATS.
+//
+// Usage: pf_bench [buffer pages]
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <thread>
+#include <vector>
+#include "pf.h"
+
+using namespace std;
+
+#ifdef PF_STATS
+#include "statistics.h"
+
+// This is defined within pf_buffermgr.cc
+extern StatisticsMgr *pStatisticsMgr;
+#endif
+
+//
+// Defines
+//
+#define BENCHFILE       "pf_bench.data"
+#define FILE_PAGES      4000      // pages in the benchmark file
+#define HOT_PAGES       64        // pages in the hot set
+#define NUM_ROUNDS      10        // times each trace is repeated
+#define LOOKUPS_PER_SCAN_PAGE 1   // lookups between two scanned pages
+#define THREAD_OPS      200000    // page accesses per thread
+#define UPDATE_EVERY    8         // one access in this many is an update
+#define COUNTER_OFFSET  64        // place of the update counter on a page
+
+static int bufferPages = 256;     // pages in the buffer
+
+//
+// Counters kept while a trace runs
+//
+struct BenchCounts {
+   long gets;                     // GetThisPage calls
+   long hits;                     // of which found in the buffer
+   long lookupGets;               // GetThisPage calls for lookups
+   long lookupHits;               // of which found in the buffer
+};
+
+//
+// PagesFound
+//
+// Desc: Number of GetPage calls so far that found the page in the buffer
+//
+static long PagesFound()
+{
+#ifdef PF_STATS
+   int *piPF = pStatisticsMgr->Get(PF_PAGEFOUND);
+   long found = piPF ? *piPF : 0;
+   delete piPF;
+   return (found);
+#else
+   return (0);
+#endif
+}
+
+//
+// Touch
+//
+// Desc: Reference one page: pin it, read it and unpin it
+// In:   fh - open file
+//       pageNum - page to reference
+//       bLookup - TRUE if the reference is a point lookup
+// Out:  counts - updated
+// Ret:  PF return code
+//
+static RC Touch(PF_FileHandle &fh, PageNum pageNum, int bLookup,
+                BenchCounts &counts)
+{
+   RC rc;
+   PF_PageHandle ph;
+   char *pData;
+   long found = PagesFound();
+
+   if ((rc = fh.GetThisPage(pageNum, ph)) ||
+         (rc = ph.GetData(pData)))
+      return (rc);
+   if (*(PageNum *)pData != pageNum) {
+      cerr << "Page " << pageNum << " holds the wrong data\n";
+      exit(1);
+   }
+   if ((rc = fh.UnpinPage(pageNum)))
+      return (rc);
+
+   int bHit = PagesFound() > found;
+   counts.gets++;
+   counts.hits += bHit;
+   if (bLookup) {
+      counts.lookupGets++;
+      counts.lookupHits += bHit;
+   }
+   return (0);
+}
+
+//
+// TraceScanLookup
+//
+// Desc: Lookups on the hot pages at the front of the file interleaved
+//       with scans of the rest of the file
+//
+static RC TraceScanLookup(PF_FileHandle &fh, BenchCounts &counts)
+{
+   RC rc;
+   for (int round = 0; round < NUM_ROUNDS; round++) {
+      for (PageNum p = HOT_PAGES; p < FILE_PAGES; p++) {
+         if ((rc = Touch(fh, p, FALSE, counts)))
+            return (rc);
+         for (int i = 0; i < LOOKUPS_PER_SCAN_PAGE; i++)
+            if ((rc = Touch(fh, rand() % HOT_PAGES, TRUE, counts)))
+               return (rc);
+      }
+   }
+   return (0);
+}
+
+//
+// TraceZipf
+//
+// Desc: Random lookups over the whole file, skewed towards low pages
+//
+static RC TraceZipf(PF_FileHandle &fh, BenchCounts &counts)
+{
+   RC rc;
+   for (long i = 0; i < (long)NUM_ROUNDS * FILE_PAGES; i++) {
+      // Page numbers drawn with density proportional to 1/x
+      double u = (double)rand() / RAND_MAX;
+      PageNum p = (PageNum)(pow((double)FILE_PAGES, u)) - 1;
+      if ((rc = Touch(fh, p, TRUE, counts)))
+         return (rc);
+   }
+   return (0);
+}
+
+//
+// TraceLoop
+//
+// Desc: Repeated scans of slightly more pages than fit in the buffer
+//
+static RC TraceLoop(PF_FileHandle &fh, BenchCounts &counts)
+{
+   RC rc;
+   int loopPages = bufferPages + bufferPages / 8;
+   if (loopPages > FILE_PAGES)
+      loopPages = FILE_PAGES;
+   for (int round = 0; round < 4 * NUM_ROUNDS; round++)
+      for (PageNum p = 0; p < loopPages; p++)
+         if ((rc = Touch(fh, p, FALSE, counts)))
+            return (rc);
+   return (0);
+}
+
+//
+// Traces and policies to run
+//
+struct BenchTrace {
+   const char *name;
+   RC (*run)(PF_FileHandle &fh, BenchCounts &counts);
+};
+
+static BenchTrace traces[] = {
+   { "scan+lookup", TraceScanLookup },
+   { "zipf",        TraceZipf },
+   { "loop",        TraceLoop },
+};
+
+static const char *policies[] = { "lru", "clock", "2q" };
+
+//
+// CreateBenchFile
+//
+// Desc: Create the benchmark file, each page holding its page number
+//
+static RC CreateBenchFile()
+{
+   RC rc;
+   PF_Manager pfm;
+   PF_FileHandle fh;
+   PF_PageHandle ph;
+   char *pData;
+   PageNum pageNum;
+
+   unlink(BENCHFILE);
+   if ((rc = pfm.CreateFile(BENCHFILE)) ||
+         (rc = pfm.OpenFile(BENCHFILE, fh)))
+      return (rc);
+
+   for (int i = 0; i < FILE_PAGES; i++) {
+      if ((rc = fh.AllocatePage(ph)) ||
+            (rc = ph.GetData(pData)) ||
+            (rc = ph.GetPageNum(pageNum)))
+         return (rc);
+      memcpy(pData, &pageNum, sizeof(PageNum));
+      if ((rc = fh.MarkDirty(pageNum)) ||
+            (rc = fh.UnpinPage(pageNum)))
+         return (rc);
+   }
+
+   return (pfm.CloseFile(fh));
+}
+
+//
+// RunTrace
+//
+// Desc: Run one trace with one replacement policy, from a cold buffer
+//
+static RC RunTrace(const BenchTrace &trace, const char *policy)
+{
+   RC rc;
+   char size[20];
+
+   // The buffer manager reads its settings when it is created
+   sprintf(size, "%d", bufferPages);
+   setenv("REDBASE_BUFFER_SIZE", size, 1);
+   setenv("REDBASE_REPLACEMENT", policy, 1);
+   setenv("REDBASE_READAHEAD_PAGES", "0", 1);
+
+   PF_Manager pfm;
+   PF_FileHandle fh;
+   BenchCounts counts = { 0, 0, 0, 0 };
+
+   srand(1);
+   if ((rc = pfm.OpenFile(BENCHFILE, fh)) ||
+         (rc = trace.run(fh, counts)) ||
+         (rc = pfm.CloseFile(fh)))
+      return (rc);
+
+   cout << setw(12) << trace.name << setw(8) << policy
+        << setw(10) << counts.gets
+        << setw(10) << fixed << setprecision(3)
+        << (double)counts.hits / counts.gets;
+   if (counts.lookupGets && counts.lookupGets != counts.gets)
+      cout << setw(10) << (double)counts.lookupHits / counts.lookupGets;
+   cout << "\n";
+   return (0);
+}
+
+//
+// DropCache
+//
+// Desc: Ask the operating system to drop the benchmark file from its
+//       cache, so that a scan has to go to the disk
+//
+static void DropCache()
+{
+   int fd = open(BENCHFILE, O_RDONLY);
+   if (fd < 0)
+      return;
+   fdatasync(fd);
+   posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+   close(fd);
+}
+
+//
+// RunScan
+//
+// Desc: Time full scans of the file through GetNextPage
+// In:   raPages - readahead setting to use
+//       ioMode - how to open the file
+//
+static RC RunScan(const char *raPages, int ioMode)
+{
+   RC rc;
+   char size[20];
+   struct timeval start, end;
+   const int numScans = 4;
+
+   sprintf(size, "%d", bufferPages);
+   setenv("REDBASE_BUFFER_SIZE", size, 1);
+   setenv("REDBASE_REPLACEMENT", "lru", 1);
+   setenv("REDBASE_READAHEAD_PAGES", raPages, 1);
+
+   PF_Manager pfm;
+   PF_FileHandle fh;
+   PF_PageHandle ph;
+   PageNum pageNum;
+   double elapsed = 0;
+   long numPages = 0;
+
+   if ((rc = pfm.OpenFile(BENCHFILE, fh, ioMode)))
+      return (rc);
+   for (int i = 0; i < numScans; i++) {
+      DropCache();
+      gettimeofday(&start, NULL);
+      pageNum = -1;
+      while ((rc = fh.GetNextPage(pageNum, ph)) == 0) {
+         if ((rc = ph.GetPageNum(pageNum)) ||
+               (rc = fh.UnpinPage(pageNum)))
+            return (rc);
+         numPages++;
+      }
+      if (rc != PF_EOF)
+         return (rc);
+      gettimeofday(&end, NULL);
+      elapsed += (end.tv_sec - start.tv_sec)
+         + (end.tv_usec - start.tv_usec) / 1e6;
+   }
+
+#ifdef PF_STATS
+   int *piRA = pStatisticsMgr->Get(PF_READAHEAD);
+   long readAhead = piRA ? *piRA : 0;
+   delete piRA;
+#else
+   long readAhead = 0;
+#endif
+
+   if ((rc = pfm.CloseFile(fh)))
+      return (rc);
+
+   const char *ioNames[] = { "default", "buffered", "direct", "mmap" };
+   cout << setw(12) << raPages << setw(10) << ioNames[ioMode]
+        << setw(10) << numPages
+        << setw(12) << readAhead
+        << setw(10) << fixed << setprecision(1)
+        << numPages * 4.096 / 1024 / elapsed << "\n";
+   return (0);
+}
+
+//
+// StatValue
+//
+// Desc: Current value of a PF statistic, 0 if it is not tracked
+//
+static long StatValue(const char *psKey)
+{
+#ifdef PF_STATS
+   int *piValue = pStatisticsMgr->Get(psKey);
+   long value = piValue ? *piValue : 0;
+   delete piValue;
+   return (value);
+#else
+   return (0);
+#endif
+}
+
+//
+// RunUpdates
+//
+// Desc: Time random page updates and count who wrote the dirty pages
+// In:   bgHigh - background writer setting to use
+//
+static RC RunUpdates(const char *bgHigh)
+{
+   RC rc;
+   char size[20];
+   struct timeval start, end;
+   const int numUpdates = 10 * FILE_PAGES;
+
+   sprintf(size, "%d", bufferPages);
+   setenv("REDBASE_BUFFER_SIZE", size, 1);
+   setenv("REDBASE_REPLACEMENT", "lru", 1);
+   setenv("REDBASE_READAHEAD_PAGES", "0", 1);
+   setenv("REDBASE_BGWRITER_HIGH", bgHigh, 1);
+   setenv("REDBASE_BGWRITER_DELAY", "10", 1);
+
+   PF_Manager pfm;
+   PF_FileHandle fh;
+   PF_PageHandle ph;
+   char *pData;
+
+   srand(1);
+   if ((rc = pfm.OpenFile(BENCHFILE, fh)))
+      return (rc);
+   gettimeofday(&start, NULL);
+   for (int i = 0; i < numUpdates; i++) {
+      PageNum pageNum = rand() % FILE_PAGES;
+      if ((rc = fh.GetThisPage(pageNum, ph)) ||
+            (rc = ph.GetData(pData)))
+         return (rc);
+      pData[sizeof(PageNum)]++;
+      if ((rc = fh.MarkDirty(pageNum)) ||
+            (rc = fh.UnpinPage(pageNum)))
+         return (rc);
+   }
+   gettimeofday(&end, NULL);
+
+   long fgWrites = StatValue(PF_FGWRITE);
+   long bgWrites = StatValue(PF_BGWRITE);
+   if ((rc = pfm.CloseFile(fh)))
+      return (rc);
+
+   cout << setw(12) << bgHigh << setw(10) << numUpdates
+        << setw(10) << fgWrites << setw(10) << bgWrites
+        << setw(10) << fixed << setprecision(3)
+        << (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6
+        << "\n";
+   return (0);
+}
+
+//
+// ThreadMain
+//
+// Desc: Body of a thread of RunThreads
+// In:   fh - the thread's own copy of the file handle
+//       numPages - pages 0 to numPages - 1 are accessed
+//       seed - random seed
+// Out:  rc - return code
+//       numUpdates - number of updates made
+//
+static void ThreadMain(PF_FileHandle fh, int numPages, unsigned int seed,
+                       RC *rc, long *numUpdates)
+{
+   PF_PageHandle ph;
+   char *pData;
+
+   *rc = 0;
+   *numUpdates = 0;
+   for (int i = 0; i < THREAD_OPS && !*rc; i++) {
+      PageNum pageNum = rand_r(&seed) % numPages;
+      int bUpdate = (rand_r(&seed) % UPDATE_EVERY == 0);
+
+      if ((*rc = fh.GetThisPage(pageNum, ph)) ||
+            (*rc = ph.GetData(pData)))
+         return;
+
+      if (bUpdate) {
+         if ((*rc = ph.LatchExclusive()))
+            return;
+         (*(int *)(pData + COUNTER_OFFSET))++;
+         (*numUpdates)++;
+         *rc = fh.MarkDirty(pageNum);
+      }
+      else {
+         if ((*rc = ph.LatchShared()))
+            return;
+         PageNum onPage;
+         memcpy(&onPage, pData, sizeof(PageNum));
+         if (onPage != pageNum) {
+            cerr << "Page " << pageNum << " holds page " << onPage << "\n";
+            *rc = PF_INVALIDPAGE;
+         }
+      }
+
+      RC rcUnlatch = ph.Unlatch();
+      RC rcUnpin = fh.UnpinPage(pageNum);
+      if (!*rc)
+         *rc = rcUnlatch ? rcUnlatch : rcUnpin;
+   }
+}
+
+//
+// SumCounters
+//
+// Desc: Sum of the update counters of all the pages of the file
+//
+static RC SumCounters(PF_FileHandle &fh, long &sum)
+{
+   RC rc;
+   PF_PageHandle ph;
+   char *pData;
+
+   sum = 0;
+   for (PageNum pageNum = 0; pageNum < FILE_PAGES; pageNum++) {
+      if ((rc = fh.GetThisPage(pageNum, ph)) ||
+            (rc = ph.GetData(pData)))
+         return (rc);
+      sum += *(int *)(pData + COUNTER_OFFSET);
+      if ((rc = fh.UnpinPage(pageNum)))
+         return (rc);
+   }
+   return (0);
+}
+
+//
+// RunThreads
+//
+// Desc: Time numThreads threads accessing random pages at the same time
+//       and check the updates they made
+// In:   numThreads - number of threads
+//       numPages - size of the working set
+//       baseRate - accesses per second of one thread, 0 if this is the
+//                  run with one thread
+// Out:  rate - accesses per second
+// Ret:  PF return code, or PF_INVALIDPAGE if updates were lost
+//
+static RC RunThreads(int numThreads, int numPages, double baseRate,
+                     double &rate)
+{
+   RC rc;
+   char size[20];
+   struct timeval start, end;
+
+   sprintf(size, "%d", bufferPages);
+   setenv("REDBASE_BUFFER_SIZE", size, 1);
+   setenv("REDBASE_REPLACEMENT", "lru", 1);
+   setenv("REDBASE_READAHEAD_PAGES", "0", 1);
+   unsetenv("REDBASE_BGWRITER_HIGH");
+   unsetenv("REDBASE_BGWRITER_DELAY");
+
+   PF_Manager pfm;
+   PF_FileHandle fh;
+   long before, after;
+
+   if ((rc = pfm.OpenFile(BENCHFILE, fh)) ||
+         (rc = SumCounters(fh, before)))
+      return (rc);
+
+   vector<thread> threads;
+   vector<RC> rcs(numThreads);
+   vector<long> updates(numThreads);
+   gettimeofday(&start, NULL);
+   for (int i = 0; i < numThreads; i++)
+      threads.push_back(thread(ThreadMain, fh, numPages, i + 1,
+                               &rcs[i], &updates[i]));
+   for (int i = 0; i < numThreads; i++)
+      threads[i].join();
+   gettimeofday(&end, NULL);
+
+   long numUpdates = 0;
+   for (int i = 0; i < numThreads; i++) {
+      if (rcs[i])
+         return (rcs[i]);
+      numUpdates += updates[i];
+   }
+
+   if ((rc = SumCounters(fh, after)) ||
+         (rc = pfm.CloseFile(fh)))
+      return (rc);
+
+   double seconds = (end.tv_sec - start.tv_sec) +
+      (end.tv_usec - start.tv_usec) / 1e6;
+   rate = numThreads * (double)THREAD_OPS / seconds;
+
+   cout << setw(12) << numPages << setw(10) << numThreads
+        << setw(14) << fixed << setprecision(0) << rate
+        << setw(10) << setprecision(2)
+        << (baseRate > 0 ? rate / baseRate : 1.0)
+        << setw(10) << (after - before == numUpdates ? "ok" : "LOST")
+        << "\n";
+
+   if (after - before != numUpdates) {
+      cerr << numUpdates << " updates made, " << after - before
+           << " found\n";
+      return (PF_INVALIDPAGE);
+   }
+   return (0);
+}
+
+int main(int argc, char *argv[])
+{
+   RC rc;
+
+#ifndef PF_STATS
+   cout << " ** The PF layer was not compiled with the -DPF_STATS flag **\n";
+   cout << " **      Hit ratios cannot be measured without it.       **\n";
+   return (1);
+#endif
+
+   if (argc > 1 && (bufferPages = atoi(argv[1])) <= 0) {
+      cerr << "Usage: " << argv[0] << " [buffer pages]\n";
+      return (1);
+   }
+
+   if ((rc = CreateBenchFile())) {
+      PF_PrintError(rc);
+      return (1);
+   }
+
+   cout << "Buffer of " << bufferPages << " pages, file of "
+        << FILE_PAGES << " pages, hot set of " << HOT_PAGES << " pages\n\n";
+   cout << setw(12) << "trace" << setw(8) << "policy" << setw(10) << "gets"
+        << setw(10) << "hit" << setw(10) << "lookup" << "\n";
+
+   for (unsigned t = 0; t < sizeof(traces) / sizeof(traces[0]); t++)
+      for (unsigned p = 0; p < sizeof(policies) / sizeof(policies[0]); p++)
+         if ((rc = RunTrace(traces[t], policies[p]))) {
+            PF_PrintError(rc);
+            return (1);
+         }
+
+   cout << "\nFull scans from a cold cache\n\n";
+   cout << setw(12) << "readahead" << setw(10) << "I/O" << setw(10)
+        << "pages" << setw(12) << "read ahead" << setw(10) << "MB/s" << "\n";
+   int ioModes[] = { PF_IO_BUFFERED, PF_IO_DIRECT, PF_IO_MMAP };
+   for (int m = 0; m < 3; m++)
+      if ((rc = RunScan("0", ioModes[m])) ||
+            (rc = RunScan("32", ioModes[m]))) {
+         PF_PrintError(rc);
+         return (1);
+      }
+
+   cout << "\nRandom updates\n\n";
+   cout << setw(12) << "bgwriter" << setw(10) << "updates"
+        << setw(10) << "fg write" << setw(10) << "bg write"
+        << setw(10) << "seconds" << "\n";
+   if ((rc = RunUpdates("0")) || (rc = RunUpdates("25"))) {
+      PF_PrintError(rc);
+      return (1);
+   }
+
+   int maxThreads = thread::hardware_concurrency();
+   if (maxThreads < 4)
+      maxThreads = 4;
+   cout << "\nThreads on " << thread::hardware_concurrency() << " cores\n\n";
+   cout << setw(12) << "pages" << setw(10) << "threads"
+        << setw(14) << "accesses/s" << setw(10) << "speedup"
+        << setw(10) << "updates" << "\n";
+   int workingSets[] = { bufferPages / 2, FILE_PAGES };
+   for (int w = 0; w < 2; w++) {
+      double baseRate = 0, rate = 0;
+      for (int numThreads = 1; numThreads <= maxThreads; numThreads *= 2) {
+         if ((rc = RunThreads(numThreads, workingSets[w], baseRate, rate))) {
+            PF_PrintError(rc);
+            return (1);
+         }
+         if (numThreads == 1)
+            baseRate = rate;
+      }
+   }
+
+   unlink(BENCHFILE);
+   return (0);
+}
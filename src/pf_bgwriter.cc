@@ -0,0 +1,257 @@
+//
+// File:        pf_bgwriter.cc
+// Description: Background writer for the PF buffer manager
+//
+// When the page chosen for replacement is dirty, GetPage has to write it
+// before it can read its own page.  The background writer keeps the
+// pages at the cold end of the buffer, the ones the replacement policy
+// will give up next, clean ahead of time so that this rarely happens.
+//
+// The writer wakes up every bgwriter_delay milliseconds, and at once
+// whenever page replacement has had to write a dirty page.  It counts
+// the free frames and the clean pages among the coldest bgwriter_high
+// percent of the buffer.  If there are fewer than bgwriter_low percent
+// of the buffer, it writes every dirty page in that cold end, in runs of
+// consecutive pages, without holding the buffer manager lock.
+//
+// Settings (see pf_config.cc):
+//    bgwriter_low     start writing below this % of clean pages (default 5)
+//    bgwriter_high    % of the buffer kept clean (default 10, 0 turns the
+//                     writer off)
+//    bgwriter_delay   milliseconds between rounds (default 200)
+//
+// Pages written by the writer are counted under BGWRITE, dirty pages
+// written by page replacement under FGWRITE.
+//
+
+#include <algorithm>
+#include <chrono>
+#include "pf_buffermgr.h"
+
+using namespace std;
+
+#ifdef PF_STATS
+#include "statistics.h"
+
+// This is defined within pf_buffermgr.cc
+extern StatisticsMgr *pStatisticsMgr;
+#endif
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+//
+// Defines
+//
+#define PF_BGWRITER_LOW     5      // default low watermark, %
+#define PF_BGWRITER_HIGH    10     // default high watermark, %
+#define PF_BGWRITER_DELAY   200    // default ms between rounds
+
+//
+// StartBgWriter
+//
+// Desc: Internal.  Read the writer settings and start the writer thread.
+//       Called by the constructor.
+//
+void PF_BufferMgr::StartBgWriter()
+{
+   bBgShutdown = FALSE;
+
+   bgHigh = PF_GetConfigInt("bgwriter_high", PF_BGWRITER_HIGH);
+   bgLow = PF_GetConfigInt("bgwriter_low", PF_BGWRITER_LOW);
+   bgDelay = PF_GetConfigInt("bgwriter_delay", PF_BGWRITER_DELAY);
+   if (bgHigh > 100)
+      bgHigh = 100;
+   if (bgLow > bgHigh)
+      bgLow = bgHigh;
+   if (bgDelay < 1)
+      bgDelay = 1;
+
+   if (bgHigh <= 0)
+      return;
+
+   bgWriter = thread(&PF_BufferMgr::BgWriterMain, this);
+}
+
+//
+// StopBgWriter
+//
+// Desc: Internal.  Stop the writer thread.  Called by the destructor.
+//
+void PF_BufferMgr::StopBgWriter()
+{
+   if (!bgWriter.joinable())
+      return;
+
+   {
+      lock_guard<mutex> lock(bufMutex);
+      bBgShutdown = TRUE;
+   }
+   bgWake.notify_one();
+   bgWriter.join();
+}
+
+//
+// BgWriterMain
+//
+// Desc: Internal.  Body of the writer thread.
+//
+void PF_BufferMgr::BgWriterMain()
+{
+   unique_lock<mutex> lock(bufMutex);
+
+   while (!bBgShutdown) {
+      bgWake.wait_for(lock, chrono::milliseconds(bgDelay));
+      if (bBgShutdown)
+         break;
+      BgClean(lock);
+   }
+}
+
+//
+// BgClean
+//
+// Desc: Internal.  One round of the writer: check the watermarks and
+//       write the dirty pages at the cold end of the buffer if needed
+// In:   lock - the held buffer manager lock
+//
+void PF_BufferMgr::BgClean(unique_lock<mutex> &lock)
+{
+   int window = numPages * bgHigh / 100;
+   if (window < 1)
+      window = 1;
+   int lowMark = numPages * bgLow / 100;
+
+   // Free frames are as good as clean ones
+   int numClean = 0;
+   for (int slot = free; slot != INVALID_SLOT && numClean < window;
+         slot = bufTable[slot].next)
+      numClean++;
+
+   vector<int> slots;
+   pReplacer->Coldest(bufTable, window - numClean, slots);
+
+   vector<int> dirty;
+   for (size_t i = 0; i < slots.size(); i++) {
+      int slot = slots[i];
+      if (!bufTable[slot].bDirty)
+         numClean++;
+      else if (bufTable[slot].fd >= 0 && !bufTable[slot].bWriting)
+         dirty.push_back(slot);
+   }
+
+   if (numClean >= lowMark && numClean > 0)
+      return;
+
+   int numWritten;
+   BgWrite(lock, dirty, numWritten);
+#ifdef PF_STATS
+   if (numWritten > 0)
+      pStatisticsMgr->Add(PF_STAT_BGWRITE, numWritten);
+#endif
+}
+
+//
+// BgWrite
+//
+// Desc: Internal.  Write dirty pages in file and page order, in runs of
+//       consecutive pages, without holding the buffer manager lock.  The
+//       pages being written are pinned and marked bWriting, so that they
+//       are not replaced, and marked clean before the write so that a
+//       page dirtied again meanwhile is written again later.  Pages
+//       latched exclusive are skipped.
+// In:   lock - the held buffer manager lock
+//       dirty - slots of dirty pages that are not being written
+// Out:  dirty - the slots of the pages claimed, in the order written
+//       numWritten - number of pages written
+// Ret:  the first error, the pages that were not written are left dirty
+//
+RC PF_BufferMgr::BgWrite(unique_lock<mutex> &lock, vector<int> &dirty,
+                         int &numWritten)
+{
+   RC firstRc = 0;
+
+   numWritten = 0;
+   sort(dirty.begin(), dirty.end(), [this](int a, int b) {
+      if (bufTable[a].fd != bufTable[b].fd)
+         return bufTable[a].fd < bufTable[b].fd;
+      return bufTable[a].pageNum < bufTable[b].pageNum;
+   });
+
+   // Claim all the pages first.  The shared latch keeps the contents
+   // from changing during the write.  A page latched exclusive is being
+   // changed right now, so it is left for a later round.
+   size_t numClaimed = 0;
+   for (size_t i = 0; i < dirty.size(); i++) {
+      PF_BufPageDesc &desc = bufTable[dirty[i]];
+      if (!desc.latch.TryShared())
+         continue;
+      desc.pinCount++;
+      desc.bWriting = TRUE;
+      desc.bDirty = FALSE;
+      dirty[numClaimed++] = dirty[i];
+   }
+   dirty.resize(numClaimed);
+
+   // Write each run of consecutive pages of a file.  The frames cannot
+   // move while they are pinned, so the lock can be dropped.
+   size_t start = 0;
+   while (start < dirty.size()) {
+      size_t end = start + 1;
+      while (end < dirty.size() && end - start < IOV_MAX &&
+            bufTable[dirty[end]].fd == bufTable[dirty[start]].fd &&
+            bufTable[dirty[end]].pageNum ==
+               bufTable[dirty[end - 1]].pageNum + 1)
+         end++;
+
+      int fd = bufTable[dirty[start]].fd;
+      int numSlots = end - start;
+      lock.unlock();
+      RC rc = WritePages(fd, &dirty[start], numSlots);
+      lock.lock();
+
+      if (!rc)
+         numWritten += numSlots;
+      else if (!firstRc)
+         firstRc = rc;
+
+      for (size_t i = start; i < end; i++) {
+         PF_BufPageDesc &desc = bufTable[dirty[i]];
+         if (rc)
+            desc.bDirty = TRUE;
+         desc.latch.Release();
+         desc.bWriting = FALSE;
+         desc.pinCount--;
+      }
+      ioDone.notify_all();
+
+      start = end;
+   }
+
+   return (firstRc);
+}
+
+//
+// WaitForWrites
+//
+// Desc: Internal.  Wait until the background writer has no page of the
+//       file in flight.
+// In:   lock - the held buffer manager lock
+//       fd - OS file descriptor, or ALL_FILES
+//
+void PF_BufferMgr::WaitForWrites(unique_lock<mutex> &lock, int fd)
+{
+   for (;;) {
+      int bWriting = FALSE;
+      for (int slot = first; slot != INVALID_SLOT; slot = bufTable[slot].next)
+         if (bufTable[slot].bWriting &&
+               (fd == ALL_FILES || bufTable[slot].fd == fd)) {
+            bWriting = TRUE;
+            break;
+         }
+      if (!bWriting)
+         return;
+      ioDone.wait(lock);
+   }
+}
@@ -0,0 +1,266 @@
+//
+// File:        pf_bufdump.cc
+// Description: Buffer dumps for the PF_Manager
+//
+// A buffer dump is a text file listing pages by file name and page
+// number, one "fileName pageNum" line each, grouped by file and in page
+// order.  It is written when a database is closed (or when asked for) and
+// read back when it is opened again, so that the pages the database was
+// working on are in the buffer again before queries ask for them.
+//
+// The buffer only holds pages of open files.  RestoreBuffer therefore
+// keeps the pages of each file that is not open until it is opened, and
+// then queues them to the readahead workers in page order.  In the
+// meantime the operating system is asked to start reading them into its
+// own cache.
+//
+// Settings (see pf_config.cc):
+//    warm_restore       "off" makes RestoreBuffer do nothing (default on)
+//
+
+#include <cerrno>
+#include <cstdio>
+#include <algorithm>
+#include <unistd.h>
+#include <fcntl.h>
+#include "pf_internal.h"
+#include "pf_buffermgr.h"
+
+using namespace std;
+
+//
+// Defines
+//
+#define PF_DUMP_RUN_PAGES  64      // most pages queued in one request
+#define PF_DUMP_NAME_LEN   1024    // longest file name in a dump
+
+//
+// QueueRuns
+//
+// Desc: Internal.  Queue pages of an open file to be read in the
+//       background, a run of consecutive pages at a time
+// In:   pBufferMgr - buffer manager
+//       fd - OS file descriptor
+//       pages - page numbers, in ascending order
+//
+static void QueueRuns(PF_BufferMgr *pBufferMgr, int fd,
+                      const vector<PageNum> &pages)
+{
+   size_t start = 0;
+   while (start < pages.size()) {
+      size_t end = start + 1;
+      while (end < pages.size() && end - start < PF_DUMP_RUN_PAGES &&
+             pages[end] == pages[end - 1] + 1)
+         end++;
+      pBufferMgr->ReadAhead(fd, pages[start], end - start, NO_HINT);
+      start = end;
+   }
+}
+
+//
+// Prefetch
+//
+// Desc: Internal.  Ask the operating system to read pages of a file that
+//       is not open into its cache.  Errors are ignored: the pages will
+//       simply be read when they are needed.
+// In:   fileName - name of the file
+//       pages - page numbers, in ascending order
+//
+static void Prefetch(const char *fileName, const vector<PageNum> &pages)
+{
+#ifdef POSIX_FADV_WILLNEED
+   PF_FileHdr hdr;
+   int fd = open(fileName, O_RDONLY);
+   if (fd < 0)
+      return;
+   if (pread(fd, &hdr, sizeof(hdr), 0) == sizeof(hdr)) {
+      long pageSize = hdr.pageSize ? hdr.pageSize : PF_MIN_DISK_PAGE_SIZE;
+      size_t start = 0;
+      while (start < pages.size()) {
+         size_t end = start + 1;
+         while (end < pages.size() && pages[end] == pages[end - 1] + 1)
+            end++;
+         posix_fadvise(fd, pages[start] * pageSize + PF_FILE_HDR_SIZE,
+                       (end - start) * pageSize, POSIX_FADV_WILLNEED);
+         start = end;
+      }
+   }
+   close(fd);
+#endif
+}
+
+//
+// NoteOpen
+//
+// Desc: Internal.  Called by OpenFile.  Record that a file is open, and
+//       queue the pages a restored dump holds for it.
+// In:   fileName - name the file was opened by
+//       fileHandle - handle of the open file
+//
+void PF_Manager::NoteOpen(const char *fileName,
+                          const PF_FileHandle &fileHandle)
+{
+   if (fileHandle.bMapped)
+      return;
+
+   // Forget what the file held the last time it was closed
+   vector<PF_WarmFile> &files = pWarmList->files;
+   for (size_t i = 0; i < files.size(); )
+      if (files[i].fd < 0 && files[i].fileName == fileName)
+         files.erase(files.begin() + i);
+      else
+         i++;
+
+   PF_WarmFile file;
+   file.fileName = fileName;
+   file.fd = fileHandle.unixfd;
+   files.push_back(file);
+
+   map<string, vector<PageNum> >::iterator it =
+      pWarmList->pending.find(fileName);
+   if (it != pWarmList->pending.end()) {
+      QueueRuns(pBufferMgr, fileHandle.unixfd, it->second);
+      pWarmList->pending.erase(it);
+   }
+}
+
+//
+// NoteClose
+//
+// Desc: Internal.  Called by CloseFile before the pages of the file are
+//       flushed.  Take down the pages of the file in the buffer.  Only as
+//       many pages as the buffer holds are remembered for closed files,
+//       those of the files closed last.
+// In:   fileHandle - handle of the file being closed
+//
+void PF_Manager::NoteClose(const PF_FileHandle &fileHandle)
+{
+   if (fileHandle.bMapped)
+      return;
+
+   vector<PF_WarmFile> &files = pWarmList->files;
+   for (size_t i = 0; i < files.size(); i++)
+      if (files[i].fd == fileHandle.unixfd) {
+         PF_WarmFile file = files[i];
+         pBufferMgr->GetResidentPages(file.fd, file.pages);
+         file.fd = -1;
+         files.erase(files.begin() + i);
+         files.push_back(file);
+         break;
+      }
+
+   int bufferSize, numPages = 0;
+   pBufferMgr->GetBufferSize(bufferSize);
+   for (size_t i = files.size(); i-- > 0; ) {
+      if (files[i].fd >= 0)
+         continue;
+      if (numPages >= bufferSize)
+         files.erase(files.begin() + i);
+      else
+         numPages += files[i].pages.size();
+   }
+}
+
+//
+// DumpBuffer
+//
+// Desc: Write the pages in the buffer, and those of the files closed
+//       last, to a buffer dump.  No more pages than the buffer holds are
+//       written; the files used last come first.  The dump is written
+//       under a temporary name and then renamed, so that an old dump is
+//       only replaced by a complete one.
+// In:   fileName - name of the dump
+// Ret:  PF_UNIX if the dump cannot be written
+//
+RC PF_Manager::DumpBuffer(const char *fileName)
+{
+   int bufferSize, numPages = 0;
+   pBufferMgr->GetBufferSize(bufferSize);
+
+   string tmpName = string(fileName) + ".tmp";
+   FILE *fp = fopen(tmpName.c_str(), "w");
+   if (fp == NULL)
+      return (PF_UNIX);
+
+   vector<PF_WarmFile> &files = pWarmList->files;
+   vector<string> done;
+   vector<PageNum> pages;
+   for (size_t i = files.size(); i-- > 0 && numPages < bufferSize; ) {
+      const PF_WarmFile &file = files[i];
+      if (find(done.begin(), done.end(), file.fileName) != done.end() ||
+            file.fileName.size() >= PF_DUMP_NAME_LEN ||
+            file.fileName.find_first_of(" \t\n") != string::npos)
+         continue;
+      done.push_back(file.fileName);
+
+      if (file.fd >= 0)
+         pBufferMgr->GetResidentPages(file.fd, pages);
+      else
+         pages = file.pages;
+      for (size_t j = 0; j < pages.size() && numPages < bufferSize;
+            j++, numPages++)
+         fprintf(fp, "%s %d\n", file.fileName.c_str(), pages[j]);
+   }
+
+   if (fclose(fp) || rename(tmpName.c_str(), fileName)) {
+      unlink(tmpName.c_str());
+      return (PF_UNIX);
+   }
+
+   // Return ok
+   return (0);
+}
+
+//
+// RestoreBuffer
+//
+// Desc: Read a buffer dump back.  The pages of files that are open are
+//       queued to be read at once; the others are read when their file
+//       is opened.  Only as many pages as the buffer holds are taken.
+//       It is not an error for the dump not to exist.
+// In:   fileName - name of the dump
+// Ret:  PF_UNIX if the dump cannot be read
+//
+RC PF_Manager::RestoreBuffer(const char *fileName)
+{
+   if (!PF_GetConfigBool("warm_restore", TRUE))
+      return (0);
+
+   FILE *fp = fopen(fileName, "r");
+   if (fp == NULL)
+      return (errno == ENOENT ? 0 : PF_UNIX);
+
+   int bufferSize, numPages = 0;
+   pBufferMgr->GetBufferSize(bufferSize);
+
+   // Read the pages of each file; the dump is sorted by page already
+   map<string, vector<PageNum> > dump;
+   char name[PF_DUMP_NAME_LEN];
+   PageNum pageNum;
+   while (numPages < bufferSize &&
+          fscanf(fp, "%1023s %d", name, &pageNum) == 2) {
+      if (pageNum < 0)
+         continue;
+      dump[name].push_back(pageNum);
+      numPages++;
+   }
+   fclose(fp);
+
+   vector<PF_WarmFile> &files = pWarmList->files;
+   for (map<string, vector<PageNum> >::iterator it = dump.begin();
+         it != dump.end(); ++it) {
+      size_t i;
+      for (i = 0; i < files.size(); i++)
+         if (files[i].fd >= 0 && files[i].fileName == it->first)
+            break;
+      if (i < files.size())
+         QueueRuns(pBufferMgr, files[i].fd, it->second);
+      else {
+         Prefetch(it->first.c_str(), it->second);
+         pWarmList->pending[it->first].swap(it->second);
+      }
+   }
+
+   // Return ok
+   return (0);
+}
@@ -16,19 +16,31 @@
 //
 
 #include <cstdio>
+#include <climits>
 #include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 #include <iostream>
+#include <vector>
+#include <algorithm>
 #include "pf_buffermgr.h"
 
 using namespace std;
 
+// Largest number of buffers passed to one pwritev call
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
 // The switch PF_STATS indicates that the user wishes to have statistics
 // tracked for the PF layer
 #ifdef PF_STATS
 #include "statistics.h"   // For StatisticsMgr interface
+#include "pf_iostats.h"   // For PF_IOStats interface
 
 // Global variable for the statistics manager
 StatisticsMgr *pStatisticsMgr;
+PF_IOStats *pIOStats;
 #endif
 
 #ifdef PF_LOG
@@ -84,7 +96,9 @@ void WriteLog(const char *psMessage)
 //       it checks if it is in the buffer.  If so, it pins the page (pages
 //       can be pinned multiple times).  If not, it reads it from the file
 //       and pins it.  If the buffer is full and a new page needs to be
-//       inserted, an unpinned page is replaced according to an LRU
+//       inserted, an unpinned page is replaced according to the
+//       replacement policy named by the "replacement" setting (LRU if
+//       it is not set, see pf_replacer.h)
 // In:   numPages - the number of pages in the buffer
 //
 // Note: The constructor will initialize the global pStatisticsMgr.  We
@@ -94,15 +108,20 @@ void WriteLog(const char *psMessage)
 // Aut2003
 // numPages changed to _numPages for to eliminate CC warnings
 
-PF_BufferMgr::PF_BufferMgr(int _numPages) : hashTable(PF_HASH_TBL_SIZE)
+PF_BufferMgr::PF_BufferMgr(int _numPages) : hashTable(_numPages)
 {
    // Initialize local variables
    this->numPages = _numPages;
    pageSize = PF_PAGE_SIZE + sizeof(PF_PageHdr);
+   pLog = NULL;
+   ckptTimeout = 0;
+   ckptLogSize = 0;
+   bCkptShutdown = FALSE;
 
 #ifdef PF_STATS
    // Initialize the global variable for the statistics manager
    pStatisticsMgr = new StatisticsMgr();
+   pIOStats = new PF_IOStats();
 #endif
 
 #ifdef PF_LOG
@@ -112,19 +131,31 @@ PF_BufferMgr::PF_BufferMgr(int _numPages) : hashTable(PF_HASH_TBL_SIZE)
    WriteLog(psMessage);
 #endif
 
+   // Reserve room for the largest buffer the pool may be resized to, and
+   // map the memory for the pages (which reads as zeroes)
+   if (arena.Reserve((size_t)PF_MAX_BUFFER_SIZE * pageSize,
+            (size_t)numPages * pageSize,
+            PF_GetConfigBool("huge_pages", TRUE)) ||
+         arena.Resize((size_t)numPages * pageSize)) {
+      cerr << "Not enough memory for buffer\n";
+      exit(1);
+   }
+
    // Allocate memory for buffer page description table
    bufTable = new PF_BufPageDesc[numPages];
 
-   // Initialize the buffer table and allocate memory for buffer pages.
-   // Initially, the free list contains all pages
+   // Initialize the buffer table, each page taking its place in the
+   // arena.  Initially, the free list contains all pages
    for (int i = 0; i < numPages; i++) {
-      if ((bufTable[i].pData = new char[pageSize]) == NULL) {
-         cerr << "Not enough memory for buffer\n";
-         exit(1);
-      }
-
-      memset ((void *)bufTable[i].pData, 0, pageSize);
-
+      bufTable[i].pData = arena.Base() + (size_t)i * pageSize;
+      bufTable[i].frameSize = pageSize;
+      bufTable[i].bDirty = bufTable[i].bReading = FALSE;
+      bufTable[i].bWriting = FALSE;
+      bufTable[i].pinCount = 0;
+      bufTable[i].logId = -1;
+      bufTable[i].bLogPending = FALSE;
+      bufTable[i].lsn = 0;
+      bufTable[i].recLsn = 0;
       bufTable[i].prev = i - 1;
       bufTable[i].next = i + 1;
    }
@@ -132,6 +163,19 @@ PF_BufferMgr::PF_BufferMgr(int _numPages) : hashTable(PF_HASH_TBL_SIZE)
    free = 0;
    first = last = INVALID_SLOT;
 
+   // Create the replacement policy
+   const char *policy = PF_GetConfig("replacement");
+   if (policy == NULL)
+      policy = "lru";
+   if ((pReplacer = PF_NewReplacer(policy, numPages)) == NULL) {
+      cerr << "Unknown replacement policy " << policy << ", using lru\n";
+      pReplacer = PF_NewReplacer("lru", numPages);
+   }
+
+   // Start the readahead workers and the background writer
+   StartReadAhead();
+   StartBgWriter();
+
 #ifdef PF_LOG
    WriteLog("Succesfully created the buffer manager.\n");
 #endif
@@ -144,15 +188,21 @@ PF_BufferMgr::PF_BufferMgr(int _numPages) : hashTable(PF_HASH_TBL_SIZE)
 //
 PF_BufferMgr::~PF_BufferMgr()
 {
-   // Free up buffer pages and tables
-   for (int i = 0; i < this->numPages; i++)
-      delete [] bufTable[i].pData;
-
+   // Stop the background threads first, they use everything below
+   StopCheckpointer();
+   StopBgWriter();
+   StopReadAhead();
+
+   // Free up the buffer table and the frames not in the arena, the arena
+   // frees the rest
+   FreeFrames();
    delete [] bufTable;
+   delete pReplacer;
 
 #ifdef PF_STATS
    // Destroy the global statistics manager
    delete pStatisticsMgr;
+   delete pIOStats;
 #endif
 
 #ifdef PF_LOG
@@ -160,6 +210,25 @@ PF_BufferMgr::~PF_BufferMgr()
 #endif
 }
 
+//
+// NoteHint
+//
+// Desc: Internal.  Note how a page found in the buffer is being used.
+//       Only the use that brings a page in makes it cold, so that a
+//       one-off scan does not demote pages that others use, and any
+//       other use warms a cold page up.  A page used as HOT_METADATA
+//       stays so while it is in the buffer.
+// In:   desc - descriptor of the page
+//       hint - hint of this use
+//
+static void NoteHint(PF_BufPageDesc &desc, ClientHint hint)
+{
+   if (hint == HOT_METADATA)
+      desc.hint = HOT_METADATA;
+   else if (PF_IsColdHint(desc.hint) && !PF_IsColdHint(hint))
+      desc.hint = NO_HINT;
+}
+
 //
 // GetPage
 //
@@ -172,11 +241,14 @@ PF_BufferMgr::~PF_BufferMgr()
 //       pageNum - number of the page to read
 //       bMultiplePins - if FALSE, it is an error to ask for a page that is
 //                       already pinned in the buffer.
+//       hint - how the page will be used (see NoteHint)
 // Out:  ppBuffer - set *ppBuffer to point to the page in the buffer
+//       ppLatch - if not NULL, set *ppLatch to point to the latch of
+//                 the page
 // Ret:  PF return code
 //
 RC PF_BufferMgr::GetPage(int fd, PageNum pageNum, char **ppBuffer,
-      int bMultiplePins)
+      int bMultiplePins, PF_Latch **ppLatch, ClientHint hint)
 {
    RC  rc;     // return code
    int slot;   // buffer slot where page is located
@@ -189,37 +261,113 @@ RC PF_BufferMgr::GetPage(int fd, PageNum pageNum, char **ppBuffer,
 
 
 #ifdef PF_STATS
-   pStatisticsMgr->Register(PF_GETPAGE, STAT_ADDONE);
+   pStatisticsMgr->Add(PF_STAT_GETPAGE);
+#endif
+
+   // Look for the page holding only the latch of its hash table
+   // partition.  A page that is not there, is still being read in, or
+   // is pinned by the background writer when only one pin is wanted, is
+   // left to the code below.
+   {
+      lock_guard<mutex> part(hashTable.Latch(fd, pageNum));
+      if (!hashTable.Find(fd, pageNum, slot) && !bufTable[slot].bReading &&
+            (bMultiplePins || !bufTable[slot].bWriting)) {
+
+#ifdef PF_STATS
+         pStatisticsMgr->Add(PF_STAT_PAGEFOUND);
+         pIOStats->Counts(fd).hits++;
+#endif
+
+         // Error if we don't want to get a pinned page
+         if (!bMultiplePins && bufTable[slot].pinCount > 0)
+            return (PF_PAGEPINNED);
+
+         // Page is alredy in memory, just increment pin count
+         bufTable[slot].pinCount++;
+         NoteHint(bufTable[slot], hint);
+#ifdef PF_LOG
+         sprintf (psMessage, "Page found in buffer.  %d pin count.\n",
+               (int)bufTable[slot].pinCount);
+         WriteLog(psMessage);
 #endif
 
-   // Search for page in buffer
-   if ((rc = hashTable.Find(fd, pageNum, slot)) &&
-         (rc != PF_HASHNOTFOUND))
+         // Point ppBuffer to page
+         *ppBuffer = bufTable[slot].pData;
+         if (ppLatch != NULL)
+            *ppLatch = &bufTable[slot].latch;
+      }
+      else
+         slot = INVALID_SLOT;
+   }
+
+   if (slot != INVALID_SLOT) {
+      // Make this page the most recently used page
+      Touch(slot);
+      return (0);
+   }
+
+   unique_lock<mutex> lock(bufMutex);
+
+   // Search for page in buffer again, it may have been brought in since.
+   // If the page is being read in by another thread, wait for the read
+   // to finish and look again.  The pin of the background writer only
+   // lasts for its write, so wait for that too rather than report the
+   // page as pinned.
+   while (!(rc = hashTable.Find(fd, pageNum, slot)) &&
+         (bufTable[slot].bReading ||
+          (!bMultiplePins && bufTable[slot].bWriting)))
+      ioDone.wait(lock);
+   if (rc && rc != PF_HASHNOTFOUND)
       return (rc);                // unexpected error
 
    // If page not in buffer...
    if (rc == PF_HASHNOTFOUND) {
 
 #ifdef PF_STATS
-   pStatisticsMgr->Register(PF_PAGENOTFOUND, STAT_ADDONE);
+   pStatisticsMgr->Add(PF_STAT_PAGENOTFOUND);
+   pStatisticsMgr->Add(PF_STAT_READPAGE);
+   pIOStats->Counts(fd).misses++;
 #endif
 
       // Allocate an empty page, this will also promote the newly allocated
       // page to the MRU slot
-      if ((rc = InternalAlloc(slot)))
+      if ((rc = WaitAlloc(lock, slot)))
          return (rc);
 
-      // read the page, insert it into the hash table,
-      // and initialize the page description entry
-      if ((rc = ReadPage(fd, pageNum, bufTable[slot].pData)) ||
-            (rc = hashTable.Insert(fd, pageNum, slot)) ||
-            (rc = InitPageDesc(fd, pageNum, slot))) {
+      // Initialize the page description entry and mark the page as being
+      // read before inserting it into the hash table, so that other
+      // threads asking for the page wait for it rather than read it a
+      // second time
+      if (!(rc = InitPageDesc(fd, pageNum, slot, hint))) {
+         bufTable[slot].bReading = TRUE;
+         rc = HashInsert(fd, pageNum, slot);
+      }
+      if (rc) {
 
          // Put the slot back on the free list before returning the error
+         bufTable[slot].bReading = FALSE;
          Unlink(slot);
          InsertFree(slot);
          return (rc);
       }
+
+      // Read the page without holding the buffer manager lock
+      char *pData = bufTable[slot].pData;
+      int size = bufTable[slot].frameSize;
+      lock.unlock();
+      rc = ReadPage(fd, pageNum, pData, size);
+      lock.lock();
+
+      if (rc) {
+         // Put the slot back on the free list before returning the error
+         HashDelete(fd, pageNum);
+         Unlink(slot);
+         InsertFree(slot);
+      }
+      bufTable[slot].bReading = FALSE;
+      ioDone.notify_all();
+      if (rc)
+         return (rc);
 #ifdef PF_LOG
    WriteLog("Page not found in buffer. Loaded.\n");
 #endif
@@ -227,7 +375,8 @@ RC PF_BufferMgr::GetPage(int fd, PageNum pageNum, char **ppBuffer,
    else {   // Page is in the buffer...
 
 #ifdef PF_STATS
-   pStatisticsMgr->Register(PF_PAGEFOUND, STAT_ADDONE);
+   pStatisticsMgr->Add(PF_STAT_PAGEFOUND);
+   pIOStats->Counts(fd).hits++;
 #endif
 
       // Error if we don't want to get a pinned page
@@ -236,20 +385,16 @@ RC PF_BufferMgr::GetPage(int fd, PageNum pageNum, char **ppBuffer,
 
       // Page is alredy in memory, just increment pin count
       bufTable[slot].pinCount++;
-#ifdef PF_LOG
-      sprintf (psMessage, "Page found in buffer.  %d pin count.\n",
-            bufTable[slot].pinCount);
-      WriteLog(psMessage);
-#endif
+      NoteHint(bufTable[slot], hint);
 
       // Make this page the most recently used page
-      if ((rc = Unlink(slot)) ||
-            (rc = LinkHead (slot)))
-         return (rc);
+      pReplacer->Reference(slot, (ClientHint)(int)bufTable[slot].hint);
    }
 
    // Point ppBuffer to page
    *ppBuffer = bufTable[slot].pData;
+   if (ppLatch != NULL)
+      *ppLatch = &bufTable[slot].latch;
 
    // Return ok
    return (0);
@@ -261,11 +406,16 @@ RC PF_BufferMgr::GetPage(int fd, PageNum pageNum, char **ppBuffer,
 // Desc: Allocate a new page in the buffer and return a pointer to it.
 // In:   fd - OS file descriptor of the file associated with the new page
 //       pageNum - number of the new page
+//       hint - how the page will be used
 // Out:  ppBuffer - set *ppBuffer to point to the page in the buffer
+//       ppLatch - if not NULL, set *ppLatch to point to the latch of
+//                 the page
 // Ret:  PF return code
 //
-RC PF_BufferMgr::AllocatePage(int fd, PageNum pageNum, char **ppBuffer)
+RC PF_BufferMgr::AllocatePage(int fd, PageNum pageNum, char **ppBuffer,
+      PF_Latch **ppLatch, ClientHint hint)
 {
+   unique_lock<mutex> lock(bufMutex);
    RC  rc;     // return code
    int slot;   // buffer slot where page is located
 
@@ -282,13 +432,13 @@ RC PF_BufferMgr::AllocatePage(int fd, PageNum pageNum, char **ppBuffer)
       return (rc);              // unexpected error
 
    // Allocate an empty page
-   if ((rc = InternalAlloc(slot)))
+   if ((rc = WaitAlloc(lock, slot)))
       return (rc);
 
-   // Insert the page into the hash table,
-   // and initialize the page description entry
-   if ((rc = hashTable.Insert(fd, pageNum, slot)) ||
-         (rc = InitPageDesc(fd, pageNum, slot))) {
+   // Initialize the page description entry,
+   // and insert the page into the hash table
+   if ((rc = InitPageDesc(fd, pageNum, slot, hint)) ||
+         (rc = HashInsert(fd, pageNum, slot))) {
 
       // Put the slot back on the free list before returning the error
       Unlink(slot);
@@ -302,6 +452,8 @@ RC PF_BufferMgr::AllocatePage(int fd, PageNum pageNum, char **ppBuffer)
 
    // Point ppBuffer to page
    *ppBuffer = bufTable[slot].pData;
+   if (ppLatch != NULL)
+      *ppLatch = &bufTable[slot].latch;
 
    // Return ok
    return (0);
@@ -327,24 +479,29 @@ RC PF_BufferMgr::MarkDirty(int fd, PageNum pageNum)
    WriteLog(psMessage);
 #endif
 
-   // The page must be found and pinned in the buffer
-   if ((rc = hashTable.Find(fd, pageNum, slot))){
-      if ((rc == PF_HASHNOTFOUND))
-         return (PF_PAGENOTINBUF);
-      else
-         return (rc);              // unexpected error
-   }
+   {
+      lock_guard<mutex> part(hashTable.Latch(fd, pageNum));
 
-   if (bufTable[slot].pinCount == 0)
-      return (PF_PAGEUNPINNED);
+      // The page must be found and pinned in the buffer
+      if ((rc = hashTable.Find(fd, pageNum, slot))){
+         if ((rc == PF_HASHNOTFOUND))
+            return (PF_PAGENOTINBUF);
+         else
+            return (rc);              // unexpected error
+      }
 
-   // Mark this page dirty
-   bufTable[slot].bDirty = TRUE;
+      if (bufTable[slot].pinCount == 0)
+         return (PF_PAGEUNPINNED);
+
+      // Mark this page dirty.  A logged page is logged whole, unless
+      // the change is logged by LogChange.
+      bufTable[slot].bDirty = TRUE;
+      if (bufTable[slot].logId >= 0)
+         bufTable[slot].bLogPending = TRUE;
+   }
 
    // Make this page the most recently used page
-   if ((rc = Unlink(slot)) ||
-         (rc = LinkHead (slot)))
-      return (rc);
+   Touch(slot);
 
    // Return ok
    return (0);
@@ -360,6 +517,7 @@ RC PF_BufferMgr::MarkDirty(int fd, PageNum pageNum)
 //
 RC PF_BufferMgr::UnpinPage(int fd, PageNum pageNum)
 {
+   lock_guard<mutex> part(hashTable.Latch(fd, pageNum));
    RC  rc;       // return code
    int slot;     // buffer slot where page is located
 
@@ -381,12 +539,11 @@ RC PF_BufferMgr::UnpinPage(int fd, PageNum pageNum)
    WriteLog(psMessage);
 #endif
 
-   // If unpinning the last pin, make it the most recently used page
-   if (--(bufTable[slot].pinCount) == 0) {
-      if ((rc = Unlink(slot)) ||
-            (rc = LinkHead (slot)))
-         return (rc);
-   }
+   // If unpinning the last pin, make it the most recently used page.
+   // This is done first, while the page cannot be replaced.
+   if (bufTable[slot].pinCount == 1)
+      Touch(slot);
+   bufTable[slot].pinCount--;
 
    // Return ok
    return (0);
@@ -405,6 +562,12 @@ RC PF_BufferMgr::UnpinPage(int fd, PageNum pageNum)
 RC PF_BufferMgr::FlushPages(int fd)
 {
    RC rc, rcWarn = 0;  // return codes
+   unique_lock<mutex> lock(bufMutex);
+
+   // Pages of the file may still be on their way in from readahead, or
+   // out from the background writer
+   WaitForReads(lock, fd);
+   WaitForWrites(lock, fd);
 
 #ifdef PF_LOG
    char psMessage[100];
@@ -413,9 +576,14 @@ RC PF_BufferMgr::FlushPages(int fd)
 #endif
 
 #ifdef PF_STATS
-   pStatisticsMgr->Register(PF_FLUSHPAGES, STAT_ADDONE);
+   pStatisticsMgr->Add(PF_STAT_FLUSHPAGES);
 #endif
 
+   // Write out the dirty pages that are about to be released, coalescing
+   // consecutive pages into single writes
+   if ((rc = WriteDirty(lock, fd, ALL_PAGES, TRUE)))
+      return (rc);
+
    // Do a linear scan of the buffer to find pages belonging to the file
    int slot = first;
    while (slot != INVALID_SLOT) {
@@ -429,28 +597,15 @@ RC PF_BufferMgr::FlushPages(int fd)
  sprintf (psMessage, "Page (%d) is in buffer manager.\n", bufTable[slot].pageNum);
  WriteLog(psMessage);
 #endif
-         // Ensure the page is not pinned
-         if (bufTable[slot].pinCount) {
-            rcWarn = PF_PAGEPINNED;
-         }
-         else {
-            // Write the page if dirty
-            if (bufTable[slot].bDirty) {
-#ifdef PF_LOG
- sprintf (psMessage, "Page (%d) is dirty\n",bufTable[slot].pageNum);
- WriteLog(psMessage);
-#endif
-               if ((rc = WritePage(fd, bufTable[slot].pageNum, bufTable[slot].pData)))
-                  return (rc);
-               bufTable[slot].bDirty = FALSE;
-            }
-
-            // Remove page from the hash table and add the slot to the free list
-            if ((rc = hashTable.Delete(fd, bufTable[slot].pageNum)) ||
-                  (rc = Unlink(slot)) ||
-                  (rc = InsertFree(slot)))
-               return (rc);
-         }
+         // Remove page from the hash table unless it is pinned, and add
+         // the slot to the free list.  A page dirtied again since it was
+         // written above is written again.
+         if ((rc = Evict(slot, TRUE)) == PF_PAGEPINNED)
+            rcWarn = rc;
+         else if (rc ||
+               (rc = Unlink(slot)) ||
+               (rc = InsertFree(slot)))
+            return (rc);
       }
       slot = next;
    }
@@ -475,47 +630,126 @@ RC PF_BufferMgr::FlushPages(int fd)
 //
 RC PF_BufferMgr::ForcePages(int fd, PageNum pageNum)
 {
-   RC rc;  // return codes
+   unique_lock<mutex> lock(bufMutex);
 
+   // Pages being written by the background writer are not dirty any
+   // more, but are not on disk yet either
+   WaitForWrites(lock, fd);
 #ifdef PF_LOG
    char psMessage[100];
    sprintf (psMessage, "Forcing page %d for (%d).\n", pageNum, fd);
    WriteLog(psMessage);
 #endif
 
-   // Do a linear scan of the buffer to find the page for the file
-   int slot = first;
-   while (slot != INVALID_SLOT) {
+   // I don't care if the pages are pinned or not, just write them if
+   // they are dirty.
+   return (WriteDirty(lock, fd, pageNum, FALSE));
+}
 
-      int next = bufTable[slot].next;
+//
+// WriteDirty
+//
+// Desc: Internal.  Write the dirty pages of a file to disk and mark them
+//       clean.  The pages are sorted by page number and each run of
+//       consecutive pages is written with one call to WritePages.
+//       As in BgWrite, the pages are pinned and marked bWriting, latched
+//       shared so that another thread cannot change them during the
+//       write, and marked clean before it so that a change made after
+//       the write is not lost.  The lock is dropped while waiting for a
+//       latch; the calling thread must not hold any of the pages
+//       latched exclusive.
+// In:   lock - the held buffer manager lock
+//       fd - file descriptor
+//       pageNum - the page to write, or ALL_PAGES
+//       bUnpinnedOnly - if TRUE, pinned pages are not written
+// Ret:  the first error, the pages that were not written are left dirty
+//
+RC PF_BufferMgr::WriteDirty(unique_lock<mutex> &lock, int fd,
+                            PageNum pageNum, int bUnpinnedOnly)
+{
+   RC rc, firstRc = 0;
+
+   // Do a linear scan of the buffer to find the dirty pages of the file,
+   // and pin them so that they stay put while the lock is dropped
+   vector<int> slots;
+   for (int slot = first; slot != INVALID_SLOT; slot = bufTable[slot].next) {
+      if (bufTable[slot].fd == fd && bufTable[slot].bDirty &&
+            !bufTable[slot].bWriting &&
+            (pageNum == ALL_PAGES || bufTable[slot].pageNum == pageNum) &&
+            (!bUnpinnedOnly || bufTable[slot].pinCount == 0)) {
+         bufTable[slot].pinCount++;
+         bufTable[slot].bWriting = TRUE;
+         slots.push_back(slot);
+      }
+   }
 
-      // If the page belongs to the passed-in file descriptor
-      if (bufTable[slot].fd == fd &&
-            (pageNum==ALL_PAGES || bufTable[slot].pageNum == pageNum)) {
+   // Claim the pages
+   for (size_t i = 0; i < slots.size(); i++) {
+      PF_BufPageDesc &desc = bufTable[slots[i]];
+      if (!desc.latch.TryShared()) {
+         lock.unlock();
+         desc.latch.Shared();
+         lock.lock();
+      }
+      desc.bDirty = FALSE;
+   }
 
-#ifdef PF_LOG
- sprintf (psMessage, "Page (%d) is in buffer pool.\n", bufTable[slot].pageNum);
- WriteLog(psMessage);
-#endif
-         // I don't care if the page is pinned or not, just write it if
-         // it is dirty.
-         if (bufTable[slot].bDirty) {
-#ifdef PF_LOG
-sprintf (psMessage, "Page (%d) is dirty\n",bufTable[slot].pageNum);
-WriteLog(psMessage);
-#endif
-            if ((rc = WritePage(fd, bufTable[slot].pageNum, bufTable[slot].pData)))
-               return (rc);
-            bufTable[slot].bDirty = FALSE;
-         }
+   sort(slots.begin(), slots.end(), [this](int a, int b)
+        { return bufTable[a].pageNum < bufTable[b].pageNum; });
+
+   // Write each run of consecutive pages
+   size_t start = 0;
+   while (start < slots.size()) {
+      size_t end = start + 1;
+      while (end < slots.size() && end - start < IOV_MAX &&
+            bufTable[slots[end]].pageNum == bufTable[slots[end - 1]].pageNum + 1)
+         end++;
+
+      rc = WritePages(fd, &slots[start], end - start);
+      if (rc && !firstRc)
+         firstRc = rc;
+
+      for (size_t i = start; i < end; i++) {
+         PF_BufPageDesc &desc = bufTable[slots[i]];
+         if (rc)
+            desc.bDirty = TRUE;
+         desc.latch.Release();
+         desc.bWriting = FALSE;
+         desc.pinCount--;
       }
-      slot = next;
+
+      start = end;
    }
+   if (!slots.empty())
+      ioDone.notify_all();
 
-   return 0;
+   return (firstRc);
 }
 
 
+//
+// GetResidentPages
+//
+// Desc: List the pages of a file that are in the buffer, for a buffer
+//       dump.  Pages still being read ahead are included.
+// In:   fd - OS file descriptor
+// Out:  pages - page numbers, in ascending order
+// Ret:  OK_RC
+//
+RC PF_BufferMgr::GetResidentPages(int fd, vector<PageNum> &pages)
+{
+   lock_guard<mutex> lock(bufMutex);
+
+   pages.clear();
+   for (int slot = first; slot != INVALID_SLOT; slot = bufTable[slot].next)
+      if (bufTable[slot].fd == fd)
+         pages.push_back(bufTable[slot].pageNum);
+   sort(pages.begin(), pages.end());
+
+   // Return ok
+   return (OK_RC);
+}
+
 //
 // PrintBuffer
 //
@@ -527,10 +761,13 @@ WriteLog(psMessage);
 //
 RC PF_BufferMgr::PrintBuffer()
 {
+   lock_guard<mutex> lock(bufMutex);
    cout << "Buffer contains " << numPages << " pages of size "
       << pageSize <<".\n";
-   cout << "Contents in order from most recently used to "
-      << "least recently used.\n";
+   cout << "Replacement policy is " << pReplacer->Name() << ".\n";
+   cout << "Pages are on " << arena.Backing() << ".\n";
+   cout << "Contents in the order the pages were brought into the "
+      << "buffer, newest first.\n";
 
    int slot, next;
    slot = first;
@@ -540,7 +777,9 @@ RC PF_BufferMgr::PrintBuffer()
       cout << "  fd = " << bufTable[slot].fd << "\n";
       cout << "  pageNum = " << bufTable[slot].pageNum << "\n";
       cout << "  bDirty = " << bufTable[slot].bDirty << "\n";
-      cout << "  pinCount = " << bufTable[slot].pinCount << "\n";
+      cout << "  pinCount = " << (int)bufTable[slot].pinCount << "\n";
+      if (bufTable[slot].frameSize != pageSize)
+         cout << "  size = " << bufTable[slot].frameSize << "\n";
       slot = next;
    }
 
@@ -565,6 +804,21 @@ RC PF_BufferMgr::PrintBuffer()
 // Ret:  Will return an error if a page is pinned and the Clear routine
 //       is called.
 RC PF_BufferMgr::ClearBuffer()
+{
+   unique_lock<mutex> lock(bufMutex);
+   WaitForReads(lock, ALL_FILES);
+   WaitForWrites(lock, ALL_FILES);
+   return (InternalClear());
+}
+
+//
+// InternalClear
+//
+// Desc: Internal.  Remove all unpinned pages from the buffer, without
+//       writing them.  Called with the buffer manager lock held.
+// Ret:  PF return code
+//
+RC PF_BufferMgr::InternalClear()
 {
    RC rc;
 
@@ -572,11 +826,12 @@ RC PF_BufferMgr::ClearBuffer()
    slot = first;
    while (slot != INVALID_SLOT) {
       next = bufTable[slot].next;
-      if (bufTable[slot].pinCount == 0)
-         if ((rc = hashTable.Delete(bufTable[slot].fd,
-               bufTable[slot].pageNum)) ||
-            (rc = Unlink(slot)) ||
-            (rc = InsertFree(slot)))
+      if ((rc = Evict(slot, FALSE)) == 0) {
+         if ((rc = Unlink(slot)) ||
+               (rc = InsertFree(slot)))
+            return (rc);
+      }
+      else if (rc != PF_PAGEPINNED)
          return (rc);
       slot = next;
    }
@@ -592,43 +847,56 @@ RC PF_BufferMgr::ClearBuffer()
 // In:   The new buffer size
 // Out:  Nothing
 // Ret:  0 for success or,
+//       PF_PAGEPINNED if pages are pinned, or
 //       Some other PF error (probably PF_NOBUF)
 //
-// Notes: This method attempts to copy all the old pages which I am
-// unable to kick out of the old buffer manager into the new buffer
-// manager.  This obviously cannot always be successfull!
+// Notes: The buffer is cleared first.  Pinned pages cannot be moved to
+// the new buffer, since other threads hold pointers into their frames,
+// so the buffer is left as it is if any page is pinned.
 //
 RC PF_BufferMgr::ResizeBuffer(int iNewSize)
 {
    int i;
    RC rc;
+   unique_lock<mutex> lock(bufMutex);
+
+   // No read or write may be in progress while the frames are moved
+   WaitForReads(lock, ALL_FILES);
+   WaitForWrites(lock, ALL_FILES);
 
    // First try and clear out the old buffer!
-   ClearBuffer();
+   if ((rc = InternalClear()))
+      return (rc);
+   if (first != INVALID_SLOT)
+      return (PF_PAGEPINNED);
+
+   // Grow or shrink the arena in place.  The hash table is empty, so no
+   // other thread can get at the frames.
+   if ((rc = arena.Resize((size_t)iNewSize * pageSize)))
+      return (rc);
+   FreeFrames();
 
    // Allocate memory for a new buffer table
    PF_BufPageDesc *pNewBufTable = new PF_BufPageDesc[iNewSize];
 
-   // Initialize the new buffer table and allocate memory for buffer
-   // pages.  Initially, the free list contains all pages
+   // Initialize the new buffer table.  Initially, the free list contains
+   // all pages
    for (i = 0; i < iNewSize; i++) {
-      if ((pNewBufTable[i].pData = new char[pageSize]) == NULL) {
-         cerr << "Not enough memory for buffer\n";
-         exit(1);
-      }
-
-      memset ((void *)pNewBufTable[i].pData, 0, pageSize);
-
+      pNewBufTable[i].pData = arena.Base() + (size_t)i * pageSize;
+      pNewBufTable[i].frameSize = pageSize;
+      pNewBufTable[i].bDirty = pNewBufTable[i].bReading = FALSE;
+      pNewBufTable[i].bWriting = FALSE;
+      pNewBufTable[i].pinCount = 0;
+      pNewBufTable[i].logId = -1;
+      pNewBufTable[i].bLogPending = FALSE;
+      pNewBufTable[i].lsn = 0;
+      pNewBufTable[i].recLsn = 0;
       pNewBufTable[i].prev = i - 1;
       pNewBufTable[i].next = i + 1;
    }
    pNewBufTable[0].prev = pNewBufTable[iNewSize - 1].next = INVALID_SLOT;
 
-   // Now we must remember the old first and last slots and (of course)
-   // the buffer table itself.  Then we use insert methods to insert
-   // each of the entries into the new buffertable
-   int oldFirst = first;
-   PF_BufPageDesc *pOldBufTable = bufTable;
+   delete [] bufTable;
 
    // Setup the new number of pages,  first, last and free
    numPages = iNewSize;
@@ -638,47 +906,16 @@ RC PF_BufferMgr::ResizeBuffer(int iNewSize)
    // Setup the new buffer table
    bufTable = pNewBufTable;
 
-   // We must first remove from the hashtable any possible entries
-   int slot, next, newSlot;
-   slot = oldFirst;
-   while (slot != INVALID_SLOT) {
-      next = pOldBufTable[slot].next;
-
-      // Must remove the entry from the hashtable from the
-      if ((rc=hashTable.Delete(pOldBufTable[slot].fd, pOldBufTable[slot].pageNum)))
-         return (rc);
-      slot = next;
-   }
-
-   // Now we traverse through the old buffer table and copy any old
-   // entries into the new one
-   slot = oldFirst;
-   while (slot != INVALID_SLOT) {
-
-      next = pOldBufTable[slot].next;
-      // Allocate a new slot for the old page
-      if ((rc = InternalAlloc(newSlot)))
-         return (rc);
+   // Start the replacement policy afresh for the new slots
+   PF_Replacer *pNewReplacer = PF_NewReplacer(pReplacer->Name(), iNewSize);
+   delete pReplacer;
+   pReplacer = pNewReplacer;
 
-      // Insert the page into the hash table,
-      // and initialize the page description entry
-      if ((rc = hashTable.Insert(pOldBufTable[slot].fd,
-            pOldBufTable[slot].pageNum, newSlot)) ||
-            (rc = InitPageDesc(pOldBufTable[slot].fd,
-            pOldBufTable[slot].pageNum, newSlot)))
-         return (rc);
-
-      // Put the slot back on the free list before returning the error
-      Unlink(newSlot);
-      InsertFree(newSlot);
+   // Readahead is kept to a quarter of the buffer
+   raWindow = raPages < numPages / 4 ? raPages : numPages / 4;
 
-      slot = next;
-   }
-
-   // Finally, delete the old buffer table
-   delete [] pOldBufTable;
-
-   return 0;
+   // Size the hash table for the new number of pages
+   return (hashTable.Resize(iNewSize));
 }
 
 
@@ -691,6 +928,9 @@ RC PF_BufferMgr::ResizeBuffer(int iNewSize)
 //
 RC PF_BufferMgr::InsertFree(int slot)
 {
+   // The page is no longer in the buffer
+   pReplacer->Erase(slot);
+
    bufTable[slot].next = free;
    free = slot;
 
@@ -761,14 +1001,127 @@ RC PF_BufferMgr::Unlink(int slot)
    return (0);
 }
 
+//
+// HashInsert
+//
+// Desc: Internal.  Insert a hash table entry, holding the latch of its
+//       partition.  Called with the buffer manager lock held.
+// In:   fd - file descriptor
+//       pageNum - page number
+//       slot - slot of the page
+// Ret:  PF return code
+//
+RC PF_BufferMgr::HashInsert(int fd, PageNum pageNum, int slot)
+{
+   lock_guard<mutex> part(hashTable.Latch(fd, pageNum));
+   return (hashTable.Insert(fd, pageNum, slot));
+}
+
+//
+// HashDelete
+//
+// Desc: Internal.  Delete a hash table entry, holding the latch of its
+//       partition.  Called with the buffer manager lock held.
+// In:   fd - file descriptor
+//       pageNum - page number
+// Ret:  PF return code
+//
+RC PF_BufferMgr::HashDelete(int fd, PageNum pageNum)
+{
+   lock_guard<mutex> part(hashTable.Latch(fd, pageNum));
+   return (hashTable.Delete(fd, pageNum));
+}
+
+//
+// Evict
+//
+// Desc: Internal.  Remove the page in a slot from the hash table, unless
+//       it is pinned.  The pin count is checked under the partition
+//       latch, so no thread can pin the page once it has been removed.
+//       For the same reason no thread can change it while it is written
+//       here.  Called with the buffer manager lock held.
+// In:   slot - slot of the page
+//       bWriteDirty - TRUE to write the page first if it is dirty, FALSE
+//                     if the caller writes it or drops the changes
+// Ret:  PF_PAGEPINNED if the page is pinned, other PF return code
+//
+RC PF_BufferMgr::Evict(int slot, int bWriteDirty)
+{
+   RC rc;
+   int fd = bufTable[slot].fd;
+   PageNum pageNum = bufTable[slot].pageNum;
+   lock_guard<mutex> part(hashTable.Latch(fd, pageNum));
+
+   if (bufTable[slot].pinCount > 0)
+      return (PF_PAGEPINNED);
+   if (bWriteDirty && bufTable[slot].bDirty) {
+      if ((rc = WritePages(fd, &slot, 1)))
+         return (rc);
+      bufTable[slot].bDirty = FALSE;
+   }
+   return (hashTable.Delete(fd, pageNum));
+}
+
+//
+// Touch
+//
+// Desc: Internal.  Tell the replacement policy that the page in a slot
+//       has been used.  The caller holds a pin on the page but not the
+//       buffer manager lock.  If another thread holds the lock the use
+//       is not recorded rather than waited for, so that threads working
+//       on pages already in the buffer never queue behind a miss.  Even
+//       with a single client thread some uses go unrecorded, since the
+//       readahead, background writer and checkpointer threads take the
+//       lock too.
+// In:   slot - slot of the page
+//
+void PF_BufferMgr::Touch(int slot)
+{
+   unique_lock<mutex> lock(bufMutex, try_to_lock);
+   if (lock.owns_lock())
+      pReplacer->Reference(slot, (ClientHint)(int)bufTable[slot].hint);
+}
+
+//
+// WaitAlloc
+//
+// Desc: Internal.  Allocate a buffer slot like InternalAlloc.  Frames
+//       being read ahead or written by the background writer are pinned
+//       only for the duration of the I/O, so if those pins are all that
+//       stand in the way, wait for the I/O to finish and try again.
+//       With direct I/O the reads take long enough for a small buffer to
+//       run out this way.
+// In:   lock - the held buffer manager lock
+// Out:  slot - set to newly-allocated slot
+// Ret:  PF_NOBUF if all pages are pinned by the callers
+//
+RC PF_BufferMgr::WaitAlloc(unique_lock<mutex> &lock, int &slot)
+{
+   RC rc;
+
+   while ((rc = InternalAlloc(slot)) == PF_NOBUF) {
+      int bBusy = FALSE;
+      for (int i = first; i != INVALID_SLOT; i = bufTable[i].next)
+         if (bufTable[i].bReading || bufTable[i].bWriting) {
+            bBusy = TRUE;
+            break;
+         }
+      if (!bBusy)
+         break;
+      ioDone.wait(lock);
+   }
+   return (rc);
+}
+
 //
 // InternalAlloc
 //
 // Desc: Internal.  Allocate a buffer slot.  The slot is inserted at the
 //       head of the used list.  Here's how it chooses which slot to use:
 //       If there is something on the free list, then use it.
-//       Otherwise, choose a victim to replace.  If a victim cannot be
-//       chosen (because all the pages are pinned), then return an error.
+//       Otherwise, ask the replacement policy for a victim.  If a victim
+//       cannot be chosen (because all the pages are pinned), then return
+//       an error.
 // Out:  slot - set to newly-allocated slot
 // Ret:  PF_NOBUF if all pages are pinned, other PF return code otherwise
 //
@@ -783,28 +1136,57 @@ RC PF_BufferMgr::InternalAlloc(int &slot)
    }
    else {
 
-      // Choose the least-recently used page that is unpinned
-      for (slot = last; slot != INVALID_SLOT; slot = bufTable[slot].prev) {
-         if (bufTable[slot].pinCount == 0)
+      // Choose an unpinned page to replace and remove it from the hash
+      // table.  Another thread may pin the page in between, in which case
+      // it is put back in the replacement policy and another page is
+      // chosen.
+      for (int tries = 0; ; tries++) {
+         slot = pReplacer->Victim(bufTable);
+
+         // Return error if all buffers were pinned
+         if (slot == INVALID_SLOT)
+            return (PF_NOBUF);
+
+         if ((rc = Evict(slot, FALSE)) != PF_PAGEPINNED)
             break;
+         pReplacer->PutBack(slot, bufTable[slot].fd, bufTable[slot].pageNum,
+                            (ClientHint)(int)bufTable[slot].hint);
+         if (tries == numPages)
+            return (PF_NOBUF);
+      }
+      if (rc) {
+         pReplacer->PutBack(slot, bufTable[slot].fd, bufTable[slot].pageNum,
+                            (ClientHint)(int)bufTable[slot].hint);
+         return (rc);
       }
 
-      // Return error if all buffers were pinned
-      if (slot == INVALID_SLOT)
-         return (PF_NOBUF);
+#ifdef PF_STATS
+      pIOStats->Counts(bufTable[slot].fd).evictions++;
+#endif
 
-      // Write out the page if it is dirty
+      // Write out the page if it is dirty.  No other thread can find it
+      // now.  If it cannot be written it stays in the buffer, so give it
+      // back to the hash table and put it back in the replacement policy.
+      // Having to write here means the background writer is behind, so wake it up.
       if (bufTable[slot].bDirty) {
-         if ((rc = WritePage(bufTable[slot].fd, bufTable[slot].pageNum,
-               bufTable[slot].pData)))
+#ifdef PF_STATS
+         pStatisticsMgr->Add(PF_STAT_FGWRITE);
+         pIOStats->Counts(bufTable[slot].fd).dirtyEvictions++;
+#endif
+         bgWake.notify_one();
+         if ((rc = WritePages(bufTable[slot].fd, &slot, 1))) {
+            HashInsert(bufTable[slot].fd, bufTable[slot].pageNum, slot);
+            pReplacer->PutBack(slot, bufTable[slot].fd,
+                               bufTable[slot].pageNum,
+                               (ClientHint)(int)bufTable[slot].hint);
             return (rc);
+         }
 
          bufTable[slot].bDirty = FALSE;
       }
 
-      // Remove page from the hash table and slot from the used buffer list
-      if ((rc = hashTable.Delete(bufTable[slot].fd, bufTable[slot].pageNum)) ||
-            (rc = Unlink(slot)))
+      // Remove slot from the used buffer list
+      if ((rc = Unlink(slot)))
          return (rc);
    }
 
@@ -819,15 +1201,17 @@ RC PF_BufferMgr::InternalAlloc(int &slot)
 //
 // ReadPage
 //
-// Desc: Read a page from disk
+// Desc: Read a page from disk.  Called without the buffer manager lock
+//       held; the caller counts the read in the statistics.
 //
 // In:   fd - OS file descriptor
 //       pageNum - number of page to read
 //       dest - pointer to buffer in which to read page
+//       size - size of the page
 // Out:  dest - buffer contains page contents
 // Ret:  PF return code
 //
-RC PF_BufferMgr::ReadPage(int fd, PageNum pageNum, char *dest)
+RC PF_BufferMgr::ReadPage(int fd, PageNum pageNum, char *dest, int size)
 {
 
 #ifdef PF_LOG
@@ -836,20 +1220,20 @@ RC PF_BufferMgr::ReadPage(int fd, PageNum pageNum, char *dest)
    WriteLog(psMessage);
 #endif
 
+   // Read the data at the page's offset (cast to long for PC's)
+   long offset = pageNum * (long)size + PF_FILE_HDR_SIZE;
 #ifdef PF_STATS
-   pStatisticsMgr->Register(PF_READPAGE, STAT_ADDONE);
+   PF_IOTimer timer;
+#endif
+   int numBytes = pread(fd, dest, size, offset);
+#ifdef PF_STATS
+   pIOStats->readLatency.Add(timer.Micros());
+   if (numBytes == size)
+      pIOStats->Counts(fd).reads++;
 #endif
-
-   // seek to the appropriate place (cast to long for PC's)
-   long offset = pageNum * (long)pageSize + PF_FILE_HDR_SIZE;
-   if (lseek(fd, offset, L_SET) < 0)
-      return (PF_UNIX);
-
-   // Read the data
-   int numBytes = read(fd, dest, pageSize);
    if (numBytes < 0)
       return (PF_UNIX);
-   else if (numBytes != pageSize)
+   else if (numBytes != size)
       return (PF_INCOMPLETEREAD);
    else
       return (0);
@@ -863,9 +1247,10 @@ RC PF_BufferMgr::ReadPage(int fd, PageNum pageNum, char *dest)
 // In:   fd - OS file descriptor
 //       pageNum - number of page to write
 //       dest - pointer to buffer containing page contents
+//       size - size of the page
 // Ret:  PF return code
 //
-RC PF_BufferMgr::WritePage(int fd, PageNum pageNum, char *source)
+RC PF_BufferMgr::WritePage(int fd, PageNum pageNum, char *source, int size)
 {
 
 #ifdef PF_LOG
@@ -875,19 +1260,110 @@ RC PF_BufferMgr::WritePage(int fd, PageNum pageNum, char *source)
 #endif
 
 #ifdef PF_STATS
-   pStatisticsMgr->Register(PF_WRITEPAGE, STAT_ADDONE);
+   pStatisticsMgr->Add(PF_STAT_WRITEPAGE);
 #endif
 
-   // seek to the appropriate place (cast to long for PC's)
-   long offset = pageNum * (long)pageSize + PF_FILE_HDR_SIZE;
-   if (lseek(fd, offset, L_SET) < 0)
+   // Write the data at the page's offset (cast to long for PC's)
+   long offset = pageNum * (long)size + PF_FILE_HDR_SIZE;
+#ifdef PF_STATS
+   PF_IOTimer timer;
+#endif
+   int numBytes = pwrite(fd, source, size, offset);
+#ifdef PF_STATS
+   pIOStats->writeLatency.Add(timer.Micros());
+   if (numBytes == size)
+      pIOStats->Counts(fd).writes++;
+#endif
+   if (numBytes < 0)
       return (PF_UNIX);
+   else if (numBytes != size)
+      return (PF_INCOMPLETEWRITE);
+   else
+      return (0);
+}
+
+//
+// WritePages
+//
+// Desc: Internal.  Write a run of consecutive pages of a file to disk
+//       with one system call, once the log has their changes
+// In:   fd - OS file descriptor
+//       slots - buffer slots holding the pages, in page number order
+//       numSlots - number of slots, at most IOV_MAX
+// Ret:  PF return code
+//
+RC PF_BufferMgr::WritePages(int fd, const int *slots, int numSlots)
+{
+   RC rc;
+
+   // Write-ahead rule
+   if ((rc = LogBeforeWrite(slots, numSlots)))
+      return (rc);
+
+   if (numSlots == 1)
+      rc = WritePage(fd, bufTable[slots[0]].pageNum,
+                     bufTable[slots[0]].pData, bufTable[slots[0]].frameSize);
+   else
+      rc = WriteRun(fd, slots, numSlots);
+   if (rc)
+      return (rc);
+
+   // The changes logged for the pages are in the file now; once it is
+   // synced, a checkpoint no longer has to keep their records
+   for (int i = 0; i < numSlots; i++)
+      bufTable[slots[i]].recLsn = 0;
 
-   // Read the data
-   int numBytes = write(fd, source, pageSize);
+   // Return ok
+   return (0);
+}
+
+//
+// WriteRun
+//
+// Desc: Internal.  Write a run of consecutive pages of a file to disk
+//       with one pwritev call.  Called by WritePages.
+// In:   fd - OS file descriptor
+//       slots - buffer slots holding the pages, in page number order
+//       numSlots - number of slots, 2 to IOV_MAX
+// Ret:  PF return code
+//
+RC PF_BufferMgr::WriteRun(int fd, const int *slots, int numSlots)
+{
+
+#ifdef PF_LOG
+   char psMessage[100];
+   sprintf (psMessage, "Writing (%d,%d) to (%d,%d).\n", fd,
+         bufTable[slots[0]].pageNum, fd,
+         bufTable[slots[numSlots - 1]].pageNum);
+   WriteLog(psMessage);
+#endif
+
+#ifdef PF_STATS
+   pStatisticsMgr->Add(PF_STAT_WRITEPAGE, numSlots);
+#endif
+
+   // The pages of a file all have the same size
+   int size = bufTable[slots[0]].frameSize;
+   vector<struct iovec> iov(numSlots);
+   for (int i = 0; i < numSlots; i++) {
+      iov[i].iov_base = bufTable[slots[i]].pData;
+      iov[i].iov_len = size;
+   }
+
+   // Write the data starting at the first page's offset
+   long offset = bufTable[slots[0]].pageNum * (long)size + PF_FILE_HDR_SIZE;
+#ifdef PF_STATS
+   PF_IOTimer timer;
+#endif
+   long numBytes = pwritev(fd, &iov[0], numSlots, offset);
+#ifdef PF_STATS
+   pIOStats->writeLatency.Add(timer.Micros());
+   if (numBytes > 0)
+      pIOStats->Counts(fd).writes += numBytes / size;
+#endif
    if (numBytes < 0)
       return (PF_UNIX);
-   else if (numBytes != pageSize)
+   else if (numBytes != (long)numSlots * size)
       return (PF_INCOMPLETEWRITE);
    else
       return (0);
@@ -897,29 +1373,370 @@ RC PF_BufferMgr::WritePage(int fd, PageNum pageNum, char *source)
 // InitPageDesc
 //
 // Desc: Internal.  Initialize PF_BufPageDesc to a newly-pinned page
-//       for a newly pinned page
+//       for a newly pinned page, giving the slot a frame of the size of
+//       the pages of the file
 // In:   fd - file descriptor
 //       pageNum - page number
-// Ret:  PF return code
+//       hint - how the page will be used
+// Ret:  PF_NOMEM or other PF return code
 //
-RC PF_BufferMgr::InitPageDesc(int fd, PageNum pageNum, int slot)
+RC PF_BufferMgr::InitPageDesc(int fd, PageNum pageNum, int slot,
+                              ClientHint hint)
 {
+   RC rc;
+
+   if ((rc = SetFrame(slot, FilePageSize(fd))))
+      return (rc);
+
    // set the slot to refer to a newly-pinned page
    bufTable[slot].fd       = fd;
    bufTable[slot].pageNum  = pageNum;
    bufTable[slot].bDirty   = FALSE;
    bufTable[slot].pinCount = 1;
+   bufTable[slot].bReading = FALSE;
+   bufTable[slot].bWriting = FALSE;
+   bufTable[slot].hint     = hint;
+
+   map<int, int>::const_iterator it = fileLogId.find(fd);
+   bufTable[slot].logId       = (it == fileLogId.end() ? -1 : it->second);
+   bufTable[slot].bLogPending = FALSE;
+   bufTable[slot].lsn         = 0;
+   bufTable[slot].recLsn      = 0;
+
+   // Let the replacement policy know about the page
+   pReplacer->Insert(slot, fd, pageNum, hint);
+
+   // Return ok
+   return (0);
+}
+
+//
+// SetPageSize
+//
+// Desc: Tell the buffer manager the size of the pages of a file.  Called
+//       by PF_Manager when the file is opened and closed.
+// In:   fd - OS file descriptor
+//       pageSize - size of the pages on disk, 0 to forget fd
+// Ret:  PF return code
+//
+RC PF_BufferMgr::SetPageSize(int fd, int _pageSize)
+{
+   lock_guard<mutex> lock(bufMutex);
+
+   if (_pageSize == 0 || _pageSize == pageSize)
+      filePageSize.erase(fd);
+   else
+      filePageSize[fd] = _pageSize;
+
+   // Return ok
+   return (0);
+}
+
+//
+// MoveFile
+//
+// Desc: Copy a file to another and make the descriptors of the first
+//       refer to the copy, with dup2.  The pages of the file in the
+//       buffer then go to the copy under the same descriptors.  The lock
+//       is held throughout, once no page is being written, so that no
+//       write goes to the file left behind.
+// In:   fds - the descriptors of the file; fds[0] is read
+//       numFds - number of descriptors in fds
+//       newFd - descriptor of the copy, which should be empty
+// Ret:  PF_UNIX if the file cannot be copied
+//
+RC PF_BufferMgr::MoveFile(const int *fds, int numFds, int newFd)
+{
+   unique_lock<mutex> lock(bufMutex);
+   WaitForWrites(lock, ALL_FILES);
+
+   struct stat st;
+   if (fstat(fds[0], &st) < 0)
+      return (PF_UNIX);
+
+   vector<char> buf(16 * PF_MIN_DISK_PAGE_SIZE);
+   for (off_t offset = 0; offset < st.st_size; ) {
+      ssize_t numBytes = pread(fds[0], &buf[0],
+                               min((off_t)buf.size(), st.st_size - offset),
+                               offset);
+      if (numBytes <= 0 ||
+            pwrite(newFd, &buf[0], numBytes, offset) != numBytes)
+         return (PF_UNIX);
+      offset += numBytes;
+   }
+
+   for (int i = 0; i < numFds; i++)
+      if (dup2(newFd, fds[i]) < 0)
+         return (PF_UNIX);
 
    // Return ok
    return (0);
 }
 
+//
+// FilePageSize
+//
+// Desc: Internal.  Size of the pages of a file.  Called with the buffer
+//       manager lock held.
+// In:   fd - OS file descriptor
+// Ret:  size in bytes
+//
+int PF_BufferMgr::FilePageSize(int fd) const
+{
+   map<int, int>::const_iterator it = filePageSize.find(fd);
+   return (it == filePageSize.end() ? pageSize : it->second);
+}
+
+//
+// SetLog
+//
+// Desc: Give the buffer manager the write-ahead log, or NULL when there
+//       is none.  Called by PF_Manager when the log is opened and closed.
+// In:   _pLog - the log
+//
+void PF_BufferMgr::SetLog(PF_LogMgr *_pLog)
+{
+   lock_guard<mutex> lock(bufMutex);
+   pLog = _pLog;
+}
+
+//
+// GetLog
+//
+// Desc: Return the write-ahead log, NULL if there is none
+//
+PF_LogMgr *PF_BufferMgr::GetLog() const
+{
+   return (pLog);
+}
+
+//
+// SetLogId
+//
+// Desc: Tell the buffer manager that the pages of a file are logged, and
+//       the id of the file in the log.  Called by PF_Manager when the
+//       file is opened and closed, before any of its pages is in the
+//       buffer.
+// In:   fd - OS file descriptor
+//       logId - id of the file in the log, -1 if it is not logged
+// Ret:  PF return code
+//
+RC PF_BufferMgr::SetLogId(int fd, int logId)
+{
+   lock_guard<mutex> lock(bufMutex);
+
+   if (logId < 0)
+      fileLogId.erase(fd);
+   else
+      fileLogId[fd] = logId;
+
+   // Return ok
+   return (0);
+}
+
+//
+// LogChange
+//
+// Desc: Mark a page dirty and add a log record of the bytes of it that
+//       were changed.  Nothing is logged if the page is not logged, or
+//       will be logged whole anyway.
+// In:   fd - OS file descriptor of the file associated with the page
+//       pageNum - number of the page, which must be pinned
+//       offset - offset in the page of the bytes changed
+//       length - number of bytes changed
+// Ret:  PF return code
+//
+RC PF_BufferMgr::LogChange(int fd, PageNum pageNum, int offset, int length)
+{
+   RC  rc;       // return code
+   int slot;     // buffer slot where page is located
+
+   {
+      lock_guard<mutex> part(hashTable.Latch(fd, pageNum));
+
+      // The page must be found and pinned in the buffer
+      if ((rc = hashTable.Find(fd, pageNum, slot))){
+         if ((rc == PF_HASHNOTFOUND))
+            return (PF_PAGENOTINBUF);
+         else
+            return (rc);              // unexpected error
+      }
+
+      if (bufTable[slot].pinCount == 0)
+         return (PF_PAGEUNPINNED);
+
+      PF_BufPageDesc &desc = bufTable[slot];
+      desc.bDirty = TRUE;
+      if (desc.logId >= 0 && pLog != NULL && !desc.bLogPending) {
+         long lsn;
+         long fileOffset = desc.pageNum * (long)desc.frameSize +
+            PF_FILE_HDR_SIZE + offset;
+         if ((rc = pLog->Append(desc.logId, fileOffset, desc.pData + offset,
+                                length, lsn, &desc.recLsn)))
+            return (rc);
+         desc.lsn = lsn;
+      }
+   }
+
+   // Make this page the most recently used page
+   Touch(slot);
+
+   // Return ok
+   return (0);
+}
+
+//
+// LogPages
+//
+// Desc: Add a log record holding the image of each page of a file that
+//       has changed since it was last logged.  The records are not
+//       flushed.
+// In:   fd - OS file descriptor, or ALL_FILES
+// Ret:  PF return code
+//
+RC PF_BufferMgr::LogPages(int fd)
+{
+   RC rc;
+   lock_guard<mutex> lock(bufMutex);
+
+   if (pLog == NULL)
+      return (0);
+   for (int slot = first; slot != INVALID_SLOT; slot = bufTable[slot].next)
+      if ((fd == ALL_FILES || bufTable[slot].fd == fd) &&
+            bufTable[slot].logId >= 0 &&
+            bufTable[slot].bLogPending.exchange(FALSE) &&
+            (rc = LogImage(slot)))
+         return (rc);
+
+   // Return ok
+   return (0);
+}
+
+//
+// LogImage
+//
+// Desc: Internal.  Add a log record holding the image of the page in a
+//       slot.  The caller has taken its bLogPending flag.  The image is
+//       copied under the lock of the log, so that the record has every
+//       change made before the records that follow it.
+// In:   slot - slot of a page of a logged file
+// Ret:  PF return code
+//
+RC PF_BufferMgr::LogImage(int slot)
+{
+   RC rc;
+   long lsn;
+   PF_BufPageDesc &desc = bufTable[slot];
+
+   if ((rc = pLog->Append(desc.logId,
+         desc.pageNum * (long)desc.frameSize + PF_FILE_HDR_SIZE,
+         desc.pData, desc.frameSize, lsn, &desc.recLsn))) {
+      desc.bLogPending = TRUE;
+      return (rc);
+   }
+   desc.lsn = lsn;
+
+   // Return ok
+   return (0);
+}
+
+//
+// LogBeforeWrite
+//
+// Desc: Internal.  Make the log records of pages about to be written
+//       durable, logging the pages that changed since their last record
+//       first.  The pages are pinned or cannot be found by other threads.
+// In:   slots - slots of the pages
+//       numSlots - number of slots
+// Ret:  PF return code
+//
+RC PF_BufferMgr::LogBeforeWrite(const int *slots, int numSlots)
+{
+   RC rc;
+   long lsn = 0;
+
+   if (pLog == NULL || !pLog->IsOpen())
+      return (0);
+
+   for (int i = 0; i < numSlots; i++) {
+      PF_BufPageDesc &desc = bufTable[slots[i]];
+      if (desc.logId < 0)
+         continue;
+      if (desc.bLogPending.exchange(FALSE) && (rc = LogImage(slots[i])))
+         return (rc);
+      if (desc.lsn > lsn)
+         lsn = desc.lsn;
+   }
+
+   return (lsn > 0 ? pLog->FlushTo(lsn) : 0);
+}
+
+//
+// SetFrame
+//
+// Desc: Internal.  Make the frame of a slot the given size.  Frames of
+//       the size of the arena frames are the slot's frame in the arena,
+//       others are allocated on their own, aligned for direct I/O.  The
+//       slot must not hold a page.
+// In:   slot - slot number
+//       size - frame size needed
+// Ret:  PF_NOMEM or 0
+//
+RC PF_BufferMgr::SetFrame(int slot, int size)
+{
+   PF_BufPageDesc &desc = bufTable[slot];
+   if (desc.frameSize == size)
+      return (0);
+
+   if (desc.frameSize != pageSize)
+      ::free(desc.pData);
+   desc.pData = arena.Base() + (size_t)slot * pageSize;
+   desc.frameSize = pageSize;
+
+   if (size != pageSize) {
+      void *p;
+      if (posix_memalign(&p, pageSize, size))
+         return (PF_NOMEM);
+      desc.pData = (char *)p;
+      desc.frameSize = size;
+   }
+
+   // Return ok
+   return (0);
+}
+
+//
+// FreeFrames
+//
+// Desc: Internal.  Free the frames that are not in the arena, before
+//       the buffer table goes away.  No slot may hold a page.
+//
+void PF_BufferMgr::FreeFrames()
+{
+   for (int i = 0; i < numPages; i++)
+      SetFrame(i, pageSize);
+}
+
 //------------------------------------------------------------------------------
 // Methods for manipulating raw memory buffers
 //------------------------------------------------------------------------------
 
 #define MEMORY_FD -1
 
+//
+// GetBufferSize
+//
+// Desc: Return the number of pages in the buffer
+// Out:  _numPages - number of pages
+// Ret:  OK_RC
+//
+RC PF_BufferMgr::GetBufferSize(int &_numPages) const
+{
+   lock_guard<mutex> lock(bufMutex);
+   _numPages = numPages;
+   return OK_RC;
+}
+
 //
 // GetBlockSize
 //
@@ -943,19 +1760,21 @@ RC PF_BufferMgr::GetBlockSize(int &length) const
 //
 RC PF_BufferMgr::AllocateBlock(char *&buffer)
 {
+   unique_lock<mutex> lock(bufMutex);
    RC rc = OK_RC;
 
    // Get an empty slot from the buffer pool
    int slot;
-   if ((rc = InternalAlloc(slot)) != OK_RC)
+   if ((rc = WaitAlloc(lock, slot)) != OK_RC)
       return rc;
 
-   // Create artificial page number (just needs to be unique for hash table)
-   PageNum pageNum = bufTable[slot].pData - (char*)0;
+   // Create artificial page number (just needs to be unique for hash
+   // table), the slot, which DisposeBlock finds from the address
+   PageNum pageNum = slot;
 
-   // Insert the page into the hash table, and initialize the page description entry
-   if ((rc = hashTable.Insert(MEMORY_FD, pageNum, slot) != OK_RC) ||
-         (rc = InitPageDesc(MEMORY_FD, pageNum, slot)) != OK_RC) {
+   // Initialize the page description entry, and insert the page into the hash table
+   if ((rc = InitPageDesc(MEMORY_FD, pageNum, slot, NO_HINT)) != OK_RC ||
+         (rc = HashInsert(MEMORY_FD, pageNum, slot)) != OK_RC) {
       // Put the slot back on the free list before returning the error
       Unlink(slot);
       InsertFree(slot);
@@ -976,5 +1795,9 @@ RC PF_BufferMgr::AllocateBlock(char *&buffer)
 //
 RC PF_BufferMgr::DisposeBlock(char* buffer)
 {
-   return UnpinPage(MEMORY_FD, buffer - (char*)0);
+   size_t offset = buffer - arena.Base();
+   if (buffer < arena.Base() || offset >= arena.Reserved() ||
+         offset % pageSize != 0)
+      return (PF_PAGENOTINBUF);
+   return UnpinPage(MEMORY_FD, offset / pageSize);
 }
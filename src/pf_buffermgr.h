@@ -11,12 +11,50 @@
 // a particular file.  Allows students to use main memory chunks that
 // are associated with (and limited by) the buffer.
 //
+// Concurrency: any number of threads may call the buffer manager.  A
+// page that is already in the buffer is pinned, marked dirty and
+// unpinned holding only the latch of its hash table partition, so that
+// threads working on resident pages do not wait for each other.
+// Everything that changes which pages are in the buffer (misses, page
+// replacement, flushing, readahead, the background writer) holds
+// bufMutex, and takes the partition latch as well when it changes the
+// hash table.  Pin counts and the dirty and reading flags are atomic.
+// The contents of a page are protected by the latch of its frame, see
+// PF_PageHandle::LatchShared.
+//
+// Files may have pages larger than the 4096 bytes of a frame in the
+// arena (see PF_Manager::CreateFile).  Such a page is held in a frame of
+// its own size, allocated when a slot takes the page and freed when the
+// slot takes a page of another size.  The buffer holds numPages pages
+// whatever their size.
+//
+// Pages of files that are logged (see PF_Manager::OpenLog) follow the
+// write-ahead rule: a page is only written once the log records of its
+// changes are durable.  A change is logged either as the bytes changed,
+// by LogChange, or, for a page that was only marked dirty, as an image
+// of the whole page, taken when its changes are committed or just
+// before it is written.
+//
+// The oldest record of a change that is not yet written is noted for
+// each frame (recLsn); together these make the dirty page table that
+// Checkpoint uses to tell how much of the log is still needed.
+//
 
 #ifndef PF_BUFFERMGR_H
 #define PF_BUFFERMGR_H
 
+#include <atomic>
+#include <deque>
+#include <map>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
 #include "pf_internal.h"
 #include "pf_hashtable.h"
+#include "pf_replacer.h"
+#include "pf_arena.h"
+#include "pf_logmgr.h"
 
 //
 // Defines
@@ -28,17 +66,41 @@
 // next.
 #define INVALID_SLOT  (-1)
 
+// ALL_FILES is passed instead of a file descriptor to wait for the
+// reads of every file
+#define ALL_FILES     (-2)
+
 //
 // PF_BufPageDesc - struct containing data about a page in the buffer
 //
 struct PF_BufPageDesc {
     char       *pData;      // page contents
+    int        frameSize;   // bytes at pData
     int        next;        // next in the linked list of buffer pages
     int        prev;        // prev in the linked list of buffer pages
-    int        bDirty;      // TRUE if page is dirty
-    short int  pinCount;    // pin count
+    std::atomic<int> bDirty;   // TRUE if page is dirty
+    std::atomic<int> pinCount; // pin count
     PageNum    pageNum;     // page number for this page
     int        fd;          // OS file descriptor of this page
+    std::atomic<int> bReading; // TRUE while the page is being read in
+    int        bWriting;    // TRUE while the background writer writes it
+    std::atomic<int> hint;  // ClientHint the page is being used with
+    PF_Latch   latch;       // shared/exclusive latch on the contents
+    int        logId;       // file id in the log, -1 if not logged
+    std::atomic<int> bLogPending; // TRUE if changed since last logged
+    std::atomic<long> lsn;  // LSN past the last record of the page
+    std::atomic<long> recLsn; // LSN of the first record of a change not
+                            // yet written, 0 if none
+};
+
+//
+// PF_ReadAheadReq - pages of a file queued for readahead
+//
+struct PF_ReadAheadReq {
+    int        fd;          // OS file descriptor
+    PageNum    pageNum;     // first page to read
+    int        numPages;    // number of pages to read
+    ClientHint hint;        // hint of the scan asking for them
 };
 
 //
@@ -51,11 +113,15 @@ public:
                                                   // numPages buffer pages
     ~PF_BufferMgr    ();                         // Destructor
 
-    // Read pageNum into buffer, point *ppBuffer to location
+    // Read pageNum into buffer, point *ppBuffer to location, and
+    // *ppLatch to the latch of the page if ppLatch is given.  hint says
+    // how the page will be used, for the replacement policy.
     RC  GetPage      (int fd, PageNum pageNum, char **ppBuffer,
-                      int bMultiplePins = TRUE);
+                      int bMultiplePins = TRUE, PF_Latch **ppLatch = NULL,
+                      ClientHint hint = NO_HINT);
     // Allocate a new page in the buffer, point *ppBuffer to its location
-    RC  AllocatePage (int fd, PageNum pageNum, char **ppBuffer);
+    RC  AllocatePage (int fd, PageNum pageNum, char **ppBuffer,
+                      PF_Latch **ppLatch = NULL, ClientHint hint = NO_HINT);
 
     RC  MarkDirty    (int fd, PageNum pageNum);  // Mark page dirty
     RC  UnpinPage    (int fd, PageNum pageNum);  // Unpin page from the buffer
@@ -73,6 +139,51 @@ public:
     // Attempts to resize the buffer to the new size
     RC ResizeBuffer  (int iNewSize);
 
+    // Return the number of pages in the buffer
+    RC GetBufferSize (int &_numPages) const;
+
+    // Set pages to the numbers of the pages of fd in the buffer, in
+    // ascending order
+    RC GetResidentPages(int fd, std::vector<PageNum> &pages);
+
+    // Readahead (pf_readahead.cc).  ReadAhead queues numPages pages of
+    // fd starting at pageNum to be read into free frames in the
+    // background.  GetReadAheadPages returns how many pages a
+    // sequential scan should keep queued ahead of itself (0 if
+    // readahead is turned off).  The workers also bring back the pages
+    // of a buffer dump (see PF_Manager::RestoreBuffer).
+    RC  ReadAhead    (int fd, PageNum pageNum, int numPages,
+                      ClientHint hint = NO_HINT);
+    int GetReadAheadPages() const;
+
+    // Set the size of the pages of fd on disk, when the file is opened.
+    // 0 forgets fd, when it is closed.
+    RC  SetPageSize  (int fd, int pageSize);
+
+    // Copy the file open as fds[0] into the file open as newFd, and make
+    // the numFds descriptors in fds refer to the copy.  No page is
+    // written meanwhile.
+    RC  MoveFile     (const int *fds, int numFds, int newFd);
+
+    // Write-ahead logging.  SetLog gives the log to write to, SetLogId
+    // the id of fd in the log (-1 if fd is not logged).  LogChange marks
+    // a pinned page dirty and logs length bytes of it at offset.
+    // LogPages logs an image of each page of fd (or ALL_FILES) that has
+    // changed since it was last logged; the records are not flushed.
+    void SetLog      (PF_LogMgr *pLog);
+    PF_LogMgr *GetLog() const;
+    RC  SetLogId     (int fd, int logId);
+    RC  LogChange    (int fd, PageNum pageNum, int offset, int length);
+    RC  LogPages     (int fd);
+
+    // Checkpoints (pf_checkpoint.cc).  Checkpoint writes the dirty pages
+    // of the logged files, syncs the files and drops the log records no
+    // longer needed.  StartCheckpointer starts a thread doing this
+    // periodically while the log is open, StopCheckpointer stops it.
+    RC  Checkpoint   ();
+    void StartCheckpointer();
+    void StopCheckpointer ();
+
     // Three Methods for manipulating raw memory buffers.  These memory
     // locations are handled by the buffer manager, but are not
     // associated with a particular file.  These should be used if you
@@ -91,23 +202,125 @@ private:
     RC  LinkHead     (int slot);                 // Insert slot at head of used
     RC  Unlink       (int slot);                 // Unlink slot
     RC  InternalAlloc(int &slot);                // Get a slot to use
+    // Get a slot to use for a caller that can wait for the pins held by
+    // readahead and the background writer to go away
+    RC  WaitAlloc    (std::unique_lock<std::mutex> &lock, int &slot);
 
-    // Read a page
-    RC  ReadPage     (int fd, PageNum pageNum, char *dest);
+    // Add or remove a hash table entry, latching its partition
+    RC  HashInsert   (int fd, PageNum pageNum, int slot);
+    RC  HashDelete   (int fd, PageNum pageNum);
 
-    // Write a page
-    RC  WritePage    (int fd, PageNum pageNum, char *source);
+    // Remove the page in slot from the hash table if it is not pinned,
+    // writing it first if it is dirty and bWriteDirty is TRUE.  Returns
+    // PF_PAGEPINNED if it is pinned.
+    RC  Evict        (int slot, int bWriteDirty);
+
+    // Tell the replacement policy about a use of the pinned page in
+    // slot, unless another thread holds bufMutex
+    void Touch       (int slot);
+
+    // Size of the pages of fd, pageSize unless SetPageSize said otherwise
+    int FilePageSize (int fd) const;
+
+    // Give slot a frame of size bytes, and give all the frames not in the
+    // arena back
+    RC  SetFrame     (int slot, int size);
+    void FreeFrames  ();
+
+    // Read a page of size bytes
+    RC  ReadPage     (int fd, PageNum pageNum, char *dest, int size);
+
+    // Write a page of size bytes
+    RC  WritePage    (int fd, PageNum pageNum, char *source, int size);
+
+    // Write the pages in numSlots slots, holding consecutive pages of
+    // fd, with a single system call (WriteRun when there are several)
+    RC  WritePages   (int fd, const int *slots, int numSlots);
+    RC  WriteRun     (int fd, const int *slots, int numSlots);
+
+    // Log an image of the page in slot.  LogBeforeWrite makes the
+    // changes of the pages in numSlots slots durable before they are
+    // written.
+    RC  LogImage     (int slot);
+    RC  LogBeforeWrite(const int *slots, int numSlots);
+
+    // Write the dirty pages of fd (all of them or only pageNum), in
+    // runs of consecutive pages, with the lock held
+    RC  WriteDirty   (std::unique_lock<std::mutex> &lock, int fd,
+                      PageNum pageNum, int bUnpinnedOnly);
 
     // Init the page desc entry
-    RC  InitPageDesc (int fd, PageNum pageNum, int slot);
+    RC  InitPageDesc (int fd, PageNum pageNum, int slot, ClientHint hint);
 
+    // Remove all unpinned pages, with the lock held
+    RC  InternalClear();
+
+    // Readahead (pf_readahead.cc)
+    void StartReadAhead ();                      // Start the workers
+    void StopReadAhead  ();                      // Stop the workers
+    void ReadAheadWorker();                      // Body of a worker thread
+    void ReadRun     (std::unique_lock<std::mutex> &lock, int fd,
+                      const int *slots, int numSlots);
+    // Drop queued readahead for fd (or ALL_FILES) and wait for the
+    // reads already under way
+    void WaitForReads(std::unique_lock<std::mutex> &lock, int fd);
+
+    // Background writer (pf_bgwriter.cc)
+    void StartBgWriter  ();                      // Start the writer
+    void StopBgWriter   ();                      // Stop the writer
+    void BgWriterMain   ();                      // Body of the writer
+    void BgClean     (std::unique_lock<std::mutex> &lock);
+    // Write the dirty pages in slots, dropping the lock while writing
+    RC  BgWrite      (std::unique_lock<std::mutex> &lock,
+                      std::vector<int> &slots, int &numWritten);
+    // Wait until the background writer is done with the pages of fd
+    // (or ALL_FILES)
+    void WaitForWrites(std::unique_lock<std::mutex> &lock, int fd);
+
+    // Checkpointer (pf_checkpoint.cc)
+    void CheckpointerMain();                      // Body of the thread
+
+    PF_Arena       arena;                         // memory of the frames
     PF_BufPageDesc *bufTable;                     // info on buffer pages
     PF_HashTable   hashTable;                     // Hash table object
+    PF_Replacer    *pReplacer;                    // Replacement policy
     int            numPages;                      // # of pages in the buffer
-    int            pageSize;                      // Size of pages in the buffer
+    int            pageSize;                      // Size of frames in the arena
+    std::map<int, int> filePageSize;              // fd -> size, if not pageSize
+    std::map<int, int> fileLogId;                 // fd -> id, if logged
+    PF_LogMgr      *pLog;                         // write-ahead log, or NULL
     int            first;                         // MRU page slot
     int            last;                          // LRU page slot
     int            free;                          // head of free list
+
+    // All of the above is protected by bufMutex (see the top of the
+    // file for the hash table and the atomic fields of bufTable).
+    // ioDone is signalled whenever a read or write of a frame completes.
+    mutable std::mutex          bufMutex;
+    std::condition_variable     ioDone;
+
+    // Readahead state, also protected by bufMutex
+    std::deque<PF_ReadAheadReq> raQueue;          // requests not yet started
+    std::condition_variable     raWork;           // signalled on new requests
+    std::vector<std::thread>    raWorkers;        // worker threads
+    int            raPages;                       // pages to read ahead
+    std::atomic<int> raWindow;                    // GetReadAheadPages value
+    int            bShutdown;                     // TRUE to stop the workers
+
+    // Background writer state, also protected by bufMutex
+    std::thread                 bgWriter;         // writer thread
+    std::condition_variable     bgWake;           // wakes the writer early
+    int            bgLow;                         // % clean to start writing
+    int            bgHigh;                        // % of pool kept clean
+    int            bgDelay;                       // ms between rounds
+    int            bBgShutdown;                   // TRUE to stop the writer
+
+    // Checkpointer state, also protected by bufMutex
+    std::thread                 checkpointer;     // checkpointer thread
+    std::condition_variable     ckptWake;         // wakes it to stop
+    int            ckptTimeout;                   // s between checkpoints
+    long           ckptLogSize;                   // log bytes to start one
+    int            bCkptShutdown;                 // TRUE to stop it
 };
 
 #endif
@@ -0,0 +1,200 @@
+//
+// File:        pf_checkpoint.cc
+// Description: Fuzzy checkpoints of the PF buffer manager
+//
+// Pages of logged files are written lazily, so the write-ahead log grows
+// until the files are closed for good, and recovery would redo all of
+// it.  A checkpoint bounds both without stopping the other threads:
+//
+//    1. the dirty pages of the logged files are written, in file and
+//       page order, the way the background writer writes them;
+//    2. the dirty page table is read: the redo LSN is the oldest recLsn
+//       of a page still dirty (changed again meanwhile, or latched), or
+//       the end of the log if there is none;
+//    3. the logged files are synced, so that everything written before
+//       step 2 is on disk;
+//    4. the log records a checkpoint and drops what comes before the
+//       redo LSN (see PF_LogMgr::Checkpoint).
+//
+// The checkpointer thread runs while the log is open.  It starts a
+// checkpoint checkpoint_timeout seconds after the last one, or as soon
+// as the log holds checkpoint_log_size kilobytes, if anything was logged
+// since the last one.
+//
+// Settings (see pf_config.cc):
+//    checkpoint_timeout    seconds between checkpoints (default 30, 0
+//                          turns the checkpointer off)
+//    checkpoint_log_size   log size, in KB, that starts a checkpoint
+//                          early (default 16384)
+//
+// Checkpoints are counted under CHECKPOINT, and the pages they write
+// under CKPTWRITE.  How long each took goes in the checkpoint histogram
+// of PRINT IO.
+//
+
+#include <cerrno>
+#include <chrono>
+#include <unistd.h>
+#include "pf_buffermgr.h"
+
+using namespace std;
+
+#ifdef PF_STATS
+#include "statistics.h"
+#include "pf_iostats.h"
+
+// This is defined within pf_buffermgr.cc
+extern StatisticsMgr *pStatisticsMgr;
+#endif
+
+//
+// Defines
+//
+#define PF_CHECKPOINT_TIMEOUT  30     // default s between checkpoints
+#define PF_CHECKPOINT_LOG_SIZE 16384  // default KB of log to start one
+#define PF_CHECKPOINT_POLL     1000   // ms between looks at the log size
+
+//
+// Checkpoint
+//
+// Desc: Take a checkpoint, see the top of the file.  Does nothing if
+//       there is no log open.  May be called by any thread.
+// Ret:  PF return code; the log is left as it was on an error
+//
+RC PF_BufferMgr::Checkpoint()
+{
+   RC rc;
+#ifdef PF_STATS
+   PF_IOTimer timer;
+#endif
+   unique_lock<mutex> lock(bufMutex);
+
+   if (pLog == NULL || !pLog->IsOpen())
+      return (0);
+
+   // Write the dirty pages of the logged files
+   vector<int> dirty;
+   for (int slot = first; slot != INVALID_SLOT; slot = bufTable[slot].next)
+      if (bufTable[slot].logId >= 0 && bufTable[slot].bDirty &&
+            bufTable[slot].fd >= 0 && !bufTable[slot].bWriting)
+         dirty.push_back(slot);
+
+   int numWritten;
+   rc = BgWrite(lock, dirty, numWritten);
+#ifdef PF_STATS
+   if (numWritten > 0)
+      pStatisticsMgr->Add(PF_STAT_CKPTWRITE, numWritten);
+#endif
+   if (rc)
+      return (rc);
+
+   // Read the dirty page table.  A record added after redoLsn is taken
+   // is past it; one added before has set the recLsn of its page, which
+   // stays set until the page is written.
+   long redoLsn = pLog->EndLsn();
+   for (int slot = first; slot != INVALID_SLOT; slot = bufTable[slot].next) {
+      long recLsn = bufTable[slot].recLsn;
+      if (recLsn > 0 && recLsn < redoLsn)
+         redoLsn = recLsn;
+   }
+
+   vector<int> fds;
+   for (map<int, int>::iterator it = fileLogId.begin();
+         it != fileLogId.end(); ++it)
+      fds.push_back(it->first);
+   lock.unlock();
+
+   // Pages written before the table was read are on disk once their
+   // files are synced.  A file closed meanwhile was synced when it was
+   // written back.
+   for (size_t i = 0; i < fds.size(); i++)
+      if (fdatasync(fds[i]) < 0 && errno != EBADF)
+         return (PF_UNIX);
+
+   if ((rc = pLog->Checkpoint(redoLsn)))
+      return (rc);
+
+#ifdef PF_STATS
+   pStatisticsMgr->Add(PF_STAT_CHECKPOINT);
+   pIOStats->checkpointTime.Add(timer.Micros());
+#endif
+
+   // Return ok
+   return (0);
+}
+
+//
+// StartCheckpointer
+//
+// Desc: Read the checkpoint settings and start the checkpointer thread.
+//       Called by PF_Manager::OpenLog once the log is open.
+//
+void PF_BufferMgr::StartCheckpointer()
+{
+   if (checkpointer.joinable())
+      return;
+
+   bCkptShutdown = FALSE;
+   ckptTimeout = PF_GetConfigInt("checkpoint_timeout",
+                                 PF_CHECKPOINT_TIMEOUT);
+   ckptLogSize = PF_GetConfigInt("checkpoint_log_size",
+                                 PF_CHECKPOINT_LOG_SIZE) * 1024L;
+   if (ckptLogSize < 1)
+      ckptLogSize = 1;
+
+   if (ckptTimeout <= 0)
+      return;
+
+   checkpointer = thread(&PF_BufferMgr::CheckpointerMain, this);
+}
+
+//
+// StopCheckpointer
+//
+// Desc: Stop the checkpointer thread, waiting for a checkpoint under way.
+//       Called by PF_Manager::CloseLog and the destructor.
+//
+void PF_BufferMgr::StopCheckpointer()
+{
+   if (!checkpointer.joinable())
+      return;
+
+   {
+      lock_guard<mutex> lock(bufMutex);
+      bCkptShutdown = TRUE;
+   }
+   ckptWake.notify_one();
+   checkpointer.join();
+}
+
+//
+// CheckpointerMain
+//
+// Desc: Internal.  Body of the checkpointer thread.  A checkpoint that
+//       fails is tried again at the next look.
+//
+void PF_BufferMgr::CheckpointerMain()
+{
+   unique_lock<mutex> lock(bufMutex);
+   chrono::steady_clock::time_point last = chrono::steady_clock::now();
+   long lastEndLsn = pLog->EndLsn();
+
+   while (!bCkptShutdown) {
+      ckptWake.wait_for(lock, chrono::milliseconds(PF_CHECKPOINT_POLL));
+      if (bCkptShutdown)
+         break;
+
+      if (pLog->EndLsn() == lastEndLsn)
+         continue;
+      if (chrono::steady_clock::now() - last < chrono::seconds(ckptTimeout)
+            && pLog->Size() < ckptLogSize)
+         continue;
+
+      lock.unlock();
+      if (!Checkpoint()) {
+         last = chrono::steady_clock::now();
+         lastEndLsn = pLog->EndLsn();
+      }
+      lock.lock();
+   }
+}
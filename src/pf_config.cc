@@ -0,0 +1,191 @@
+//
+// File:        pf_config.cc
+// Description: Run-time configuration of the PF component
+//
+// Settings are looked up by key (for example "buffer_size").  A setting
+// can be given either in the environment, as REDBASE_<KEY> with the key
+// in upper case, or in a configuration file of "key = value" lines.  The
+// file is named by the REDBASE_CONFIG environment variable and defaults
+// to "redbase.conf" in the current directory.  The environment always
+// takes precedence over the file.  Lines starting with '#' are comments.
+//
+
+#include <cctype>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <strings.h>
+#include <string>
+#include <map>
+#include "pf_internal.h"
+
+using namespace std;
+
+//
+// Defines
+//
+#define PF_CONFIG_FILE     "redbase.conf"     // default config file
+#define PF_CONFIG_ENV      "REDBASE_CONFIG"   // names another config file
+#define PF_CONFIG_PREFIX   "REDBASE_"         // prefix of environment keys
+#define PF_CONFIG_LINE     256                // longest line in the file
+
+//
+// Settings read from the configuration files
+//
+static map<string, string> *pConfig = NULL;
+
+static RC ReadConfigFile(const char *fileName);
+
+//
+// Trim
+//
+// Desc: Internal.  Strip leading and trailing white space from a string
+//
+static string Trim(const string &s)
+{
+   size_t start = 0, end = s.size();
+   while (start < end && isspace((unsigned char)s[start]))
+      start++;
+   while (end > start && isspace((unsigned char)s[end - 1]))
+      end--;
+   return s.substr(start, end - start);
+}
+
+//
+// ReadDefaults
+//
+// Desc: Internal.  Read the default configuration file the first time
+//       any setting is needed.
+//
+static void ReadDefaults()
+{
+   if (pConfig != NULL)
+      return;
+
+   pConfig = new map<string, string>;
+   const char *fileName = getenv(PF_CONFIG_ENV);
+   ReadConfigFile(fileName ? fileName : PF_CONFIG_FILE);
+}
+
+//
+// PF_LoadConfig
+//
+// Desc: Read the settings in fileName on top of the default
+//       configuration.  Settings from fileName replace settings of the
+//       same name read earlier.  It is not an error for the file not to
+//       exist.  Used to apply per-database settings at startup.
+// In:   fileName - name of the configuration file
+// Ret:  PF return code
+//
+RC PF_LoadConfig(const char *fileName)
+{
+   ReadDefaults();
+   return (ReadConfigFile(fileName));
+}
+
+//
+// ReadConfigFile
+//
+// Desc: Internal.  Add the settings in fileName to the table
+// In:   fileName - name of the configuration file
+// Ret:  PF return code
+//
+static RC ReadConfigFile(const char *fileName)
+{
+   FILE *fp = fopen(fileName, "r");
+   if (fp == NULL)
+      return (0);
+
+   char line[PF_CONFIG_LINE];
+   while (fgets(line, PF_CONFIG_LINE, fp) != NULL) {
+      string entry = Trim(line);
+      if (entry.empty() || entry[0] == '#')
+         continue;
+
+      // Accept both "key = value" and "key value"
+      size_t sep = entry.find('=');
+      if (sep == string::npos)
+         sep = entry.find_first_of(" \t");
+      if (sep == string::npos)
+         continue;
+
+      string key = Trim(entry.substr(0, sep));
+      for (size_t i = 0; i < key.size(); i++)
+         key[i] = tolower((unsigned char)key[i]);
+      (*pConfig)[key] = Trim(entry.substr(sep + 1));
+   }
+
+   fclose(fp);
+   return (0);
+}
+
+//
+// PF_GetConfig
+//
+// Desc: Look up the value of a setting
+// In:   key - name of the setting, in lower case
+// Ret:  the value, or NULL if the setting is not given anywhere
+//
+const char *PF_GetConfig(const char *key)
+{
+   // The environment overrides anything in a file
+   string envKey = PF_CONFIG_PREFIX;
+   for (const char *p = key; *p; p++)
+      envKey += toupper((unsigned char)*p);
+   const char *value = getenv(envKey.c_str());
+   if (value != NULL)
+      return (value);
+
+   ReadDefaults();
+   map<string, string>::const_iterator it = pConfig->find(key);
+   if (it == pConfig->end())
+      return (NULL);
+   return (it->second.c_str());
+}
+
+//
+// PF_GetConfigInt
+//
+// Desc: Look up an integer setting
+// In:   key - name of the setting, in lower case
+//       defaultValue - value to use if the setting is not given, is
+//                      not a number or does not fit in an int
+// Ret:  the value of the setting
+//
+int PF_GetConfigInt(const char *key, int defaultValue)
+{
+   const char *value = PF_GetConfig(key);
+   if (value == NULL)
+      return (defaultValue);
+
+   char *end;
+   long result = strtol(value, &end, 10);
+   if (end == value || *end != '\0' || result < INT_MIN || result > INT_MAX)
+      return (defaultValue);
+   return ((int)result);
+}
+
+//
+// PF_GetConfigBool
+//
+// Desc: Look up an on/off setting.  "on", "yes", "true" and "1" turn it
+//       on, "off", "no", "false" and "0" turn it off.
+// In:   key - name of the setting, in lower case
+//       defaultValue - value to use if the setting is not given or is
+//                      none of the above
+// Ret:  TRUE or FALSE
+//
+int PF_GetConfigBool(const char *key, int defaultValue)
+{
+   const char *value = PF_GetConfig(key);
+   if (value == NULL)
+      return (defaultValue);
+
+   if (!strcasecmp(value, "on") || !strcasecmp(value, "yes") ||
+         !strcasecmp(value, "true") || !strcmp(value, "1"))
+      return (TRUE);
+   if (!strcasecmp(value, "off") || !strcasecmp(value, "no") ||
+         !strcasecmp(value, "false") || !strcmp(value, "0"))
+      return (FALSE);
+   return (defaultValue);
+}
@@ -25,6 +25,10 @@ static char *PF_WarnMsg[] = {
   (char*)"page already unpinned",
   (char*)"end of file",
   (char*)"attempting to resize the buffer too small",
+  (char*)"page already latched",
+  (char*)"page is not latched",
+  (char*)"file is open read only",
+  (char*)"page size must be a power of two from 4096 to 65536",
   (char*)"invalid filename"
 };
 
@@ -6,6 +6,9 @@
 //
 
 #include <unistd.h>
+#include <fcntl.h>
+#include <algorithm>
+#include <sys/mman.h>
 #include <sys/types.h>
 #include "pf_internal.h"
 #include "pf_buffermgr.h"
@@ -26,8 +29,18 @@
 PF_FileHandle::PF_FileHandle()
 {
    // Initialize local variables
+   pHdr.reset(new PF_FileHdr());
    bFileOpen = FALSE;
+   bDirectIO = FALSE;
+   bMapped = FALSE;
+   mapSize = 0;
+   extentPages = 1;
+   extentEnd = 0;
+   logId = -1;
    pBufferMgr = NULL;
+   pTempFiles = NULL;
+   raNextPage = raHorizon = 0;
+   raRunLength = 0;
 }
 
 //
@@ -35,7 +48,8 @@ PF_FileHandle::PF_FileHandle()
 //
 // Desc: Destroy the file handle object
 //       If the file handle object refers to an open file, the file will
-//       NOT be closed.
+//       NOT be closed.  The mapping and the used-page map go away with
+//       the last handle that shares them.
 //
 PF_FileHandle::~PF_FileHandle()
 {
@@ -46,16 +60,35 @@ PF_FileHandle::~PF_FileHandle()
 // PF_FileHandle
 //
 // Desc: copy constructor
+//       The copy refers to the same open file.  It shares the header,
+//       the mapping and the used-page map with fileHandle; they are
+//       released with the last handle holding them, so closing one copy
+//       leaves them valid for the others.  The file descriptor is not
+//       shared that way: once the file is closed through any copy, the
+//       others must not be used.
 // In:   fileHandle - file handle object from which to construct this object
 //
 PF_FileHandle::PF_FileHandle(const PF_FileHandle &fileHandle)
 {
-   // Just copy the data members since there is no memory allocation involved
+   // Copy the data members; the header, the mapping and the used-page
+   // map are shared
    this->pBufferMgr  = fileHandle.pBufferMgr;
-   this->hdr         = fileHandle.hdr;
+   this->pHdr        = fileHandle.pHdr;
    this->bFileOpen   = fileHandle.bFileOpen;
    this->bHdrChanged = fileHandle.bHdrChanged;
    this->unixfd      = fileHandle.unixfd;
+   this->bDirectIO   = fileHandle.bDirectIO;
+   this->bMapped     = fileHandle.bMapped;
+   this->pMap        = fileHandle.pMap;
+   this->mapSize     = fileHandle.mapSize;
+   this->pUsedMap    = fileHandle.pUsedMap;
+   this->pTempFiles  = fileHandle.pTempFiles;
+   this->extentPages = fileHandle.extentPages;
+   this->extentEnd   = fileHandle.extentEnd;
+   this->logId       = fileHandle.logId;
+   this->raNextPage  = fileHandle.raNextPage;
+   this->raRunLength = fileHandle.raRunLength;
+   this->raHorizon   = fileHandle.raHorizon;
 }
 
 //
@@ -63,7 +96,8 @@ PF_FileHandle::PF_FileHandle(const PF_FileHandle &fileHandle)
 //
 // Desc: overload = operator
 //       If this file handle object refers to an open file, the file will
-//       NOT be closed.
+//       NOT be closed.  As with the copy constructor, the header, the
+//       mapping and the used-page map become shared with fileHandle.
 // In:   fileHandle - file handle object to set this object equal to
 // Ret:  reference to *this
 //
@@ -72,12 +106,25 @@ PF_FileHandle& PF_FileHandle::operator= (const PF_FileHandle &fileHandle)
    // Test for self-assignment
    if (this != &fileHandle) {
 
-      // Just copy the members since there is no memory allocation involved
+      // Copy the members; the header, the mapping and the used-page map
+      // are shared
       this->pBufferMgr  = fileHandle.pBufferMgr;
-      this->hdr         = fileHandle.hdr;
+      this->pHdr        = fileHandle.pHdr;
       this->bFileOpen   = fileHandle.bFileOpen;
       this->bHdrChanged = fileHandle.bHdrChanged;
       this->unixfd      = fileHandle.unixfd;
+      this->bDirectIO   = fileHandle.bDirectIO;
+      this->bMapped     = fileHandle.bMapped;
+      this->pMap        = fileHandle.pMap;
+      this->mapSize     = fileHandle.mapSize;
+      this->pUsedMap    = fileHandle.pUsedMap;
+      this->pTempFiles  = fileHandle.pTempFiles;
+      this->extentPages = fileHandle.extentPages;
+      this->extentEnd   = fileHandle.extentEnd;
+      this->logId       = fileHandle.logId;
+      this->raNextPage  = fileHandle.raNextPage;
+      this->raRunLength = fileHandle.raRunLength;
+      this->raHorizon   = fileHandle.raHorizon;
    }
 
    // Return a reference to this
@@ -89,13 +136,15 @@ PF_FileHandle& PF_FileHandle::operator= (const PF_FileHandle &fileHandle)
 //
 // Desc: Get the first page in a file
 //       The file handle must refer to an open file
+// In:   hint - how the page will be used
 // Out:  pageHandle - becomes a handle to the first page of the file
 //       The referenced page is pinned in the buffer pool.
 // Ret:  PF return code
 //
-RC PF_FileHandle::GetFirstPage(PF_PageHandle &pageHandle) const
+RC PF_FileHandle::GetFirstPage(PF_PageHandle &pageHandle,
+                               ClientHint hint) const
 {
-   return (GetNextPage((PageNum)-1, pageHandle));
+   return (GetNextPage((PageNum)-1, pageHandle, hint));
 }
 
 //
@@ -103,13 +152,15 @@ RC PF_FileHandle::GetFirstPage(PF_PageHandle &pageHandle) const
 //
 // Desc: Get the last page in a file
 //       The file handle must refer to an open file
+// In:   hint - how the page will be used
 // Out:  pageHandle - becomes a handle to the last page of the file
 //       The referenced page is pinned in the buffer pool.
 // Ret:  PF return code
 //
-RC PF_FileHandle::GetLastPage(PF_PageHandle &pageHandle) const
+RC PF_FileHandle::GetLastPage(PF_PageHandle &pageHandle,
+                              ClientHint hint) const
 {
-   return (GetPrevPage((PageNum)hdr.numPages, pageHandle));
+   return (GetPrevPage((PageNum)pHdr->numPages, pageHandle, hint));
 }
 
 //
@@ -119,11 +170,13 @@ RC PF_FileHandle::GetLastPage(PF_PageHandle &pageHandle) const
 //       The file handle must refer to an open file
 // In:   current - get the next valid page after this page number
 //       current can refer to a page that has been disposed
+//       hint - how the page will be used
 // Out:  pageHandle - becomes a handle to the next page of the file
 //       The referenced page is pinned in the buffer pool.
 // Ret:  PF_EOF, or another PF return code
 //
-RC PF_FileHandle::GetNextPage(PageNum current, PF_PageHandle &pageHandle) const
+RC PF_FileHandle::GetNextPage(PageNum current, PF_PageHandle &pageHandle,
+                              ClientHint hint) const
 {
    int rc;               // return code
 
@@ -135,11 +188,17 @@ RC PF_FileHandle::GetNextPage(PageNum current, PF_PageHandle &pageHandle) const
    if (current != -1 &&  !IsValidPageNum(current))
       return (PF_INVALIDPAGE);
 
-   // Scan the file until a valid used page is found
-   for (current++; current < hdr.numPages; current++) {
+   // Scan the file until a valid used page is found.  Free pages are
+   // passed over without being read, and do not break a sequential scan.
+   for (current++; current < pHdr->numPages; current++) {
+      if (!IsUsedPage(current)) {
+         if (raNextPage == current)
+            raNextPage++;
+         continue;
+      }
 
       // If this is a valid (used) page, we're done
-      if (!(rc = GetThisPage(current, pageHandle)))
+      if (!(rc = GetThisPage(current, pageHandle, hint)))
          return (0);
 
       // If unexpected error, return it
@@ -158,11 +217,13 @@ RC PF_FileHandle::GetNextPage(PageNum current, PF_PageHandle &pageHandle) const
 //       The file handle must refer to an open file
 // In:   current - get the prev valid page before this page number
 //       current can refer to a page that has been disposed
+//       hint - how the page will be used
 // Out:  pageHandle - becomes a handle to the prev page of the file
 //       The referenced page is pinned in the buffer pool.
 // Ret:  PF_EOF, or another PF return code
 //
-RC PF_FileHandle::GetPrevPage(PageNum current, PF_PageHandle &pageHandle) const
+RC PF_FileHandle::GetPrevPage(PageNum current, PF_PageHandle &pageHandle,
+                              ClientHint hint) const
 {
    int rc;               // return code
 
@@ -170,15 +231,18 @@ RC PF_FileHandle::GetPrevPage(PageNum current, PF_PageHandle &pageHandle) const
    if (!bFileOpen)
       return (PF_CLOSEDFILE);
 
-   // Validate page number (note that hdr.numPages is acceptable here)
-   if (current != hdr.numPages &&  !IsValidPageNum(current))
+   // Validate page number (note that pHdr->numPages is acceptable here)
+   if (current != pHdr->numPages &&  !IsValidPageNum(current))
       return (PF_INVALIDPAGE);
 
-   // Scan the file until a valid used page is found
+   // Scan the file until a valid used page is found, passing over free
+   // pages without reading them
    for (current--; current >= 0; current--) {
+      if (!IsUsedPage(current))
+         continue;
 
       // If this is a valid (used) page, we're done
-      if (!(rc = GetThisPage(current, pageHandle)))
+      if (!(rc = GetThisPage(current, pageHandle, hint)))
          return (0);
 
       // If unexpected error, return it
@@ -196,34 +260,47 @@ RC PF_FileHandle::GetPrevPage(PageNum current, PF_PageHandle &pageHandle) const
 // Desc: Get a specific page in a file
 //       The file handle must refer to an open file
 // In:   pageNum - the number of the page to get
+//       hint - how the page will be used.  RANDOM pages are never read
+//              ahead.
 // Out:  pageHandle - becomes a handle to the this page of the file
 //                    this function modifies local var's in pageHandle
 //       The referenced page is pinned in the buffer pool.
 // Ret:  PF return code
 //
-RC PF_FileHandle::GetThisPage(PageNum pageNum, PF_PageHandle &pageHandle) const
+RC PF_FileHandle::GetThisPage(PageNum pageNum, PF_PageHandle &pageHandle,
+                              ClientHint hint) const
 {
    int  rc;               // return code
    char *pPageBuf;        // address of page in buffer pool
+   PF_Latch *pLatch;      // latch of the page
 
    // File must be open
    if (!bFileOpen)
       return (PF_CLOSEDFILE);
 
-   // Validate page number
-   if (!IsValidPageNum(pageNum))
+   // Validate page number.  A free page is known to be free without
+   // reading it.
+   if (!IsValidPageNum(pageNum) || !IsUsedPage(pageNum))
       return (PF_INVALIDPAGE);
 
+   // Read the following pages ahead if the file is read sequentially
+   if (hint != RANDOM)
+      ReadAhead(pageNum, hint);
+
+   // A mapped file bypasses the buffer manager
+   if (bMapped)
+      return (GetMappedPage(pageNum, pageHandle));
+
    // Get this page from the buffer manager
-   if ((rc = pBufferMgr->GetPage(unixfd, pageNum, &pPageBuf)))
+   if ((rc = pBufferMgr->GetPage(unixfd, pageNum, &pPageBuf, TRUE, &pLatch,
+                                 hint)))
       return (rc);
 
    // If the page is valid, then set pageHandle to this page and return ok
    if (((PF_PageHdr*)pPageBuf)->nextFree == PF_PAGE_USED) {
 
       // Set the pageHandle local variables
-      pageHandle.pageNum = pageNum;
-      pageHandle.pPageData = pPageBuf + sizeof(PF_PageHdr);
+      pageHandle.SetPage(pageNum, pPageBuf + sizeof(PF_PageHdr), pLatch);
 
       // Return ok
       return (0);
@@ -236,52 +313,101 @@ RC PF_FileHandle::GetThisPage(PageNum pageNum, PF_PageHandle &pageHandle) const
    return (PF_INVALIDPAGE);
 }
 
+//
+// ReadAhead
+//
+// Desc: Internal.  Keep track of sequential access to the file.  Once two
+//       pages in a row have been asked for in order, the buffer manager
+//       is asked to read the next pages in the background.  More pages
+//       are asked for whenever the scan has used up half of them, so
+//       that the reads stay ahead of the scan.
+// In:   pageNum - page being accessed
+//       hint - how the pages will be used
+//
+void PF_FileHandle::ReadAhead(PageNum pageNum, ClientHint hint) const
+{
+   if (pageNum == raNextPage)
+      raRunLength++;
+   else {
+      raRunLength = 0;
+      raHorizon = pageNum + 1;
+   }
+   raNextPage = pageNum + 1;
+
+   if (raRunLength < 1)
+      return;
+
+   int window = pBufferMgr->GetReadAheadPages();
+   if (window == 0 || pageNum + window / 2 < raHorizon)
+      return;
+
+   PageNum start = raHorizon > pageNum + 1 ? raHorizon : pageNum + 1;
+   PageNum end = pageNum + 1 + window;
+   if (end > pHdr->numPages)
+      end = pHdr->numPages;
+   if (end <= start)
+      return;
+
+   // For a mapped file the operating system does the reading
+   if (bMapped) {
+      long offset = start * (long)pHdr->pageSize + PF_FILE_HDR_SIZE;
+      long length = (end - start) * (long)pHdr->pageSize;
+      if (offset + length > mapSize)
+         length = mapSize - offset;
+      if (length > 0)
+         madvise(pMap.get() + offset, length, MADV_WILLNEED);
+   }
+   else
+      pBufferMgr->ReadAhead(unixfd, start, end - start, hint);
+   raHorizon = end;
+}
+
 //
 // AllocatePage
 //
 // Desc: Allocate a new page in the file (may get a page which was
 //       previously disposed)
 //       The file handle must refer to an open file
+// In:   hint - how the page will be used
 // Out:  pageHandle - becomes a handle to the newly-allocated page
 //                    this function modifies local var's in pageHandle
 // Ret:  PF return code
 //
-RC PF_FileHandle::AllocatePage(PF_PageHandle &pageHandle)
+RC PF_FileHandle::AllocatePage(PF_PageHandle &pageHandle, ClientHint hint)
 {
    int     rc;               // return code
    int     pageNum;          // new-page number
    char    *pPageBuf;        // address of page in buffer pool
+   PF_Latch *pLatch;         // latch of the page
 
    // File must be open
    if (!bFileOpen)
       return (PF_CLOSEDFILE);
 
-   // If the free list isn't empty...
-   if (hdr.firstFree != PF_PAGE_LIST_END) {
-      pageNum = hdr.firstFree;
+   if (bMapped)
+      return (PF_READONLY);
 
-      // Get the first free page into the buffer
-      if ((rc = pBufferMgr->GetPage(unixfd,
-            pageNum,
-            &pPageBuf)))
+   // If a page is free, the map says which without reading any...
+   if ((pageNum = FindFreePage()) >= 0) {
+      if ((rc = NewPage(pageNum, &pPageBuf, &pLatch, hint)))
          return (rc);
-
-      // Set the first free page to the next page on the free list
-      hdr.firstFree = ((PF_PageHdr*)pPageBuf)->nextFree;
    }
    else {
 
-      // The free list is empty...
-      pageNum = hdr.numPages;
+      // No page is free.  The map may need another page first to have a
+      // bit for the new one.
+      if (pHdr->numPages >= (PageNum)pUsedMap->bits.size() * 8 &&
+            (rc = AddMapPage()))
+         return (rc);
+      pageNum = pHdr->numPages;
 
       // Allocate a new page in the file
-      if ((rc = pBufferMgr->AllocatePage(unixfd,
-            pageNum,
-            &pPageBuf)))
+      Preallocate(pageNum + 1);
+      if ((rc = NewPage(pageNum, &pPageBuf, &pLatch, hint)))
          return (rc);
 
       // Increment the number of pages for this file
-      hdr.numPages++;
+      pHdr->numPages++;
    }
 
    // Mark the header as changed
@@ -289,17 +415,83 @@ RC PF_FileHandle::AllocatePage(PF_PageHandle &pageHandle)
 
    // Mark this page as used
    ((PF_PageHdr *)pPageBuf)->nextFree = PF_PAGE_USED;
+   SetUsed(pageNum, TRUE);
 
    // Zero out the page data
-   memset(pPageBuf + sizeof(PF_PageHdr), 0, PF_PAGE_SIZE);
+   memset(pPageBuf + sizeof(PF_PageHdr), 0,
+          pHdr->pageSize - sizeof(PF_PageHdr));
 
    // Mark the page dirty because we changed the next pointer
    if ((rc = MarkDirty(pageNum)))
       return (rc);
 
    // Set the pageHandle local variables
-   pageHandle.pageNum = pageNum;
-   pageHandle.pPageData = pPageBuf + sizeof(PF_PageHdr);
+   pageHandle.SetPage(pageNum, pPageBuf + sizeof(PF_PageHdr), pLatch);
+
+   // Return ok
+   return (0);
+}
+
+//
+// AllocatePages
+//
+// Desc: Allocate a run of pages with consecutive numbers.  The first run
+//       of free pages long enough is taken, and failing that the file is
+//       extended.  Since the room for a file is set aside on disk in
+//       extents, pages that follow each other in the file follow each
+//       other on disk, and a scan of them reads sequentially.
+//       The file handle must refer to an open file
+// In:   numPages - number of pages, at least 1
+// Out:  firstPage - number of the first page of the run
+//       The pages are zeroed, marked dirty and not pinned
+// Ret:  PF return code
+//
+RC PF_FileHandle::AllocatePages(int numPages, PageNum &firstPage)
+{
+   RC rc;
+   char *pPageBuf;
+
+   // File must be open
+   if (!bFileOpen)
+      return (PF_CLOSEDFILE);
+
+   if (bMapped)
+      return (PF_READONLY);
+
+   if (numPages < 1)
+      return (PF_INVALIDPAGE);
+
+   // The run may go past the end of the file.  If the map has no bits
+   // for all of it, map pages are added first so that they do not fall
+   // inside the run.
+   firstPage = FindFreeRun(numPages);
+   if (firstPage + numPages > (PageNum)pUsedMap->bits.size() * 8) {
+      while (pHdr->numPages + numPages > (PageNum)pUsedMap->bits.size() * 8)
+         if ((rc = AddMapPage()))
+            return (rc);
+      firstPage = pHdr->numPages;
+   }
+   Preallocate(firstPage + numPages);
+
+   for (PageNum pageNum = firstPage; pageNum < firstPage + numPages;
+         pageNum++) {
+      if ((rc = NewPage(pageNum, &pPageBuf, NULL, NO_HINT)))
+         return (rc);
+      if (pageNum >= pHdr->numPages)
+         pHdr->numPages = pageNum + 1;
+
+      ((PF_PageHdr *)pPageBuf)->nextFree = PF_PAGE_USED;
+      memset(pPageBuf + sizeof(PF_PageHdr), 0,
+             pHdr->pageSize - sizeof(PF_PageHdr));
+      SetUsed(pageNum, TRUE);
+
+      if ((rc = pBufferMgr->MarkDirty(unixfd, pageNum)) ||
+            (rc = pBufferMgr->UnpinPage(unixfd, pageNum)))
+         return (rc);
+   }
+
+   // Mark the header as changed
+   bHdrChanged = TRUE;
 
    // Return ok
    return (0);
@@ -328,6 +520,13 @@ RC PF_FileHandle::DisposePage(PageNum pageNum)
    if (!IsValidPageNum(pageNum))
       return (PF_INVALIDPAGE);
 
+   if (bMapped)
+      return (PF_READONLY);
+
+   // Page must be valid (used)
+   if (!IsUsedPage(pageNum))
+      return (PF_PAGEFREE);
+
    // Get the page (but don't re-pin it if it's already pinned)
    if ((rc = pBufferMgr->GetPage(unixfd,
          pageNum,
@@ -335,21 +534,9 @@ RC PF_FileHandle::DisposePage(PageNum pageNum)
          FALSE)))
       return (rc);
 
-   // Page must be valid (used)
-   if (((PF_PageHdr *)pPageBuf)->nextFree != PF_PAGE_USED) {
-
-      // Unpin the page
-      if ((rc = UnpinPage(pageNum)))
-         return (rc);
-
-      // Return page already free
-      return (PF_PAGEFREE);
-   }
-
-   // Put this page onto the free list
-   ((PF_PageHdr *)pPageBuf)->nextFree = hdr.firstFree;
-   hdr.firstFree = pageNum;
-   bHdrChanged = TRUE;
+   // Mark the page free, on the page and in the map
+   ((PF_PageHdr *)pPageBuf)->nextFree = PF_PAGE_LIST_END;
+   SetUsed(pageNum, FALSE);
 
    // Mark the page dirty because we changed the next pointer
    if ((rc = MarkDirty(pageNum)))
@@ -383,10 +570,49 @@ RC PF_FileHandle::MarkDirty(PageNum pageNum) const
    if (!IsValidPageNum(pageNum))
       return (PF_INVALIDPAGE);
 
+   if (bMapped)
+      return (PF_READONLY);
+
    // Tell the buffer manager to mark the page dirty
    return (pBufferMgr->MarkDirty(unixfd, pageNum));
 }
 
+//
+// LogChange
+//
+// Desc: Mark a page as being dirty, having changed some bytes of it.
+//       If the file is logged, a log record of those bytes is added;
+//       otherwise this is the same as MarkDirty.
+//       The file handle must refer to an open file
+// In:   pageNum - number of page changed, which must be pinned
+//       offset - offset of the bytes changed, from the start of the data
+//                GetData points to
+//       length - number of bytes changed
+// Ret:  PF return code
+//
+RC PF_FileHandle::LogChange(PageNum pageNum, int offset, int length) const
+{
+   int pageSize;
+
+   // File must be open
+   if (!bFileOpen)
+      return (PF_CLOSEDFILE);
+
+   // Validate page number and range
+   GetPageSize(pageSize);
+   if (!IsValidPageNum(pageNum) || offset < 0 || length < 0 ||
+         offset + length > pageSize)
+      return (PF_INVALIDPAGE);
+
+   if (bMapped)
+      return (PF_READONLY);
+
+   if (logId < 0)
+      return (pBufferMgr->MarkDirty(unixfd, pageNum));
+   return (pBufferMgr->LogChange(unixfd, pageNum,
+                                 sizeof(PF_PageHdr) + offset, length));
+}
+
 //
 // UnpinPage
 //
@@ -408,6 +634,10 @@ RC PF_FileHandle::UnpinPage(PageNum pageNum) const
    if (!IsValidPageNum(pageNum))
       return (PF_INVALIDPAGE);
 
+   // Pages of a mapped file are not pinned
+   if (bMapped)
+      return (0);
+
    // Tell the buffer manager to unpin the page
    return (pBufferMgr->UnpinPage(unixfd, pageNum));
 }
@@ -422,25 +652,22 @@ RC PF_FileHandle::UnpinPage(PageNum pageNum) const
 //
 RC PF_FileHandle::FlushPages() const
 {
+   RC rc;
+
    // File must be open
    if (!bFileOpen)
       return (PF_CLOSEDFILE);
 
+   // The pages of a logged file are written later
+   if (logId >= 0)
+      return (LogPages());
+
    // If the file header has changed, write it back to the file
    if (bHdrChanged) {
 
-      // First seek to the appropriate place
-      if (lseek(unixfd, 0, L_SET) < 0)
-         return (PF_UNIX);
-
-      // Write header
-      int numBytes = write(unixfd,
-            (char *)&hdr,
-            sizeof(PF_FileHdr));
-      if (numBytes < 0)
-         return (PF_UNIX);
-      if (numBytes != sizeof(PF_FileHdr))
-         return (PF_HDRWRITE);
+      // Write header at the start of the file
+      if ((rc = WriteHdr()))
+         return (rc);
 
       // This function is declared const, but we need to change the
       // bHdrChanged variable.  Cast away the constness
@@ -448,6 +675,14 @@ RC PF_FileHandle::FlushPages() const
       dummy->bHdrChanged = FALSE;
    }
 
+   // A mapped file has no pages in the buffer
+   if (bMapped)
+      return (0);
+
+   // Put the changed map pages in the buffer, to go out with the rest
+   if ((rc = WriteMap()))
+      return (rc);
+
    // Tell Buffer Manager to flush pages
    return (pBufferMgr->FlushPages(unixfd));
 }
@@ -464,25 +699,22 @@ RC PF_FileHandle::FlushPages() const
 //
 RC PF_FileHandle::ForcePages(PageNum pageNum) const
 {
+   RC rc;
+
    // File must be open
    if (!bFileOpen)
       return (PF_CLOSEDFILE);
 
+   // The pages of a logged file are written later
+   if (logId >= 0)
+      return (LogPages());
+
    // If the file header has changed, write it back to the file
    if (bHdrChanged) {
 
-      // First seek to the appropriate place
-      if (lseek(unixfd, 0, L_SET) < 0)
-         return (PF_UNIX);
-
-      // Write header
-      int numBytes = write(unixfd,
-            (char *)&hdr,
-            sizeof(PF_FileHdr));
-      if (numBytes < 0)
-         return (PF_UNIX);
-      if (numBytes != sizeof(PF_FileHdr))
-         return (PF_HDRWRITE);
+      // Write header at the start of the file
+      if ((rc = WriteHdr()))
+         return (rc);
 
       // This function is declared const, but we need to change the
       // bHdrChanged variable.  Cast away the constness
@@ -490,11 +722,490 @@ RC PF_FileHandle::ForcePages(PageNum pageNum) const
       dummy->bHdrChanged = FALSE;
    }
 
+   // A mapped file has no pages in the buffer
+   if (bMapped)
+      return (0);
+
+   // Put the changed map pages in the buffer, to go out with the rest
+   if ((rc = WriteMap()))
+      return (rc);
+
    // Tell Buffer Manager to Force the page
    return (pBufferMgr->ForcePages(unixfd, pageNum));
 }
 
 
+//
+// GetPageSize
+//
+// Desc: Return the number of bytes of data on each page of the file,
+//       which is what GetData points to.  It is PF_PAGE_SIZE for a file
+//       with 4096-byte pages.
+//       The file handle must refer to an open file
+// Out:  pageSize - set to the number of bytes
+// Ret:  PF return code
+//
+RC PF_FileHandle::GetPageSize(int &pageSize) const
+{
+   // File must be open
+   if (!bFileOpen)
+      return (PF_CLOSEDFILE);
+
+   pageSize = pHdr->pageSize - sizeof(PF_PageHdr);
+
+   // Return ok
+   return (0);
+}
+
+//
+// WriteHdr
+//
+// Desc: Internal.  Write the header page at the start of the file: the
+//       file header, followed by the part of the used-page map kept
+//       there.  The page is written from an aligned buffer, which a file
+//       opened for direct I/O needs.
+// Ret:  PF return code
+//
+RC PF_FileHandle::WriteHdr() const
+{
+   int numBytes;
+   char *pBuf;
+
+   if (posix_memalign((void **)&pBuf, PF_FILE_HDR_SIZE, PF_FILE_HDR_SIZE))
+      return (PF_NOMEM);
+   GetHdrPage(pBuf);
+   numBytes = pwrite(unixfd, pBuf, PF_FILE_HDR_SIZE, 0);
+   free(pBuf);
+
+   if (numBytes < 0)
+      return (PF_UNIX);
+   if (numBytes != PF_FILE_HDR_SIZE)
+      return (PF_HDRWRITE);
+
+   // Return ok
+   return (0);
+}
+
+//
+// GetHdrPage
+//
+// Desc: Internal.  Fill a buffer with the header page of the file
+// Out:  pBuf - PF_FILE_HDR_SIZE bytes
+//
+void PF_FileHandle::GetHdrPage(char *pBuf) const
+{
+   memcpy(pBuf, pHdr.get(), sizeof(PF_FileHdr));
+   memcpy(pBuf + sizeof(PF_FileHdr), &pUsedMap->bits[0], PF_HDR_MAP_BYTES);
+}
+
+//
+// LogPages
+//
+// Desc: Internal.  Called by FlushPages and ForcePages for a logged file
+//       instead of writing anything.  Add log records of the header page,
+//       if it has changed, and of the pages of the file that changed
+//       since they were last logged.  The map pages that have changed
+//       are put in the buffer first.  The records are made durable by
+//       PF_Manager::Commit.
+// Ret:  PF return code
+//
+RC PF_FileHandle::LogPages() const
+{
+   RC rc;
+   long lsn;
+
+   if (bHdrChanged) {
+      char pBuf[PF_FILE_HDR_SIZE];
+      GetHdrPage(pBuf);
+      if ((rc = pBufferMgr->GetLog()->AppendHdr(logId, pBuf,
+                                                PF_FILE_HDR_SIZE, lsn)))
+         return (rc);
+
+      // This function is declared const, but we need to change the
+      // bHdrChanged variable.  Cast away the constness
+      PF_FileHandle *dummy = (PF_FileHandle *)this;
+      dummy->bHdrChanged = FALSE;
+   }
+
+   if ((rc = WriteMap()))
+      return (rc);
+   return (pBufferMgr->LogPages(unixfd));
+}
+
+//
+// GetMappedPage
+//
+// Desc: Internal.  Get a page of a file opened PF_IO_MMAP.  The page
+//       handle points straight into the mapping.  The page is not pinned
+//       and has no latch, since it can only be read.
+// In:   pageNum - the number of the page to get, already validated
+// Out:  pageHandle - becomes a handle to the page
+// Ret:  PF_INVALIDPAGE if the page is free, PF_INCOMPLETEREAD if it is
+//       past the end of the mapping, or 0
+//
+RC PF_FileHandle::GetMappedPage(PageNum pageNum,
+                                PF_PageHandle &pageHandle) const
+{
+   long offset = pageNum * (long)pHdr->pageSize + PF_FILE_HDR_SIZE;
+   if (offset + pHdr->pageSize > mapSize)
+      return (PF_INCOMPLETEREAD);
+
+   char *pPageBuf = pMap.get() + offset;
+   if (((PF_PageHdr*)pPageBuf)->nextFree != PF_PAGE_USED)
+      return (PF_INVALIDPAGE);
+
+   pageHandle.SetPage(pageNum, pPageBuf + sizeof(PF_PageHdr), NULL);
+
+   // Return ok
+   return (0);
+}
+
+//
+// ReadMap
+//
+// Desc: Internal.  Load the used-page map of a file being opened.  The
+//       first part is in the header page, the rest is on the chain of
+//       map pages.  A file from before the map has it built from the
+//       header of each of its pages.  This is done once: the map is
+//       written back with the header, with map pages added as needed,
+//       and the free list is given up.  A file opened PF_IO_MMAP cannot
+//       be written, so it has the map built each time.
+// In:   pHdrPage - the header page of the file
+// Ret:  PF return code
+//
+RC PF_FileHandle::ReadMap(const char *pHdrPage)
+{
+   RC rc;
+   char *pPageBuf;
+   long offset;
+
+   pUsedMap.reset(new PF_UsedMap);
+   pUsedMap->bytesPerMapPage =
+      pHdr->pageSize - sizeof(PF_PageHdr) - sizeof(PageNum);
+   pUsedMap->freeHint = 0;
+   pUsedMap->bits.assign(pHdrPage + sizeof(PF_FileHdr),
+                         pHdrPage + PF_FILE_HDR_SIZE);
+
+   if (pHdr->bUsedMap) {
+      PageNum mapPage = pHdr->firstMapPage;
+      while (mapPage != PF_PAGE_LIST_END) {
+
+         // Guard against a damaged chain
+         if (!IsValidPageNum(mapPage) ||
+               (PageNum)pUsedMap->mapPages.size() >= pHdr->numPages)
+            return (PF_HDRREAD);
+
+         if (bMapped) {
+            offset = mapPage * (long)pHdr->pageSize + PF_FILE_HDR_SIZE;
+            if (offset + pHdr->pageSize > mapSize)
+               return (PF_INCOMPLETEREAD);
+            pPageBuf = pMap.get() + offset;
+         }
+         else if ((rc = pBufferMgr->GetPage(unixfd, mapPage, &pPageBuf)))
+            return (rc);
+
+         char *pData = pPageBuf + sizeof(PF_PageHdr) + sizeof(PageNum);
+         pUsedMap->bits.insert(pUsedMap->bits.end(), pData,
+                               pData + pUsedMap->bytesPerMapPage);
+         pUsedMap->mapPages.push_back(mapPage);
+         pUsedMap->mapDirty.push_back(FALSE);
+         memcpy(&mapPage, pPageBuf + sizeof(PF_PageHdr), sizeof(PageNum));
+
+         if (!bMapped &&
+               (rc = pBufferMgr->UnpinPage(unixfd, pUsedMap->mapPages.back())))
+            return (rc);
+      }
+
+      // Return ok
+      return (0);
+   }
+
+   // An older file.  Make room in the map for all its pages.
+   PageNum numPages = pHdr->numPages;
+   pUsedMap->bits.assign(PF_HDR_MAP_BYTES, 0);
+   if (bMapped) {
+      if (numPages > PF_HDR_MAP_BYTES * 8)
+         pUsedMap->bits.resize((numPages + 7) / 8, 0);
+   }
+   else {
+      pHdr->bUsedMap = TRUE;
+      pHdr->firstFree = PF_PAGE_LIST_END;
+      pHdr->firstMapPage = PF_PAGE_LIST_END;
+      bHdrChanged = TRUE;
+      while (pHdr->numPages > (PageNum)pUsedMap->bits.size() * 8)
+         if ((rc = AddMapPage()))
+            return (rc);
+   }
+
+   // Then look at the header of each page
+   pPageBuf = NULL;
+   if (!bMapped &&
+         posix_memalign((void **)&pPageBuf, PF_MIN_DISK_PAGE_SIZE,
+                        pHdr->pageSize))
+      return (PF_NOMEM);
+
+   for (PageNum pageNum = 0; pageNum < numPages; pageNum++) {
+      PF_PageHdr pageHdr;
+
+      offset = pageNum * (long)pHdr->pageSize + PF_FILE_HDR_SIZE;
+      if (bMapped) {
+         if (offset + pHdr->pageSize > mapSize)
+            break;
+         memcpy(&pageHdr, pMap.get() + offset, sizeof(PF_PageHdr));
+      }
+      else {
+         int numBytes = pread(unixfd, pPageBuf, pHdr->pageSize, offset);
+         if (numBytes != pHdr->pageSize) {
+            free(pPageBuf);
+            return (numBytes < 0 ? PF_UNIX : PF_INCOMPLETEREAD);
+         }
+         memcpy(&pageHdr, pPageBuf, sizeof(PF_PageHdr));
+      }
+
+      if (pageHdr.nextFree == PF_PAGE_USED)
+         pUsedMap->bits[pageNum >> 3] |= 1 << (pageNum & 7);
+   }
+   free(pPageBuf);
+
+   // Return ok
+   return (0);
+}
+
+//
+// WriteMap
+//
+// Desc: Internal.  Copy the map pages that have changed into the buffer
+//       pool and mark them dirty there, so that they are written along
+//       with the other pages of the file.
+// Ret:  PF return code
+//
+RC PF_FileHandle::WriteMap() const
+{
+   RC rc;
+   char *pPageBuf;
+
+   for (size_t i = 0; i < pUsedMap->mapPages.size(); i++) {
+      if (!pUsedMap->mapDirty[i])
+         continue;
+
+      PageNum mapPage = pUsedMap->mapPages[i];
+      PageNum nextMapPage = (i + 1 < pUsedMap->mapPages.size()) ?
+         pUsedMap->mapPages[i + 1] : PF_PAGE_LIST_END;
+
+      if ((rc = pBufferMgr->GetPage(unixfd, mapPage, &pPageBuf)))
+         return (rc);
+      ((PF_PageHdr *)pPageBuf)->nextFree = PF_PAGE_MAP;
+      memcpy(pPageBuf + sizeof(PF_PageHdr), &nextMapPage, sizeof(PageNum));
+      memcpy(pPageBuf + sizeof(PF_PageHdr) + sizeof(PageNum),
+             &pUsedMap->bits[PF_HDR_MAP_BYTES + i * pUsedMap->bytesPerMapPage],
+             pUsedMap->bytesPerMapPage);
+      if ((rc = pBufferMgr->MarkDirty(unixfd, mapPage)) ||
+            (rc = pBufferMgr->UnpinPage(unixfd, mapPage)))
+         return (rc);
+
+      pUsedMap->mapDirty[i] = FALSE;
+   }
+
+   // Return ok
+   return (0);
+}
+
+//
+// IsUsedPage
+//
+// Desc: Internal.  Return TRUE if pageNum is allocated, going by the map
+// In:   pageNum - page number to test, already validated
+// Ret:  TRUE or FALSE
+//
+int PF_FileHandle::IsUsedPage(PageNum pageNum) const
+{
+   return (pUsedMap->IsSet(pageNum) &&
+           !std::binary_search(pUsedMap->mapPages.begin(),
+                               pUsedMap->mapPages.end(), pageNum));
+}
+
+//
+// SetUsed
+//
+// Desc: Internal.  Set or clear the bit of a page in the map, and note
+//       that the part of the map holding it must be written back
+// In:   pageNum - page number, with a bit in the map
+//       bUsed - TRUE to set the bit, FALSE to clear it
+//
+void PF_FileHandle::SetUsed(PageNum pageNum, int bUsed)
+{
+   int byteNum = pageNum >> 3;
+
+   if (bUsed)
+      pUsedMap->bits[byteNum] |= 1 << (pageNum & 7);
+   else {
+      pUsedMap->bits[byteNum] &= ~(1 << (pageNum & 7));
+      if (pageNum < pUsedMap->freeHint)
+         pUsedMap->freeHint = pageNum;
+   }
+
+   if (byteNum < PF_HDR_MAP_BYTES)
+      bHdrChanged = TRUE;
+   else
+      pUsedMap->mapDirty[(byteNum - PF_HDR_MAP_BYTES) /
+                         pUsedMap->bytesPerMapPage] = TRUE;
+}
+
+//
+// FindFreePage
+//
+// Desc: Internal.  Find the lowest numbered free page of the file in the
+//       map.  Bytes of the map with all bits set are passed over whole.
+// Ret:  the page number, or -1 if no page is free
+//
+PageNum PF_FileHandle::FindFreePage() const
+{
+   const std::vector<unsigned char> &bits = pUsedMap->bits;
+   PageNum pageNum = pUsedMap->freeHint;
+
+   while (pageNum < pHdr->numPages) {
+      if ((pageNum & 7) == 0 && bits[pageNum >> 3] == 0xff)
+         pageNum += 8;
+      else if ((bits[pageNum >> 3] >> (pageNum & 7)) & 1)
+         pageNum++;
+      else
+         break;
+   }
+
+   pUsedMap->freeHint = pageNum;
+   return (pageNum < pHdr->numPages ? pageNum : -1);
+}
+
+//
+// FindFreeRun
+//
+// Desc: Internal.  Find the lowest numbered run of numPages free pages.
+//       A run of free pages at the end of the file counts, with the pages
+//       past the end added to it.
+// In:   numPages - length of the run
+// Ret:  the first page of the run
+//
+PageNum PF_FileHandle::FindFreeRun(int numPages) const
+{
+   PageNum start = pUsedMap->freeHint;
+
+   for (PageNum pageNum = start; pageNum < pHdr->numPages; pageNum++) {
+      if (pUsedMap->IsSet(pageNum))
+         start = pageNum + 1;
+      else if (pageNum - start + 1 == numPages)
+         break;
+   }
+
+   return (start);
+}
+
+//
+// AddMapPage
+//
+// Desc: Internal.  Take a new page at the end of the file for more of the
+//       used-page map.  Its contents are filled in by WriteMap.
+// Ret:  PF return code
+//
+RC PF_FileHandle::AddMapPage()
+{
+   RC rc;
+   char *pPageBuf;
+   PageNum mapPage = pHdr->numPages;
+
+   Preallocate(mapPage + 1);
+   if ((rc = pBufferMgr->AllocatePage(unixfd, mapPage, &pPageBuf)))
+      return (rc);
+   memset(pPageBuf, 0, pHdr->pageSize);
+   ((PF_PageHdr *)pPageBuf)->nextFree = PF_PAGE_MAP;
+   pHdr->numPages++;
+   if ((rc = pBufferMgr->MarkDirty(unixfd, mapPage)) ||
+         (rc = pBufferMgr->UnpinPage(unixfd, mapPage)))
+      return (rc);
+
+   // Link it after the last map page
+   if (pUsedMap->mapPages.empty())
+      pHdr->firstMapPage = mapPage;
+   else
+      pUsedMap->mapDirty.back() = TRUE;
+   pUsedMap->mapPages.push_back(mapPage);
+   pUsedMap->mapDirty.push_back(TRUE);
+   pUsedMap->bits.resize(pUsedMap->bits.size() + pUsedMap->bytesPerMapPage, 0);
+   bHdrChanged = TRUE;
+
+   // The map page is never handed out
+   SetUsed(mapPage, TRUE);
+
+   // Return ok
+   return (0);
+}
+
+//
+// NewPage
+//
+// Desc: Internal.  Get a frame in the buffer for a page that is being
+//       allocated.  Its old contents are not needed, so the page is only
+//       read if it is in the buffer already.
+// In:   pageNum - the page, free or just past the end of the file
+//       hint - how the page will be used
+// Out:  ppPageBuf - set to the frame, pinned
+//       ppLatch - set to the latch of the frame, if given
+// Ret:  PF return code
+//
+RC PF_FileHandle::NewPage(PageNum pageNum, char **ppPageBuf,
+                          PF_Latch **ppLatch, ClientHint hint)
+{
+   RC rc = pBufferMgr->AllocatePage(unixfd, pageNum, ppPageBuf, ppLatch,
+                                    hint);
+   if (rc == PF_PAGEINBUF)
+      rc = pBufferMgr->GetPage(unixfd, pageNum, ppPageBuf, TRUE, ppLatch,
+                               hint);
+   return (rc);
+}
+
+//
+// Preallocate
+//
+// Desc: Internal.  Make sure the file has room on disk for its first
+//       numPages pages.  The file grows by the "extent_pages" setting
+//       (see pf_config.cc) at a time, or more if needed, with the room
+//       set aside by fallocate.  The file system can then lay out each
+//       extent in one piece, and the file size changes once an extent
+//       rather than once a page.  A file smaller than an extent grows by
+//       as many pages as it has, so that the many files holding a page
+//       or two are not each given a whole extent.  Where fallocate is not
+//       supported the file grows a page at a time as pages are written.
+//       A temporary file in memory is first moved to disk if it would
+//       take the temporary files in memory over the "temp_mem" setting;
+//       it stays in memory if it cannot be moved.
+// In:   numPages - pages the file needs room for
+//
+void PF_FileHandle::Preallocate(PageNum numPages)
+{
+   if (numPages <= extentEnd)
+      return;
+   if (pTempFiles)
+      PF_GrowTempFile(pTempFiles, pBufferMgr, unixfd,
+                      numPages * (long)pHdr->pageSize + PF_FILE_HDR_SIZE);
+   if (extentPages <= 1)
+      return;
+
+   PageNum extent = std::min((PageNum)extentPages,
+                             std::max(extentEnd, (PageNum)1));
+   PageNum newEnd = numPages + extent - 1;
+   newEnd -= newEnd % extent;
+
+#ifdef __linux__
+   long offset = extentEnd * (long)pHdr->pageSize + PF_FILE_HDR_SIZE;
+   long length = (newEnd - extentEnd) * (long)pHdr->pageSize;
+   if (fallocate(unixfd, 0, offset, length) == 0)
+      extentEnd = newEnd;
+   else
+      extentPages = 1;
+#else
+   extentPages = 1;
+#endif
+}
+
 //
 // IsValidPageNum
 //
@@ -507,5 +1218,5 @@ int PF_FileHandle::IsValidPageNum(PageNum pageNum) const
 {
    return (bFileOpen &&
          pageNum >= 0 &&
-         pageNum < hdr.numPages);
+         pageNum < pHdr->numPages);
 }
\ No newline at end of file
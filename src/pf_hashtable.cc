@@ -8,24 +8,40 @@
 #include "pf_internal.h"
 #include "pf_hashtable.h"
 
+//
+// RoundUpPow2
+//
+// Desc: Internal.  Smallest power of two that is at least n (and at least 1)
+//
+static int RoundUpPow2(int n)
+{
+  int result = 1;
+  while (result < n && result < (1 << 30))
+    result <<= 1;
+  return (result);
+}
+
 //
 // PF_HashTable
 //
 // Desc: Constructor for PF_HashTable object, which allows search, insert,
 //       and delete of hash table entries.
-// In:   numBuckets - number of hash table buckets
+// In:   numBuckets - number of hash table buckets, spread over the
+//                    partitions and rounded up to a power of two in each
 //
 PF_HashTable::PF_HashTable(int _numBuckets)
 {
-  // Initialize numBuckets local variable from parameter
-  this->numBuckets = _numBuckets;
-
-  // Allocate memory for hash table
-  hashTable = new PF_HashEntry* [numBuckets];
+  int partBuckets = RoundUpPow2(_numBuckets / PF_HASH_PARTITIONS);
 
-  // Initialize all buckets to empty
-  for (int i = 0; i < numBuckets; i++)
-    hashTable[i] = NULL;
+  // Allocate the buckets of each partition and set them to empty
+  for (int p = 0; p < PF_HASH_PARTITIONS; p++) {
+    PF_HashPartition &part = partitions[p];
+    part.numBuckets = partBuckets;
+    part.numEntries = 0;
+    part.buckets = new PF_HashEntry* [partBuckets];
+    for (int i = 0; i < partBuckets; i++)
+      part.buckets[i] = NULL;
+  }
 }
 
 //
@@ -35,20 +51,66 @@ PF_HashTable::PF_HashTable(int _numBuckets)
 //
 PF_HashTable::~PF_HashTable()
 {
-  // Clear out all buckets
-  for (int i = 0; i < numBuckets; i++) {
+  for (int p = 0; p < PF_HASH_PARTITIONS; p++) {
+    PF_HashPartition &part = partitions[p];
 
-    // Delete all entries in the bucket
-    PF_HashEntry *entry = hashTable[i];
-    while (entry != NULL) {
-      PF_HashEntry *next = entry->next;
-      delete entry;
-      entry = next;
+    // Clear out all buckets
+    for (int i = 0; i < part.numBuckets; i++) {
+
+      // Delete all entries in the bucket
+      PF_HashEntry *entry = part.buckets[i];
+      while (entry != NULL) {
+        PF_HashEntry *next = entry->next;
+        delete entry;
+        entry = next;
+      }
     }
+
+    // Finally delete the bucket array
+    delete[] part.buckets;
   }
+}
 
-  // Finally delete the hash table
-  delete[] hashTable;
+//
+// Hash
+//
+// Desc: Hash function.  fd and pageNum are mixed together so that the
+//       pages of a file, which are usually numbered consecutively, spread
+//       over the whole table.  The computation is done unsigned so that
+//       the memory blocks of AllocateBlock, whose page numbers may be
+//       negative, still map to a valid bucket.  The low bits choose the
+//       partition and the bits above them the bucket within it.
+// In:   fd - file descriptor
+//       pageNum - page number
+// Ret:  hash value
+//
+unsigned int PF_HashTable::Hash(int fd, PageNum pageNum) const
+{
+  unsigned int h = (unsigned int)pageNum * 0x9e3779b1u + (unsigned int)fd;
+  h ^= h >> 16;
+  h *= 0x85ebca6bu;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35u;
+  h ^= h >> 16;
+  return (h);
+}
+
+//
+// Bucket
+//
+// Desc: Internal.  Find the bucket chain of fd and pageNum
+// In:   fd - file descriptor
+//       pageNum - page number
+// Out:  part - set to the partition of the bucket
+// Ret:  pointer to the head of the chain
+//
+PF_HashEntry **PF_HashTable::Bucket(int fd, PageNum pageNum,
+                                    PF_HashPartition *&part)
+{
+  unsigned int h = Hash(fd, pageNum);
+  part = &partitions[h % PF_HASH_PARTITIONS];
+  h /= PF_HASH_PARTITIONS;
+  return (&part->buckets[h & (unsigned int)(part->numBuckets - 1)]);
 }
 
 //
@@ -63,13 +125,11 @@ PF_HashTable::~PF_HashTable()
 RC PF_HashTable::Find(int fd, PageNum pageNum, int &slot)
 {
   // Get which bucket it should be in
-  int bucket = Hash(fd, pageNum);
-
-  if (bucket<0)
-     return (PF_HASHNOTFOUND);
+  PF_HashPartition *part;
+  PF_HashEntry **bucket = Bucket(fd, pageNum, part);
 
   // Go through the linked list of this bucket
-  for (PF_HashEntry *entry = hashTable[bucket];
+  for (PF_HashEntry *entry = *bucket;
        entry != NULL;
        entry = entry->next) {
     if (entry->fd == fd && entry->pageNum == pageNum) {
@@ -96,11 +156,12 @@ RC PF_HashTable::Find(int fd, PageNum pageNum, int &slot)
 RC PF_HashTable::Insert(int fd, PageNum pageNum, int slot)
 {
   // Get which bucket it should be in
-  int bucket = Hash(fd, pageNum);
+  PF_HashPartition *part;
+  PF_HashEntry **bucket = Bucket(fd, pageNum, part);
 
   // Check entry doesn't already exist in the bucket
   PF_HashEntry *entry;
-  for (entry = hashTable[bucket];
+  for (entry = *bucket;
        entry != NULL;
        entry = entry->next) {
     if (entry->fd == fd && entry->pageNum == pageNum)
@@ -115,11 +176,15 @@ RC PF_HashTable::Insert(int fd, PageNum pageNum, int slot)
   entry->fd = fd;
   entry->pageNum = pageNum;
   entry->slot = slot;
-  entry->next = hashTable[bucket];
+  entry->next = *bucket;
   entry->prev = NULL;
-  if (hashTable[bucket] != NULL)
-    hashTable[bucket]->prev = entry;
-  hashTable[bucket] = entry;
+  if (*bucket != NULL)
+    (*bucket)->prev = entry;
+  *bucket = entry;
+
+  // Grow the partition once it holds more entries than buckets
+  if (++part->numEntries > part->numBuckets)
+    return (ResizePartition(*part, part->numBuckets * 2));
 
   // Return ok
   return (0);
@@ -136,11 +201,12 @@ RC PF_HashTable::Insert(int fd, PageNum pageNum, int slot)
 RC PF_HashTable::Delete(int fd, PageNum pageNum)
 {
   // Get which bucket it should be in
-  int bucket = Hash(fd, pageNum);
+  PF_HashPartition *part;
+  PF_HashEntry **bucket = Bucket(fd, pageNum, part);
 
   // Find the entry is in this bucket
   PF_HashEntry *entry;
-  for (entry = hashTable[bucket];
+  for (entry = *bucket;
        entry != NULL;
        entry = entry->next) {
     if (entry->fd == fd && entry->pageNum == pageNum)
@@ -152,16 +218,83 @@ RC PF_HashTable::Delete(int fd, PageNum pageNum)
     return (PF_HASHNOTFOUND);
 
   // Remove this entry
-  if (entry == hashTable[bucket])
-    hashTable[bucket] = entry->next;
+  if (entry == *bucket)
+    *bucket = entry->next;
   if (entry->prev != NULL)
     entry->prev->next = entry->next;
   if (entry->next != NULL)
     entry->next->prev = entry->prev;
   delete entry;
+  part->numEntries--;
 
   // Return ook
   return (0);
 }
 
+//
+// Resize
+//
+// Desc: Rehash every partition for a new total number of buckets.
+//       Called as the buffer pool changes size so that chains stay
+//       short.  Each partition is latched while it is rehashed.
+// In:   _numBuckets - new number of buckets
+// Ret:  PF return code
+//
+RC PF_HashTable::Resize(int _numBuckets)
+{
+  RC rc;
+
+  for (int p = 0; p < PF_HASH_PARTITIONS; p++) {
+    std::lock_guard<std::mutex> lock(partitions[p].latch);
+    if ((rc = ResizePartition(partitions[p],
+                              _numBuckets / PF_HASH_PARTITIONS)))
+      return (rc);
+  }
+  return (0);
+}
 
+//
+// ResizePartition
+//
+// Desc: Internal.  Move all entries of a partition into a new bucket
+//       array.  The partition is never made smaller than it needs to be
+//       for the entries it holds.  The caller holds the partition latch.
+// In:   part - the partition
+//       _numBuckets - new number of buckets, rounded up to a power of two
+// Ret:  PF return code
+//
+RC PF_HashTable::ResizePartition(PF_HashPartition &part, int _numBuckets)
+{
+  int newNumBuckets = RoundUpPow2(_numBuckets < part.numEntries ?
+                                  part.numEntries : _numBuckets);
+  if (newNumBuckets == part.numBuckets)
+    return (0);
+
+  PF_HashEntry **newBuckets = new PF_HashEntry* [newNumBuckets];
+  for (int i = 0; i < newNumBuckets; i++)
+    newBuckets[i] = NULL;
+
+  // Relink every entry into its bucket in the new array
+  PF_HashEntry **oldBuckets = part.buckets;
+  int oldNumBuckets = part.numBuckets;
+  part.buckets = newBuckets;
+  part.numBuckets = newNumBuckets;
+
+  for (int i = 0; i < oldNumBuckets; i++) {
+    PF_HashEntry *entry = oldBuckets[i];
+    while (entry != NULL) {
+      PF_HashEntry *next = entry->next;
+      PF_HashPartition *pPart;
+      PF_HashEntry **bucket = Bucket(entry->fd, entry->pageNum, pPart);
+      entry->next = *bucket;
+      entry->prev = NULL;
+      if (*bucket != NULL)
+        (*bucket)->prev = entry;
+      *bucket = entry;
+      entry = next;
+    }
+  }
+
+  delete[] oldBuckets;
+  return (0);
+}
@@ -8,8 +8,14 @@
 #ifndef PF_HASHTABLE_H
 #define PF_HASHTABLE_H
 
+#include <mutex>
 #include "pf_internal.h"
 
+//
+// Defines
+//
+#define PF_HASH_PARTITIONS  16     // Number of partitions, a power of two
+
 //
 // HashEntry - Hash table bucket entries
 //
@@ -21,9 +27,30 @@ struct PF_HashEntry {
     int          slot;    // slot of this page in the buffer
 };
 
+//
+// PF_HashPartition - one independently locked part of the hash table
+//
+struct PF_HashPartition {
+    std::mutex   latch;           // protects the chains of the partition
+    int          numBuckets;      // Number of buckets, a power of two
+    int          numEntries;      // Number of entries
+    PF_HashEntry **buckets;       // Bucket chains
+    char         pad[64];         // Keep partitions on separate cache lines
+};
+
 //
 // PF_HashTable - allow search, insertion, and deletion of hash table entries
 //
+// The table is split into PF_HASH_PARTITIONS partitions, each with its
+// own latch, so that threads looking up different pages seldom wait for
+// each other.  The table does no locking of its own: the caller holds
+// the latch of the partition of the page (see Latch) around Find,
+// Insert and Delete.  Resize takes the partition latches itself.
+//
+// The number of buckets of a partition is always a power of two.  A
+// partition doubles itself whenever it holds more entries than buckets,
+// so that lookups stay short however large the buffer pool is made.
+//
 class PF_HashTable {
 public:
     PF_HashTable (int numBuckets);           // Constructor
@@ -34,12 +61,20 @@ public:
     RC  Insert   (int fd, PageNum pageNum, int slot);
                                              // Insert a hash table entry
     RC  Delete   (int fd, PageNum pageNum);  // Delete a hash table entry
+    RC  Resize   (int numBuckets);           // Rehash into numBuckets
+                                             // (rounded up to a power of 2)
+
+    // Latch of the partition that holds fd and pageNum
+    std::mutex &Latch (int fd, PageNum pageNum)
+       { return (partitions[Hash(fd, pageNum) % PF_HASH_PARTITIONS].latch); }
 
 private:
-    int Hash     (int fd, PageNum pageNum) const
-      { return ((fd + pageNum) % numBuckets); }   // Hash function
-    int numBuckets;                               // Number of hash table buckets
-    PF_HashEntry **hashTable;                     // Hash table
+    unsigned int Hash (int fd, PageNum pageNum) const; // Hash function
+    // Find the partition and bucket of fd and pageNum
+    PF_HashEntry **Bucket (int fd, PageNum pageNum, PF_HashPartition *&part);
+    RC  ResizePartition (PF_HashPartition &part, int numBuckets);
+
+    PF_HashPartition partitions[PF_HASH_PARTITIONS];
 };
 
 #endif
@@ -11,17 +11,25 @@
 
 #include <cstdlib>
 #include <cstring>
+#include <pthread.h>
+#include <map>
+#include <string>
+#include <vector>
 #include "pf.h"
 
 //
 // Constants and defines
 //
-const int PF_BUFFER_SIZE = 40;     // Number of pages in the buffer
-const int PF_HASH_TBL_SIZE = 20;   // Size of hash table
+const int PF_BUFFER_SIZE = 40;     // Default number of pages in the buffer
+const int PF_MAX_BUFFER_SIZE = 1 << 24;   // Largest buffer that may be set
+const int PF_EXTENT_PAGES = 16;    // Default pages to grow a file by
+const int PF_TEMP_MEM_PAGES = 4096;       // Default 4K pages of temporary
+                                          // files kept in memory
 
 #define CREATION_MASK      0600    // r/w privileges to owner only
 #define PF_PAGE_LIST_END  -1       // end of list of free pages
 #define PF_PAGE_USED      -2       // page is being used
+#define PF_PAGE_MAP       -3       // page holds part of the used-page map
 
 // L_SET is used to indicate the "whence" argument of the lseek call
 // defined in "/usr/include/unistd.h".  A value of 0 indicates to
@@ -43,4 +51,142 @@ struct PF_PageHdr {
 // Justify the file header to the length of one page
 const int PF_FILE_HDR_SIZE = PF_PAGE_SIZE + sizeof(PF_PageHdr);
 
+//
+// PF_UsedMap: one bit for each page of a file, set unless the page is free
+//
+// The bits for the first pages are kept in the header page, after
+// PF_FileHdr.  When a file outgrows them a page of the file is taken for
+// more of the map, and so on.  Each map page starts with the number of
+// the next one.  Map pages have their own bit set so that they are never
+// handed out, but they are not used pages.
+//
+// A file handle keeps the whole map in memory while the file is open, so
+// that free pages are skipped and found without reading them, and writes
+// it back with the header.  Files from before the map have it built when
+// they are opened.
+//
+const int PF_HDR_MAP_BYTES = PF_FILE_HDR_SIZE - sizeof(PF_FileHdr);
+
+struct PF_UsedMap {
+   std::vector<unsigned char> bits;   // the map, one bit per page
+   std::vector<PageNum> mapPages;     // the map pages, in ascending order
+   std::vector<char> mapDirty;        // TRUE if mapPages[i] must be written
+   int bytesPerMapPage;               // bytes of the map on each map page
+   PageNum freeHint;                  // no page below this one is free
+
+   int IsSet(PageNum pageNum) const {
+      return (pageNum < (PageNum)bits.size() * 8 &&
+              (bits[pageNum >> 3] >> (pageNum & 7)) & 1);
+   }
+};
+
+//
+// PF_WarmList: pages to write to, or read back from, a buffer dump
+//
+// Closing a file drops its pages from the buffer, so the pages of each
+// file are taken down as it is closed; a dump lists those together with
+// the pages of the files still open.  Pages read from a dump wait in
+// pending until their file is opened.
+//
+struct PF_WarmFile {
+   std::string fileName;              // name the file was opened by
+   int fd;                            // OS file descriptor, -1 if closed
+   std::vector<PageNum> pages;        // pages in the buffer when closed
+};
+
+struct PF_WarmList {
+   std::vector<PF_WarmFile> files;    // least recently opened first
+   std::map<std::string, std::vector<PageNum> > pending;
+};
+
+//
+// PF_TempFiles: temporary files, by the name they were created with
+//
+// A temporary file has no name on disk.  Its pages are in anonymous
+// memory or, once the temporary files in memory are over the "temp_mem"
+// setting, in a file of "temp_dir" that is unlinked as soon as it is
+// created.  A file in memory that grows past the setting moves to
+// "temp_dir" then (see PF_GrowTempFile).  The descriptor kept here holds
+// the file until it is destroyed; each OpenFile gets a duplicate of it.
+//
+struct PF_TempFile {
+   int fd;                            // OS file descriptor
+   int bInMemory;                     // TRUE unless spilled to temp_dir
+   std::vector<int> openFds;          // duplicates of fd that are open
+};
+
+struct PF_TempFiles {
+   std::map<std::string, PF_TempFile> files;
+};
+
+//
+// PF_KeptFiles: logged files that were closed, but are still open
+//
+// While the write-ahead log is open, closing a logged file only logs its
+// changes.  The file stays open with its pages in the buffer, to be
+// written lazily, and OpenFile hands out the kept handle again.  When
+// more than PF_KEPT_FILES files are kept, those closed longest ago are
+// written back and closed for real.
+//
+const int PF_KEPT_FILES = 32;
+
+struct PF_KeptFile {
+   PF_FileHandle fileHandle;          // handle of the open file
+   int numOpen;                       // handles given out and not closed
+   long lastClose;                    // numCloses at the last close
+};
+
+struct PF_KeptFiles {
+   std::map<std::string, PF_KeptFile> files;
+   long numCloses;                    // closes of kept files so far
+};
+
+//
+// PF_Latch: shared/exclusive latch on the contents of a buffer page
+//
+// Every buffer frame has one.  Threads that share pages take it through
+// PF_PageHandle: shared to read the page, exclusive to change it.  The
+// buffer manager takes it shared when it writes a page in the background.
+//
+class PF_Latch {
+public:
+   PF_Latch  ()       { pthread_rwlock_init(&rwlock, NULL); }
+   ~PF_Latch ()       { pthread_rwlock_destroy(&rwlock); }
+
+   void Shared    ()  { pthread_rwlock_rdlock(&rwlock); }
+   void Exclusive ()  { pthread_rwlock_wrlock(&rwlock); }
+   int  TryShared ()  { return (pthread_rwlock_tryrdlock(&rwlock) == 0); }
+   void Release   ()  { pthread_rwlock_unlock(&rwlock); }
+
+private:
+   PF_Latch (const PF_Latch &);                  // Not copyable
+   PF_Latch &operator= (const PF_Latch &);
+   pthread_rwlock_t rwlock;
+};
+
+// Latch held through a PF_PageHandle
+#define PF_UNLATCHED       0
+#define PF_LATCH_SHARED    1
+#define PF_LATCH_EXCLUSIVE 2
+
+//
+// Run-time configuration (pf_config.cc)
+//
+const char *PF_GetConfig   (const char *key);
+int         PF_GetConfigInt(const char *key, int defaultValue);
+int         PF_GetConfigBool(const char *key, int defaultValue);
+
+//
+// Sync the directory holding a file, after creating or renaming the file
+// (pf_manager.cc)
+//
+RC PF_SyncDir(const char *fileName);
+
+//
+// Move a temporary file in memory to disk if growing it to size bytes
+// puts the temporary files in memory over "temp_mem" (pf_manager.cc)
+//
+RC PF_GrowTempFile(PF_TempFiles *pTempFiles, PF_BufferMgr *pBufferMgr,
+                   int fd, long size);
+
 #endif
@@ -0,0 +1,115 @@
+//
+// File:        pf_iostats.h
+// Description: PF_IOStats class interface
+//
+// The StatisticsMgr keeps totals for the whole PF layer.  PF_IOStats
+// keeps the same kind of counts for each file (by the name it was opened
+// with), so that the relation or index that is thrashing the buffer can
+// be told apart, and histograms of how long each read and write system
+// call, and each checkpoint, took.  Histogram buckets are powers of two
+// of microseconds.
+//
+// The counters are atomic and the table of open files is indexed by
+// file descriptor, so that counting takes no lock.  Only kept when
+// PF_STATS is defined; printed by PRINT IO and cleared by RESET IO.
+//
+
+#ifndef PF_IOSTATS_H
+#define PF_IOSTATS_H
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include "pf_internal.h"
+
+//
+// Defines
+//
+#define PF_IOSTATS_FDS      4096   // files counted apart, by descriptor
+#define PF_IOSTATS_BUCKETS  24     // histogram buckets, 1us up to 8s
+
+//
+// PF_IOCounts: counts for one file
+//
+struct PF_IOCounts {
+   std::atomic<long> hits;            // GetPage found the page
+   std::atomic<long> misses;          // GetPage had to read the page
+   std::atomic<long> reads;           // pages read, readahead included
+   std::atomic<long> writes;          // pages written
+   std::atomic<long> evictions;       // pages replaced
+   std::atomic<long> dirtyEvictions;  // pages written to be replaced
+
+   PF_IOCounts() { Reset(); }
+   void Reset();
+};
+
+//
+// PF_Histogram: latencies of one kind of system call
+//
+struct PF_Histogram {
+   std::atomic<long> buckets[PF_IOSTATS_BUCKETS];
+
+   PF_Histogram() { Reset(); }
+   void Reset();
+   void Add(long micros);
+   void Print(const char *name) const;
+};
+
+//
+// PF_IOStats - per-file counts and I/O latencies
+//
+class PF_IOStats {
+public:
+   PF_IOStats  ();
+   ~PF_IOStats ();
+
+   // Count the pages of fd under fileName from now on, added to what was
+   // counted the last times the file was open.  Close stops it.
+   void Open    (int fd, const char *fileName);
+   void Close   (int fd);
+
+   // Counts for fd.  Files that are not open (and blocks of memory) are
+   // counted together.
+   PF_IOCounts &Counts (int fd)
+   {
+      PF_IOCounts *pCounts = NULL;
+      if (fd >= 0 && fd < PF_IOSTATS_FDS)
+         pCounts = byFd[fd].load(std::memory_order_acquire);
+      return (pCounts != NULL ? *pCounts : other);
+   }
+
+   PF_Histogram readLatency;          // pread and preadv calls
+   PF_Histogram writeLatency;         // pwrite and pwritev calls
+   PF_Histogram checkpointTime;       // checkpoints, start to end
+
+   void Print   ();
+   void Reset   ();
+
+private:
+   std::mutex mutex;                  // protects byName
+   std::map<std::string, PF_IOCounts *> byName;
+   std::atomic<PF_IOCounts *> byFd[PF_IOSTATS_FDS];
+   PF_IOCounts other;
+};
+
+//
+// PF_IOTimer: measures a system call, for PF_Histogram::Add
+//
+class PF_IOTimer {
+public:
+   PF_IOTimer () : start(std::chrono::steady_clock::now()) {}
+   long Micros () const
+   {
+      return (std::chrono::duration_cast<std::chrono::microseconds>(
+                 std::chrono::steady_clock::now() - start).count());
+   }
+private:
+   std::chrono::steady_clock::time_point start;
+};
+
+// Global, created with the buffer manager (see pf_buffermgr.cc)
+extern PF_IOStats *pIOStats;
+
+#endif
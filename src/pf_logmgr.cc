@@ -0,0 +1,779 @@
+//
+// File:        pf_logmgr.cc
+// Description: PF_LogMgr class implementation, and the write-ahead log
+//              methods of PF_Manager
+//
+// The log file is a sequence of records, each a PF_LogRecHdr followed by
+// its data.  A data record names its file by an id; the id is tied to
+// the file name by a PF_LOG_FILE record the first time it is used after
+// the log was emptied.
+//
+// Recovery reads the records up to the first one that is cut short or
+// has a bad checksum (the end of what was synced), and writes the data
+// (or header image) of each into its file in log order.  The records of
+// a file that come before its last PF_LOG_DESTROY record are skipped, as
+// are those of files that do not exist.  The files are then synced and the log is
+// emptied.
+//
+// A checkpoint rewrites the log from its redo LSN on into a new file,
+// which takes the place of the old one by a rename.  The new file starts
+// with the checkpoint record, the names of the files, and the header
+// images whose records are dropped.
+//
+// Settings (see pf_config.cc):
+//    wal                "off" keeps files from being logged (default on),
+//                       see PF_Manager::OpenLog
+//
+// Records added are counted under LOGRECORD, syncs of the log under
+// LOGSYNC.
+//
+
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "pf_logmgr.h"
+#include "pf_buffermgr.h"
+
+using namespace std;
+
+#ifdef PF_STATS
+#include "statistics.h"
+
+// This is defined within pf_buffermgr.cc
+extern StatisticsMgr *pStatisticsMgr;
+#endif
+
+//
+// Checksum
+//
+// Desc: Internal.  FNV-1a hash of a record header, taken with its
+//       checksum field 0, and its data
+// In:   hdr - the record header
+//       data - hdr.length bytes of data
+// Ret:  the checksum
+//
+static unsigned Checksum(const PF_LogRecHdr &hdr, const char *data)
+{
+   PF_LogRecHdr h = hdr;
+   h.checksum = 0;
+
+   unsigned sum = 2166136261u;
+   const unsigned char *p = (const unsigned char *)&h;
+   for (size_t i = 0; i < sizeof(h); i++)
+      sum = (sum ^ p[i]) * 16777619u;
+   p = (const unsigned char *)data;
+   for (int i = 0; i < hdr.length; i++)
+      sum = (sum ^ p[i]) * 16777619u;
+   return (sum);
+}
+
+//
+// PutRecord
+//
+// Desc: Internal.  Add a record to the end of a vector
+// In:   out - where the record goes
+//       type - record type
+//       fileId - id of the file, or -1
+//       offset - byte offset in the file
+//       data - data of the record
+//       length - bytes of data
+//
+static void PutRecord(vector<char> &out, int type, int fileId, long offset,
+                      const char *data, int length)
+{
+   PF_LogRecHdr hdr;
+   hdr.length = length;
+   hdr.type = type;
+   hdr.fileId = fileId;
+   hdr.offset = offset;
+   hdr.checksum = Checksum(hdr, data);
+
+   out.insert(out.end(), (const char *)&hdr,
+              (const char *)&hdr + sizeof(hdr));
+   out.insert(out.end(), data, data + length);
+}
+
+//
+// PF_LogMgr
+//
+// Desc: Constructor.  The log is closed until Open is called.
+//
+PF_LogMgr::PF_LogMgr()
+{
+   fd = -1;
+   baseLsn = writtenLsn = durableLsn = 1;
+   bFlushing = FALSE;
+}
+
+//
+// ~PF_LogMgr
+//
+// Desc: Destructor.  Closes the log; records not yet flushed are lost.
+//
+PF_LogMgr::~PF_LogMgr()
+{
+   Close();
+}
+
+//
+// Open
+//
+// Desc: Open the log file, creating it if it does not exist.  Records
+//       left in it are redone, and it is emptied.
+// In:   fileName - name of the log file
+// Ret:  PF_FILEOPEN if the log is open, PF_UNIX or other PF return code
+//
+RC PF_LogMgr::Open(const char *fileName)
+{
+   RC rc;
+
+   if (fd >= 0)
+      return (PF_FILEOPEN);
+
+   if ((fd = open(fileName, O_RDWR | O_CREAT, CREATION_MASK)) < 0)
+      return (PF_UNIX);
+   this->fileName = fileName;
+
+   if ((rc = Recover()) || (rc = Truncate())) {
+      close(fd);
+      fd = -1;
+      return (rc);
+   }
+
+   // Return ok
+   return (0);
+}
+
+//
+// Close
+//
+// Desc: Close the log file
+// Ret:  PF_UNIX if it cannot be closed
+//
+RC PF_LogMgr::Close()
+{
+   if (fd < 0)
+      return (0);
+
+   int bError = (close(fd) < 0);
+   fd = -1;
+   return (bError ? PF_UNIX : 0);
+}
+
+//
+// FileId
+//
+// Desc: Return the id of a file in the records, giving it one if it has
+//       none yet
+// In:   fileName - name of the file
+// Ret:  the id
+//
+int PF_LogMgr::FileId(const char *fileName)
+{
+   lock_guard<std::mutex> lock(mutex);
+
+   map<string, int>::iterator it = fileIds.find(fileName);
+   if (it != fileIds.end())
+      return (it->second);
+
+   int fileId = fileNames.size();
+   fileIds[fileName] = fileId;
+   fileNames.push_back(fileName);
+   bNamed.push_back(FALSE);
+   return (fileId);
+}
+
+//
+// AddRecord
+//
+// Desc: Internal.  Add a record to the buffer, preceded by the name of
+//       its file if the log does not have it yet.  Called with mutex
+//       held.
+// In:   type - record type
+//       fileId - id of the file, or -1
+//       offset - byte offset in the file
+//       data - data of the record
+//       length - bytes of data
+// Ret:  LSN past the record
+//
+long PF_LogMgr::AddRecord(int type, int fileId, long offset,
+                          const char *data, int length)
+{
+   if (fileId >= 0 && !bNamed[fileId]) {
+      bNamed[fileId] = TRUE;
+      const string &name = fileNames[fileId];
+      AddRecord(PF_LOG_FILE, fileId, 0, name.data(), name.size());
+   }
+
+   PutRecord(buffer, type, fileId, offset, data, length);
+
+#ifdef PF_STATS
+   pStatisticsMgr->Add(PF_STAT_LOGRECORD);
+#endif
+
+   return (writtenLsn + buffer.size());
+}
+
+//
+// Append
+//
+// Desc: Add a record of bytes to be written into a file.  The data is
+//       copied before Append returns.  The record is not durable until
+//       FlushTo is called with the LSN returned, or a later one.
+// In:   fileId - id of the file, from FileId
+//       offset - byte offset in the file
+//       data - bytes to write there
+//       length - number of bytes
+//       pRecLsn - set to the LSN of the record if it is 0, or NULL
+// Out:  lsn - LSN just past the record
+// Ret:  PF_CLOSEDFILE if the log is not open
+//
+RC PF_LogMgr::Append(int fileId, long offset, const char *data, int length,
+                     long &lsn, std::atomic<long> *pRecLsn)
+{
+   lock_guard<std::mutex> lock(mutex);
+
+   if (fd < 0)
+      return (PF_CLOSEDFILE);
+   if (pRecLsn != NULL && *pRecLsn == 0)
+      *pRecLsn = writtenLsn + buffer.size();
+   lsn = AddRecord(PF_LOG_DATA, fileId, offset, data, length);
+
+   // Return ok
+   return (0);
+}
+
+//
+// AppendHdr
+//
+// Desc: Add a record of the image of a file header, which goes at offset
+//       0 of the file.  The log keeps the last image of each file, to be
+//       carried over by checkpoints.
+// In:   fileId - id of the file, from FileId
+//       data - the header
+//       length - bytes of the header
+// Out:  lsn - LSN just past the record
+// Ret:  PF_CLOSEDFILE if the log is not open
+//
+RC PF_LogMgr::AppendHdr(int fileId, const char *data, int length, long &lsn)
+{
+   lock_guard<std::mutex> lock(mutex);
+
+   if (fd < 0)
+      return (PF_CLOSEDFILE);
+   lsn = AddRecord(PF_LOG_HDR, fileId, 0, data, length);
+
+   PF_LogHdrImage &image = lastHdr[fileId];
+   image.lsn = lsn;
+   image.data.assign(data, data + length);
+
+   // Return ok
+   return (0);
+}
+
+//
+// AppendDestroy
+//
+// Desc: Add a record saying that a file is gone from under its name,
+//       destroyed or renamed.  Recovery skips the records of the file
+//       that come before it.
+// In:   fileId - id of the file, from FileId
+// Ret:  PF_CLOSEDFILE if the log is not open
+//
+RC PF_LogMgr::AppendDestroy(int fileId)
+{
+   lock_guard<std::mutex> lock(mutex);
+
+   if (fd < 0)
+      return (PF_CLOSEDFILE);
+   AddRecord(PF_LOG_DESTROY, fileId, 0, NULL, 0);
+   lastHdr.erase(fileId);
+
+   // Return ok
+   return (0);
+}
+
+//
+// FlushTo
+//
+// Desc: Make the records up to lsn durable.  One thread at a time writes
+//       the whole buffer and syncs the log; threads that come in the
+//       meantime wait, and find their records synced by the next thread
+//       to go, or already by this one.
+// In:   lsn - LSN to flush up to
+// Ret:  PF_UNIX or PF_INCOMPLETEWRITE if the log cannot be written
+//
+RC PF_LogMgr::FlushTo(long lsn)
+{
+   unique_lock<std::mutex> lock(mutex);
+
+   while (durableLsn < lsn) {
+      if (bFlushing) {
+         flushed.wait(lock);
+         continue;
+      }
+      if (fd < 0)
+         return (PF_CLOSEDFILE);
+
+      // Take the buffer and write it without the lock, so that other
+      // threads can go on adding records
+      bFlushing = TRUE;
+      vector<char> out;
+      out.swap(buffer);
+      long startLsn = writtenLsn;
+      writtenLsn += out.size();
+      lock.unlock();
+
+      RC rc = 0;
+      long numBytes = out.empty() ? 0 :
+         pwrite(fd, &out[0], out.size(), startLsn - baseLsn);
+      if (numBytes < 0)
+         rc = PF_UNIX;
+      else if (numBytes != (long)out.size())
+         rc = PF_INCOMPLETEWRITE;
+      else if (fdatasync(fd) < 0)
+         rc = PF_UNIX;
+#ifdef PF_STATS
+      if (!rc)
+         pStatisticsMgr->Add(PF_STAT_LOGSYNC);
+#endif
+
+      lock.lock();
+      bFlushing = FALSE;
+      if (!rc)
+         durableLsn = startLsn + out.size();
+      flushed.notify_all();
+      if (rc)
+         return (rc);
+   }
+
+   // Return ok
+   return (0);
+}
+
+//
+// EndLsn
+//
+// Desc: Return the LSN past the last record added
+//
+long PF_LogMgr::EndLsn()
+{
+   lock_guard<std::mutex> lock(mutex);
+   return (writtenLsn + buffer.size());
+}
+
+//
+// Size
+//
+// Desc: Return the number of bytes in the log, flushed or not
+//
+long PF_LogMgr::Size()
+{
+   lock_guard<std::mutex> lock(mutex);
+   return (writtenLsn + buffer.size() - baseLsn);
+}
+
+//
+// Truncate
+//
+// Desc: Empty the log.  The records in it, synced or not, are dropped;
+//       the files they are for must all be on disk.  LSNs go on from
+//       where they were.
+// Ret:  PF_UNIX if the log file cannot be truncated
+//
+RC PF_LogMgr::Truncate()
+{
+   lock_guard<std::mutex> lock(mutex);
+
+   if (fd < 0)
+      return (PF_CLOSEDFILE);
+   if (ftruncate(fd, 0) < 0 || fsync(fd) < 0)
+      return (PF_UNIX);
+
+   writtenLsn += buffer.size();
+   buffer.clear();
+   baseLsn = durableLsn = writtenLsn;
+   for (size_t i = 0; i < bNamed.size(); i++)
+      bNamed[i] = FALSE;
+   lastHdr.clear();
+
+   // Return ok
+   return (0);
+}
+
+//
+// Checkpoint
+//
+// Desc: Add a checkpoint record, and drop the records before redoLsn.
+//       Every change they hold must be on disk; the header images among
+//       them are kept.  The log is rewritten, and synced, only if there
+//       is something to drop.
+// In:   redoLsn - LSN recovery would have to start from
+// Ret:  PF return code
+//
+RC PF_LogMgr::Checkpoint(long redoLsn)
+{
+   unique_lock<std::mutex> lock(mutex);
+
+   // The log file cannot be replaced under a thread writing it
+   while (bFlushing)
+      flushed.wait(lock);
+   if (fd < 0)
+      return (PF_CLOSEDFILE);
+
+   long endLsn = writtenLsn + buffer.size();
+   if (redoLsn > endLsn)
+      redoLsn = endLsn;
+   if (redoLsn <= baseLsn) {
+      AddRecord(PF_LOG_CHECKPOINT, -1, redoLsn, NULL, 0);
+      return (0);
+   }
+   return (Rewrite(redoLsn));
+}
+
+//
+// Rewrite
+//
+// Desc: Internal.  Write a new log file holding the checkpoint record,
+//       the names of the files, the header images whose records come
+//       before redoLsn, and every record from redoLsn on.  It is synced
+//       and renamed over the log file.  Called by Checkpoint with mutex
+//       held, and no thread flushing.
+// In:   redoLsn - first LSN kept, between baseLsn and the end of the log
+// Ret:  PF return code
+//
+RC PF_LogMgr::Rewrite(long redoLsn)
+{
+   vector<char> out;
+   PutRecord(out, PF_LOG_CHECKPOINT, -1, redoLsn, NULL, 0);
+   for (size_t i = 0; i < fileNames.size(); i++)
+      if (bNamed[i])
+         PutRecord(out, PF_LOG_FILE, i, 0, fileNames[i].data(),
+                   fileNames[i].size());
+   for (map<int, PF_LogHdrImage>::iterator it = lastHdr.begin();
+         it != lastHdr.end(); ++it)
+      if (it->second.lsn <= redoLsn)
+         PutRecord(out, PF_LOG_HDR, it->first, 0, &it->second.data[0],
+                   it->second.data.size());
+   long newBaseLsn = redoLsn - out.size();
+
+   // The records from redoLsn on, in the log file and in the buffer
+   if (redoLsn < writtenLsn) {
+      size_t headSize = out.size();
+      out.resize(headSize + (writtenLsn - redoLsn));
+      long numBytes = pread(fd, &out[headSize], writtenLsn - redoLsn,
+                            redoLsn - baseLsn);
+      if (numBytes != writtenLsn - redoLsn)
+         return (numBytes < 0 ? PF_UNIX : PF_INCOMPLETEREAD);
+      out.insert(out.end(), buffer.begin(), buffer.end());
+   }
+   else
+      out.insert(out.end(), buffer.begin() + (redoLsn - writtenLsn),
+                 buffer.end());
+
+   string tmpName = fileName + ".tmp";
+   int newFd = open(tmpName.c_str(), O_RDWR | O_CREAT | O_TRUNC,
+                    CREATION_MASK);
+   if (newFd < 0)
+      return (PF_UNIX);
+   RC rc = 0;
+   long numBytes = pwrite(newFd, &out[0], out.size(), 0);
+   if (numBytes < 0)
+      rc = PF_UNIX;
+   else if (numBytes != (long)out.size())
+      rc = PF_INCOMPLETEWRITE;
+   else if (fdatasync(newFd) < 0 ||
+            rename(tmpName.c_str(), fileName.c_str()) < 0)
+      rc = PF_UNIX;
+   else
+      rc = PF_SyncDir(fileName.c_str());
+   if (rc) {
+      close(newFd);
+      unlink(tmpName.c_str());
+      return (rc);
+   }
+
+#ifdef PF_STATS
+   pStatisticsMgr->Add(PF_STAT_LOGSYNC);
+#endif
+
+   close(fd);
+   fd = newFd;
+   writtenLsn = durableLsn = writtenLsn + buffer.size();
+   buffer.clear();
+   baseLsn = newBaseLsn;
+
+   // Return ok
+   return (0);
+}
+
+//
+// Recover
+//
+// Desc: Internal.  Redo the records in the log file, see the top of the
+//       file.  Called by Open.
+// Ret:  PF_UNIX if the log or a file cannot be read or written
+//
+RC PF_LogMgr::Recover()
+{
+   struct stat st;
+   if (fstat(fd, &st) < 0)
+      return (PF_UNIX);
+   if (st.st_size == 0)
+      return (0);
+
+   vector<char> log(st.st_size);
+   if (pread(fd, &log[0], log.size(), 0) != (long)log.size())
+      return (PF_UNIX);
+
+   // Find the records that made it to disk, the names of their files,
+   // and the last record destroying each file
+   vector<size_t> records;
+   map<int, string> names;
+   map<string, size_t> lastDestroy;
+   size_t pos = 0;
+   while (pos + sizeof(PF_LogRecHdr) <= log.size()) {
+      PF_LogRecHdr hdr;
+      memcpy(&hdr, &log[pos], sizeof(hdr));
+      const char *data = &log[pos + sizeof(hdr)];
+      if (hdr.length < 0 ||
+            (long)hdr.length > (long)(log.size() - pos - sizeof(hdr)) ||
+            hdr.checksum != Checksum(hdr, data))
+         break;
+
+      if (hdr.type == PF_LOG_FILE)
+         names[hdr.fileId] = string(data, hdr.length);
+      else if (hdr.type == PF_LOG_DESTROY)
+         lastDestroy[names[hdr.fileId]] = records.size();
+      records.push_back(pos);
+      pos += sizeof(hdr) + hdr.length;
+   }
+
+   // Write the data of each record into its file
+   RC rc = 0;
+   map<string, int> fds;
+   for (size_t i = 0; i < records.size() && !rc; i++) {
+      PF_LogRecHdr hdr;
+      memcpy(&hdr, &log[records[i]], sizeof(hdr));
+      if ((hdr.type != PF_LOG_DATA && hdr.type != PF_LOG_HDR) ||
+            !names.count(hdr.fileId))
+         continue;
+
+      const string &name = names[hdr.fileId];
+      map<string, size_t>::iterator destroyed = lastDestroy.find(name);
+      if (destroyed != lastDestroy.end() && i < destroyed->second)
+         continue;
+
+      map<string, int>::iterator it = fds.find(name);
+      if (it == fds.end())
+         it = fds.insert(make_pair(name, open(name.c_str(), O_RDWR))).first;
+      if (it->second < 0)
+         continue;
+
+      if (pwrite(it->second, &log[records[i] + sizeof(hdr)], hdr.length,
+                 hdr.offset) != hdr.length)
+         rc = PF_UNIX;
+   }
+
+   // The files must be on disk before the log is emptied
+   for (map<string, int>::iterator it = fds.begin(); it != fds.end(); ++it) {
+      if (it->second < 0)
+         continue;
+      if (fdatasync(it->second) < 0 && !rc)
+         rc = PF_UNIX;
+      close(it->second);
+   }
+
+   return (rc);
+}
+
+//
+// OpenLog
+//
+// Desc: Open the write-ahead log, redoing the changes it holds, and
+//       start taking checkpoints.  The files opened from then on are
+//       logged (see OpenFile).  Does nothing if the "wal" setting is off.
+// In:   fileName - name of the log file
+// Ret:  PF return code
+//
+RC PF_Manager::OpenLog(const char *fileName)
+{
+   RC rc;
+
+   if (!PF_GetConfigBool("wal", TRUE))
+      return (0);
+   if ((rc = pLog->Open(fileName)))
+      return (rc);
+   pBufferMgr->StartCheckpointer();
+
+   // Return ok
+   return (0);
+}
+
+//
+// CloseLog
+//
+// Desc: Stop taking checkpoints, write back and close the logged files,
+//       then empty and close the log.  The log is left as it is if a
+//       file cannot be written.
+// Ret:  PF return code
+//
+RC PF_Manager::CloseLog()
+{
+   RC rc;
+
+   if (!pLog->IsOpen())
+      return (0);
+   pBufferMgr->StopCheckpointer();
+
+   while (!pKeptFiles->files.empty())
+      if ((rc = WriteBack(pKeptFiles->files.begin()->first.c_str())))
+         return (rc);
+
+   // Every file the log covers is now on disk
+   if ((rc = pLog->Truncate()))
+      return (rc);
+   return (pLog->Close());
+}
+
+//
+// Commit
+//
+// Desc: Make the changes to the logged files durable: log the pages that
+//       changed since their last record, and flush the log.  Changes
+//       made through handles that are still open must have been flushed
+//       or forced first.
+// Ret:  PF return code
+//
+RC PF_Manager::Commit()
+{
+   RC rc;
+
+   if (!pLog->IsOpen())
+      return (0);
+   if ((rc = pBufferMgr->LogPages(ALL_FILES)))
+      return (rc);
+   return (pLog->FlushTo(pLog->EndLsn()));
+}
+
+//
+// KeepFile
+//
+// Desc: Internal.  Called by CloseFile for a logged file.  Log the
+//       changes made through fileHandle and keep the file open.  Files
+//       kept past PF_KEPT_FILES are written back, those closed longest
+//       ago first.
+// In:   fileHandle - handle of the file being closed
+// Out:  fileHandle - no longer refers to an open file
+// Ret:  PF return code
+//
+RC PF_Manager::KeepFile(PF_FileHandle &fileHandle)
+{
+   RC rc;
+   std::map<std::string, PF_KeptFile>::iterator it;
+
+   if ((rc = fileHandle.FlushPages()))
+      return (rc);
+
+   // The kept handle shares the header with the handle, and takes the
+   // room it made on disk
+   for (it = pKeptFiles->files.begin(); it != pKeptFiles->files.end(); ++it)
+      if (it->second.fileHandle.unixfd == fileHandle.unixfd) {
+         PF_FileHandle &kept = it->second.fileHandle;
+         if (fileHandle.extentEnd > kept.extentEnd)
+            kept.extentEnd = fileHandle.extentEnd;
+         it->second.numOpen--;
+         it->second.lastClose = ++pKeptFiles->numCloses;
+         break;
+      }
+
+   // The kept handle holds on to the used-page map
+   fileHandle.pUsedMap.reset();
+   fileHandle.bFileOpen = FALSE;
+   fileHandle.pBufferMgr = NULL;
+
+   while ((int)pKeptFiles->files.size() > PF_KEPT_FILES) {
+      std::map<std::string, PF_KeptFile>::iterator oldest =
+         pKeptFiles->files.end();
+      for (it = pKeptFiles->files.begin(); it != pKeptFiles->files.end();
+            ++it)
+         if (it->second.numOpen <= 0 && (oldest == pKeptFiles->files.end() ||
+               it->second.lastClose < oldest->second.lastClose))
+            oldest = it;
+      if (oldest == pKeptFiles->files.end())
+         break;
+      if ((rc = WriteBack(oldest->first.c_str())))
+         return (rc);
+   }
+
+   // Return ok
+   return (0);
+}
+
+//
+// WriteBack
+//
+// Desc: Internal.  Close a kept file for real.  Its changes are logged
+//       and made durable, then its pages and header are written and
+//       synced, so that the log is no longer needed for it.  Handles of
+//       the file that were given out and not closed must not be used
+//       again.
+// In:   fileName - name of the file, which need not be kept
+// Ret:  PF return code
+//
+RC PF_Manager::WriteBack(const char *fileName)
+{
+   RC rc;
+
+   std::map<std::string, PF_KeptFile>::iterator it =
+      pKeptFiles->files.find(fileName);
+   if (it == pKeptFiles->files.end())
+      return (0);
+   PF_FileHandle fileHandle = it->second.fileHandle;
+
+   if ((rc = fileHandle.FlushPages()) ||
+         (rc = pLog->FlushTo(pLog->EndLsn())))
+      return (rc);
+
+   // Write the file as an unlogged one; the buffer manager still sees to
+   // it that no page goes out before its records.  Any warning, such as
+   // PF_PAGEPINNED, means that pages were not written, and the file
+   // stays kept so that the log is not emptied.
+   NoteClose(fileHandle);
+   fileHandle.logId = -1;
+   fileHandle.bHdrChanged = TRUE;
+   if ((rc = fileHandle.FlushPages()))
+      return (rc);
+   if (fdatasync(fileHandle.unixfd) < 0)
+      return (PF_UNIX);
+
+   // The log is no longer needed for the file
+   pKeptFiles->files.erase(it);
+   return (CloseFile(fileHandle));
+}
+
+//
+// ForceKeptFiles
+//
+// Desc: Internal.  Write the dirty pages of the kept files, after
+//       logging them, without closing the files.  Called before the
+//       buffer is cleared.
+// Ret:  PF return code
+//
+RC PF_Manager::ForceKeptFiles()
+{
+   RC rc;
+
+   if ((rc = Commit()))
+      return (rc);
+   for (std::map<std::string, PF_KeptFile>::iterator it =
+         pKeptFiles->files.begin(); it != pKeptFiles->files.end(); ++it)
+      if ((rc = pBufferMgr->ForcePages(it->second.fileHandle.unixfd,
+                                       ALL_PAGES)))
+         return (rc);
+
+   // Return ok
+   return (0);
+}
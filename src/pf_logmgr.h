@@ -0,0 +1,130 @@
+//
+// File:        pf_logmgr.h
+// Description: PF_LogMgr class interface
+//
+// The write-ahead log holds redo records: bytes to be written at an
+// offset of a file.  Records are added to a buffer in memory and made
+// durable by FlushTo, which writes out everything added so far and syncs
+// the log once for all the threads waiting on it (group commit).  A page
+// of a logged file may only be written to its file once the records of
+// its changes are durable; until then the changes are safe in the log
+// and the page can stay in the buffer.
+//
+// Positions in the log (LSNs) grow for as long as the program runs, even
+// though the log file is emptied whenever the files it covers are all on
+// disk.  LSN 0 stands for no position.
+//
+// A checkpoint (see PF_BufferMgr::Checkpoint) drops the records that
+// come before the oldest change not yet on disk.  File headers are not
+// pages of the buffer, so the last image of each header is carried over
+// into what is kept.
+//
+
+#ifndef PF_LOGMGR_H
+#define PF_LOGMGR_H
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "pf_internal.h"
+
+//
+// Defines
+//
+#define PF_LOG_DATA        1       // bytes to write into a file
+#define PF_LOG_FILE        2       // name of a file id, as the data
+#define PF_LOG_DESTROY     3       // earlier records of the file are void
+#define PF_LOG_HDR         4       // image of a file header, at offset 0
+#define PF_LOG_CHECKPOINT  5       // checkpoint, the offset is its redo LSN
+
+//
+// PF_LogRecHdr - header of a log record, followed by length bytes of data
+//
+struct PF_LogRecHdr {
+    int        length;      // bytes of data after the header
+    int        type;        // PF_LOG_DATA, PF_LOG_FILE, ...
+    int        fileId;      // file the record is for, -1 if none
+    unsigned   checksum;    // of the header (with 0 here) and the data
+    long       offset;      // byte offset in the file of the data
+};
+
+//
+// PF_LogHdrImage - the last image of a file header in the log
+//
+struct PF_LogHdrImage {
+    long       lsn;         // LSN past its record
+    std::vector<char> data; // the header
+};
+
+//
+// PF_LogMgr - write-ahead log
+//
+class PF_LogMgr {
+public:
+    PF_LogMgr        ();                         // Constructor
+    ~PF_LogMgr       ();                         // Destructor, closes
+
+    // Open the log file, creating it if needed.  The records left in it
+    // by a program that did not close the log are redone first.
+    RC  Open         (const char *fileName);
+    // Close the log file.  Call Truncate first if all is on disk.
+    RC  Close        ();
+    int IsOpen       () const { return (fd >= 0); }
+
+    // Id of a file in the records.  Ids last as long as the program.
+    int FileId       (const char *fileName);
+
+    // Add a record of length bytes to be written at offset in the file
+    // with the id, and return the LSN just past it.  If *pRecLsn is 0 it
+    // is set to the LSN of the record, under the lock of the log.
+    RC  Append       (int fileId, long offset, const char *data, int length,
+                      long &lsn, std::atomic<long> *pRecLsn = NULL);
+    // Same for the image of the header of the file
+    RC  AppendHdr    (int fileId, const char *data, int length, long &lsn);
+    // Add a record saying that the file has been destroyed or renamed,
+    // so that the records before it are not redone
+    RC  AppendDestroy(int fileId);
+
+    // Make the records up to lsn durable
+    RC  FlushTo      (long lsn);
+    // LSN past the last record added
+    long EndLsn      ();
+    // Bytes in the log, whether flushed or not
+    long Size        ();
+
+    // Empty the log.  Every file it covers must be on disk.
+    RC  Truncate     ();
+    // Add a checkpoint record and drop the records before redoLsn, whose
+    // changes must all be on disk.  The log is durable when it returns.
+    RC  Checkpoint   (long redoLsn);
+
+private:
+    // Add a record, with mutex held
+    long AddRecord   (int type, int fileId, long offset, const char *data,
+                      int length);
+    // Replace the log file with the records from redoLsn on, preceded by
+    // those that must be carried over.  Called with mutex held.
+    RC  Rewrite      (long redoLsn);
+    // Redo the records of the log file
+    RC  Recover      ();
+
+    std::mutex     mutex;                        // protects the members
+    std::condition_variable flushed;             // signalled by FlushTo
+    int            fd;                           // log file, -1 if closed
+    std::string    fileName;                     // name of the log file
+    std::vector<char> buffer;                    // records not yet written
+    long           baseLsn;                      // LSN of the log file start
+    long           writtenLsn;                   // LSN of buffer[0]
+    long           durableLsn;                   // synced up to here
+    int            bFlushing;                    // TRUE while a thread syncs
+    std::map<std::string, int> fileIds;          // ids by file name
+    std::vector<std::string> fileNames;          // names by id
+    std::vector<char> bNamed;                    // TRUE if the log has the
+                                                 // name of the id
+    std::map<int, PF_LogHdrImage> lastHdr;       // last header image by id
+};
+
+#endif
@@ -5,13 +5,23 @@
 //              Dallan Quass (quass@cs.stanford.edu)
 //
 
+#include <cerrno>
 #include <cstdio>
+#include <string>
+#include <algorithm>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include "pf_internal.h"
 #include "pf_buffermgr.h"
+#include "pf_membroker.h"
+#include "pf_logmgr.h"
+
+#ifdef PF_STATS
+#include "pf_iostats.h"
+#endif
 
 //
 // PF_Manager
@@ -20,11 +30,42 @@
 //       Handles creation, deletion, opening and closing of files.
 //       It is associated with a PF_BufferMgr that manages the page
 //       buffer and executes the page replacement policies.
+//       The number of pages in the buffer is taken from the
+//       "buffer_size" setting (see pf_config.cc), PF_BUFFER_SIZE if
+//       it is not set.  The work memory of queries is kept apart, its
+//       size taken from the "work_mem" setting.
+//
+//       Temporary files are kept in memory up to the "temp_mem" setting,
+//       4096 pages of 4096 bytes by default, and past it in the
+//       directory named by "temp_dir" (the current directory by
+//       default).
 //
 PF_Manager::PF_Manager()
 {
+   int bufferSize = PF_GetConfigInt("buffer_size", PF_BUFFER_SIZE);
+   if (bufferSize < 1)
+      bufferSize = PF_BUFFER_SIZE;
+   if (bufferSize > PF_MAX_BUFFER_SIZE)
+      bufferSize = PF_MAX_BUFFER_SIZE;
+
    // Create Buffer Manager
-   pBufferMgr = new PF_BufferMgr(PF_BUFFER_SIZE);
+   pBufferMgr = new PF_BufferMgr(bufferSize);
+   pWarmList = new PF_WarmList;
+
+   // Create the work memory pool
+   int workMem = PF_GetConfigInt("work_mem", PF_WORK_MEM_PAGES);
+   if (workMem < 0)
+      workMem = PF_WORK_MEM_PAGES;
+   int blockSize;
+   pBufferMgr->GetBlockSize(blockSize);
+   pMemBroker = new PF_MemBroker(workMem, blockSize);
+   pTempFiles = new PF_TempFiles;
+
+   // The write-ahead log is opened by OpenLog
+   pLog = new PF_LogMgr;
+   pBufferMgr->SetLog(pLog);
+   pKeptFiles = new PF_KeptFiles;
+   pKeptFiles->numCloses = 0;
 }
 
 //
@@ -33,24 +74,124 @@ PF_Manager::PF_Manager()
 // Desc: Destructor - intended to be called once at end of program
 //       Destroys the buffer manager.
 //       All files are expected to be closed when this method is called.
+//       Temporary files that were not destroyed are.  The log is closed,
+//       writing the logged files out.
 //
 PF_Manager::~PF_Manager()
 {
+   CloseLog();
+   pBufferMgr->SetLog(NULL);
+   delete pLog;
+   delete pKeptFiles;
+
+   for (std::map<std::string, PF_TempFile>::iterator it =
+         pTempFiles->files.begin(); it != pTempFiles->files.end(); ++it)
+      close(it->second.fd);
+
    // Destroy the buffer manager objects
    delete pBufferMgr;
+   delete pWarmList;
+   delete pMemBroker;
+   delete pTempFiles;
+}
+
+//
+// IsValidPageSize
+//
+// Desc: Internal.  Return TRUE if pageSize is a power of two between
+//       PF_MIN_DISK_PAGE_SIZE and PF_MAX_DISK_PAGE_SIZE
+//
+static int IsValidPageSize(int pageSize)
+{
+   return (pageSize >= PF_MIN_DISK_PAGE_SIZE &&
+         pageSize <= PF_MAX_DISK_PAGE_SIZE &&
+         (pageSize & (pageSize - 1)) == 0);
+}
+
+//
+// WriteNewHdr
+//
+// Desc: Internal.  Write the header of an empty file
+// In:   fd - OS file descriptor of the new file
+//       pageSize - size of the pages of the file
+// Ret:  PF_HDRWRITE or PF_UNIX
+//
+static RC WriteNewHdr(int fd, int pageSize)
+{
+   int numBytes;		// return code form write syscall
+
+   // Initialize the file header: must reserve FileHdrSize bytes in memory
+   // though the actual size of FileHdr is smaller
+   char hdrBuf[PF_FILE_HDR_SIZE];
+
+   // So that Purify doesn't complain
+   memset(hdrBuf, 0, PF_FILE_HDR_SIZE);
+
+   PF_FileHdr *hdr = (PF_FileHdr*)hdrBuf;
+   hdr->firstFree = PF_PAGE_LIST_END;
+   hdr->numPages = 0;
+   hdr->pageSize = pageSize;
+   hdr->bUsedMap = TRUE;
+   hdr->firstMapPage = PF_PAGE_LIST_END;
+
+   if ((numBytes = write(fd, hdrBuf, PF_FILE_HDR_SIZE))
+         != PF_FILE_HDR_SIZE)
+      return ((numBytes < 0) ? PF_UNIX : PF_HDRWRITE);
+
+   // Return ok
+   return (0);
+}
+
+//
+// PF_SyncDir
+//
+// Desc: Internal.  Sync the directory holding a file, so that a file
+//       created in it or renamed into it stays there
+// In:   fileName - name of the file
+// Ret:  PF_UNIX if the directory cannot be synced
+//
+RC PF_SyncDir(const char *fileName)
+{
+   std::string dirName = fileName;
+   size_t slash = dirName.rfind('/');
+   dirName = (slash == std::string::npos) ? "." : dirName.substr(0, slash + 1);
+
+   int dirFd = open(dirName.c_str(), O_RDONLY);
+   if (dirFd < 0)
+      return (PF_UNIX);
+   int bError = (fsync(dirFd) < 0);
+   close(dirFd);
+   return (bError ? PF_UNIX : 0);
 }
 
 //
 // CreateFile
 //
 // Desc: Create a new PF file named fileName
+//       Larger pages hold more records or keys each and are read and
+//       written in fewer, larger transfers.  Every page of a file has the
+//       same size, while the files in the buffer pool may differ.  The
+//       file header always takes the first 4096 bytes.
 // In:   fileName - name of file to create
-// Ret:  PF return code
+//       pageSize - size of the pages on disk: a power of two from 4096
+//                  to 65536, or 0 to take the "page_size" setting (4096
+//                  if it is not set, see pf_config.cc)
+// Ret:  PF_BADPAGESIZE or other PF return code
 //
-RC PF_Manager::CreateFile (const char *fileName)
+RC PF_Manager::CreateFile (const char *fileName, int pageSize)
 {
    int fd;		// unix file descriptor
-   int numBytes;		// return code form write syscall
+   RC rc;
+
+   if (pageSize == 0)
+      pageSize = PF_GetConfigInt("page_size", PF_MIN_DISK_PAGE_SIZE);
+   if (!IsValidPageSize(pageSize))
+      return (PF_BADPAGESIZE);
+
+   // The records voiding earlier files of the name must be durable
+   // before a new one can be created, lest they are redone into it
+   if (pLog->IsOpen() && (rc = pLog->FlushTo(pLog->EndLsn())))
+      return (rc);
 
    // Create file for exclusive use
    if ((fd = open(fileName,
@@ -61,30 +202,20 @@ RC PF_Manager::CreateFile (const char *fileName)
          CREATION_MASK)) < 0)
       return (PF_UNIX);
 
-   // Initialize the file header: must reserve FileHdrSize bytes in memory
-   // though the actual size of FileHdr is smaller
-   char hdrBuf[PF_FILE_HDR_SIZE];
-
-   // So that Purify doesn't complain
-   memset(hdrBuf, 0, PF_FILE_HDR_SIZE);
-
-   PF_FileHdr *hdr = (PF_FileHdr*)hdrBuf;
-   hdr->firstFree = PF_PAGE_LIST_END;
-   hdr->numPages = 0;
-
    // Write header to file
-   if((numBytes = write(fd, hdrBuf, PF_FILE_HDR_SIZE))
-         != PF_FILE_HDR_SIZE) {
+   if ((rc = WriteNewHdr(fd, pageSize))) {
 
       // Error while writing: close and remove file
       close(fd);
       unlink(fileName);
+      return (rc);
+   }
 
-      // Return an error
-      if(numBytes < 0)
-         return (PF_UNIX);
-      else
-         return (PF_HDRWRITE);
+   // A file created while the log is open must be on disk, since the
+   // records of its changes are only redone into files that exist
+   if (pLog->IsOpen() && (fsync(fd) < 0 || PF_SyncDir(fileName))) {
+      close(fd);
+      return (PF_UNIX);
    }
 
    // Close file
@@ -99,14 +230,257 @@ RC PF_Manager::CreateFile (const char *fileName)
 // DestroyFile
 //
 // Desc: Delete a PF file named fileName (fileName must exist and not be open)
+//       A logged file kept open is written back first.  The log is told
+//       that the file is gone.
 // In:   fileName - name of file to delete
 // Ret:  PF return code
 //
 RC PF_Manager::DestroyFile (const char *fileName)
 {
+   RC rc;
+
+   // A temporary file goes with its last descriptor
+   std::map<std::string, PF_TempFile>::iterator it =
+      pTempFiles->files.find(fileName);
+   if (it != pTempFiles->files.end()) {
+      close(it->second.fd);
+      pTempFiles->files.erase(it);
+      return (0);
+   }
+
    // Remove the file
+   if ((rc = WriteBack(fileName)))
+      return (rc);
    if (unlink(fileName) < 0)
       return (PF_UNIX);
+   if (pLog->IsOpen())
+      return (pLog->AppendDestroy(pLog->FileId(fileName)));
+
+   // Return ok
+   return (0);
+}
+
+//
+// OpenSpillFile
+//
+// Desc: Internal.  Create a file with no name in directory dirName
+// In:   dirName - directory for the file
+// Ret:  OS file descriptor, -1 on error
+//
+static int OpenSpillFile(const char *dirName)
+{
+   int fd = -1;
+
+#ifdef O_TMPFILE
+   fd = open(dirName, O_TMPFILE | O_RDWR, CREATION_MASK);
+#endif
+
+   // Otherwise create a file and unlink it at once
+   if (fd < 0) {
+      std::string name = std::string(dirName) + "/redbase.tmp.XXXXXX";
+      if ((fd = mkstemp(&name[0])) >= 0)
+         unlink(name.c_str());
+   }
+   return (fd);
+}
+
+//
+// TempMemBytes
+//
+// Desc: Internal.  Add up the sizes of the temporary files in memory
+// In:   pTempFiles - the temporary files
+//       except - a file left out, or NULL
+// Ret:  the number of bytes
+//
+static long TempMemBytes(PF_TempFiles *pTempFiles, const PF_TempFile *except)
+{
+   long memBytes = 0;
+   for (std::map<std::string, PF_TempFile>::iterator it =
+         pTempFiles->files.begin(); it != pTempFiles->files.end(); ++it) {
+      struct stat st;
+      if (it->second.bInMemory && &it->second != except &&
+            fstat(it->second.fd, &st) == 0)
+         memBytes += st.st_size;
+   }
+   return (memBytes);
+}
+
+//
+// PF_GrowTempFile
+//
+// Desc: Internal.  Called before a temporary file open as fd grows.  If
+//       the file is in memory and the temporary files in memory would
+//       take more than the "temp_mem" setting, the file moves to a
+//       nameless file of "temp_dir", which takes its place under each of
+//       its descriptors.
+// In:   pTempFiles - the temporary files
+//       pBufferMgr - buffer manager holding the pages of the file
+//       fd - descriptor of an open handle of the file
+//       size - bytes the file grows to
+// Ret:  PF_UNIX if the file cannot be moved, or other PF return code
+//
+RC PF_GrowTempFile(PF_TempFiles *pTempFiles, PF_BufferMgr *pBufferMgr,
+                   int fd, long size)
+{
+   RC rc;
+
+   // Find the file by the descriptor of the handle
+   PF_TempFile *file = NULL;
+   for (std::map<std::string, PF_TempFile>::iterator it =
+         pTempFiles->files.begin(); it != pTempFiles->files.end(); ++it) {
+      std::vector<int> &fds = it->second.openFds;
+      if (std::find(fds.begin(), fds.end(), fd) != fds.end()) {
+         file = &it->second;
+         break;
+      }
+   }
+   if (file == NULL || !file->bInMemory ||
+         TempMemBytes(pTempFiles, file) + size <=
+         (long)PF_GetConfigInt("temp_mem", PF_TEMP_MEM_PAGES) *
+         PF_MIN_DISK_PAGE_SIZE)
+      return (0);
+
+   const char *dirName = PF_GetConfig("temp_dir");
+   int newFd = OpenSpillFile(dirName ? dirName : ".");
+   if (newFd < 0)
+      return (PF_UNIX);
+
+   std::vector<int> fds(file->openFds);
+   fds.insert(fds.begin(), file->fd);
+   rc = pBufferMgr->MoveFile(&fds[0], fds.size(), newFd);
+   close(newFd);
+   if (rc)
+      return (rc);
+   file->bInMemory = FALSE;
+
+   // Return ok
+   return (0);
+}
+
+//
+// CreateTempFile
+//
+// Desc: Create a new temporary file named fileName.  Its pages are held
+//       in anonymous memory while the temporary files in memory take
+//       less than the "temp_mem" setting (in pages of 4096 bytes),
+//       otherwise in a nameless file of the "temp_dir" directory.  A
+//       file in memory moves there as it grows, if it takes the
+//       temporary files in memory over the setting.
+//       Either way the file system holds no name for it, and the file
+//       goes when it is destroyed or the PF_Manager is.
+// In:   fileName - name of file to create; it may not be the name of
+//                  another temporary file
+//       pageSize - as for CreateFile
+// Ret:  PF_BADPAGESIZE, PF_UNIX if the name is taken, or other PF
+//       return code
+//
+RC PF_Manager::CreateTempFile(const char *fileName, int pageSize)
+{
+   int fd = -1;
+   int bInMemory = FALSE;
+   RC rc;
+
+   if (pageSize == 0)
+      pageSize = PF_GetConfigInt("page_size", PF_MIN_DISK_PAGE_SIZE);
+   if (!IsValidPageSize(pageSize))
+      return (PF_BADPAGESIZE);
+   if (pTempFiles->files.count(fileName)) {
+      errno = EEXIST;
+      return (PF_UNIX);
+   }
+
+#ifdef MFD_CLOEXEC
+   if (TempMemBytes(pTempFiles, NULL) < (long)PF_GetConfigInt("temp_mem", PF_TEMP_MEM_PAGES) *
+                  PF_MIN_DISK_PAGE_SIZE &&
+         (fd = memfd_create(fileName, MFD_CLOEXEC)) >= 0)
+      bInMemory = TRUE;
+#endif
+   if (fd < 0) {
+      const char *dirName = PF_GetConfig("temp_dir");
+      if ((fd = OpenSpillFile(dirName ? dirName : ".")) < 0)
+         return (PF_UNIX);
+   }
+
+   if ((rc = WriteNewHdr(fd, pageSize))) {
+      close(fd);
+      return (rc);
+   }
+
+   PF_TempFile &file = pTempFiles->files[fileName];
+   file.fd = fd;
+   file.bInMemory = bInMemory;
+
+   // Return ok
+   return (0);
+}
+
+//
+// RenameFile
+//
+// Desc: Give a file a new name.  A temporary file gets a new temporary
+//       name, replacing a temporary file of that name if there is one.
+//       Logged files kept open under either name are written back first.
+// In:   oldName - name of the file
+//       newName - its new name
+// Ret:  PF_UNIX if the file cannot be renamed
+//
+RC PF_Manager::RenameFile(const char *oldName, const char *newName)
+{
+   RC rc;
+   std::map<std::string, PF_TempFile>::iterator it =
+      pTempFiles->files.find(oldName);
+
+   // The log is told that neither name has its file any more
+   if (it == pTempFiles->files.end()) {
+      if ((rc = WriteBack(oldName)) || (rc = WriteBack(newName)))
+         return (rc);
+      if (rename(oldName, newName) < 0)
+         return (PF_UNIX);
+      if (pLog->IsOpen() &&
+            ((rc = pLog->AppendDestroy(pLog->FileId(oldName))) ||
+             (rc = pLog->AppendDestroy(pLog->FileId(newName)))))
+         return (rc);
+      return (0);
+   }
+
+   PF_TempFile file = it->second;
+   pTempFiles->files.erase(it);
+   if ((it = pTempFiles->files.find(newName)) != pTempFiles->files.end())
+      close(it->second.fd);
+   pTempFiles->files[newName] = file;
+
+   // Return ok
+   return (0);
+}
+
+//
+// ReadHdr
+//
+// Desc: Internal.  Read the header page of a file just opened: the file
+//       header and the start of the used-page map.  Some file systems
+//       accept O_DIRECT at open time but not for the I/O itself; direct
+//       I/O is then turned off for the file.
+// In:   fd - OS file descriptor
+//       pHdrPage - PF_FILE_HDR_SIZE bytes, aligned for direct I/O
+//       bDirectIO - TRUE if fd was opened O_DIRECT
+// Out:  pHdrPage - the header page
+//       bDirectIO - set to FALSE if direct I/O had to be turned off
+// Ret:  PF return code
+//
+static RC ReadHdr(int fd, char *pHdrPage, int &bDirectIO)
+{
+   int numBytes = pread(fd, pHdrPage, PF_FILE_HDR_SIZE, 0);
+
+#ifdef O_DIRECT
+   if (numBytes < 0 && errno == EINVAL && bDirectIO) {
+      fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+      bDirectIO = FALSE;
+      numBytes = pread(fd, pHdrPage, PF_FILE_HDR_SIZE, 0);
+   }
+#endif
+
+   if (numBytes != PF_FILE_HDR_SIZE)
+      return ((numBytes < 0) ? PF_UNIX : PF_HDRREAD);
 
    // Return ok
    return (0);
@@ -122,14 +496,49 @@ RC PF_Manager::DestroyFile (const char *fileName)
 //       circumstances, crash the PF layer. Note that even if only one instance
 //       of a file is for writing, problems may occur because some writes may
 //       not be seen by a reader of another instance of the file.
+//
+//       With direct I/O the pages of the file are read into and written
+//       from the buffer pool without passing through the operating system
+//       cache, so that they are not held in memory twice.  Every page and
+//       the header are a multiple of 4096 bytes at an offset that is a
+//       multiple of 4096, and the frames of the buffer pool are aligned,
+//       so all transfers meet the alignment O_DIRECT needs.  If the file
+//       system does not support direct I/O (tmpfs, for one) the file is
+//       opened normally.
+//
+//       With PF_IO_MMAP the file is opened read only and mapped into
+//       memory.  Pages are handed out as pointers into the mapping, with
+//       no copy into the buffer pool, no hash table lookup and no pin.
+//       The pages of the file must all be on disk: a writer of the file
+//       must have flushed them before the file is opened this way.
+//
+//       A file opened for writing grows by "extent_pages" pages (16 by
+//       default) at a time once it has that many, see
+//       PF_FileHandle::Preallocate.
+//
+//       A temporary file (see CreateTempFile) is opened through a
+//       duplicate of the descriptor it was created with, without direct
+//       I/O.  It is left out of buffer dumps.
+//
+//       While the write-ahead log is open, other files are logged unless
+//       PF_IO_UNLOGGED is or'ed into ioMode.  A logged file that is
+//       still open (see PF_KeptFiles) is not opened again: fileHandle
+//       becomes a copy of the handle it is open by, and shares its
+//       pages.  A file opened PF_IO_MMAP is written back first, if it is
+//       kept open with no handle given out.
 // In:   fileName - name of file to open
+//       ioMode - PF_IO_DIRECT, PF_IO_BUFFERED or PF_IO_MMAP, or
+//                PF_IO_DEFAULT to use direct I/O if the "direct_io"
+//                setting is on (it is off by default), see pf_config.cc,
+//                possibly or'ed with PF_IO_UNLOGGED
 // Out:  fileHandle - refer to the open file
 //                    this function modifies local var's in fileHandle
 //       to point to the file data in the file table, and to point to the
 //       buffer manager object
 // Ret:  PF_FILEOPEN or other PF return code
 //
-RC PF_Manager::OpenFile (const char *fileName, PF_FileHandle &fileHandle)
+RC PF_Manager::OpenFile (const char *fileName, PF_FileHandle &fileHandle,
+                         int ioMode)
 {
    int rc;                   // return code
 
@@ -137,22 +546,115 @@ RC PF_Manager::OpenFile (const char *fileName, PF_FileHandle &fileHandle)
    if (fileHandle.bFileOpen)
       return (PF_FILEOPEN);
 
-   // Open the file
-   if ((fileHandle.unixfd = open(fileName,
+   int bUnlogged = (ioMode & PF_IO_UNLOGGED);
+   ioMode &= ~PF_IO_UNLOGGED;
+
+   // A logged file may still be open, with its pages in the buffer
+   std::map<std::string, PF_KeptFile>::iterator kept =
+      pKeptFiles->files.find(fileName);
+   if (kept != pKeptFiles->files.end()) {
+      if (ioMode != PF_IO_MMAP) {
+         fileHandle = kept->second.fileHandle;
+         fileHandle.raNextPage = fileHandle.raHorizon = 0;
+         fileHandle.raRunLength = 0;
+         kept->second.numOpen++;
+         return (0);
+      }
+
+      // A mapping reads the file on disk
+      if (kept->second.numOpen <= 0 && (rc = WriteBack(fileName)))
+         return (rc);
+   }
+
+   int bDirectIO = (ioMode == PF_IO_DIRECT ||
+         (ioMode == PF_IO_DEFAULT && PF_GetConfigBool("direct_io", FALSE)));
+   int bMapped = (ioMode == PF_IO_MMAP);
+   struct stat st;
+   char *pHdrPage;
+
+   // Open the file, falling back to normal I/O if the file system will
+   // not do direct I/O
+   fileHandle.unixfd = -1;
+   fileHandle.pMap.reset();
+   fileHandle.mapSize = 0;
+   fileHandle.pUsedMap.reset();
+   fileHandle.pTempFiles = NULL;
+   std::map<std::string, PF_TempFile>::iterator temp =
+      pTempFiles->files.find(fileName);
+   int bTemp = (temp != pTempFiles->files.end());
+   int bLogged = (pLog->IsOpen() && !bTemp && !bMapped && !bUnlogged);
+   if (bTemp) {
+      bDirectIO = FALSE;
+      if ((fileHandle.unixfd = dup(temp->second.fd)) < 0)
+         return (PF_UNIX);
+   }
+   if (bMapped && !bTemp &&
+         (fileHandle.unixfd = open(fileName, O_RDONLY)) < 0)
+      return (PF_UNIX);
+#ifdef O_DIRECT
+   if (bDirectIO &&
+         (fileHandle.unixfd = open(fileName, O_RDWR | O_DIRECT)) < 0 &&
+         errno != EINVAL)
+      return (PF_UNIX);
+#endif
+   if (fileHandle.unixfd < 0) {
+      bDirectIO = FALSE;
+      if ((fileHandle.unixfd = open(fileName,
 #ifdef PC
-         O_BINARY |
+            O_BINARY |
 #endif
-         O_RDWR)) < 0)
-      return (PF_UNIX);
+            O_RDWR)) < 0)
+         return (PF_UNIX);
+   }
+
+   // Read the file header.  Files from before page sizes could be
+   // chosen have 0 for it.
+   if (posix_memalign((void **)&pHdrPage, PF_FILE_HDR_SIZE,
+                      PF_FILE_HDR_SIZE)) {
+      rc = PF_NOMEM;
+      goto err;
+   }
+   if ((rc = ReadHdr(fileHandle.unixfd, pHdrPage, bDirectIO))) {
+      free(pHdrPage);
+      goto err;
+   }
+   fileHandle.pHdr.reset(new PF_FileHdr());
+   memcpy(fileHandle.pHdr.get(), pHdrPage, sizeof(PF_FileHdr));
+   if (fileHandle.pHdr->pageSize == 0)
+      fileHandle.pHdr->pageSize = PF_MIN_DISK_PAGE_SIZE;
+   if (!IsValidPageSize(fileHandle.pHdr->pageSize)) {
+      free(pHdrPage);
+      rc = PF_HDRREAD;
+      goto err;
+   }
+
+   if (fstat(fileHandle.unixfd, &st) < 0) {
+      free(pHdrPage);
+      rc = PF_UNIX;
+      goto err;
+   }
 
-   // Read the file header
-   {
-      int numBytes = read(fileHandle.unixfd, (char *)&fileHandle.hdr,
-            sizeof(PF_FileHdr));
-      if (numBytes != sizeof(PF_FileHdr)) {
-         rc = (numBytes < 0) ? PF_UNIX : PF_HDRREAD;
+   // The file grows in extents.  Room may have been set aside on disk
+   // past its last page already.
+   fileHandle.extentPages = PF_GetConfigInt("extent_pages", PF_EXTENT_PAGES);
+   fileHandle.extentEnd =
+      (st.st_size - PF_FILE_HDR_SIZE) / fileHandle.pHdr->pageSize;
+
+   // Map the whole file, header included, so that the mapping starts
+   // at an offset mmap accepts
+   if (bMapped) {
+      long mapSize = st.st_size;
+      char *pMap = (char *)mmap(NULL, mapSize, PROT_READ, MAP_SHARED,
+                                fileHandle.unixfd, 0);
+      if (pMap == MAP_FAILED) {
+         free(pHdrPage);
+         rc = PF_UNIX;
          goto err;
       }
+
+      // Unmapped when the last handle sharing it lets go
+      fileHandle.mapSize = mapSize;
+      fileHandle.pMap.reset(pMap, [mapSize](char *p) { munmap(p, mapSize); });
    }
 
    // Set file header to be not changed
@@ -161,12 +663,59 @@ RC PF_Manager::OpenFile (const char *fileName, PF_FileHandle &fileHandle)
    // Set local variables in file handle object to refer to open file
    fileHandle.pBufferMgr = pBufferMgr;
    fileHandle.bFileOpen = TRUE;
+   fileHandle.bDirectIO = bDirectIO;
+   fileHandle.bMapped = bMapped;
+   if (!bMapped)
+      pBufferMgr->SetPageSize(fileHandle.unixfd, fileHandle.pHdr->pageSize);
+   fileHandle.logId = bLogged ? pLog->FileId(fileName) : -1;
+   pBufferMgr->SetLogId(fileHandle.unixfd, fileHandle.logId);
+   fileHandle.raNextPage = fileHandle.raHorizon = 0;
+   fileHandle.raRunLength = 0;
+
+   // Load the used-page map
+   rc = fileHandle.ReadMap(pHdrPage);
+   free(pHdrPage);
+   if (rc) {
+      fileHandle.pUsedMap.reset();
+      if (!bMapped) {
+         pBufferMgr->FlushPages(fileHandle.unixfd);
+         pBufferMgr->SetPageSize(fileHandle.unixfd, 0);
+      }
+      pBufferMgr->SetLogId(fileHandle.unixfd, -1);
+      goto err;
+   }
+
+#ifdef PF_STATS
+   // Temporary files have made-up names; they are counted together
+   if (!bMapped)
+      pIOStats->Open(fileHandle.unixfd,
+                     bTemp ? "(temporary files)" : fileName);
+#endif
+
+   // Bring back the pages of the file from a buffer dump, if any.  The
+   // descriptors of a temporary file are taken down, so that all of
+   // them move with it to disk (see PF_GrowTempFile).
+   if (!bTemp)
+      NoteOpen(fileName, fileHandle);
+   else {
+      temp->second.openFds.push_back(fileHandle.unixfd);
+      fileHandle.pTempFiles = pTempFiles;
+   }
+
+   // A logged file is kept open when it is closed
+   if (bLogged) {
+      PF_KeptFile &file = pKeptFiles->files[fileName];
+      file.fileHandle = fileHandle;
+      file.numOpen = 1;
+      file.lastClose = pKeptFiles->numCloses;
+   }
 
    // Return ok
    return 0;
 
 err:
    // Close file
+   fileHandle.pMap.reset();
    close(fileHandle.unixfd);
    fileHandle.bFileOpen = FALSE;
 
@@ -181,6 +730,7 @@ err:
 //       The file should have been opened with OpenFile().
 //       Also, flush all pages for the file from the page buffer
 //       It is an error to close a file with pages still fixed in the buffer.
+//       A logged file only has its changes logged, and is kept open.
 // In:   fileHandle - handle of file to close
 // Out:  fileHandle - no longer refers to an open file
 //                    this function modifies local var's in fileHandle
@@ -194,11 +744,38 @@ RC PF_Manager::CloseFile(PF_FileHandle &fileHandle)
    if (!fileHandle.bFileOpen)
       return (PF_CLOSEDFILE);
 
-   // Flush all buffers for this file and write out the header
+   if (fileHandle.logId >= 0)
+      return (KeepFile(fileHandle));
+
+   // Take down the pages of the file for buffer dumps, then flush all
+   // buffers for this file and write out the header
+   NoteClose(fileHandle);
    if ((rc = fileHandle.FlushPages()))
       return (rc);
 
-   // Close the file
+   // The buffer manager can forget the file
+   if (!fileHandle.bMapped)
+      pBufferMgr->SetPageSize(fileHandle.unixfd, 0);
+   pBufferMgr->SetLogId(fileHandle.unixfd, -1);
+#ifdef PF_STATS
+   pIOStats->Close(fileHandle.unixfd);
+#endif
+
+   // A temporary file no longer has the descriptor
+   if (fileHandle.pTempFiles) {
+      for (std::map<std::string, PF_TempFile>::iterator it =
+            pTempFiles->files.begin(); it != pTempFiles->files.end(); ++it) {
+         std::vector<int> &fds = it->second.openFds;
+         fds.erase(std::remove(fds.begin(), fds.end(), fileHandle.unixfd),
+                   fds.end());
+      }
+      fileHandle.pTempFiles = NULL;
+   }
+
+   // Let go of the used-page map and the mapping, which copies of the
+   // handle may still hold, and close the file
+   fileHandle.pUsedMap.reset();
+   fileHandle.pMap.reset();
    if (close(fileHandle.unixfd) < 0)
       return (PF_UNIX);
    fileHandle.bFileOpen = FALSE;
@@ -224,6 +801,11 @@ RC PF_Manager::CloseFile(PF_FileHandle &fileHandle)
 //
 RC PF_Manager::ClearBuffer()
 {
+   RC rc;
+
+   // The buffer drops dirty pages; those of logged files go out first
+   if ((rc = ForceKeptFiles()))
+      return (rc);
    return pBufferMgr->ClearBuffer();
 }
 
@@ -255,9 +837,27 @@ RC PF_Manager::PrintBuffer()
 //
 RC PF_Manager::ResizeBuffer(int iNewSize)
 {
+   RC rc;
+
+   if ((rc = ForceKeptFiles()))
+      return (rc);
    return pBufferMgr->ResizeBuffer(iNewSize);
 }
 
+//
+// GetBufferSize
+//
+// Desc: Return the number of pages in the buffer pool.  Operators that
+//       size themselves by the buffer pool should use this rather than
+//       PF_BUFFER_SIZE, since the pool size is set at run time.
+// Out:  numPages - number of pages in the buffer
+// Ret:  Returns the result of PF_BufferMgr::GetBufferSize
+//
+RC PF_Manager::GetBufferSize(int &numPages) const
+{
+   return pBufferMgr->GetBufferSize(numPages);
+}
+
 //------------------------------------------------------------------------------
 // Three Methods for manipulating raw memory buffers.  These memory
 // locations are handled by the buffer manager, but are not
@@ -0,0 +1,237 @@
+//
+// File:        pf_membroker.cc
+// Description: PF_MemBroker and PF_MemGrant implementation, and the work
+//              memory methods of PF_Manager
+//
+// Settings (see pf_config.cc):
+//    work_mem           pages of work memory shared by the operators of
+//                       queries (default 128)
+//
+
+#include <new>
+#include "pf_membroker.h"
+#include "pf_buffermgr.h"
+
+using namespace std;
+
+//
+// PF_MemBroker
+//
+// Desc: Constructor.  No memory is taken until blocks are allocated.
+// In:   _poolPages - blocks in the pool
+//       _blockSize - bytes in a block
+//
+PF_MemBroker::PF_MemBroker(int _poolPages, int _blockSize)
+{
+   poolPages = _poolPages;
+   blockSize = _blockSize;
+   numGranted = 0;
+}
+
+//
+// ~PF_MemBroker
+//
+// Desc: Destructor.  Frees the memory of the disposed blocks.
+//
+PF_MemBroker::~PF_MemBroker()
+{
+   for (size_t i = 0; i < freeBlocks.size(); i++)
+      delete [] freeBlocks[i];
+}
+
+//
+// Grant
+//
+// Desc: Reserve blocks of the pool for an operator
+// In:   numPages - blocks wanted
+//       minPages - fewest blocks the operator can work with
+// Out:  grant - holds the blocks granted
+// Ret:  PF_NOBUF if fewer than minPages blocks are left, PF return code
+//
+RC PF_MemBroker::Grant(int numPages, int minPages, PF_MemGrant &grant)
+{
+   grant.Release();
+
+   lock_guard<std::mutex> lock(mutex);
+   int numLeft = poolPages - numGranted;
+   if (numPages > numLeft)
+      numPages = numLeft;
+   if (numPages < minPages || numPages <= 0)
+      return (PF_NOBUF);
+
+   numGranted += numPages;
+   grant.pBroker = this;
+   grant.numPages = numPages;
+   grant.numUsed = 0;
+
+   // Return ok
+   return (0);
+}
+
+//
+// Release
+//
+// Desc: Give the blocks of a grant back to the pool
+// In:   grant - grant to give back
+//
+void PF_MemBroker::Release(PF_MemGrant &grant)
+{
+   lock_guard<std::mutex> lock(mutex);
+   numGranted -= grant.numPages;
+}
+
+//
+// GetBlock
+//
+// Desc: Memory for a block, reused if a block was disposed of before
+// Out:  buffer - the block
+// Ret:  PF_NOMEM if there is no memory
+//
+RC PF_MemBroker::GetBlock(char *&buffer)
+{
+   {
+      lock_guard<std::mutex> lock(mutex);
+      if (!freeBlocks.empty()) {
+         buffer = freeBlocks.back();
+         freeBlocks.pop_back();
+         return (0);
+      }
+   }
+
+   if ((buffer = new (nothrow) char[blockSize]) == NULL)
+      return (PF_NOMEM);
+
+   // Return ok
+   return (0);
+}
+
+//
+// PutBlock
+//
+// Desc: Keep the memory of a disposed block for reuse
+// In:   buffer - the block
+//
+void PF_MemBroker::PutBlock(char *buffer)
+{
+   lock_guard<std::mutex> lock(mutex);
+   freeBlocks.push_back(buffer);
+}
+
+//
+// PF_MemGrant
+//
+// Desc: Constructor.  The grant holds no blocks until it is granted by
+//       PF_Manager::GrantWorkMem.
+//
+PF_MemGrant::PF_MemGrant()
+{
+   pBroker = NULL;
+   numPages = numUsed = 0;
+}
+
+//
+// ~PF_MemGrant
+//
+// Desc: Destructor.  Gives the grant back.
+//
+PF_MemGrant::~PF_MemGrant()
+{
+   Release();
+}
+
+//
+// GetNumPages
+//
+// Desc: Return the number of blocks granted
+//
+int PF_MemGrant::GetNumPages() const
+{
+   return (numPages);
+}
+
+//
+// AllocateBlock
+//
+// Desc: Allocate a block of the grant
+// Out:  buffer - points to the block
+// Ret:  PF_NOBUF if all the blocks of the grant are allocated
+//
+RC PF_MemGrant::AllocateBlock(char *&buffer)
+{
+   RC rc;
+
+   if (pBroker == NULL || numUsed == numPages)
+      return (PF_NOBUF);
+   if ((rc = pBroker->GetBlock(buffer)))
+      return (rc);
+   numUsed++;
+
+   // Return ok
+   return (0);
+}
+
+//
+// DisposeBlock
+//
+// Desc: Give a block of the grant back, for it to be allocated again
+// In:   buffer - a block from AllocateBlock
+// Ret:  PF_PAGENOTINBUF if the grant has no blocks allocated
+//
+RC PF_MemGrant::DisposeBlock(char *buffer)
+{
+   if (pBroker == NULL || numUsed == 0)
+      return (PF_PAGENOTINBUF);
+   pBroker->PutBlock(buffer);
+   numUsed--;
+
+   // Return ok
+   return (0);
+}
+
+//
+// Release
+//
+// Desc: Give the grant back to the pool
+// Ret:  PF_PAGEPINNED if some blocks were not disposed of; their memory
+//       is lost, but the pool gets their budget back
+//
+RC PF_MemGrant::Release()
+{
+   if (pBroker == NULL)
+      return (0);
+
+   int numLost = numUsed;
+   pBroker->Release(*this);
+   pBroker = NULL;
+   numPages = numUsed = 0;
+   return (numLost > 0 ? PF_PAGEPINNED : 0);
+}
+
+//
+// GrantWorkMem
+//
+// Desc: Grant work memory to a query operator.  A grant the operator
+//       already held is given back first.
+// In:   numPages - blocks wanted
+//       minPages - fewest blocks the operator can work with
+// Out:  grant - holds the blocks granted
+// Ret:  PF_NOBUF if fewer than minPages blocks are left
+//
+RC PF_Manager::GrantWorkMem(int numPages, int minPages, PF_MemGrant &grant)
+{
+   return (pMemBroker->Grant(numPages, minPages, grant));
+}
+
+//
+// GetWorkMemSize
+//
+// Desc: Return the number of blocks in the work_mem pool, for plans to
+//       divide among their operators
+// Out:  numPages - blocks in the pool
+// Ret:  OK_RC
+//
+RC PF_Manager::GetWorkMemSize(int &numPages) const
+{
+   numPages = pMemBroker->PoolPages();
+   return (OK_RC);
+}
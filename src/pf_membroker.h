@@ -0,0 +1,51 @@
+//
+// File:        pf_membroker.h
+// Description: PF_MemBroker class interface
+//
+// The broker hands out the "work_mem" pool (see pf_config.cc) to query
+// operators as PF_MemGrant budgets, counted in blocks.  A grant only
+// reserves its blocks; the memory is taken when a block is allocated.
+// Blocks that are given back are kept for the next allocation, so the
+// memory of the pool is only ever obtained once.
+//
+
+#ifndef PF_MEMBROKER_H
+#define PF_MEMBROKER_H
+
+#include <mutex>
+#include <vector>
+#include "pf_internal.h"
+
+//
+// Defines
+//
+#define PF_WORK_MEM_PAGES  128     // default pages in the work_mem pool
+
+//
+// PF_MemBroker - grants work memory to query operators
+//
+class PF_MemBroker {
+public:
+   PF_MemBroker  (int poolPages, int blockSize);  // Constructor
+   ~PF_MemBroker ();                              // Destructor
+
+   int PoolPages () const { return (poolPages); }
+
+   // Grant between minPages and numPages blocks, as many as are left
+   RC  Grant     (int numPages, int minPages, PF_MemGrant &grant);
+   // Give a grant back
+   void Release  (PF_MemGrant &grant);
+
+   // Memory for a block of a grant, and its return
+   RC   GetBlock (char *&buffer);
+   void PutBlock (char *buffer);
+
+private:
+   std::mutex mutex;                  // protects the members below
+   int poolPages;                     // blocks in the pool
+   int blockSize;                     // bytes in a block
+   int numGranted;                    // blocks granted and not released
+   std::vector<char *> freeBlocks;    // memory of disposed blocks
+};
+
+#endif
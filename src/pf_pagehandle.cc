@@ -27,6 +27,8 @@ PF_PageHandle::PF_PageHandle()
 {
   pageNum = INVALID_PAGE;
   pPageData = NULL;
+  pLatch = NULL;
+  latchMode = PF_UNLATCHED;
 }
 
 //
@@ -34,11 +36,15 @@ PF_PageHandle::PF_PageHandle()
 //
 // Desc: Destroy the page handle object.
 //       If the page handle object refers to a pinned page, the page will
-//       NOT be unpinned.
+//       NOT be unpinned.  A latch still held through this object is
+//       released, so that a handle going out of scope on an error path
+//       does not leave the page latched for good.  Copies never hold the
+//       latch, so only the handle that took it releases it.
 //
 PF_PageHandle::~PF_PageHandle()
 {
-  // Don't need to do anything
+  if (latchMode != PF_UNLATCHED)
+    Unlatch();
 }
 
 //
@@ -46,7 +52,8 @@ PF_PageHandle::~PF_PageHandle()
 //
 // Desc: Copy constructor
 //       If the incoming page handle object refers to a pinned page,
-//       the page will NOT be pinned again.
+//       the page will NOT be pinned again.  Nor is the latch of the page
+//       taken for the copy.
 // In:   pageHandle - page handle object from which to construct this object
 //
 PF_PageHandle::PF_PageHandle(const PF_PageHandle &pageHandle)
@@ -55,6 +62,8 @@ PF_PageHandle::PF_PageHandle(const PF_PageHandle &pageHandle)
   // allocation involved
   this->pageNum = pageHandle.pageNum;
   this->pPageData = pageHandle.pPageData;
+  this->pLatch = pageHandle.pLatch;
+  this->latchMode = PF_UNLATCHED;
 }
 
 //
@@ -62,7 +71,8 @@ PF_PageHandle::PF_PageHandle(const PF_PageHandle &pageHandle)
 //
 // Desc: overload = operator
 //       If the page handle object on the rhs refers to a pinned page,
-//       the page will NOT be pinned again.
+//       the page will NOT be pinned again, nor latched.  A latch this
+//       object holds is released.
 // In:   pageHandle - page handle object to set this object equal to
 // Ret:  reference to *this
 //
@@ -73,8 +83,7 @@ PF_PageHandle& PF_PageHandle::operator= (const PF_PageHandle &pageHandle)
 
     // Just copy the pointers since there is no local memory
     // allocation involved
-    this->pageNum = pageHandle.pageNum;
-    this->pPageData = pageHandle.pPageData;
+    SetPage(pageHandle.pageNum, pageHandle.pPageData, pageHandle.pLatch);
   }
 
   // Return a reference to this
@@ -123,3 +132,96 @@ RC PF_PageHandle::GetPageNum(PageNum &_pageNum) const
   // Return ok
   return (0);
 }
+
+//
+// LatchShared
+//
+// Desc: Latch the page for reading.  Waits while another thread holds
+//       the page latched exclusive.  The page handle object must refer
+//       to a pinned page.  A page of a file opened PF_IO_MMAP has no
+//       latch, since no one can change it.
+// Ret:  PF return code
+//
+RC PF_PageHandle::LatchShared()
+{
+  // Page must refer to a pinned page
+  if (pPageData == NULL)
+    return (PF_PAGEUNPINNED);
+
+  if (latchMode != PF_UNLATCHED)
+    return (PF_LATCHED);
+
+  if (pLatch != NULL)
+    pLatch->Shared();
+  latchMode = PF_LATCH_SHARED;
+
+  // Return ok
+  return (0);
+}
+
+//
+// LatchExclusive
+//
+// Desc: Latch the page for writing.  Waits while any other thread holds
+//       the page latched.  The page handle object must refer to a pinned
+//       page.  A page of a file opened PF_IO_MMAP cannot be changed.
+// Ret:  PF return code
+//
+RC PF_PageHandle::LatchExclusive()
+{
+  // Page must refer to a pinned page
+  if (pPageData == NULL)
+    return (PF_PAGEUNPINNED);
+
+  if (pLatch == NULL)
+    return (PF_READONLY);
+
+  if (latchMode != PF_UNLATCHED)
+    return (PF_LATCHED);
+
+  pLatch->Exclusive();
+  latchMode = PF_LATCH_EXCLUSIVE;
+
+  // Return ok
+  return (0);
+}
+
+//
+// Unlatch
+//
+// Desc: Release the latch taken with LatchShared or LatchExclusive
+// Ret:  PF return code
+//
+RC PF_PageHandle::Unlatch()
+{
+  if (latchMode == PF_UNLATCHED)
+    return (PF_NOTLATCHED);
+
+  if (pLatch != NULL)
+    pLatch->Release();
+  latchMode = PF_UNLATCHED;
+
+  // Return ok
+  return (0);
+}
+
+//
+// SetPage
+//
+// Desc: Internal.  Make the handle refer to a page, unlatched.  A latch
+//       held on the page referred to before is released first, so that
+//       it is neither kept for good nor released later as the latch of
+//       the new page.
+// In:   _pageNum - number of the page
+//       _pPageData - contents of the page, after its PF header
+//       _pLatch - latch of the page, NULL if it has none
+//
+void PF_PageHandle::SetPage(PageNum _pageNum, char *_pPageData,
+                            PF_Latch *_pLatch)
+{
+  if (latchMode != PF_UNLATCHED)
+    Unlatch();
+  pageNum = _pageNum;
+  pPageData = _pPageData;
+  pLatch = _pLatch;
+}
@@ -0,0 +1,297 @@
+//
+// File:        pf_readahead.cc
+// Description: Readahead for the PF buffer manager
+//
+// PF_FileHandle notices when a file is being read page after page and
+// asks the buffer manager to read the following pages ahead of time.
+// The requests are queued and served by a pool of worker threads.  A
+// worker claims free (or replaceable) frames for the pages that are not
+// already in the buffer, marks them as being read, and reads each run
+// of consecutive pages with a single preadv call without holding the
+// buffer manager lock.  A GetPage that finds its page still being read
+// waits for the read to finish instead of issuing its own.
+//
+// Settings (see pf_config.cc):
+//    readahead_pages    pages kept queued ahead of a scan (default 32,
+//                       0 turns readahead off; the workers still bring
+//                       back buffer dumps)
+//    readahead_threads  number of worker threads (default 1)
+//
+
+#include <cstdio>
+#include <climits>
+#include <unistd.h>
+#include <sys/uio.h>
+#include "pf_buffermgr.h"
+
+using namespace std;
+
+#ifdef PF_STATS
+#include "statistics.h"
+#include "pf_iostats.h"
+
+// This is defined within pf_buffermgr.cc
+extern StatisticsMgr *pStatisticsMgr;
+#endif
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+//
+// Defines
+//
+#define PF_READAHEAD_PAGES    32   // default pages to read ahead
+#define PF_READAHEAD_THREADS  1    // default number of worker threads
+#define PF_READAHEAD_MAXTHREADS 64 // most worker threads allowed
+
+//
+// StartReadAhead
+//
+// Desc: Internal.  Read the readahead settings and start the worker
+//       threads.  Called by the constructor.
+//
+void PF_BufferMgr::StartReadAhead()
+{
+   bShutdown = FALSE;
+
+   raPages = PF_GetConfigInt("readahead_pages", PF_READAHEAD_PAGES);
+   if (raPages < 0)
+      raPages = 0;
+   if (raPages > IOV_MAX)
+      raPages = IOV_MAX;
+
+   int numThreads = PF_GetConfigInt("readahead_threads",
+                                    PF_READAHEAD_THREADS);
+   if (numThreads < 1)
+      numThreads = 1;
+   if (numThreads > PF_READAHEAD_MAXTHREADS)
+      numThreads = PF_READAHEAD_MAXTHREADS;
+
+   raWindow = raPages < numPages / 4 ? raPages : numPages / 4;
+
+   for (int i = 0; i < numThreads; i++)
+      raWorkers.push_back(thread(&PF_BufferMgr::ReadAheadWorker, this));
+}
+
+//
+// StopReadAhead
+//
+// Desc: Internal.  Drop the queued requests, let the reads under way
+//       finish, and stop the worker threads.  Called by the destructor.
+//
+void PF_BufferMgr::StopReadAhead()
+{
+   {
+      lock_guard<mutex> lock(bufMutex);
+      bShutdown = TRUE;
+      raQueue.clear();
+   }
+   raWork.notify_all();
+
+   for (size_t i = 0; i < raWorkers.size(); i++)
+      raWorkers[i].join();
+   raWorkers.clear();
+}
+
+//
+// GetReadAheadPages
+//
+// Desc: Number of pages a sequential scan should have read ahead of it.
+//       It is kept to a quarter of the buffer so that readahead does not
+//       push out the pages it is meant to feed.  Kept in raWindow so
+//       that scans need not take the buffer manager lock to ask.
+// Ret:  number of pages, 0 if readahead is turned off
+//
+int PF_BufferMgr::GetReadAheadPages() const
+{
+   return (raWindow);
+}
+
+//
+// ReadAhead
+//
+// Desc: Queue pages of a file to be read in the background.  Pages past
+//       the end of the file are not read.  At most IOV_MAX pages may be
+//       asked for at once.
+// In:   fd - OS file descriptor
+//       pageNum - first page to read
+//       numPages - number of pages to read
+//       hint - how the scan uses the pages, given to them as they are
+//              brought in
+// Ret:  PF return code
+//
+RC PF_BufferMgr::ReadAhead(int fd, PageNum pageNum, int _numPages,
+                           ClientHint hint)
+{
+   if (_numPages <= 0)
+      return (0);
+
+   {
+      lock_guard<mutex> lock(bufMutex);
+      if (raWorkers.empty() || bShutdown)
+         return (0);
+
+      PF_ReadAheadReq req = { fd, pageNum, _numPages, hint };
+      raQueue.push_back(req);
+   }
+   raWork.notify_one();
+
+   // Return ok
+   return (0);
+}
+
+//
+// ReadAheadWorker
+//
+// Desc: Internal.  Body of a readahead worker thread.  Takes requests
+//       off the queue until the buffer manager is destroyed.
+//
+void PF_BufferMgr::ReadAheadWorker()
+{
+   unique_lock<mutex> lock(bufMutex);
+   vector<int> slots;
+
+   while (!bShutdown) {
+      if (raQueue.empty()) {
+         raWork.wait(lock);
+         continue;
+      }
+      PF_ReadAheadReq req = raQueue.front();
+      raQueue.pop_front();
+
+      // Claim a frame for every page that is not in the buffer yet, and
+      // read each run of consecutive pages as soon as it is broken
+      slots.clear();
+      PageNum prevPage = req.pageNum - 1;
+      for (PageNum pageNum = req.pageNum;
+            pageNum < req.pageNum + req.numPages; pageNum++) {
+         int slot;
+         if (hashTable.Find(req.fd, pageNum, slot) != PF_HASHNOTFOUND)
+            continue;
+
+         if (!slots.empty() && pageNum != prevPage + 1) {
+            ReadRun(lock, req.fd, &slots[0], slots.size());
+            slots.clear();
+            // The buffer may have changed while the lock was released
+            if (bShutdown)
+               break;
+            if (hashTable.Find(req.fd, pageNum, slot) == 0)
+               continue;
+         }
+
+         // Stop when no frame can be had
+         if (InternalAlloc(slot))
+            break;
+         // The worker holds the pin while the page is being read
+         RC rc = InitPageDesc(req.fd, pageNum, slot, req.hint);
+         if (!rc) {
+            bufTable[slot].bReading = TRUE;
+            rc = HashInsert(req.fd, pageNum, slot);
+         }
+         if (rc) {
+            bufTable[slot].bReading = FALSE;
+            Unlink(slot);
+            InsertFree(slot);
+            break;
+         }
+         slots.push_back(slot);
+         prevPage = pageNum;
+      }
+
+      if (!slots.empty())
+         ReadRun(lock, req.fd, &slots[0], slots.size());
+   }
+}
+
+//
+// ReadRun
+//
+// Desc: Internal.  Read a run of consecutive pages into frames claimed
+//       by ReadAheadWorker.  The lock is released during the read.  Pages
+//       that could not be read (for example past the end of the file) are
+//       given back.  Waiting threads are woken up at the end.
+// In:   lock - the held buffer manager lock
+//       fd - OS file descriptor
+//       slots - frames for the pages, in page number order
+//       numSlots - number of frames, at most IOV_MAX
+//
+void PF_BufferMgr::ReadRun(unique_lock<mutex> &lock, int fd,
+                           const int *slots, int numSlots)
+{
+   int size = bufTable[slots[0]].frameSize;
+   vector<struct iovec> iov(numSlots);
+   for (int i = 0; i < numSlots; i++) {
+      iov[i].iov_base = bufTable[slots[i]].pData;
+      iov[i].iov_len = size;
+   }
+   long offset = bufTable[slots[0]].pageNum * (long)size
+      + PF_FILE_HDR_SIZE;
+
+   lock.unlock();
+#ifdef PF_STATS
+   PF_IOTimer timer;
+#endif
+   long numBytes = preadv(fd, &iov[0], numSlots, offset);
+#ifdef PF_STATS
+   pIOStats->readLatency.Add(timer.Micros());
+#endif
+   lock.lock();
+
+   int numRead = numBytes < 0 ? 0 : (int)(numBytes / size);
+
+#ifdef PF_STATS
+   if (numRead > 0) {
+      pStatisticsMgr->Add(PF_STAT_READAHEAD, numRead);
+      pIOStats->Counts(fd).reads += numRead;
+   }
+#endif
+
+   for (int i = 0; i < numSlots; i++) {
+      int slot = slots[i];
+      if (i < numRead) {
+         bufTable[slot].pinCount--;
+      }
+      else {
+         HashDelete(fd, bufTable[slot].pageNum);
+         Unlink(slot);
+         InsertFree(slot);
+      }
+      bufTable[slot].bReading = FALSE;
+   }
+
+   ioDone.notify_all();
+}
+
+//
+// WaitForReads
+//
+// Desc: Internal.  Forget the queued readahead requests of a file and
+//       wait until no page of the file is being read.  Used before pages
+//       of a file are flushed and before the whole buffer is changed.
+// In:   lock - the held buffer manager lock
+//       fd - OS file descriptor, or ALL_FILES
+//
+void PF_BufferMgr::WaitForReads(unique_lock<mutex> &lock, int fd)
+{
+   for (deque<PF_ReadAheadReq>::iterator it = raQueue.begin();
+         it != raQueue.end(); ) {
+      if (fd == ALL_FILES || it->fd == fd)
+         it = raQueue.erase(it);
+      else
+         ++it;
+   }
+
+   for (;;) {
+      int bReading = FALSE;
+      for (int slot = first; slot != INVALID_SLOT; slot = bufTable[slot].next)
+         if (bufTable[slot].bReading &&
+               (fd == ALL_FILES || bufTable[slot].fd == fd)) {
+            bReading = TRUE;
+            break;
+         }
+      if (!bReading)
+         return;
+      ioDone.wait(lock);
+   }
+}
@@ -0,0 +1,515 @@
+//
+// File:        pf_replacer.cc
+// Description: Page replacement policies of the buffer manager
+//
+
+#include <cstring>
+#include <list>
+#include <unordered_map>
+#include "pf_buffermgr.h"
+#include "pf_replacer.h"
+
+using namespace std;
+
+//
+// PF_SlotList - doubly linked list of buffer slots
+//
+// The links are kept in arrays indexed by slot, in the same way as the
+// used and free lists of the buffer manager, so that moving a slot is
+// constant time and needs no allocation.
+//
+class PF_SlotList {
+public:
+   PF_SlotList(int numSlots);
+   ~PF_SlotList();
+
+   int  Contains (int slot) const { return (inList[slot]); }
+   int  Size     () const         { return (size); }
+   int  Head     () const         { return (head); }
+   int  Tail     () const         { return (tail); }
+   int  Prev     (int slot) const { return (prev[slot]); }
+
+   void LinkHead (int slot);
+   void Unlink   (int slot);
+   void MoveHead (int slot)       { Unlink(slot); LinkHead(slot); }
+
+private:
+   int  *next;
+   int  *prev;
+   char *inList;
+   int  head;
+   int  tail;
+   int  size;
+};
+
+PF_SlotList::PF_SlotList(int numSlots)
+{
+   next = new int[numSlots];
+   prev = new int[numSlots];
+   inList = new char[numSlots];
+   memset(inList, 0, numSlots);
+   head = tail = INVALID_SLOT;
+   size = 0;
+}
+
+PF_SlotList::~PF_SlotList()
+{
+   delete [] next;
+   delete [] prev;
+   delete [] inList;
+}
+
+void PF_SlotList::LinkHead(int slot)
+{
+   next[slot] = head;
+   prev[slot] = INVALID_SLOT;
+   if (head != INVALID_SLOT)
+      prev[head] = slot;
+   head = slot;
+   if (tail == INVALID_SLOT)
+      tail = slot;
+   inList[slot] = TRUE;
+   size++;
+}
+
+void PF_SlotList::Unlink(int slot)
+{
+   if (!inList[slot])
+      return;
+   if (head == slot)
+      head = next[slot];
+   if (tail == slot)
+      tail = prev[slot];
+   if (next[slot] != INVALID_SLOT)
+      prev[next[slot]] = prev[slot];
+   if (prev[slot] != INVALID_SLOT)
+      next[prev[slot]] = next[slot];
+   inList[slot] = FALSE;
+   size--;
+}
+
+//
+// IsHot
+//
+// Desc: Internal.  TRUE if the page in slot is HOT_METADATA
+//
+static int IsHot(const PF_BufPageDesc *bufTable, int slot)
+{
+   return (bufTable[slot].hint == HOT_METADATA);
+}
+
+//
+// FindUnpinned
+//
+// Desc: Internal.  Walk list from its tail towards its head and return
+//       the first slot whose page is not pinned
+// In:   bHot - FALSE to pass over HOT_METADATA pages
+// Ret:  slot, or INVALID_SLOT if all pages on the list are pinned
+//
+static int FindUnpinned(const PF_SlotList &list,
+                        const PF_BufPageDesc *bufTable, int bHot)
+{
+   for (int slot = list.Tail(); slot != INVALID_SLOT; slot = list.Prev(slot))
+      if (bufTable[slot].pinCount == 0 && (bHot || !IsHot(bufTable, slot)))
+         return (slot);
+   return (INVALID_SLOT);
+}
+
+//
+// AppendUnpinned
+//
+// Desc: Internal.  Append the unpinned slots of list to slots, from the
+//       tail towards the head, until slots holds numSlots entries.
+//       HOT_METADATA pages are left out, since they are not about to be
+//       replaced.
+//
+static void AppendUnpinned(const PF_SlotList &list,
+                           const PF_BufPageDesc *bufTable, int numSlots,
+                           vector<int> &slots)
+{
+   for (int slot = list.Tail();
+         slot != INVALID_SLOT && (int)slots.size() < numSlots;
+         slot = list.Prev(slot))
+      if (bufTable[slot].pinCount == 0 && !IsHot(bufTable, slot))
+         slots.push_back(slot);
+}
+
+//
+// PF_LRUReplacer - least recently used
+//
+class PF_LRUReplacer : public PF_Replacer {
+public:
+   PF_LRUReplacer(int numSlots) : lru(numSlots) {}
+
+   const char *Name () const { return "lru"; }
+   void Insert    (int slot, int fd, PageNum pageNum, ClientHint hint)
+      { lru.LinkHead(slot); }
+   void Reference (int slot, ClientHint hint)
+      { if (lru.Contains(slot)) lru.MoveHead(slot); }
+   void Erase     (int slot) { lru.Unlink(slot); }
+   int  Victim    (const PF_BufPageDesc *bufTable);
+   void Coldest   (const PF_BufPageDesc *bufTable, int numSlots,
+                   vector<int> &slots) const
+      { AppendUnpinned(lru, bufTable, numSlots, slots); }
+
+private:
+   PF_SlotList lru;           // MRU slot at the head
+};
+
+int PF_LRUReplacer::Victim(const PF_BufPageDesc *bufTable)
+{
+   int slot = FindUnpinned(lru, bufTable, FALSE);
+   if (slot == INVALID_SLOT)
+      slot = FindUnpinned(lru, bufTable, TRUE);
+   if (slot != INVALID_SLOT)
+      lru.Unlink(slot);
+   return (slot);
+}
+
+//
+// PF_ClockReplacer - second chance
+//
+// Every resident slot has a reference bit that is set whenever the page
+// is used.  The clock hand sweeps the slots, clearing set bits, and
+// stops at the first unpinned page whose bit is already clear.  The
+// hand passes HOT_METADATA pages by for two turns.
+//
+class PF_ClockReplacer : public PF_Replacer {
+public:
+   PF_ClockReplacer(int numSlots);
+   ~PF_ClockReplacer();
+
+   const char *Name () const { return "clock"; }
+   void Insert    (int slot, int fd, PageNum pageNum, ClientHint hint)
+      { resident[slot] = refBit[slot] = TRUE; }
+   void Reference (int slot, ClientHint hint) { refBit[slot] = TRUE; }
+   void Erase     (int slot) { resident[slot] = FALSE; }
+   int  Victim    (const PF_BufPageDesc *bufTable);
+   void Coldest   (const PF_BufPageDesc *bufTable, int numSlots,
+                   vector<int> &slots) const;
+
+private:
+   int  numSlots;
+   int  hand;                 // next slot to look at
+   char *resident;            // TRUE if the slot holds a page
+   char *refBit;              // TRUE if used since the hand last passed
+};
+
+PF_ClockReplacer::PF_ClockReplacer(int _numSlots)
+{
+   numSlots = _numSlots;
+   hand = 0;
+   resident = new char[numSlots];
+   refBit = new char[numSlots];
+   memset(resident, 0, numSlots);
+   memset(refBit, 0, numSlots);
+}
+
+PF_ClockReplacer::~PF_ClockReplacer()
+{
+   delete [] resident;
+   delete [] refBit;
+}
+
+int PF_ClockReplacer::Victim(const PF_BufPageDesc *bufTable)
+{
+   // Two full turns clear every reference bit, so if no victim is found
+   // by then all pages but the hot ones are pinned.  Two more take in
+   // the hot pages.
+   for (int i = 0; i < 4 * numSlots; i++) {
+      int slot = hand;
+      if (++hand == numSlots)
+         hand = 0;
+
+      if (!resident[slot] || bufTable[slot].pinCount > 0 ||
+            (i < 2 * numSlots && IsHot(bufTable, slot)))
+         continue;
+      if (refBit[slot]) {
+         refBit[slot] = FALSE;
+         continue;
+      }
+      resident[slot] = FALSE;
+      return (slot);
+   }
+   return (INVALID_SLOT);
+}
+
+//
+// Coldest
+//
+// Desc: The pages the hand would take on its next turn are the unpinned
+//       ones whose reference bit is clear, in hand order
+//
+void PF_ClockReplacer::Coldest(const PF_BufPageDesc *bufTable, int n,
+                               vector<int> &slots) const
+{
+   for (int i = 0; i < numSlots && (int)slots.size() < n; i++) {
+      int slot = (hand + i) % numSlots;
+      if (resident[slot] && !refBit[slot] && bufTable[slot].pinCount == 0 &&
+            !IsHot(bufTable, slot))
+         slots.push_back(slot);
+   }
+}
+
+//
+// PF_2QReplacer - 2Q (full version)
+//
+// A1in is a FIFO of pages seen once.  When a page leaves A1in its
+// identity, but not its contents, is remembered on the A1out ghost
+// queue.  A page that is asked for again while on A1out is brought into
+// Am, an LRU queue of the pages that have proven to be reused.  A1in is
+// kept to a quarter of the buffer and A1out remembers half a buffer's
+// worth of pages, the values suggested by Johnson and Shasha.
+//
+// HOT_METADATA pages go straight to Am.
+//
+class PF_2QReplacer : public PF_Replacer {
+public:
+   PF_2QReplacer(int numSlots);
+
+   const char *Name () const { return "2q"; }
+   void Insert    (int slot, int fd, PageNum pageNum, ClientHint hint);
+   void Reference (int slot, ClientHint hint)
+      { if (am.Contains(slot)) am.MoveHead(slot); }
+   void Erase     (int slot) { a1in.Unlink(slot); am.Unlink(slot); }
+   int  Victim    (const PF_BufPageDesc *bufTable);
+   void PutBack   (int slot, int fd, PageNum pageNum, ClientHint hint);
+   void Coldest   (const PF_BufPageDesc *bufTable, int numSlots,
+                   vector<int> &slots) const;
+
+private:
+   typedef unsigned long long PageKey;
+   static PageKey Key(int fd, PageNum pageNum)
+      { return (((PageKey)(unsigned int)fd << 32) | (unsigned int)pageNum); }
+
+   void Remember  (int fd, PageNum pageNum);
+   int  Choose    (const PF_BufPageDesc *bufTable, int bHot) const;
+
+   PF_SlotList a1in;          // FIFO of pages referenced once
+   PF_SlotList am;            // LRU of pages referenced again
+   int         kIn;           // target size of a1in
+   int         kOut;          // size of a1out
+
+   list<PageKey> a1out;       // ghost FIFO, newest at the front
+   unordered_map<PageKey, list<PageKey>::iterator> a1outIndex;
+   vector<char>  fromA1in;    // TRUE if the last victim in slot was
+                              // taken from A1in
+};
+
+PF_2QReplacer::PF_2QReplacer(int numSlots)
+   : a1in(numSlots), am(numSlots), fromA1in(numSlots)
+{
+   kIn = numSlots / 4;
+   if (kIn < 1)
+      kIn = 1;
+   kOut = numSlots / 2;
+   if (kOut < 1)
+      kOut = 1;
+}
+
+void PF_2QReplacer::Insert(int slot, int fd, PageNum pageNum,
+                           ClientHint hint)
+{
+   auto it = a1outIndex.find(Key(fd, pageNum));
+   if (it == a1outIndex.end()) {
+      if (hint == HOT_METADATA)
+         am.LinkHead(slot);
+      else
+         a1in.LinkHead(slot);
+      return;
+   }
+
+   // Seen recently enough to be remembered: it is reused
+   a1out.erase(it->second);
+   a1outIndex.erase(it);
+   am.LinkHead(slot);
+}
+
+void PF_2QReplacer::Remember(int fd, PageNum pageNum)
+{
+   PageKey key = Key(fd, pageNum);
+   if (a1outIndex.count(key))
+      return;
+   a1out.push_front(key);
+   a1outIndex[key] = a1out.begin();
+   if ((int)a1out.size() > kOut) {
+      a1outIndex.erase(a1out.back());
+      a1out.pop_back();
+   }
+}
+
+int PF_2QReplacer::Choose(const PF_BufPageDesc *bufTable, int bHot) const
+{
+   int slot;
+
+   // Take from A1in while it is over its share, else from Am.  Fall
+   // back to the other queue if every page on the first one is pinned.
+   if (a1in.Size() > kIn || am.Size() == 0) {
+      if ((slot = FindUnpinned(a1in, bufTable, bHot)) == INVALID_SLOT)
+         slot = FindUnpinned(am, bufTable, bHot);
+   }
+   else {
+      if ((slot = FindUnpinned(am, bufTable, bHot)) == INVALID_SLOT)
+         slot = FindUnpinned(a1in, bufTable, bHot);
+   }
+   return (slot);
+}
+
+int PF_2QReplacer::Victim(const PF_BufPageDesc *bufTable)
+{
+   int slot = Choose(bufTable, FALSE);
+   if (slot == INVALID_SLOT)
+      slot = Choose(bufTable, TRUE);
+   if (slot == INVALID_SLOT)
+      return (INVALID_SLOT);
+
+   fromA1in[slot] = a1in.Contains(slot);
+   if (fromA1in[slot]) {
+      a1in.Unlink(slot);
+      Remember(bufTable[slot].fd, bufTable[slot].pageNum);
+   }
+   else
+      am.Unlink(slot);
+   return (slot);
+}
+
+//
+// PutBack
+//
+// Desc: A page taken from A1in was remembered in A1out as it left.  It
+//       has not left, so forget it again and return it to A1in, where
+//       Insert would have found it in A1out and made it hot.
+//
+void PF_2QReplacer::PutBack(int slot, int fd, PageNum pageNum,
+                            ClientHint hint)
+{
+   if (!fromA1in[slot]) {
+      am.LinkHead(slot);
+      return;
+   }
+   auto it = a1outIndex.find(Key(fd, pageNum));
+   if (it != a1outIndex.end()) {
+      a1out.erase(it->second);
+      a1outIndex.erase(it);
+   }
+   a1in.LinkHead(slot);
+}
+
+//
+// Coldest
+//
+// Desc: Victims come from A1in while it is over its share, so its oldest
+//       pages are the coldest, followed by the least recently used
+//       pages of Am
+//
+void PF_2QReplacer::Coldest(const PF_BufPageDesc *bufTable, int numSlots,
+                            vector<int> &slots) const
+{
+   if (a1in.Size() > kIn || am.Size() == 0) {
+      AppendUnpinned(a1in, bufTable, numSlots, slots);
+      AppendUnpinned(am, bufTable, numSlots, slots);
+   }
+   else {
+      AppendUnpinned(am, bufTable, numSlots, slots);
+      AppendUnpinned(a1in, bufTable, numSlots, slots);
+   }
+}
+
+//
+// PF_ColdReplacer - cold pages first, then the policy
+//
+// Wraps every policy.  Cold pages are kept apart from the pages of the
+// policy, in the order they came in, and are replaced before any other.
+// A scan thus cycles through a few frames of its own, and the pages it
+// has read ahead go after the older ones it is done with.  A cold page
+// that is used in another way is handed to the policy.
+//
+class PF_ColdReplacer : public PF_Replacer {
+public:
+   PF_ColdReplacer(PF_Replacer *_pPolicy, int numSlots)
+      : pPolicy(_pPolicy), cold(numSlots), fds(numSlots), pageNums(numSlots)
+      {}
+   ~PF_ColdReplacer() { delete pPolicy; }
+
+   const char *Name () const { return (pPolicy->Name()); }
+   void Insert    (int slot, int fd, PageNum pageNum, ClientHint hint);
+   void Reference (int slot, ClientHint hint);
+   void Erase     (int slot) { cold.Unlink(slot); pPolicy->Erase(slot); }
+   int  Victim    (const PF_BufPageDesc *bufTable);
+   void PutBack   (int slot, int fd, PageNum pageNum, ClientHint hint);
+   void Coldest   (const PF_BufPageDesc *bufTable, int numSlots,
+                   vector<int> &slots) const
+   {
+      AppendUnpinned(cold, bufTable, numSlots, slots);
+      pPolicy->Coldest(bufTable, numSlots, slots);
+   }
+
+private:
+   PF_Replacer     *pPolicy;  // policy for the other pages
+   PF_SlotList     cold;      // FIFO of cold pages, newest at the head
+   vector<int>     fds;       // page in each cold slot, to hand it on
+   vector<PageNum> pageNums;
+};
+
+void PF_ColdReplacer::Insert(int slot, int fd, PageNum pageNum,
+                             ClientHint hint)
+{
+   if (!PF_IsColdHint(hint)) {
+      pPolicy->Insert(slot, fd, pageNum, hint);
+      return;
+   }
+   cold.LinkHead(slot);
+   fds[slot] = fd;
+   pageNums[slot] = pageNum;
+}
+
+void PF_ColdReplacer::Reference(int slot, ClientHint hint)
+{
+   if (!cold.Contains(slot))
+      pPolicy->Reference(slot, hint);
+   else if (!PF_IsColdHint(hint)) {
+      cold.Unlink(slot);
+      pPolicy->Insert(slot, fds[slot], pageNums[slot], hint);
+   }
+}
+
+int PF_ColdReplacer::Victim(const PF_BufPageDesc *bufTable)
+{
+   int slot = FindUnpinned(cold, bufTable, TRUE);
+   if (slot == INVALID_SLOT)
+      return (pPolicy->Victim(bufTable));
+   cold.Unlink(slot);
+   return (slot);
+}
+
+void PF_ColdReplacer::PutBack(int slot, int fd, PageNum pageNum,
+                              ClientHint hint)
+{
+   if (PF_IsColdHint(hint))
+      Insert(slot, fd, pageNum, hint);
+   else
+      pPolicy->PutBack(slot, fd, pageNum, hint);
+}
+
+//
+// PF_NewReplacer
+//
+// Desc: Create the replacer for a policy
+// In:   policy - "lru", "clock" or "2q"
+//       numSlots - number of pages in the buffer
+// Ret:  new replacer, or NULL if policy is not known
+//
+PF_Replacer *PF_NewReplacer(const char *policy, int numSlots)
+{
+   PF_Replacer *pPolicy;
+
+   if (!strcmp(policy, "lru"))
+      pPolicy = new PF_LRUReplacer(numSlots);
+   else if (!strcmp(policy, "clock"))
+      pPolicy = new PF_ClockReplacer(numSlots);
+   else if (!strcmp(policy, "2q"))
+      pPolicy = new PF_2QReplacer(numSlots);
+   else
+      return (NULL);
+   return new PF_ColdReplacer(pPolicy, numSlots);
+}
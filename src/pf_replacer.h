@@ -0,0 +1,94 @@
+//
+// File:        pf_replacer.h
+// Description: PF_Replacer class interface
+//
+// A replacer decides which unpinned page of the buffer is given up when
+// PF_BufferMgr needs a slot and the free list is empty.  The buffer
+// manager tells the replacer about every page brought into a slot,
+// every further reference to a resident page, and every page removed
+// from the buffer for another reason (flushed, cleared).  Policies:
+//
+//    lru    least recently used (the original PF policy)
+//    clock  second chance approximation of LRU
+//    2q     2Q (Johnson and Shasha), scan resistant: pages referenced
+//           once are kept on a short FIFO queue, and only pages that
+//           are referenced again after leaving it reach the main LRU
+//           queue.  A full scan therefore cannot push out the catalog
+//           or the upper levels of an index.
+//
+// The policy is chosen with the "replacement" setting (see
+// pf_config.cc) when the buffer manager is created.
+//
+// Every policy follows the ClientHint the pages were asked for with
+// (see redbase.h).  A page brought in for SEQUENTIAL_ONCE or TEMP use is
+// cold: cold pages are replaced first, oldest first, whatever the policy,
+// and further use under those hints does not promote them.  A
+// HOT_METADATA page is only replaced when every other unpinned page has
+// been passed over.
+//
+
+#ifndef PF_REPLACER_H
+#define PF_REPLACER_H
+
+#include <vector>
+#include "pf_internal.h"
+
+struct PF_BufPageDesc;
+
+//
+// PF_Replacer - page replacement policy of the buffer manager
+//
+class PF_Replacer {
+public:
+    virtual ~PF_Replacer () {}
+
+    // Name of the policy, as given in the "replacement" setting
+    virtual const char *Name () const = 0;
+
+    // Page pageNum of file fd has been brought into slot, for use as
+    // hint says
+    virtual void Insert    (int slot, int fd, PageNum pageNum,
+                            ClientHint hint) = 0;
+
+    // The page in slot has been pinned, dirtied or unpinned again.  hint
+    // is how the page is being used, as kept by the buffer manager.
+    virtual void Reference (int slot, ClientHint hint) = 0;
+
+    // The page in slot has left the buffer.  It is harmless to erase a
+    // slot that the replacer does not hold.
+    virtual void Erase     (int slot) = 0;
+
+    // Choose an unpinned slot to give up and forget it.  Returns
+    // INVALID_SLOT if every page is pinned.
+    virtual int  Victim    (const PF_BufPageDesc *bufTable) = 0;
+
+    // The victim in slot, holding page pageNum of file fd, could not be
+    // given up after all (pinned meanwhile, or its write failed) and
+    // stays in the buffer.  Unlike Insert, this is not a new reference:
+    // the page goes back where it was, with no promotion.
+    virtual void PutBack   (int slot, int fd, PageNum pageNum,
+                            ClientHint hint)
+       { Insert(slot, fd, pageNum, hint); }
+
+    // Append to slots the unpinned slots that would be chosen as victims
+    // next, in that order, up to numSlots of them.  Does not change the
+    // state of the replacer.  Used by the background writer.
+    virtual void Coldest   (const PF_BufPageDesc *bufTable, int numSlots,
+                            std::vector<int> &slots) const = 0;
+};
+
+//
+// TRUE for the hints of pages that are not expected to be used again
+//
+inline int PF_IsColdHint(int hint)
+{
+   return (hint == SEQUENTIAL_ONCE || hint == TEMP);
+}
+
+//
+// Create a replacer for a buffer of numSlots pages.  Returns NULL if
+// the policy is not known.
+//
+PF_Replacer *PF_NewReplacer(const char *policy, int numSlots);
+
+#endif
@@ -12,8 +12,10 @@
 //
 #ifdef PF_STATS
 
+#include <cstdio>
 #include <iostream>
 #include "pf.h"
+#include "pf_iostats.h"
 #include "statistics.h"
 
 using namespace std;
@@ -30,6 +32,13 @@ void PF_Statistics()
    int *piRP = pStatisticsMgr->Get(PF_READPAGE);
    int *piWP = pStatisticsMgr->Get(PF_WRITEPAGE);
    int *piFP = pStatisticsMgr->Get(PF_FLUSHPAGES);
+   int *piRA = pStatisticsMgr->Get(PF_READAHEAD);
+   int *piFW = pStatisticsMgr->Get(PF_FGWRITE);
+   int *piBW = pStatisticsMgr->Get(PF_BGWRITE);
+   int *piLR = pStatisticsMgr->Get(PF_LOGRECORD);
+   int *piLS = pStatisticsMgr->Get(PF_LOGSYNC);
+   int *piCP = pStatisticsMgr->Get(PF_CHECKPOINT);
+   int *piCW = pStatisticsMgr->Get(PF_CKPTWRITE);
 
    cout << "PF Layer Statistics\n";
    cout << "-------------------\n";
@@ -44,12 +53,27 @@ void PF_Statistics()
 
    cout << "Number of read requests: ";
    if (piRP) cout << *piRP; else cout << "None";
+   cout << "\nNumber of pages read ahead: ";
+   if (piRA) cout << *piRA; else cout << "None";
    cout << "\nNumber of write requests: ";
    if (piWP) cout << *piWP; else cout << "None";
+   cout << "\n  Written to replace a page: ";
+   if (piFW) cout << *piFW; else cout << "None";
+   cout << "\n  Written by the background writer: ";
+   if (piBW) cout << *piBW; else cout << "None";
+   cout << "\n  Written by checkpoints: ";
+   if (piCW) cout << *piCW; else cout << "None";
    cout << "\n-------------------\n";
    cout << "Number of flushes: ";
    if (piFP) cout << *piFP; else cout << "None";
    cout << "\n-------------------\n";
+   cout << "Number of log records: ";
+   if (piLR) cout << *piLR; else cout << "None";
+   cout << "\n  Number of log syncs: ";
+   if (piLS) cout << *piLS; else cout << "None";
+   cout << "\nNumber of checkpoints: ";
+   if (piCP) cout << *piCP; else cout << "None";
+   cout << "\n-------------------\n";
 
    // Must delete the memory returned from StatisticsMgr::Get
    delete piGP;
@@ -58,6 +82,223 @@ void PF_Statistics()
    delete piRP;
    delete piWP;
    delete piFP;
+   delete piRA;
+   delete piFW;
+   delete piBW;
+   delete piLR;
+   delete piLS;
+   delete piCP;
+   delete piCW;
+}
+
+//
+// PF_IOCounts::Reset
+//
+// Desc: Set all the counts to 0
+//
+void PF_IOCounts::Reset()
+{
+   hits = misses = reads = writes = evictions = dirtyEvictions = 0;
+}
+
+//
+// PF_Histogram::Reset
+//
+// Desc: Empty all the buckets
+//
+void PF_Histogram::Reset()
+{
+   for (int i = 0; i < PF_IOSTATS_BUCKETS; i++)
+      buckets[i] = 0;
+}
+
+//
+// PF_Histogram::Add
+//
+// Desc: Count a call.  Bucket i holds calls that took less than 2^i
+//       microseconds (and at least 2^(i-1)); the last bucket holds all
+//       slower calls.
+// In:   micros - how long the call took
+//
+void PF_Histogram::Add(long micros)
+{
+   int i = 0;
+   while (i < PF_IOSTATS_BUCKETS - 1 && micros >= (1L << i))
+      i++;
+   buckets[i].fetch_add(1, std::memory_order_relaxed);
+}
+
+//
+// PF_Histogram::Print
+//
+// Desc: Print the buckets that are not empty, and the bucket bounds under
+//       which half and 99% of the calls fall
+// In:   name - kind of call
+//
+void PF_Histogram::Print(const char *name) const
+{
+   long counts[PF_IOSTATS_BUCKETS], total = 0;
+   for (int i = 0; i < PF_IOSTATS_BUCKETS; i++)
+      total += (counts[i] = buckets[i]);
+
+   cout << name << " calls: " << total;
+   if (total == 0) {
+      cout << "\n";
+      return;
+   }
+
+   long sum = 0, p50 = -1, p99 = -1;
+   for (int i = 0; i < PF_IOSTATS_BUCKETS; i++) {
+      sum += counts[i];
+      if (p50 < 0 && sum * 2 >= total)
+         p50 = 1L << i;
+      if (p99 < 0 && sum * 100 >= total * 99)
+         p99 = 1L << i;
+   }
+   cout << "  (p50 < " << p50 << "us, p99 < " << p99 << "us)\n";
+
+   char line[80];
+   for (int i = 0; i < PF_IOSTATS_BUCKETS; i++) {
+      if (counts[i] == 0)
+         continue;
+      if (i == PF_IOSTATS_BUCKETS - 1)
+         sprintf(line, "  >= %8ldus: %ld\n", 1L << (i - 1), counts[i]);
+      else
+         sprintf(line, "   < %8ldus: %ld\n", 1L << i, counts[i]);
+      cout << line;
+   }
+}
+
+//
+// PF_IOStats
+//
+// Desc: Constructor.  No file is open.
+//
+PF_IOStats::PF_IOStats()
+{
+   for (int fd = 0; fd < PF_IOSTATS_FDS; fd++)
+      byFd[fd] = NULL;
+}
+
+//
+// ~PF_IOStats
+//
+// Desc: Destructor
+//
+PF_IOStats::~PF_IOStats()
+{
+   for (map<string, PF_IOCounts *>::iterator it = byName.begin();
+         it != byName.end(); ++it)
+      delete it->second;
+}
+
+//
+// Open
+//
+// Desc: Count the pages of a file opened as fd under its name
+// In:   fd - OS file descriptor
+//       fileName - name the file was opened with
+//
+void PF_IOStats::Open(int fd, const char *fileName)
+{
+   if (fd < 0 || fd >= PF_IOSTATS_FDS)
+      return;
+
+   lock_guard<std::mutex> lock(mutex);
+   PF_IOCounts *&pCounts = byName[fileName];
+   if (pCounts == NULL)
+      pCounts = new PF_IOCounts;
+   byFd[fd].store(pCounts, std::memory_order_release);
+}
+
+//
+// Close
+//
+// Desc: Stop counting the pages of fd under the name of its file.  The
+//       counts are kept.
+// In:   fd - OS file descriptor
+//
+void PF_IOStats::Close(int fd)
+{
+   if (fd >= 0 && fd < PF_IOSTATS_FDS)
+      byFd[fd].store(NULL, std::memory_order_release);
+}
+
+//
+// Print
+//
+// Desc: Print the counts of each file used since the last Reset, and the
+//       latency histograms
+//
+void PF_IOStats::Print()
+{
+   char line[120];
+
+   cout << "PF I/O by file\n";
+   cout << "--------------\n";
+   sprintf(line, "%-24s %9s %9s %9s %9s %9s %9s\n", "File", "Hits",
+           "Misses", "Reads", "Writes", "Evicted", "Dirty");
+   cout << line;
+
+   lock_guard<std::mutex> lock(mutex);
+   for (map<string, PF_IOCounts *>::iterator it = byName.begin();
+         it != byName.end(); ++it) {
+      const PF_IOCounts &c = *it->second;
+      if (c.hits + c.misses + c.reads + c.writes + c.evictions == 0)
+         continue;
+      sprintf(line, "%-24s %9ld %9ld %9ld %9ld %9ld %9ld\n",
+              it->first.c_str(), (long)c.hits, (long)c.misses,
+              (long)c.reads, (long)c.writes, (long)c.evictions,
+              (long)c.dirtyEvictions);
+      cout << line;
+   }
+   const PF_IOCounts &c = other;
+   if (c.hits + c.misses + c.reads + c.writes + c.evictions > 0) {
+      sprintf(line, "%-24s %9ld %9ld %9ld %9ld %9ld %9ld\n", "(other)",
+              (long)c.hits, (long)c.misses, (long)c.reads, (long)c.writes,
+              (long)c.evictions, (long)c.dirtyEvictions);
+      cout << line;
+   }
+
+   cout << "--------------\n";
+   cout << "PF I/O latency\n";
+   cout << "--------------\n";
+   readLatency.Print("Read");
+   writeLatency.Print("Write");
+   checkpointTime.Print("Checkpoint");
+}
+
+//
+// Reset
+//
+// Desc: Set all the counts to 0 and empty the histograms
+//
+void PF_IOStats::Reset()
+{
+   lock_guard<std::mutex> lock(mutex);
+   for (map<string, PF_IOCounts *>::iterator it = byName.begin();
+         it != byName.end(); ++it)
+      it->second->Reset();
+   other.Reset();
+   readLatency.Reset();
+   writeLatency.Reset();
+   checkpointTime.Reset();
+}
+
+//
+// PF_PrintIOStats, PF_ResetIOStats
+//
+// Desc: Print and reset the per-file counts and latency histograms, for
+//       the PRINT IO and RESET IO commands
+//
+void PF_PrintIOStats()
+{
+   pIOStats->Print();
+}
+
+void PF_ResetIOStats()
+{
+   pIOStats->Reset();
 }
 
 #endif
@@ -11,6 +11,7 @@
 #include <iostream>
 #include <cstring>
 #include <unistd.h>
+#include <sys/stat.h>
 #include "pf.h"
 #include "pf_internal.h"
 #include "pf_hashtable.h"
@@ -105,6 +106,7 @@ void PF_ConfirmStatistics()
 //
 #define FILE1	"file1"
 #define FILE2	"file2"
+#define HASH_TBL_SIZE	20	// buckets of the hash table tested
 
 //
 // Function declarations
@@ -114,6 +116,9 @@ RC PrintFile(PF_FileHandle &fh);
 RC ReadFile(PF_Manager &pfm, char* fname);
 RC TestPF();
 RC TestHash();
+RC StampRun(PF_FileHandle &fh, PageNum first, int numPages);
+RC CheckRun(PF_FileHandle &fh, PageNum first, int numPages);
+RC TestAllocate();
 
 RC WriteFile(PF_Manager &pfm, char *fname)
 {
@@ -466,9 +471,166 @@ printf("get bock size returned %d\n",len);
    return (0);
 }
 
+//
+// StampRun, CheckRun
+//
+// Write each page's number into a run of pages, and check it is there.
+//
+RC StampRun(PF_FileHandle &fh, PageNum first, int numPages)
+{
+   PF_PageHandle ph;
+   RC            rc;
+   char          *pData;
+
+   for (PageNum pageNum = first; pageNum < first + numPages; pageNum++) {
+      if ((rc = fh.GetThisPage(pageNum, ph)) ||
+            (rc = ph.GetData(pData)))
+         return (rc);
+      memcpy(pData, (char *)&pageNum, sizeof(PageNum));
+      if ((rc = fh.MarkDirty(pageNum)) ||
+            (rc = fh.UnpinPage(pageNum)))
+         return (rc);
+   }
+
+   // Return ok
+   return (0);
+}
+
+RC CheckRun(PF_FileHandle &fh, PageNum first, int numPages)
+{
+   PF_PageHandle ph;
+   RC            rc;
+   char          *pData;
+   PageNum       temp;
+
+   for (PageNum pageNum = first; pageNum < first + numPages; pageNum++) {
+      if ((rc = fh.GetThisPage(pageNum, ph)) ||
+            (rc = ph.GetData(pData)))
+         return (rc);
+      memcpy((char *)&temp, pData, sizeof(PageNum));
+      if (temp != pageNum) {
+         cout << "Page " << (int)pageNum << " holds " << (int)temp << "\n";
+         exit(1);
+      }
+      if ((rc = fh.UnpinPage(pageNum)))
+         return (rc);
+   }
+
+   // Return ok
+   return (0);
+}
+
+//
+// TestAllocate
+//
+// Runs of pages from AllocatePages: a small file is not given a whole
+// extent, freed runs are reused, a run that would cross the end of the
+// used-page map in the header starts after the map page added for it,
+// and all of it is still there when the file is opened again.
+//
+RC TestAllocate()
+{
+   PF_Manager    pfm;
+   PF_FileHandle fh;
+   PF_PageHandle ph;
+   RC            rc;
+   PageNum       first, second, run, pageNum;
+   int           pageSize;
+   struct stat   st;
+
+   // Pages the map in the file header has bits for
+   const int hdrMapPages = PF_HDR_MAP_BYTES * 8;
+
+   cout << "Testing AllocatePages\n";
+
+   if ((rc = pfm.CreateFile(FILE1)) ||
+         (rc = pfm.OpenFile(FILE1, fh)) ||
+         (rc = fh.AllocatePages(1, first)) ||
+         (rc = fh.GetPageSize(pageSize)) ||
+         (rc = pfm.CloseFile(fh)))
+      return (rc);
+   if (stat(FILE1, &st) < 0 || st.st_size > PF_FILE_HDR_SIZE + pageSize +
+                                  (long)sizeof(PF_PageHdr)) {
+      cout << "A file of one page takes " << (long)st.st_size << " bytes\n";
+      exit(1);
+   }
+
+   // Fill the file up to a few pages short of the end of the header map
+   if ((rc = pfm.OpenFile(FILE1, fh)) ||
+         (rc = fh.AllocatePages(hdrMapPages - 5, second)))
+      return (rc);
+   if (first != 0 || second != 1) {
+      cout << "Runs start at " << (int)first << " and " << (int)second << "\n";
+      exit(1);
+   }
+
+   // The next run would cross the end of the header map, so a map page
+   // is taken first, which the run must not include
+   if ((rc = fh.AllocatePages(10, run)))
+      return (rc);
+   if (run != hdrMapPages - 3) {
+      cout << "Run past the header map starts at " << (int)run << "\n";
+      exit(1);
+   }
+   if ((rc = fh.GetThisPage(hdrMapPages - 4, ph)) != PF_INVALIDPAGE) {
+      cout << "The map page should not be handed out: ";
+      return (rc);
+   }
+   if ((rc = StampRun(fh, 0, hdrMapPages - 4)) ||
+         (rc = StampRun(fh, run, 10)))
+      return (rc);
+
+   // Free pages 5-7 and 9.  A run of three reuses 5-7; a run of two does
+   // not fit at 9 and goes to the end; a single page then takes 9.
+   if ((rc = fh.DisposePage(5)) ||
+         (rc = fh.DisposePage(6)) ||
+         (rc = fh.DisposePage(7)) ||
+         (rc = fh.DisposePage(9)) ||
+         (rc = fh.AllocatePages(3, first)) ||
+         (rc = fh.AllocatePages(2, second)) ||
+         (rc = fh.AllocatePages(1, pageNum)))
+      return (rc);
+   if (first != 5 || second != run + 10 || pageNum != 9) {
+      cout << "Freed pages reused as " << (int)first << ", " << (int)second
+           << ", " << (int)pageNum << "\n";
+      exit(1);
+   }
+   if ((rc = StampRun(fh, 5, 3)) ||
+         (rc = StampRun(fh, 9, 1)) ||
+         (rc = StampRun(fh, second, 2)) ||
+         (rc = pfm.CloseFile(fh)))
+      return (rc);
+
+   // Everything is still there after reopening, and the map knows no
+   // page is free
+   if ((rc = pfm.OpenFile(FILE1, fh)) ||
+         (rc = CheckRun(fh, 0, hdrMapPages - 4)) ||
+         (rc = CheckRun(fh, run, 12)))
+      return (rc);
+   if ((rc = fh.GetThisPage(hdrMapPages - 4, ph)) != PF_INVALIDPAGE) {
+      cout << "The map page should not be handed out: ";
+      return (rc);
+   }
+   if ((rc = fh.AllocatePages(1, pageNum)))
+      return (rc);
+   if (pageNum != run + 12) {
+      cout << "Page allocated after reopening: " << (int)pageNum << "\n";
+      exit(1);
+   }
+
+   if ((rc = pfm.CloseFile(fh)) ||
+         (rc = pfm.DestroyFile(FILE1)))
+      return (rc);
+
+   cout << "AllocatePages ok\n";
+
+   // Return ok
+   return (0);
+}
+
 RC TestHash()
 {
-   PF_HashTable ht(PF_HASH_TBL_SIZE);
+   PF_HashTable ht(HASH_TBL_SIZE);
    RC           rc;
    int          i, s;
    PageNum      p;
@@ -528,7 +690,8 @@ int main()
 
    // Do tests
    if ((rc = TestPF()) ||
-         (rc = TestHash())) {
+         (rc = TestHash()) ||
+         (rc = TestAllocate())) {
       PF_PrintError(rc);
       return (1);
    }
@@ -294,6 +294,12 @@ int main()
    // Delete files from last time
    unlink(FILE1);
 
+   // The statistics checked below count the pages read and written on
+   // demand.  Readahead and the background writer would do some of
+   // that work early, so turn them off.
+   setenv("REDBASE_READAHEAD_PAGES", "0", 1);
+   setenv("REDBASE_BGWRITER_HIGH", "0", 1);
+
    if ((rc = TestPF())) {
       PF_PrintError(rc);
       return (1);
@@ -0,0 +1,432 @@
+//
+// File:        pf_test4.cc
+// Description: Test recovery from the PF write-ahead log
+//
+// Each case runs its changes in a child process that commits them and
+// then exits without closing its files or the log, as if it had
+// crashed.  The parent then opens the log, which redoes the committed
+// changes, and checks the pages of the files.
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <cstring>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "pf.h"
+#include "pf_internal.h"
+
+using namespace std;
+
+//
+// Defines
+//
+#define FILE1	"file1"
+#define FILE2	"file2"
+#define LOGFILE	"wal"
+
+#define NUM_PAGES	10
+
+// How the end of the log is damaged before recovery
+#define LOG_INTACT	0
+#define LOG_TORN	1       // last record cut short
+#define LOG_CHECKSUM	2       // last byte of the last record changed
+
+//
+// Function declarations
+//
+RC StampPages(PF_FileHandle &fh, PageNum first, int numPages, int value);
+RC CheckPages(PF_FileHandle &fh, int numPages, int value0, int value);
+void Crash(RC (*changes)(PF_Manager &pfm));
+void DamageLog(int damage);
+RC CommitTwice(PF_Manager &pfm);
+RC DestroyAndRecreate(PF_Manager &pfm);
+RC CloseLogPinned(PF_Manager &pfm);
+RC TestCommitted(int damage);
+RC TestRecreated();
+RC TestNotWrittenBack();
+
+//
+// StampPages
+//
+// Desc: Write value into a run of pages, allocating those past the end
+//       of the file
+//
+RC StampPages(PF_FileHandle &fh, PageNum first, int numPages, int value)
+{
+   PF_PageHandle ph;
+   RC            rc;
+   char          *pData;
+   PageNum       pageNum;
+
+   for (int i = 0; i < numPages; i++) {
+      if ((rc = fh.GetThisPage(first + i, ph)) == PF_INVALIDPAGE)
+         rc = fh.AllocatePage(ph);
+      if (rc ||
+            (rc = ph.GetData(pData)) ||
+            (rc = ph.GetPageNum(pageNum)))
+         return (rc);
+      memcpy(pData, &value, sizeof(value));
+      if ((rc = fh.MarkDirty(pageNum)) ||
+            (rc = fh.UnpinPage(pageNum)))
+         return (rc);
+   }
+
+   // Return ok
+   return (0);
+}
+
+//
+// CheckPages
+//
+// Desc: Check that the file has numPages pages, the first holding value0
+//       and the others value
+//
+RC CheckPages(PF_FileHandle &fh, int numPages, int value0, int value)
+{
+   PF_PageHandle ph;
+   RC            rc;
+   char          *pData;
+   PageNum       pageNum;
+   int           count = 0;
+   int           temp;
+
+   if ((rc = fh.GetFirstPage(ph)))
+      return (rc);
+   do {
+      if ((rc = ph.GetData(pData)) ||
+            (rc = ph.GetPageNum(pageNum)))
+         return (rc);
+      memcpy(&temp, pData, sizeof(temp));
+      if (temp != (pageNum == 0 ? value0 : value)) {
+         cout << "Page " << (int)pageNum << " holds " << temp << "\n";
+         exit(1);
+      }
+      count++;
+      if ((rc = fh.UnpinPage(pageNum)))
+         return (rc);
+   } while (!(rc = fh.GetNextPage(pageNum, ph)));
+   if (rc != PF_EOF)
+      return (rc);
+
+   if (count != numPages) {
+      cout << "File has " << count << " pages, not " << numPages << "\n";
+      exit(1);
+   }
+
+   // Return ok
+   return (0);
+}
+
+//
+// Crash
+//
+// Desc: Run changes in a child process that exits without closing
+//       anything, and wait for it.  The PF_Manager of the child is never
+//       destroyed, since that would close the log.
+//
+void Crash(RC (*changes)(PF_Manager &pfm))
+{
+   RC  rc;
+   int status;
+
+   cout.flush();
+   pid_t pid = fork();
+   if (pid < 0) {
+      cout << "Cannot fork\n";
+      exit(1);
+   }
+   if (pid == 0) {
+      PF_Manager *pfm = new PF_Manager;
+      if ((rc = changes(*pfm))) {
+         PF_PrintError(rc);
+         _exit(1);
+      }
+      _exit(0);
+   }
+
+   if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) ||
+         WEXITSTATUS(status) != 0) {
+      cout << "Child process failed\n";
+      exit(1);
+   }
+}
+
+//
+// DamageLog
+//
+// Desc: Damage the end of the log as a crash in the middle of writing
+//       its last record would
+//
+void DamageLog(int damage)
+{
+   struct stat st;
+   char        c;
+
+   int fd = open(LOGFILE, O_RDWR);
+   if (fd < 0 || fstat(fd, &st) < 0 || st.st_size == 0) {
+      cout << "Cannot read the log\n";
+      exit(1);
+   }
+   if (damage == LOG_TORN && ftruncate(fd, st.st_size - 1) < 0) {
+      cout << "Cannot cut the log short\n";
+      exit(1);
+   }
+   if (damage == LOG_CHECKSUM) {
+      if (pread(fd, &c, 1, st.st_size - 1) != 1) {
+         cout << "Cannot read the log\n";
+         exit(1);
+      }
+      c ^= 0x5a;
+      if (pwrite(fd, &c, 1, st.st_size - 1) != 1) {
+         cout << "Cannot write the log\n";
+         exit(1);
+      }
+   }
+   close(fd);
+}
+
+//
+// CommitTwice
+//
+// Desc: Child.  Commit NUM_PAGES pages holding 1, then page 0 holding 2,
+//       so that the last record of the log is the one of page 0.
+//
+RC CommitTwice(PF_Manager &pfm)
+{
+   PF_FileHandle fh;
+   RC            rc;
+
+   if ((rc = pfm.OpenLog(LOGFILE)) ||
+         (rc = pfm.CreateFile(FILE1)) ||
+         (rc = pfm.OpenFile(FILE1, fh)) ||
+         (rc = StampPages(fh, 0, NUM_PAGES, 1)) ||
+         (rc = fh.FlushPages()) ||
+         (rc = pfm.Commit()) ||
+         (rc = StampPages(fh, 0, 1, 2)) ||
+         (rc = fh.FlushPages()) ||
+         (rc = pfm.Commit()))
+      return (rc);
+
+   // Return ok
+   return (0);
+}
+
+//
+// DestroyAndRecreate
+//
+// Desc: Child.  Commit NUM_PAGES pages holding 7, destroy the file, and
+//       commit a new file of the same name with two pages holding 8
+//
+RC DestroyAndRecreate(PF_Manager &pfm)
+{
+   PF_FileHandle fh;
+   RC            rc;
+
+   if ((rc = pfm.OpenLog(LOGFILE)) ||
+         (rc = pfm.CreateFile(FILE2)) ||
+         (rc = pfm.OpenFile(FILE2, fh)) ||
+         (rc = StampPages(fh, 0, NUM_PAGES, 7)) ||
+         (rc = pfm.CloseFile(fh)) ||
+         (rc = pfm.Commit()) ||
+         (rc = pfm.DestroyFile(FILE2)) ||
+         (rc = pfm.CreateFile(FILE2)) ||
+         (rc = pfm.OpenFile(FILE2, fh)) ||
+         (rc = StampPages(fh, 0, 2, 8)) ||
+         (rc = fh.FlushPages()) ||
+         (rc = pfm.Commit()))
+      return (rc);
+
+   // Return ok
+   return (0);
+}
+
+//
+// CloseLogPinned
+//
+// Desc: Child.  Commit NUM_PAGES pages holding 3, and close the log twice,
+//       as the destructor of PF_Manager would after a failed CloseLog,
+//       with page 0 pinned.  Neither may empty the log.
+//
+RC CloseLogPinned(PF_Manager &pfm)
+{
+   PF_FileHandle fh;
+   PF_PageHandle ph;
+   RC            rc;
+
+   if ((rc = pfm.OpenLog(LOGFILE)) ||
+         (rc = pfm.CreateFile(FILE1)) ||
+         (rc = pfm.OpenFile(FILE1, fh)) ||
+         (rc = StampPages(fh, 0, NUM_PAGES, 3)) ||
+         (rc = fh.FlushPages()) ||
+         (rc = pfm.Commit()) ||
+         (rc = fh.GetThisPage(0, ph)))
+      return (rc);
+
+   if (pfm.CloseLog() == 0 || pfm.CloseLog() == 0) {
+      cout << "The log was closed with page 0 not written back\n";
+      cout.flush();
+      _exit(1);
+   }
+
+   // Return ok
+   return (0);
+}
+
+//
+// TestCommitted
+//
+// Desc: Committed pages come back after a crash.  With the last record
+//       of the log damaged, the change it holds is lost and the ones
+//       before it are not.
+//
+RC TestCommitted(int damage)
+{
+   PF_FileHandle fh;
+   RC            rc;
+   int           temp;
+
+   unlink(FILE1);
+   unlink(LOGFILE);
+   Crash(CommitTwice);
+
+   // The pages are only in the log so far
+   int fd = open(FILE1, O_RDONLY);
+   if (fd < 0) {
+      cout << "Cannot open " << FILE1 << "\n";
+      exit(1);
+   }
+   if (pread(fd, &temp, sizeof(temp), PF_FILE_HDR_SIZE + sizeof(PF_PageHdr))
+         == sizeof(temp) && temp != 0) {
+      cout << "Page 0 was written before the crash\n";
+      exit(1);
+   }
+   close(fd);
+
+   DamageLog(damage);
+
+   PF_Manager pfm;
+   if ((rc = pfm.OpenLog(LOGFILE)) ||
+         (rc = pfm.OpenFile(FILE1, fh)) ||
+         (rc = CheckPages(fh, NUM_PAGES, damage == LOG_INTACT ? 2 : 1, 1)) ||
+         (rc = pfm.CloseFile(fh)) ||
+         (rc = pfm.DestroyFile(FILE1)) ||
+         (rc = pfm.CloseLog()))
+      return (rc);
+
+   // Return ok
+   return (0);
+}
+
+//
+// TestRecreated
+//
+// Desc: The records of a file from before it was destroyed are not
+//       redone into the file created in its place.  Those of its last
+//       pages would make the new file longer.
+//
+RC TestRecreated()
+{
+   PF_FileHandle fh;
+   RC            rc;
+   int           pageSize;
+   struct stat   st;
+
+   unlink(FILE2);
+   unlink(LOGFILE);
+   Crash(DestroyAndRecreate);
+
+   PF_Manager pfm;
+   if ((rc = pfm.OpenLog(LOGFILE)) ||
+         (rc = pfm.OpenFile(FILE2, fh)) ||
+         (rc = CheckPages(fh, 2, 8, 8)) ||
+         (rc = fh.GetPageSize(pageSize)))
+      return (rc);
+   if (stat(FILE2, &st) < 0 || st.st_size >= PF_FILE_HDR_SIZE +
+         NUM_PAGES * (long)(pageSize + sizeof(PF_PageHdr))) {
+      cout << "Pages of the destroyed file were redone\n";
+      exit(1);
+   }
+   if ((rc = pfm.CloseFile(fh)) ||
+         (rc = pfm.DestroyFile(FILE2)) ||
+         (rc = pfm.CloseLog()))
+      return (rc);
+
+   // Return ok
+   return (0);
+}
+
+//
+// TestNotWrittenBack
+//
+// Desc: The log is kept as long as a file it covers cannot be written
+//       back, so the pages of the file come back after a crash
+//
+RC TestNotWrittenBack()
+{
+   PF_FileHandle fh;
+   RC            rc;
+
+   unlink(FILE1);
+   unlink(LOGFILE);
+   Crash(CloseLogPinned);
+
+   PF_Manager pfm;
+   if ((rc = pfm.OpenLog(LOGFILE)) ||
+         (rc = pfm.OpenFile(FILE1, fh)) ||
+         (rc = CheckPages(fh, NUM_PAGES, 3, 3)) ||
+         (rc = pfm.CloseFile(fh)) ||
+         (rc = pfm.DestroyFile(FILE1)) ||
+         (rc = pfm.CloseLog()))
+      return (rc);
+
+   // Return ok
+   return (0);
+}
+
+int main()
+{
+   RC rc;
+
+   // Write out initial starting message
+   cerr.flush();
+   cout.flush();
+   cout << "Starting PF write-ahead log test.\n";
+   cout.flush();
+
+   // Only the log may hold the pages at the crash, so keep the
+   // background writer and the checkpointer from writing them
+   setenv("REDBASE_WAL", "on", 1);
+   setenv("REDBASE_BGWRITER_HIGH", "0", 1);
+   setenv("REDBASE_CHECKPOINT_TIMEOUT", "0", 1);
+
+   cout << "Recovering committed pages\n";
+   if ((rc = TestCommitted(LOG_INTACT)))
+      goto err;
+   cout << "Recovering with the last record cut short\n";
+   if ((rc = TestCommitted(LOG_TORN)))
+      goto err;
+   cout << "Recovering with a bad checksum on the last record\n";
+   if ((rc = TestCommitted(LOG_CHECKSUM)))
+      goto err;
+   cout << "Recovering a file destroyed and created again\n";
+   if ((rc = TestRecreated()))
+      goto err;
+   cout << "Recovering a file that could not be written back\n";
+   if ((rc = TestNotWrittenBack()))
+      goto err;
+
+   unlink(LOGFILE);
+
+   // Write ending message and exit
+   cout << "Ending PF write-ahead log test.\n\n";
+
+   return (0);
+
+err:
+   PF_PrintError(rc);
+   return (1);
+}
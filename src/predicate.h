@@ -0,0 +1,102 @@
+//
+// predicate.h
+//
+
+// Comparison kernels shared by the RM and IX components.  A scan picks
+// the kernel for its attribute type and operator once, when it is
+// opened, and calls it for every record or key:
+//
+//    bool kernel(const void *attr, const void *value, int length);
+//
+// compares the attribute at attr, which needs no alignment, with value.
+// INT and FLOAT attributes are loaded in place, so the type fixes their
+// length; strings compare like the strings of at most length characters
+// they hold, and take the length as an argument.
+
+#ifndef PREDICATE_H
+#define PREDICATE_H
+
+#include <cstring>
+#include "redbase.h"
+
+typedef bool (*PredKernel)(const void *attr, const void *value, int length);
+
+//
+// PredCompare: a op b, for an operator known at compile time
+//
+template <CompOp op, typename T>
+inline bool PredCompare(T a, T b)
+{
+    switch (op) {
+        case EQ_OP: return a == b;
+        case NE_OP: return a != b;
+        case LT_OP: return a < b;
+        case GT_OP: return a > b;
+        case LE_OP: return a <= b;
+        case GE_OP: return a >= b;
+        default:    return true;
+    }
+}
+
+//
+// PredLoad: the value of type T at p, which may be unaligned
+//
+template <typename T>
+inline T PredLoad(const void *p)
+{
+    T v;
+    memcpy(&v, p, sizeof(T));
+    return v;
+}
+
+//
+// Kernels
+//
+template <CompOp op, typename T>
+bool PredNumber(const void *attr, const void *value, int length)
+{
+    return PredCompare<op>(PredLoad<T>(attr), PredLoad<T>(value));
+}
+
+template <CompOp op>
+bool PredString(const void *attr, const void *value, int length)
+{
+    return PredCompare<op>(strncmp((const char *) attr,
+                                   (const char *) value, length), 0);
+}
+
+inline bool PredTrue(const void *attr, const void *value, int length)
+{
+    return true;
+}
+
+template <CompOp op>
+inline PredKernel PredKernelFor(AttrType type)
+{
+    switch (type) {
+        case INT:    return &PredNumber<op, int>;
+        case FLOAT:  return &PredNumber<op, float>;
+        case STRING: return &PredString<op>;
+        default:     return NULL;
+    }
+}
+
+//
+// PredGetKernel: the kernel for attributes of the given type compared
+// by op; PredTrue for NO_OP, NULL if type or op is not valid
+//
+inline PredKernel PredGetKernel(AttrType type, CompOp op)
+{
+    switch (op) {
+        case NO_OP: return &PredTrue;
+        case EQ_OP: return PredKernelFor<EQ_OP>(type);
+        case NE_OP: return PredKernelFor<NE_OP>(type);
+        case LT_OP: return PredKernelFor<LT_OP>(type);
+        case GT_OP: return PredKernelFor<GT_OP>(type);
+        case LE_OP: return PredKernelFor<LE_OP>(type);
+        case GE_OP: return PredKernelFor<GE_OP>(type);
+        default:    return NULL;
+    }
+}
+
+#endif
@@ -19,6 +19,8 @@
 #include "ix.h"
 #include "sm.h"
 
+class QL_Op;
+
 //
 // QL_Manager: query language (DML)
 //
@@ -76,6 +78,11 @@ private:
                 const std::vector<DataAttrInfo> &attributes);
     static int findAttr(const char* relName, const char *attrName, 
                 const std::vector<DataAttrInfo> &attributes);
+    static RC collectRecords(QL_Op &scanner, int nConditions, 
+                const Condition conditions[], 
+                const std::vector<DataAttrInfo> &attributes,
+                std::vector<std::vector<char> > &records, 
+                std::vector<RID> &rids);
     void printPlanHeader(const char *operation, const char* relname);
     void printPlanFooter();
 };
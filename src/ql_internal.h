@@ -30,12 +30,21 @@ public:
     virtual RC Next(std::vector<char> &rec) = 0;
     // only the table scans implement this
     virtual RC Next(std::vector<char> &rec, RID &rid) {return QL_EOF;}
+    // Point pData at the next record, valid until the next call to the
+    // operator.  The table scans give the record in the buffer page,
+    // other operators a copy in viewRec.
+    virtual RC NextView(const char *&pData) {
+        RC rc = Next(viewRec);
+        if (rc == OK_RC) pData = &viewRec[0];
+        return rc;
+    }
     virtual RC Close() = 0; 
     virtual RC Reset() = 0;
     std::vector<DataAttrInfo> attributes;
     OpType opType;
     std::stringstream desc;
     QL_Op* parent;
+    std::vector<char> viewRec;
 };
 
 
@@ -68,13 +77,19 @@ public:
 	RC Open();
 	RC Next(std::vector<char> &rec);
 	RC Next(std::vector<char> &rec, RID &rid);
+	RC NextView(const char *&pData);
 	RC Reset();
 	RC Close();
 private:
+	// move to the next record of the batch, getting the next batch
+	// when it is used up
+	RC NextInBatch();
 	std::string relName;
 	RM_Manager *rmm;
 	IX_Manager *ixm;
 	RM_FileHandle fh;
+	RM_RecordBatch batch;
+	int batchPos;
 	AttrType type;
 	int len;
 	int offset;
@@ -95,6 +110,7 @@ public:
 	RC Open();
 	RC Next(std::vector<char> &rec);
 	RC Next(std::vector<char> &rec, RID &rid);
+	RC NextView(const char *&pData);
 	RC Reset();
 	RC Reset(void* value);
 	RC Close();
@@ -105,6 +121,7 @@ private:
 	RM_Manager *rmm;
 	IX_Manager *ixm;
 	RM_FileHandle fh;
+	RM_RecordView view;		// pins the record of NextView only
 	IX_IndexHandle ih;
 	IX_IndexScan is;
 	CompOp cmp;
@@ -126,6 +143,7 @@ public:
 	~QL_Condition();
 	RC Open();
 	RC Next(std::vector<char> &rec);
+	RC NextView(const char *&pData);
 	RC Reset();
 	RC Close();
 	CompOp getOp();
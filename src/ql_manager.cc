@@ -206,6 +206,8 @@ RC QL_Manager::Select(int nSelAttrs, const RelAttr selAttrs[],
     }
     // Step 6 - Push Sort
     optimizer.pushSort(root);
+    // Step 7 - Divide work memory among the sorts and merge joins
+    optimizer.grantWorkMem(root);
 
     // print the query plan
     if (smm->SHOW_ALL_PLANS) {
@@ -415,7 +417,7 @@ RC QL_Manager::Delete(const char *relName,
         
         dinfo = &attributes[attrInd];
         scanner.reset(new QL_FileScan(rmm, ixm, relName, attrInd,
-            cmp, value, NO_HINT, attributes));
+            cmp, value, SEQUENTIAL_ONCE, attributes));
         if (bQueryPlans) {
             cout<<"FILE SCAN ON "<<dinfo->attrName<<endl;
         }
@@ -432,29 +434,26 @@ RC QL_Manager::Delete(const char *relName,
         }
     }
     if (bQueryPlans) printPlanFooter();
-    RID rid;
+    // collect the records that satisfy all conditions before deleting
+    // any, an index scan would not see the entries deleted through
+    // the other handle of its index
     vector<char> data;
-    bool isValid = false;
-    QL_ErrorForward(scanner->Open());
+    vector<vector<char> > records;
+    vector<RID> rids;
+    QL_ErrorForward(collectRecords(*scanner, nConditions, conditions, 
+        attributes, records, rids));
     DataAttrInfo* attrs = &attributes[0];
     Printer p(attrs, relation.num_attr);
     p.PrintHeader(cout);
-    while (scanner->Next(data, rid) == OK_RC) {
-        isValid = true;
-        for (int i = 0; i < nConditions; i++) {
-            if (!evalCondition((void*) &data[0], conditions[i], attributes)) {
-                isValid = false;
-                break;
-            }
-        }
-        if (isValid) {
-            QL_ErrorForward(relh.DeleteRec(rid));
-            for (unsigned int i = 0; i < ind.size(); i++) {
-                QL_ErrorForward(ihandles[ind[i]].DeleteEntry(
-                    (void*) &data[attributes[ind[i]].offset], rid));
-            }
-            p.Print(cout, &data[0]);
+    for (size_t r = 0; r < records.size(); r++) {
+        data.swap(records[r]);
+        RID &rid = rids[r];
+        QL_ErrorForward(relh.DeleteRec(rid));
+        for (unsigned int i = 0; i < ind.size(); i++) {
+            QL_ErrorForward(ihandles[ind[i]].DeleteEntry(
+                (void*) &data[attributes[ind[i]].offset], rid));
         }
+        p.Print(cout, &data[0]);
     }
     p.PrintFooter(cout);
     ////////////////////////////////////////////////////////////
@@ -466,7 +465,6 @@ RC QL_Manager::Delete(const char *relName,
         if (access(fname, F_OK) == 0) unlink(fname);
     }
     ///////////////////////////////////////////////////////////
-    QL_ErrorForward(scanner->Close());
     // close the relation and index files
     QL_ErrorForward(rmm->CloseFile(relh));
     for (size_t i = 0; i < ind.size(); i++) {
@@ -557,7 +555,7 @@ RC QL_Manager::Update(const char *relName,
         if (!found) cmp = NO_OP;
         dinfo = &attributes[attrInd];
         scanner.reset(new QL_FileScan(rmm, ixm, relName, attrInd, 
-            cmp, value, NO_HINT, attributes));
+            cmp, value, SEQUENTIAL_ONCE, attributes));
         if (bQueryPlans) {
             cout<<"FILE SCAN ON "<<dinfo->attrName<<endl;
         }
@@ -582,61 +580,55 @@ RC QL_Manager::Update(const char *relName,
         QL_ErrorForward(ixm->OpenIndex(relName, 
                  attributes[upInd].indexNo, update_indh));
     }
-    // fetch records and check if for records that satisfy all conditions
-    RID rid;
+    // fetch the records that satisfy all conditions before updating
+    // any, so that the scan does not see the updated ones
     vector<char> data;
-    bool isValid = false;
-    QL_ErrorForward(scanner->Open());
+    vector<vector<char> > records;
+    vector<RID> rids;
+    QL_ErrorForward(collectRecords(*scanner, nConditions, conditions, 
+        attributes, records, rids));
     DataAttrInfo* attrs = &attributes[0];
     Printer p(attrs, relation.num_attr);
     p.PrintHeader(cout);
-    while (scanner->Next(data, rid) == OK_RC) {
-        isValid = true;
-        for (int i = 0; i < nConditions; i++) {
-            if (!evalCondition((void*) &data[0], conditions[i], attributes)) {
-                isValid = false;
-                break;
+    for (size_t r = 0; r < records.size(); r++) {
+        data.swap(records[r]);
+        RID &rid = rids[r];
+        // the record satisfies all conditions, update it
+        RM_Record updatedRec;
+        updatedRec.rid = rid;
+        updatedRec.record = new char[attributes.back().offset + 
+                                        attributes.back().attrLength];
+        memcpy(updatedRec.record, &data[0], attributes.back().offset + 
+                                        attributes.back().attrLength);
+        updatedRec.bIsAllocated = 1;
+
+        void *updatePos = (void*) (updatedRec.record + 
+                                attributes[upInd].offset);
+        // update the contents
+        if (bIsValue) {
+            memcpy(updatePos, rhsValue.data, attributes[upInd].attrLength);
+        }
+        else {
+            int j = findAttr(0, rhsRelAttr.attrName, attributes);
+            void *sourcePos = (void*) &data[attributes[j].offset];
+            if (attributes[upInd].attrLength < attributes[j].attrLength) {
+                memcpy(updatePos, sourcePos, attributes[upInd].attrLength);
+            } else {
+                memset(updatePos, 0, attributes[upInd].attrLength);
+                memcpy(updatePos, sourcePos, attributes[j].attrLength);
             }
         }
-        if (isValid) {
-            // the record satisfies all conditions, update it
-            RM_Record updatedRec;
-            updatedRec.rid = rid;
-            updatedRec.record = new char[attributes.back().offset + 
-                                            attributes.back().attrLength];
-            memcpy(updatedRec.record, &data[0], attributes.back().offset + 
-                                            attributes.back().attrLength);
-            updatedRec.bIsAllocated = 1;
-
-            void *updatePos = (void*) (updatedRec.record + 
-                                    attributes[upInd].offset);
-            // update the contents
-            if (bIsValue) {
-                memcpy(updatePos, rhsValue.data, attributes[upInd].attrLength);
-            }
-            else {
-                int j = findAttr(0, rhsRelAttr.attrName, attributes);
-                void *sourcePos = (void*) &data[attributes[j].offset];
-                if (attributes[upInd].attrLength < attributes[j].attrLength) {
-                    memcpy(updatePos, sourcePos, attributes[upInd].attrLength);
-                } else {
-                    memset(updatePos, 0, attributes[upInd].attrLength);
-                    memcpy(updatePos, sourcePos, attributes[j].attrLength);
-                }
-            }
-            // update the relation
-            QL_ErrorForward(relh.UpdateRec(updatedRec));
-            // update the index if exists
-            if (attributes[upInd].indexNo >= 0) {
-                QL_ErrorForward(update_indh.DeleteEntry((void*) 
-                                    &data[attributes[upInd].offset], rid));
-                QL_ErrorForward(update_indh.InsertEntry(updatePos, rid));
-            }
-            p.Print(cout, updatedRec.record);
+        // update the relation
+        QL_ErrorForward(relh.UpdateRec(updatedRec));
+        // update the index if exists
+        if (attributes[upInd].indexNo >= 0) {
+            QL_ErrorForward(update_indh.DeleteEntry((void*) 
+                                &data[attributes[upInd].offset], rid));
+            QL_ErrorForward(update_indh.InsertEntry(updatePos, rid));
         }
+        p.Print(cout, updatedRec.record);
     }
     p.PrintFooter(cout);
-    SM_ErrorForward(scanner->Close());
     // close the relation and index files
     SM_ErrorForward(rmm->CloseFile(relh));
     if (attributes[upInd].indexNo >= 0) {
@@ -868,6 +860,33 @@ int QL_Manager::findAttr(const char* relName, const char* attrName,
     return -1;
 }
 
+/*  Run the scanner to the end and collect the records that satisfy
+    all conditions, along with their rids
+*/
+RC QL_Manager::collectRecords(QL_Op &scanner, int nConditions, 
+                    const Condition conditions[], 
+                    const vector<DataAttrInfo> &attributes,
+                    vector<vector<char> > &records, vector<RID> &rids) {
+    RC rc;
+    RID rid;
+    vector<char> data;
+    if ((rc = scanner.Open())) return rc;
+    while (scanner.Next(data, rid) == OK_RC) {
+        bool isValid = true;
+        for (int i = 0; i < nConditions; i++) {
+            if (!evalCondition((void*) &data[0], conditions[i], attributes)) {
+                isValid = false;
+                break;
+            }
+        }
+        if (isValid) {
+            records.push_back(data);
+            rids.push_back(rid);
+        }
+    }
+    return scanner.Close();
+}
+
 void QL_Manager::printPlanHeader(const char* operation, const char* relname) {
     if (!smm->SHOW_ALL_PLANS) {
         cout << "********************************************\n";
@@ -67,6 +67,7 @@ RC QL_FileScan::Open() {
 	QL_ErrorForward(rmm->OpenFile(relName.c_str(), fh));
 	QL_ErrorForward(fs.OpenScan(fh, type, len,
             offset, cmp, value, hint));
+	batchPos = 0;
 	isOpen = true;
 	return OK_RC;
 }
@@ -74,40 +75,55 @@ RC QL_FileScan::Open() {
 RC QL_FileScan::Next(vector<char> &rec) {
 	RC WARN = QL_EOF, ERR = QL_FILESCAN_ERR;
 	if (!isOpen) return WARN;
-	RM_Record record;
-	char *temp;
 	rec.resize(attributes.back().offset + attributes.back().attrLength, 0);
-	QL_ErrorForward(fs.GetNextRec(record));
-	QL_ErrorForward(record.GetData(temp));
-	memcpy(&rec[0], temp, rec.size());
+	QL_ErrorForward(NextInBatch());
+	memcpy(&rec[0], batch.GetData(batchPos), rec.size());
 	return OK_RC;
 }
 
 RC QL_FileScan::Next(vector<char> &rec, RID &rid) {
 	RC WARN = QL_EOF, ERR = QL_FILESCAN_ERR;
 	if (!isOpen) return WARN;
-	RM_Record record;
-	char *temp;
 	rec.resize(attributes.back().offset + attributes.back().attrLength, 0);
-	QL_ErrorForward(fs.GetNextRec(record));
-	QL_ErrorForward(record.GetData(temp));
-	QL_ErrorForward(record.GetRid(rid));
-	memcpy(&rec[0], temp, rec.size());
+	QL_ErrorForward(NextInBatch());
+	memcpy(&rec[0], batch.GetData(batchPos), rec.size());
+	rid = batch.GetRid(batchPos);
+	return OK_RC;
+}
+
+// The record stays in the buffer page, pinned by the batch
+RC QL_FileScan::NextView(const char *&pData) {
+	RC WARN = QL_EOF, ERR = QL_FILESCAN_ERR;
+	if (!isOpen) return WARN;
+	QL_ErrorForward(NextInBatch());
+	pData = batch.GetData(batchPos);
+	return OK_RC;
+}
+
+RC QL_FileScan::NextInBatch() {
+	RC WARN = QL_EOF, ERR = QL_FILESCAN_ERR;
+	if (++batchPos >= batch.GetCount()) {
+		QL_ErrorForward(fs.GetNextBatch(batch));
+		batchPos = 0;
+	}
 	return OK_RC;
 }
 
 RC QL_FileScan::Reset() {
 	RC WARN = QL_FILESCAN_WARN, ERR = QL_FILESCAN_ERR;
 	if (!isOpen) return WARN;
+	QL_ErrorForward(batch.Release());
 	QL_ErrorForward(fs.CloseScan());
 	QL_ErrorForward(fs.OpenScan(fh, type, len,
             offset, cmp, value, hint));
+	batchPos = 0;
 	return OK_RC;
 }
 
 RC QL_FileScan::Close() {
 	RC WARN = QL_FILESCAN_WARN, ERR = QL_FILESCAN_ERR;
 	if (!isOpen) return WARN;
+	QL_ErrorForward(batch.Release());
 	QL_ErrorForward(fs.CloseScan());
 	//QL_ErrorForward(rmm->CloseFile(fh));
 	isOpen = false;
@@ -156,28 +172,42 @@ RC QL_IndexScan::Next(vector<char> &rec) {
 	RC WARN = QL_EOF, ERR = QL_IXSCAN_ERR;
 	if (!isOpen || seenEOF) return WARN;
 	RID rid;
-	RM_Record record;
-	char *temp;
+	const char *temp;
 	rec.resize(attributes.back().offset + attributes.back().attrLength, 0);
 	QL_ErrorForward(is.GetNextEntry(rid));
-	QL_ErrorForward(fh.GetRec(rid, record));
-	QL_ErrorForward(record.GetData(temp));
+	QL_ErrorForward(fh.GetRec(rid, view));
+	QL_ErrorForward(view.GetData(temp));
 	memcpy(&rec[0], temp, attributes.back().offset + 
 		attributes.back().attrLength);
+	// the copy is made, so do not keep the page pinned
+	QL_ErrorForward(view.Release());
 	return OK_RC;
 }
 
 RC QL_IndexScan::Next(vector<char> &rec, RID &rid) {
 	RC WARN = QL_EOF, ERR = QL_IXSCAN_ERR;
 	if (!isOpen || seenEOF) return WARN;
-	RM_Record record;
-	char *temp;
+	const char *temp;
 	rec.resize(attributes.back().offset + attributes.back().attrLength, 0);
 	QL_ErrorForward(is.GetNextEntry(rid));
-	QL_ErrorForward(fh.GetRec(rid, record));
-	QL_ErrorForward(record.GetData(temp));
+	QL_ErrorForward(fh.GetRec(rid, view));
+	QL_ErrorForward(view.GetData(temp));
 	memcpy(&rec[0], temp, attributes.back().offset + 
 		attributes.back().attrLength);
+	// the copy is made, so do not keep the page pinned
+	QL_ErrorForward(view.Release());
+	return OK_RC;
+}
+
+// The record stays in the buffer page, pinned by view until the next
+// call or Close
+RC QL_IndexScan::NextView(const char *&pData) {
+	RC WARN = QL_EOF, ERR = QL_IXSCAN_ERR;
+	if (!isOpen || seenEOF) return WARN;
+	RID rid;
+	QL_ErrorForward(is.GetNextEntry(rid));
+	QL_ErrorForward(fh.GetRec(rid, view));
+	QL_ErrorForward(view.GetData(pData));
 	return OK_RC;
 }
 
@@ -204,6 +234,7 @@ RC QL_IndexScan::Close() {
 	RC WARN = QL_IXSCAN_WARN, ERR = QL_IXSCAN_ERR;
 	if (!isOpen) return WARN;
 	if (!seenEOF) QL_ErrorForward(is.CloseScan());
+	QL_ErrorForward(view.Release());
 	QL_ErrorForward(ixm->CloseIndex(ih));
 	QL_ErrorForward(rmm->CloseFile(fh));
 	isOpen = false;
@@ -251,9 +282,19 @@ RC QL_Condition::Next(vector<char> &rec) {
 	RC WARN = QL_EOF, ERR = QL_COND_ERR;
 	if (!isOpen) return WARN;
 	rec.resize(attributes.back().offset + attributes.back().attrLength, 0);
+	const char *data;
+	QL_ErrorForward(NextView(data));
+	memcpy(&rec[0], data, rec.size());
+	return OK_RC;
+}
+
+// Records are tested in place, so those that fail are never copied
+RC QL_Condition::NextView(const char *&pData) {
+	RC WARN = QL_EOF, ERR = QL_COND_ERR;
+	if (!isOpen) return WARN;
 	do {
-		QL_ErrorForward(child->Next(rec));
-	} while(!QL_Manager::evalCondition((void*) &rec[0], *cond, attributes));
+		QL_ErrorForward(child->NextView(pData));
+	} while(!QL_Manager::evalCondition((void*) pData, *cond, attributes));
 	return OK_RC;
 }
 
@@ -377,8 +418,8 @@ RC QL_Projection::Next(vector<char> &rec) {
 	RC WARN = QL_EOF, ERR = QL_PROJ_ERR;
 	if (!isOpen) return WARN;
 	rec.resize(attributes.back().offset + attributes.back().attrLength, 0);
-	vector<char> temp(inputAttr.back().offset + inputAttr.back().attrLength);
-	QL_ErrorForward(child->Next(temp));
+	const char *temp;
+	QL_ErrorForward(child->NextView(temp));
 	int st = 0, sz = 0, curr = 0;
 	for (unsigned int i = 0; i < attributes.size(); i++) {
 		st = inputAttr[this->position[i]].offset;
@@ -458,8 +499,8 @@ RC QL_PermDup::Next(vector<char> &rec) {
 	RC WARN = QL_EOF, ERR = QL_PERMDUP_ERR;
 	if (!isOpen) return WARN;
 	rec.resize(attributes.back().offset + attributes.back().attrLength, 0);
-	vector<char> temp(inputAttr.back().offset + inputAttr.back().attrLength);
-	QL_ErrorForward(child->Next(temp));
+	const char *temp;
+	QL_ErrorForward(child->NextView(temp));
 	int st = 0, sz = 0, curr = 0;
 	for (unsigned int i = 0; i < attributes.size(); i++) {
 		st = inputAttr[this->position[i]].offset;
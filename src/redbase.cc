@@ -33,6 +33,11 @@ int main(int argc, char *argv[])
 
     dbname = argv[1];
 
+    // Settings for this database override the default configuration
+    char confName[MAXNAME + 20];
+    snprintf(confName, sizeof(confName), "%s/redbase.conf", dbname);
+    PF_LoadConfig(confName);
+
     PF_Manager pfm;
     RM_Manager rmm(pfm);
     IX_Manager ixm(pfm);
@@ -76,12 +76,23 @@ enum CompOp {
 //
 enum ClientHint {
     NO_HINT,          // default value
-    KEEP_PAGES
+    KEEP_PAGES,
+    SEQUENTIAL_ONCE,
+    RANDOM,
+    HOT_METADATA,
+    TEMP
 };
 /*
 Hint meaning-
 1. NO_HINT - Unpin and flush after every update
 2. KEEP_PAGES - Keep the page pinned, it will be needed soon
+3. SEQUENTIAL_ONCE - The pages are read in order and not again, as by a
+   one-off scan.  Pages brought into the buffer go to the cold end.
+4. RANDOM - The pages are read in no order.  No readahead.
+5. HOT_METADATA - Headers, catalogs and index roots.  Such pages are
+   the last to be replaced while they are in the buffer.
+6. TEMP - Pages of temporary data, such as sorted runs, that are read
+   once more at most.  Cold, like SEQUENTIAL_ONCE.
 */
 
 
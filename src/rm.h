@@ -60,6 +60,76 @@ private:
     int bIsAllocated;
 };
 
+//
+// RM_RecordView: a record read in place, in the buffer page holding it
+//
+// The view keeps its page pinned until it is released, moved to another
+// page by the next GetRec or GetNextRec, or destroyed.  It must be
+// released before the file is closed.  The data must not be changed.
+//
+class RM_RecordView {
+    friend class RM_FileHandle;
+    friend class RM_FileScan;
+    friend class RM_RecordBatch;
+public:
+    RM_RecordView ();
+    ~RM_RecordView();                       // Releases the page
+
+    // Sets pData to the record contents, valid while the view holds it
+    RC GetData  (const char *&pData) const;
+    RC GetRid   (RID &rid) const;           // RID of the record
+    int GetLength() const;                  // length of the record
+
+    RC Release  ();                         // Unpin the page
+private:
+    RM_RecordView (const RM_RecordView &);  // Not copyable
+    RM_RecordView &operator= (const RM_RecordView &);
+    // Take over the pin of page pnum of a file, releasing the old page
+    RC Hold(const PF_FileHandle &pf_fh, PageNum pnum, char *page);
+    // True if the view pins page pnum of the file
+    bool Holds(const PF_FileHandle &pf_fh, PageNum pnum) const {
+        return this->pf_fh == &pf_fh && this->pnum == pnum;
+    }
+    const PF_FileHandle *pf_fh;     // file of the pinned page, 0 if none
+    PageNum pnum;                   // pinned page
+    char *page;                     // its data
+    char *record;                   // the record, within page
+    int length;
+    RID rid;
+};
+
+//
+// RM_RecordBatch: records of one page read in place by GetNextBatch
+//
+// Holds up to a given number of records, all from the same page, which
+// stays pinned as for RM_RecordView.
+//
+#define RM_BATCH_SIZE 256           // default records in a batch
+
+class RM_RecordBatch {
+    friend class RM_FileScan;
+public:
+    RM_RecordBatch (int capacity = RM_BATCH_SIZE);
+    ~RM_RecordBatch();                      // Releases the page
+
+    int GetCount () const { return count; } // number of records
+    // Record i of the batch, 0 <= i < GetCount()
+    const char *GetData(int i) const {
+        return view.page + first_record_offset + slots[i] * view.length;
+    }
+    RID GetRid   (int i) const { return RID(view.pnum, slots[i]); }
+
+    RC Release   ();                        // Unpin the page
+private:
+    RM_RecordBatch (const RM_RecordBatch &); // Not copyable
+    RM_RecordBatch &operator= (const RM_RecordBatch &);
+    RM_RecordView view;             // pin of the page
+    SlotNum *slots;                 // slots of the records
+    int capacity;
+    int count;
+    int first_record_offset;
+};
+
 //
 // RM_FileHandle: RM File interface
 //
@@ -72,6 +142,8 @@ public:
 
     // Given a RID, return the record
     RC GetRec     (const RID &rid, RM_Record &rec) const;
+    // Same, in place.  The view keeps the page pinned.
+    RC GetRec     (const RID &rid, RM_RecordView &view) const;
 
     RC InsertRec  (const char *pData, RID &rid);       // Insert a new record
 
@@ -94,6 +166,8 @@ private:
     // Functions for updating records
     RC FetchRecord(char *page, char *buffer, int slot) const;
     RC DumpRecord(char *page, const char *buffer, int slot);
+    // Mark a page dirty after a slot was filled or emptied
+    RC LogChange(int pnum, int slot, bool hasRecord = true);
 };
 
 //
@@ -112,6 +186,11 @@ public:
                   void       *value,
                   ClientHint pinHint = NO_HINT); // Initialize a file scan
     RC GetNextRec(RM_Record &rec);               // Get next matching record
+    RC GetNextRec(RM_RecordView &view);          // Same, in place; the view
+                                                 // is released at the end
+    // Fill batch with the next matching records of the current page, or
+    // of the next page that has any
+    RC GetNextBatch(RM_RecordBatch &batch);
     RC CloseScan ();                             // Close the scan
 private:
     const RM_FileHandle *rm_fh;
@@ -127,20 +206,20 @@ private:
     int num_recs;
     int current;
     char *bitmap_copy;
+    int word_idx;                  // word of bitmap_copy being read
+    unsigned long long cur_word;   // its slots not yet seen
     PF_PageHandle pf_ph;
-    // pointer to a member function
-    bool (RM_FileScan::*comp)(void* attr);
-    
-    // Functions for comparison
+    // comparison kernel of the scan (a PredKernel, see predicate.h)
+    bool (*comp)(const void *attr, const void *value, int length);
+    // filter of whole pages, if the comparison has one (an RM_PageFilter,
+    // see rm_internal.h); comp is then not called
+    void (*filter)(const char *attrs, int stride, int capacity,
+                   const void *value, char *bitmap);
+
     void buffer(void *ptr, char* buff);
-    bool no_op(void* attr);
-    bool eq_op(void* attr);
-    bool ne_op(void* attr);
-    bool lt_op(void* attr);
-    bool gt_op(void* attr);
-    bool le_op(void* attr);
-    bool ge_op(void* attr);
     RC GiveNewPage(char *&data);
+    // Find up to max next matching slots of the current page
+    RC NextMatches(char *data, SlotNum *slots, int max, int &count);
 };
 
 //
@@ -148,20 +227,26 @@ private:
 //
 class RM_Manager {
     friend class QL_Manager;        // for accessing pf manager
+    friend class SM_Manager;        // for the buffer dump
 public:
     RM_Manager    (PF_Manager &pfm);
     ~RM_Manager   ();
 
-    RC CreateFile (const char *fileName, int recordSize);
+    // pageSize is passed on to PF_Manager::CreateFile (0 for the
+    // "page_size" setting)
+    RC CreateFile (const char *fileName, int recordSize, int pageSize = 0);
     RC DestroyFile(const char *fileName);
-    RC OpenFile   (const char *fileName, RM_FileHandle &fileHandle);
+    // ioMode is passed on to PF_Manager::OpenFile; a file opened
+    // PF_IO_MMAP can only be scanned
+    RC OpenFile   (const char *fileName, RM_FileHandle &fileHandle,
+                   int ioMode = PF_IO_DEFAULT);
 
     RC CloseFile  (RM_FileHandle &fileHandle);
     
 private:
     PF_Manager *pf_manager;
     // Function to calculate number of records per page
-    int numRecordsPerPage(int recordSize);
+    int numRecordsPerPage(int recordSize, int pageSize);
 };
 
 
@@ -0,0 +1,269 @@
+//
+// File:        rm_bench.cc
+// Description: Microbenchmark of the predicate kernels of predicate.h
+//
+// Runs every comparison kernel, one for each attribute type and
+// operator, over records laid out the way an RM page holds them: the
+// attribute at a fixed, unaligned offset of records of RECORD_LENGTH
+// bytes.  For each it reports the cycles and nanoseconds per record and
+// the fraction of records that matched, and the same for the way
+// RM_FileScan used to compare, copying each attribute into a buffer
+// first and switching on the type and operator.
+//
+// Then it times the page filters of RM_FileScan (rm_pagefilter.cc) for
+// INT and FLOAT attributes, with the records taken PAGE_SLOTS to a page
+// and every slot taken, once for each setting of "simd".
+//
+// Cycles are read from the time stamp counter, so they are only given
+// on x86; elsewhere the column shows 0.
+//
+// Usage: rm_bench [records]
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <sys/time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "redbase.h"
+#include "predicate.h"
+#include "rm.h"
+#include "rm_internal.h"
+
+using namespace std;
+
+//
+// Defines
+//
+#define RECORD_LENGTH   32        // bytes per record
+#define ATTR_OFFSET     3         // offset of the attribute in a record
+#define STRING_LENGTH   12        // length of the STRING attribute
+#define NUM_ROUNDS      20        // passes over the records per kernel
+#define PAGE_SLOTS      127       // slots of a page for the page filters
+
+static int numRecords = 1 << 16;  // records per pass
+
+//
+// Cycles
+//
+// Desc: Value of the time stamp counter, 0 where there is none
+//
+static unsigned long long Cycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+   return (__rdtsc());
+#else
+   return (0);
+#endif
+}
+
+//
+// CopyCompare
+//
+// Desc: Compare the way RM_FileScan did before the kernels: copy the
+//       attribute into a null-terminated buffer, then switch on the type
+//       and the operator
+//
+static bool CopyCompare(AttrType type, CompOp op, const void *attr,
+                        const void *value, int length)
+{
+   char buf[length + 1];
+   buf[length] = '\0';
+   memcpy(buf, attr, length);
+   int cmp;
+   switch (type) {
+   case INT:
+      cmp = *(int *)buf < *(int *)value ? -1 : *(int *)buf > *(int *)value;
+      break;
+   case FLOAT:
+      cmp = *(float *)buf < *(float *)value ? -1
+         : *(float *)buf > *(float *)value;
+      break;
+   default:
+      cmp = string(buf).compare(string((const char *)value));
+      break;
+   }
+   switch (op) {
+   case EQ_OP: return (cmp == 0);
+   case NE_OP: return (cmp != 0);
+   case LT_OP: return (cmp < 0);
+   case GT_OP: return (cmp > 0);
+   case LE_OP: return (cmp <= 0);
+   case GE_OP: return (cmp >= 0);
+   default:    return (true);
+   }
+}
+
+//
+// FillRecords
+//
+// Desc: Fill the records with random attributes of the given type; the
+//       value compared with is in the middle of their range
+// Out:  records - the records
+//       value - the value to compare with
+//
+static void FillRecords(AttrType type, vector<char> &records,
+                        vector<char> &value)
+{
+   records.assign((size_t)numRecords * RECORD_LENGTH, 0);
+   value.assign(STRING_LENGTH + 1, 0);
+   srand(1);
+   for (int i = 0; i < numRecords; i++) {
+      char *attr = &records[(size_t)i * RECORD_LENGTH + ATTR_OFFSET];
+      if (type == INT) {
+         int v = rand() % 1000;
+         memcpy(attr, &v, sizeof(v));
+      } else if (type == FLOAT) {
+         float v = (rand() % 1000) / 10.0f;
+         memcpy(attr, &v, sizeof(v));
+      } else {
+         // Strings of 1 to STRING_LENGTH letters from a small alphabet,
+         // so that some share long prefixes
+         int n = 1 + rand() % STRING_LENGTH;
+         for (int j = 0; j < n; j++)
+            attr[j] = 'a' + rand() % 4;
+      }
+   }
+   if (type == INT) {
+      int v = 500;
+      memcpy(&value[0], &v, sizeof(v));
+   } else if (type == FLOAT) {
+      float v = 50.0f;
+      memcpy(&value[0], &v, sizeof(v));
+   } else
+      strcpy(&value[0], "bbaa");
+}
+
+//
+// RunKernel
+//
+// Desc: Time NUM_ROUNDS passes of one kernel over the records, or of
+//       CopyCompare if kernel is NULL, and print the result
+//
+static void RunKernel(const char *typeName, AttrType type, int length,
+                      const char *opName, CompOp op, PredKernel kernel,
+                      const vector<char> &records,
+                      const vector<char> &value)
+{
+   struct timeval start, end;
+   long matches = 0;
+
+   gettimeofday(&start, NULL);
+   unsigned long long startCycles = Cycles();
+   for (int r = 0; r < NUM_ROUNDS; r++) {
+      const char *attr = &records[ATTR_OFFSET];
+      for (int i = 0; i < numRecords; i++, attr += RECORD_LENGTH)
+         matches += kernel ? kernel(attr, &value[0], length)
+            : CopyCompare(type, op, attr, &value[0], length);
+   }
+   unsigned long long cycles = Cycles() - startCycles;
+   gettimeofday(&end, NULL);
+
+   double total = (double)numRecords * NUM_ROUNDS;
+   double elapsed = (end.tv_sec - start.tv_sec)
+      + (end.tv_usec - start.tv_usec) / 1e6;
+   cout << setw(8) << typeName << setw(6) << opName
+        << setw(8) << (kernel ? "kernel" : "copy")
+        << setw(10) << fixed << setprecision(2) << cycles / total
+        << setw(10) << elapsed * 1e9 / total
+        << setw(10) << setprecision(3) << matches / total << "\n";
+}
+
+//
+// RunFilter
+//
+// Desc: Time NUM_ROUNDS passes of the page filter for type and op, with
+//       the "simd" setting given, over the records, and print the result
+//
+static void RunFilter(const char *typeName, AttrType type, const char *opName,
+                      CompOp op, const char *simd,
+                      const vector<char> &records,
+                      const vector<char> &value)
+{
+   struct timeval start, end;
+   long matches = 0;
+   int numPages = numRecords / PAGE_SLOTS;
+   int bitmapSize = (PAGE_SLOTS + 7) / 8;
+   vector<char> bitmap(bitmapSize);
+
+   setenv("REDBASE_SIMD", simd, 1);
+   RM_PageFilter filter = RM_GetPageFilter(type, op);
+
+   gettimeofday(&start, NULL);
+   unsigned long long startCycles = Cycles();
+   for (int r = 0; r < NUM_ROUNDS; r++) {
+      for (int p = 0; p < numPages; p++) {
+         memset(&bitmap[0], 0xFF, bitmapSize);
+         bitmap[bitmapSize - 1] &= (char)(0xFF << (8 * bitmapSize - PAGE_SLOTS));
+         filter(&records[(size_t)p * PAGE_SLOTS * RECORD_LENGTH + ATTR_OFFSET],
+                RECORD_LENGTH, PAGE_SLOTS, &value[0], &bitmap[0]);
+         for (int i = 0; i < bitmapSize; i++)
+            matches += __builtin_popcount((unsigned char)bitmap[i]);
+      }
+   }
+   unsigned long long cycles = Cycles() - startCycles;
+   gettimeofday(&end, NULL);
+
+   double total = (double)numPages * PAGE_SLOTS * NUM_ROUNDS;
+   double elapsed = (end.tv_sec - start.tv_sec)
+      + (end.tv_usec - start.tv_usec) / 1e6;
+   cout << setw(8) << typeName << setw(6) << opName << setw(8) << simd
+        << setw(10) << fixed << setprecision(2) << cycles / total
+        << setw(10) << elapsed * 1e9 / total
+        << setw(10) << setprecision(3) << matches / total << "\n";
+}
+
+int main(int argc, char *argv[])
+{
+   if (argc > 1 && (numRecords = atoi(argv[1])) <= 0) {
+      cerr << "Usage: " << argv[0] << " [records]\n";
+      return (1);
+   }
+
+   struct { const char *name; AttrType type; int length; } types[] = {
+      { "INT", INT, 4 }, { "FLOAT", FLOAT, 4 },
+      { "STRING", STRING, STRING_LENGTH }
+   };
+   struct { const char *name; CompOp op; } ops[] = {
+      { "NO", NO_OP }, { "EQ", EQ_OP }, { "NE", NE_OP }, { "LT", LT_OP },
+      { "GT", GT_OP }, { "LE", LE_OP }, { "GE", GE_OP }
+   };
+
+   cout << numRecords << " records of " << RECORD_LENGTH << " bytes, "
+        << NUM_ROUNDS << " passes\n\n";
+   cout << setw(8) << "type" << setw(6) << "op" << setw(8) << "path"
+        << setw(10) << "cycles" << setw(10) << "ns" << setw(10) << "match"
+        << "\n";
+
+   vector<char> records, value;
+   for (unsigned t = 0; t < sizeof(types) / sizeof(types[0]); t++) {
+      FillRecords(types[t].type, records, value);
+      for (unsigned o = 0; o < sizeof(ops) / sizeof(ops[0]); o++) {
+         PredKernel kernel = PredGetKernel(types[t].type, ops[o].op);
+         RunKernel(types[t].name, types[t].type, types[t].length,
+                   ops[o].name, ops[o].op, kernel, records, value);
+         RunKernel(types[t].name, types[t].type, types[t].length,
+                   ops[o].name, ops[o].op, NULL, records, value);
+      }
+   }
+
+   cout << "\nPage filters, " << PAGE_SLOTS << " slots a page\n\n";
+   cout << setw(8) << "type" << setw(6) << "op" << setw(8) << "simd"
+        << setw(10) << "cycles" << setw(10) << "ns" << setw(10) << "match"
+        << "\n";
+   const char *simds[] = { "off", "sse4", "avx2" };
+   for (unsigned t = 0; t < 2; t++) {
+      FillRecords(types[t].type, records, value);
+      for (unsigned o = 1; o < sizeof(ops) / sizeof(ops[0]); o++)
+         for (int m = 0; m < 3; m++)
+            RunFilter(types[t].name, types[t].type, ops[o].name, ops[o].op,
+                      simds[m], records, value);
+   }
+   return (0);
+}
@@ -1,7 +1,6 @@
 #include <cstdio>
 #include <iostream>
 #include <cstring>
-#include <cmath>
 #include "rm.h"
 #include "rm_internal.h"
 
@@ -55,6 +54,35 @@ RC RM_FileHandle::GetRec(const RID &rid, RM_Record &rec) const {
 	RM_ErrorForward(pf_fh.UnpinPage(pnum));
 	return OK_RC;
 }
+
+/*	Same as above, without copying the record.  The view takes the pin
+	of the page, and keeps it if it already holds the page.
+*/
+RC RM_FileHandle::GetRec(const RID &rid, RM_RecordView &view) const {
+	RC WARN = RM_INVALID_RID, ERR = RM_FILEHANDLE_FATAL; // used by macro
+	if (bIsOpen == 0) return RM_FILE_NOT_OPEN;
+	int pnum;
+	int snum;
+	RM_ErrorForward(rid.GetPageNum(pnum));
+	RM_ErrorForward(rid.GetSlotNum(snum));
+	if (!view.Holds(pf_fh, pnum)) {
+		PF_PageHandle page;
+		RM_ErrorForward(pf_fh.GetThisPage(pnum, page));
+		char *data;
+		RM_ErrorForward(page.GetData(data));
+		RM_ErrorForward(view.Hold(pf_fh, pnum, data));
+	}
+	view.record = 0;
+	int rec_exists;
+	RM_ErrorForward(GetBit(view.page+fHdr.bitmap_offset, snum, rec_exists));
+	if (rec_exists == 0) RM_ErrorForward(1); // Record doesn't exist, warn
+	view.record = view.page + fHdr.first_record_offset
+					+ snum * fHdr.record_length;
+	view.length = fHdr.record_length;
+	view.rid = rid;
+	return OK_RC;
+}
+
 /*	Steps-
 	1. Check if the file is open
 	2. If a free page doesn't exist, allocate a new page
@@ -86,8 +114,6 @@ RC RM_FileHandle::InsertRec  (const char *pData, RID &rid) {
 	// be inserted and its page number is dest_page
 	char* data;
 	RM_ErrorForward(pf_ph.GetData(data));
-	// Mark the page dirty
-	RM_ErrorForward(pf_fh.MarkDirty(dest_page));
 	// Update the page header and file header if a new page was
 	// allocated
 	if (fHdr.first_free == RM_SENTINEL) {
@@ -96,11 +122,18 @@ RC RM_FileHandle::InsertRec  (const char *pData, RID &rid) {
 		bHeaderChanged = 1;
 	}
 	int dest_slot = FindSlot(data + fHdr.bitmap_offset);
+	if (dest_slot < 0) {
+		// A full page on the free list; the header is damaged
+		RM_ErrorForward(pf_fh.UnpinPage(dest_page));
+		return RM_PAGE_OVERFLOW;
+	}
 	// Update the record on the file
 	RM_ErrorForward(DumpRecord(data, pData, dest_slot));
 	// update the record count and bitmap
 	((RM_PageHdr*) data)->num_recs ++;
 	RM_ErrorForward(SetBit(data + fHdr.bitmap_offset, dest_slot));
+	// Mark the page dirty, logging the bytes changed
+	RM_ErrorForward(LogChange(dest_page, dest_slot));
 	// Remove the page from free list if the page became full
 	if (((RM_PageHdr*) data)->num_recs == fHdr.capacity) {
 		fHdr.first_free = ((RM_PageHdr*) data)->next_free;
@@ -141,8 +174,7 @@ RC RM_FileHandle::DeleteRec(const RID &rid) {
     	RM_ErrorForward(pf_fh.UnpinPage(pnum));
     	RM_ErrorForward(1); // Record doesn't exist, warn
 	}
-	// Mark the page dirty and unset the bit in bitmap
-	RM_ErrorForward(pf_fh.MarkDirty(pnum));
+	// Unset the bit in bitmap and mark the page dirty
 	RM_ErrorForward(UnsetBit(data + fHdr.bitmap_offset, snum));
 	if (((RM_PageHdr*) data)->num_recs == fHdr.capacity) {
 		((RM_PageHdr*) data)->next_free = fHdr.first_free;
@@ -150,6 +182,7 @@ RC RM_FileHandle::DeleteRec(const RID &rid) {
 		bHeaderChanged = 1;
 	} 
 	((RM_PageHdr*) data)->num_recs --;
+	RM_ErrorForward(LogChange(pnum, snum, false));
 	RM_ErrorForward(pf_fh.UnpinPage(pnum));
 	return OK_RC;
 }
@@ -178,9 +211,10 @@ RC RM_FileHandle::UpdateRec(const RM_Record &rec) {
     int rec_exists;
     RM_ErrorForward(GetBit(data+fHdr.bitmap_offset, snum, rec_exists));
     if (rec_exists == 0) RM_ErrorForward(1); // Record doesn't exist, warn
-	// Mark the page dirty and update the record
-	RM_ErrorForward(pf_fh.MarkDirty(pnum));
+	// Update the record and mark the page dirty
 	RM_ErrorForward(DumpRecord(data, rec.record, snum));
+	RM_ErrorForward(pf_fh.LogChange(pnum, fHdr.first_record_offset 
+						+ snum * fHdr.record_length, fHdr.record_length));
 	RM_ErrorForward(pf_fh.UnpinPage(pnum));
 	return OK_RC;
 }
@@ -239,6 +273,22 @@ RC RM_FileHandle::DumpRecord(char *page, const char *buffer, int slot) {
 }
 
 
+/*  Mark page pnum dirty after slot# slot was filled (or emptied if
+	hasRecord is false), logging the page header, the byte of the
+	bitmap and the record that changed
+*/
+RC RM_FileHandle::LogChange(int pnum, int slot, bool hasRecord) {
+	RC WARN = RM_INVALID_RID, ERR = RM_FILEHANDLE_FATAL; // used by macro
+	RM_ErrorForward(pf_fh.LogChange(pnum, 0, sizeof(RM_PageHdr)));
+	RM_ErrorForward(pf_fh.LogChange(pnum, fHdr.bitmap_offset + slot/8, 1));
+	if (hasRecord) {
+		RM_ErrorForward(pf_fh.LogChange(pnum, fHdr.first_record_offset 
+						+ slot * fHdr.record_length, fHdr.record_length));
+	}
+	return OK_RC;
+}
+
+
 // Functions for modifying bitmap
 
 RC RM_FileHandle::SetBit(char *bitmap, int index) const {
@@ -265,22 +315,17 @@ RC RM_FileHandle::GetBit(char *bitmap, int index, int& status) const {
     return OK_RC;
 }
 
-// Function to find the first empty slot in a page
+// Function to find the first empty slot in a page, a word of the
+// bitmap at a time. A full page has every word all ones, and gives -1.
 // Slots are numbered from 0, 1, ..., capacity-1
 int RM_FileHandle::FindSlot(char *bitmap) const{
-	int slot = -1, base = 0;
-	unsigned char byte;
-	for (int i = 0; i < fHdr.bitmap_size; i++) {
-		byte = (unsigned char) ~*(bitmap + i);
-		if (byte == 0) {
-			base += 8;
-			continue;
-		}
-		slot = base + 7 - floor(log2(byte));
-		break;
+	int words = RM_BitmapWords(fHdr.bitmap_size);
+	for (int w = 0; w < words; w++) {
+		RM_BitmapWord_t free = ~RM_BitmapWord(bitmap, w, fHdr.bitmap_size)
+								& RM_SlotMask(w, fHdr.capacity);
+		if (free) return RM_FirstSlot(free, w);
 	}
-	if (slot >= fHdr.capacity) slot = -1;
-	return slot;
+	return -1;
 }
 
 /*  Keeping track of free pages-
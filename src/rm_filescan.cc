@@ -3,30 +3,11 @@
 #include <cstring>
 #include "rm.h"
 #include "rm_internal.h"
+#include "predicate.h"
 
 using namespace std;
 
 
-/* macro for writing comparison operators
-	This occurs in the body of the function having signature
-	bool RM_FileScan::xx_op(void* attr)
-	where xx = eq, lt, gt etc.
-*/
-#define RM_filescan_operator(expr) do { \
-    char attr_value[attr_length+1];\
-    buffer(attr, attr_value);\
-    switch (attr_type) { \
-        case INT:\
-        	return *((int*) attr_value) expr *((int*) query_value);\
-        case FLOAT: \
-        	return *((float*) attr_value) expr *((float*) query_value);\
-        case STRING: \
-        	return string(attr_value) expr string(query_value);\
-        default: return 1 == 1;\
-    }\
-}while(0)
-
-
 RM_FileScan::RM_FileScan() {
 	bIsOpen = 0;
 }
@@ -45,8 +26,7 @@ RM_FileScan::~RM_FileScan() {
 	2. The the value pointer is null, set comparison operator to 
 	   NO_OP
 	3. Store the passed parameters
-	4. Make the comp function pointer point to the correct member 
-	   function
+	4. Pick the comparison kernel for the type and operator
 	TODO : Error if CLientHint invalid
 */
 RC RM_FileScan::OpenScan(const RM_FileHandle &fileHandle,
@@ -82,35 +62,14 @@ RC RM_FileScan::OpenScan(const RM_FileHandle &fileHandle,
 	query_value = new char[attr_length + 1];
 	if (value) buffer(value, query_value);
 	pin_hint = pinHint;
-	switch (compOp) {
-		case NO_OP:
-			comp = &RM_FileScan::no_op;
-			break;
-		case EQ_OP:
-			comp = &RM_FileScan::eq_op;
-			break;
-		case NE_OP:
-			comp = &RM_FileScan::ne_op;
-			break;
-		case LT_OP:
-			comp = &RM_FileScan::lt_op;
-			break;
-		case GT_OP:
-			comp = &RM_FileScan::gt_op;
-			break;
-		case LE_OP:
-			comp = &RM_FileScan::le_op;
-			break;
-		case GE_OP:
-			comp = &RM_FileScan::ge_op;
-			break;
-		default:
-			comp = &RM_FileScan::no_op;
-			break;
-	}
+	// NO_OP and the attribute type were checked above
+	comp = PredGetKernel(attr_type, compOp);
+	filter = RM_GetPageFilter(attr_type, compOp);
 	recs_seen = 0;
 	num_recs = 0;
 	current = fileHandle.fHdr.header_pnum;
+	word_idx = 0;
+	cur_word = 0;
 	bitmap_copy = new char[fileHandle.fHdr.bitmap_size];
 	return OK_RC;
 }
@@ -140,7 +99,6 @@ RC RM_FileScan::GetNextRec(RM_Record &rec) {
 	// if record was allocated earlier, delete it
 	char *data;
 	SlotNum dest;
-	char* attr_position;
 	int bFound = 0;
 	//RM_FileHandle temp; // using for some non-const function access
 	while (1) {
@@ -148,25 +106,17 @@ RC RM_FileScan::GetNextRec(RM_Record &rec) {
 			RM_ErrorForward(GiveNewPage(data));
 			recs_seen = 0;
 		} else {
-			RM_ErrorForward(rm_fh->pf_fh.GetThisPage(current, pf_ph));
+			RM_ErrorForward(rm_fh->pf_fh.GetThisPage(current, pf_ph,
+				pin_hint));
 			RM_ErrorForward(pf_ph.GetData(data));
 		}
-		while (recs_seen < num_recs) {
-			dest = rm_fh->FindSlot(bitmap_copy);
-			attr_position = data + rm_fh->fHdr.first_record_offset
-							+ dest * rm_fh->fHdr.record_length 
-							+ attr_offset;
-			recs_seen ++;
-			RM_ErrorForward(rm_fh->SetBit(bitmap_copy, dest));
-			if ((this->*comp)(attr_position)) {
-				if (rec.bIsAllocated) delete[] rec.record;
-				rec.record = new char[rm_fh->fHdr.record_length];
-				RM_ErrorForward(rm_fh->FetchRecord(data, rec.record, dest));
-				rec.rid = RID(current, dest);
-				rec.bIsAllocated = 1;
-				bFound = 1;
-				break;
-			}
+		RM_ErrorForward(NextMatches(data, &dest, 1, bFound));
+		if (bFound) {
+			if (rec.bIsAllocated) delete[] rec.record;
+			rec.record = new char[rm_fh->fHdr.record_length];
+			RM_ErrorForward(rm_fh->FetchRecord(data, rec.record, dest));
+			rec.rid = RID(current, dest);
+			rec.bIsAllocated = 1;
 		}
 		// Unpin page, new page will be allocated or we will exit
 		RM_ErrorForward(rm_fh->pf_fh.UnpinPage(current));
@@ -174,6 +124,114 @@ RC RM_FileScan::GetNextRec(RM_Record &rec) {
 	}
 }
 
+/*	Get next matching record, in place
+	Same as above, except that the page of the record stays pinned by
+	the view.  While the records come from the same page the view keeps
+	its pin, so the page is neither looked up nor pinned again and the
+	record is not copied.  The view is released when the scan ends.
+*/
+RC RM_FileScan::GetNextRec(RM_RecordView &view) {
+	RC WARN = RM_EOF, ERR = RM_FILESCAN_FATAL; // used by macro
+	if (!bIsOpen) return RM_SCAN_NOT_OPEN;
+	if (!rm_fh->bIsOpen) return RM_FILE_NOT_OPEN;
+	char *data;
+	SlotNum dest;
+	int bFound = 0;
+	while (1) {
+		// bPinned is set if the scan pinned the page itself
+		int bPinned = 1;
+		if (recs_seen == num_recs) {
+			RM_ErrorForward(view.Release());
+			RM_ErrorForward(GiveNewPage(data));
+			recs_seen = 0;
+		} else if (view.Holds(rm_fh->pf_fh, current)) {
+			data = view.page;
+			bPinned = 0;
+		} else {
+			RM_ErrorForward(rm_fh->pf_fh.GetThisPage(current, pf_ph,
+				pin_hint));
+			RM_ErrorForward(pf_ph.GetData(data));
+		}
+		RM_ErrorForward(NextMatches(data, &dest, 1, bFound));
+		if (bFound) {
+			if (bPinned) RM_ErrorForward(view.Hold(rm_fh->pf_fh, current, data));
+			view.record = data + rm_fh->fHdr.first_record_offset
+							+ dest * rm_fh->fHdr.record_length;
+			view.length = rm_fh->fHdr.record_length;
+			view.rid = RID(current, dest);
+			return OK_RC;
+		}
+		// Done with the page
+		if (bPinned) RM_ErrorForward(rm_fh->pf_fh.UnpinPage(current));
+		else RM_ErrorForward(view.Release());
+	}
+}
+
+/*	Get the next matching records, a page at a time
+	The batch is filled with up to its capacity of matching records of
+	the current page, or else of the next page having any, and keeps
+	that page pinned.  Records of a page that do not fit in one batch
+	are given by the next call, from the same pin.  The batch is
+	released when the scan ends.
+*/
+RC RM_FileScan::GetNextBatch(RM_RecordBatch &batch) {
+	RC WARN = RM_EOF, ERR = RM_FILESCAN_FATAL; // used by macro
+	if (!bIsOpen) return RM_SCAN_NOT_OPEN;
+	if (!rm_fh->bIsOpen) return RM_FILE_NOT_OPEN;
+	char *data;
+	while (1) {
+		// bPinned is set if the scan pinned the page itself
+		int bPinned = 1;
+		if (recs_seen == num_recs) {
+			RM_ErrorForward(batch.Release());
+			RM_ErrorForward(GiveNewPage(data));
+			recs_seen = 0;
+		} else if (batch.view.Holds(rm_fh->pf_fh, current)) {
+			data = batch.view.page;
+			bPinned = 0;
+		} else {
+			RM_ErrorForward(rm_fh->pf_fh.GetThisPage(current, pf_ph,
+				pin_hint));
+			RM_ErrorForward(pf_ph.GetData(data));
+		}
+		RM_ErrorForward(NextMatches(data, batch.slots, batch.capacity,
+			batch.count));
+		if (batch.count > 0) {
+			if (bPinned)
+				RM_ErrorForward(batch.view.Hold(rm_fh->pf_fh, current, data));
+			batch.view.length = rm_fh->fHdr.record_length;
+			batch.first_record_offset = rm_fh->fHdr.first_record_offset;
+			return OK_RC;
+		}
+		// Done with the page
+		if (bPinned) RM_ErrorForward(rm_fh->pf_fh.UnpinPage(current));
+		else RM_ErrorForward(batch.Release());
+	}
+}
+
+/*	Find up to max next records of the current page that satisfy the
+	condition, marking the slots looked at as seen
+*/
+RC RM_FileScan::NextMatches(char *data, SlotNum *slots, int max,
+		int &count) {
+	char *records = data + rm_fh->fHdr.first_record_offset + attr_offset;
+	int length = rm_fh->fHdr.record_length;
+	count = 0;
+	int size = rm_fh->fHdr.bitmap_size;
+	while (recs_seen < num_recs && count < max) {
+		// Some slot is left while recs_seen < num_recs
+		while (cur_word == 0)
+			cur_word = RM_BitmapWord(bitmap_copy, ++word_idx, size);
+		int bit = __builtin_clzll(cur_word);
+		cur_word ^= (1ULL << (RM_WORD_SLOTS - 1)) >> bit;
+		SlotNum slot = word_idx * RM_WORD_SLOTS + bit;
+		recs_seen ++;
+		if (filter || comp(records + slot * length, query_value, attr_length))
+			slots[count++] = slot;
+	}
+	return OK_RC;
+}
+
 RC RM_FileScan::CloseScan() {
 	if (!bIsOpen) return RM_SCAN_NOT_OPEN;
 	delete[] query_value;
@@ -182,23 +240,41 @@ RC RM_FileScan::CloseScan() {
 	return OK_RC;
 }
 
-// Read a new non-blank page and update status variables
+// Read a new page having records that may match and update status
+// variables
 RC RM_FileScan::GiveNewPage(char *&data) {
 	RC WARN = RM_EOF, ERR = RM_FILESCAN_FATAL; // used by macro
-	do {
-		RM_ErrorForward(rm_fh->pf_fh.GetNextPage(current, pf_ph));
+	int size = rm_fh->fHdr.bitmap_size;
+	int last = RM_BitmapWords(size) - 1;
+	while (1) {
+		RM_ErrorForward(rm_fh->pf_fh.GetNextPage(current, pf_ph, pin_hint));
 		RM_ErrorForward(pf_ph.GetData(data));
-		num_recs = ((RM_PageHdr *) data)->num_recs;
 		RM_ErrorForward(pf_ph.GetPageNum(current));
-		if (num_recs == 0) {
-			RM_ErrorForward(rm_fh->pf_fh.UnpinPage(current));
+		if (((RM_PageHdr *) data)->num_recs != 0) {
+			memcpy(bitmap_copy, data+rm_fh->fHdr.bitmap_offset, size);
+			// Drop the bits past the last slot
+			RM_BitmapWord_t tail = RM_BitmapWord(bitmap_copy, last, size)
+									& RM_SlotMask(last, rm_fh->fHdr.capacity);
+			for (int i = last * 8; i < size; i++)
+				bitmap_copy[i] = (char) (tail >> (56 - 8 * (i - last * 8)));
+			// Keep only the matching slots, if the whole page can be
+			// compared at once
+			if (filter)
+				filter(data + rm_fh->fHdr.first_record_offset + attr_offset,
+					rm_fh->fHdr.record_length, rm_fh->fHdr.capacity,
+					query_value, bitmap_copy);
+			// Count the slots left a word at a time, so that the count
+			// always matches the bitmap
+			num_recs = 0;
+			for (int w = 0; w <= last; w++)
+				num_recs += __builtin_popcountll(
+								RM_BitmapWord(bitmap_copy, w, size));
+			if (num_recs != 0) break;
 		}
-	} while(num_recs == 0);
-	memcpy(bitmap_copy, data+rm_fh->fHdr.bitmap_offset, rm_fh->fHdr.bitmap_size);
-	// Negate the bits because we are interested in taken slots
-	for (int i = 0; i < rm_fh->fHdr.bitmap_size; i++) {
-		*(bitmap_copy + i) = ~*(bitmap_copy+i);
+		RM_ErrorForward(rm_fh->pf_fh.UnpinPage(current));
 	}
+	word_idx = 0;
+	cur_word = RM_BitmapWord(bitmap_copy, 0, size);
 	return OK_RC;
 }
 
@@ -208,25 +284,3 @@ void RM_FileScan::buffer(void *ptr, char* buff) {
     memcpy(buff, ptr, attr_length);
     return;
 }
-
-bool RM_FileScan::no_op(void* attr) {
-	return 1 == 1;
-}
-bool RM_FileScan::eq_op(void* attr) {
-	RM_filescan_operator(==);
-}
-bool RM_FileScan::ne_op(void* attr) {
-	RM_filescan_operator(!=);
-}
-bool RM_FileScan::lt_op(void* attr) {
-	RM_filescan_operator(<);
-}
-bool RM_FileScan::gt_op(void* attr) {
-	RM_filescan_operator(>);
-}
-bool RM_FileScan::le_op(void* attr) {
-	RM_filescan_operator(<=);
-}
-bool RM_FileScan::ge_op(void* attr) {
-	RM_filescan_operator(>=);
-}
\ No newline at end of file
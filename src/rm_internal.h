@@ -6,6 +6,8 @@
 #ifndef RM_INT_H
 #define RM_INT_H
 
+#include <cstring>
+
 //
 // Structures for page header 
 //
@@ -17,6 +19,52 @@ struct RM_PageHdr {
 
 
 
+//
+// Bitmap of a page, bit i set if slot i holds a record. The bit of
+// slot i is the bit 7-i%8 of byte i/8, so the bitmap read as big endian
+// 64 bit words has slot 64*w+j at bit 63-j of word w, and the first set
+// bit of a word is found by counting its leading zeros.
+//
+typedef unsigned long long RM_BitmapWord_t;
+#define RM_WORD_SLOTS 64
+
+// Number of words covering a bitmap of size bytes
+inline int RM_BitmapWords(int size) {
+	return (size + 7) / 8;
+}
+
+// Word w of a bitmap of size bytes; bytes past the end read as zero
+inline RM_BitmapWord_t RM_BitmapWord(const char *bitmap, int w, int size) {
+	RM_BitmapWord_t word = 0;
+	int n = size - w * 8;
+	memcpy(&word, bitmap + w * 8, n < 8 ? n : 8);
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	word = __builtin_bswap64(word);
+#endif
+	return word;
+}
+
+// Mask of the bits of word w that stand for one of capacity slots
+inline RM_BitmapWord_t RM_SlotMask(int w, int capacity) {
+	int n = capacity - w * RM_WORD_SLOTS;
+	return n >= RM_WORD_SLOTS ? ~0ULL : ~0ULL << (RM_WORD_SLOTS - n);
+}
+
+// Slot of the first set bit of word w, which must not be zero
+inline int RM_FirstSlot(RM_BitmapWord_t word, int w) {
+	return w * RM_WORD_SLOTS + __builtin_clzll(word);
+}
+
+//
+// Page filters (rm_pagefilter.cc): filter(attrs, stride, capacity,
+// value, bitmap) clears the bits of a copy of a page bitmap whose slot
+// has an attribute, at attrs + slot * stride, that does not compare
+// with value.
+//
+typedef void (*RM_PageFilter)(const char *attrs, int stride, int capacity,
+								const void *value, char *bitmap);
+RM_PageFilter RM_GetPageFilter(AttrType type, CompOp op);
+
 // Macro for error forwarding
 // WARN and ERR to be defined in the context where macro is used
 #define RM_ErrorForward(expr) do { \
@@ -26,7 +26,7 @@ RM_Manager::~RM_Manager() {
 /*  Steps - 
     1. Check if the record size is valid
     2. Call pfmanager to create a file named filename
-    3. Open the created file
+    3. Open the created file, and check that a record fits its pages
     4. Allocate a new file header page
     5. Mark the file header page dirty
     6. Fetch the contents of the page and update the header
@@ -35,17 +35,26 @@ RM_Manager::~RM_Manager() {
     Question-
     1. Should the header page be forced to disk?
 */
-RC RM_Manager::CreateFile (const char *fileName, int recordSize) {
+RC RM_Manager::CreateFile (const char *fileName, int recordSize,
+        int pageSize) {
     RC WARN = RM_MANAGER_CREATE_WARN, ERR = RM_MANAGER_CREATE_ERR; // used by macro
-    if ((recordSize >= PF_PAGE_SIZE - (int) sizeof(RM_PageHdr)) || (recordSize <= 0)) {
+    if (recordSize <= 0) {
         return RM_BAD_REC_SIZE;
     }
     if (!fileName) return RM_NULL_FILENAME;
-    RM_ErrorForward(pf_manager->CreateFile(fileName));
+    RM_ErrorForward(pf_manager->CreateFile(fileName, pageSize));
     // define a file handle and page handles to open the file
     PF_FileHandle fh;
     PF_PageHandle header;
     RM_ErrorForward(pf_manager->OpenFile(fileName, fh));
+    // the capacity of a page depends on the page size of the file
+    int psize;
+    RM_ErrorForward(fh.GetPageSize(psize));
+    if (recordSize >= psize - (int) sizeof(RM_PageHdr)) {
+        pf_manager->CloseFile(fh);
+        pf_manager->DestroyFile(fileName);
+        return RM_BAD_REC_SIZE;
+    }
     RM_ErrorForward(fh.AllocatePage(header));
     // get the assigned page number
     PageNum header_pnum;
@@ -56,7 +65,7 @@ RC RM_Manager::CreateFile (const char *fileName, int recordSize) {
     RM_ErrorForward(header.GetData(contents));
     RM_FileHdr fHdr;
     fHdr.record_length = recordSize;
-    fHdr.capacity = numRecordsPerPage(recordSize);
+    fHdr.capacity = numRecordsPerPage(recordSize, psize);
     fHdr.bitmap_size = ceil(fHdr.capacity/8.0);
     fHdr.bitmap_offset = sizeof(RM_PageHdr);
     fHdr.first_record_offset = fHdr.bitmap_offset + fHdr.bitmap_size;
@@ -97,13 +106,14 @@ RC RM_Manager::DestroyFile(const char *fileName) {
     4. Copy the header to RM_FileHandle object
     5. Unpin the PF page handle  
 */
-RC RM_Manager::OpenFile(const char *fileName, RM_FileHandle &fileHandle) {
+RC RM_Manager::OpenFile(const char *fileName, RM_FileHandle &fileHandle,
+        int ioMode) {
     RC WARN = RM_MANAGER_OPEN_WARN, ERR = RM_MANAGER_OPEN_ERR; // used by macro
     if (!fileName) return RM_NULL_FILENAME;
     if (fileHandle.bIsOpen) {
         RM_ErrorForward(1); // Positive number for warning
     }
-    RM_ErrorForward(pf_manager->OpenFile(fileName, fileHandle.pf_fh));
+    RM_ErrorForward(pf_manager->OpenFile(fileName, fileHandle.pf_fh, ioMode));
     PF_PageHandle header;
     // First page is the header page 
     RM_ErrorForward(fileHandle.pf_fh.GetFirstPage(header));
@@ -155,9 +165,9 @@ RC RM_Manager::CloseFile(RM_FileHandle &fileHandle) {
 // Function to figure out max number of records that can be put in
 // page. A separate function needs to be written because the page
 // header has a bitmap whose size depends on the number of pages
-int RM_Manager::numRecordsPerPage(int rec_size) {
+int RM_Manager::numRecordsPerPage(int rec_size, int page_size) {
     int num = 0;
-    int effective_psize = PF_PAGE_SIZE - sizeof(RM_PageHdr);
+    int effective_psize = page_size - sizeof(RM_PageHdr);
     while (num * rec_size +  ceil(num/8.0) <= effective_psize) num++;
     return num - 1;
 }
\ No newline at end of file
@@ -0,0 +1,286 @@
+//
+// rm_pagefilter.cc
+//
+//   Page filters: a comparison of an INT or FLOAT attribute evaluated
+//   over all the slots of a page at once
+
+/*	A page filter is given the attributes of the slots of a page, at
+	attrs, attrs + stride, ..., and a copy of the page bitmap. It clears
+	the bit of every slot whose attribute does not compare with value,
+	leaving a bitmap of the matching records in the layout of the page
+	bitmap (see rm_internal.h).
+
+	Slots are taken 8 at a time, one byte of the bitmap, and a byte
+	with no record is skipped. There are three versions of each filter,
+	picked when the scan is opened:
+	- AVX2 gathers the attributes of 8 slots into a vector and compares
+	  them with a single instruction
+	- SSE4.1 loads the attributes of 4 slots at a time with strided
+	  loads
+	- the scalar one compares the slots one by one
+	The vector versions leave the last slots of the page, which do not
+	fill a group of 8, to the scalar one, so that no load reaches past
+	the last record.
+
+	The "simd" setting (see pf_config.cc) caps the version used: "off"
+	for the scalar one, "sse4" for SSE4.1 at most. By default the best
+	one the processor has is used.
+*/
+
+#include <cstring>
+#include <strings.h>
+#include "rm.h"
+#include "rm_internal.h"
+#include "predicate.h"
+#include "pf_internal.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RM_X86
+#endif
+
+// Versions of the page filters
+#define RM_SIMD_OFF  0
+#define RM_SIMD_SSE4 1
+#define RM_SIMD_AVX2 2
+
+/* 	Bits of a byte in reverse order. The vector compares give the bit of
+	slot j of a group at bit j of their mask, and the bitmap at bit 7-j
+*/
+static struct RM_ReverseTable {
+	unsigned char bits[256];
+	RM_ReverseTable() {
+		for (int b = 0; b < 256; b++) {
+			bits[b] = 0;
+			for (int j = 0; j < 8; j++)
+				if (b & (1 << j)) bits[b] |= 0x80 >> j;
+		}
+	}
+} reverse;
+
+/*	Scalar filter, from slot first on; first is a multiple of 8
+*/
+template <CompOp op, typename T>
+static void FilterScalar(const char *attrs, int stride, int capacity,
+		const void *value, char *bitmap, int first) {
+	T v = PredLoad<T>(value);
+	for (int i = first; i < capacity; i += 8) {
+		unsigned char byte = bitmap[i / 8];
+		if (byte == 0) continue;
+		unsigned char sel = 0;
+		int n = capacity - i < 8 ? capacity - i : 8;
+		const char *attr = attrs + i * stride;
+		for (int j = 0; j < n; j++, attr += stride)
+			sel |= PredCompare<op>(PredLoad<T>(attr), v) << (7 - j);
+		bitmap[i / 8] = byte & sel;
+	}
+}
+
+template <CompOp op, typename T>
+static void FilterOff(const char *attrs, int stride, int capacity,
+		const void *value, char *bitmap) {
+	FilterScalar<op, T>(attrs, stride, capacity, value, bitmap, 0);
+}
+
+#ifdef RM_X86
+
+/*	Mask of the lanes where a op v holds, one bit per lane. The integer
+	compares only have == and >, the other operators are built from them
+*/
+template <CompOp op>
+__attribute__((target("sse4.1")))
+static inline int MaskSse4(__m128i a, __m128i v) {
+	switch (op) {
+		case EQ_OP: return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(a, v)));
+		case NE_OP: return ~_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(a, v))) & 0xF;
+		case LT_OP: return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(v, a)));
+		case GT_OP: return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(a, v)));
+		case LE_OP: return ~_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(a, v))) & 0xF;
+		case GE_OP: return ~_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(v, a))) & 0xF;
+		default:    return 0xF;
+	}
+}
+
+template <CompOp op>
+__attribute__((target("sse4.1")))
+static inline int MaskSse4(__m128 a, __m128 v) {
+	switch (op) {
+		case EQ_OP: return _mm_movemask_ps(_mm_cmpeq_ps(a, v));
+		case NE_OP: return _mm_movemask_ps(_mm_cmpneq_ps(a, v));
+		case LT_OP: return _mm_movemask_ps(_mm_cmplt_ps(a, v));
+		case GT_OP: return _mm_movemask_ps(_mm_cmpgt_ps(a, v));
+		case LE_OP: return _mm_movemask_ps(_mm_cmple_ps(a, v));
+		case GE_OP: return _mm_movemask_ps(_mm_cmpge_ps(a, v));
+		default:    return 0xF;
+	}
+}
+
+template <CompOp op>
+__attribute__((target("avx2")))
+static inline int MaskAvx2(__m256i a, __m256i v) {
+	switch (op) {
+		case EQ_OP: return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(a, v)));
+		case NE_OP: return ~_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(a, v))) & 0xFF;
+		case LT_OP: return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(v, a)));
+		case GT_OP: return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(a, v)));
+		case LE_OP: return ~_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(a, v))) & 0xFF;
+		case GE_OP: return ~_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(v, a))) & 0xFF;
+		default:    return 0xFF;
+	}
+}
+
+// The float compares are ordered, except !=, as in C
+template <CompOp op>
+__attribute__((target("avx2")))
+static inline int MaskAvx2(__m256 a, __m256 v) {
+	switch (op) {
+		case EQ_OP: return _mm256_movemask_ps(_mm256_cmp_ps(a, v, _CMP_EQ_OQ));
+		case NE_OP: return _mm256_movemask_ps(_mm256_cmp_ps(a, v, _CMP_NEQ_UQ));
+		case LT_OP: return _mm256_movemask_ps(_mm256_cmp_ps(a, v, _CMP_LT_OQ));
+		case GT_OP: return _mm256_movemask_ps(_mm256_cmp_ps(a, v, _CMP_GT_OQ));
+		case LE_OP: return _mm256_movemask_ps(_mm256_cmp_ps(a, v, _CMP_LE_OQ));
+		case GE_OP: return _mm256_movemask_ps(_mm256_cmp_ps(a, v, _CMP_GE_OQ));
+		default:    return 0xFF;
+	}
+}
+
+/*	Strided loads of the attributes of 4 slots
+*/
+__attribute__((target("sse4.1")))
+static inline void Load4(const char *attr, int stride, __m128i &a) {
+	a = _mm_setr_epi32(PredLoad<int>(attr), PredLoad<int>(attr + stride),
+			PredLoad<int>(attr + 2 * stride), PredLoad<int>(attr + 3 * stride));
+}
+
+__attribute__((target("sse4.1")))
+static inline void Load4(const char *attr, int stride, __m128 &a) {
+	a = _mm_setr_ps(PredLoad<float>(attr), PredLoad<float>(attr + stride),
+			PredLoad<float>(attr + 2 * stride), PredLoad<float>(attr + 3 * stride));
+}
+
+__attribute__((target("sse4.1")))
+static inline void Splat4(const void *value, __m128i &v) {
+	v = _mm_set1_epi32(PredLoad<int>(value));
+}
+
+__attribute__((target("sse4.1")))
+static inline void Splat4(const void *value, __m128 &v) {
+	v = _mm_set1_ps(PredLoad<float>(value));
+}
+
+/*	Gathers of the attributes of 8 slots, at the offsets in idx
+*/
+__attribute__((target("avx2")))
+static inline void Gather8(const char *attr, __m256i idx, __m256i &a) {
+	a = _mm256_i32gather_epi32((const int *) attr, idx, 1);
+}
+
+__attribute__((target("avx2")))
+static inline void Gather8(const char *attr, __m256i idx, __m256 &a) {
+	a = _mm256_i32gather_ps((const float *) attr, idx, 1);
+}
+
+__attribute__((target("avx2")))
+static inline void Splat8(const void *value, __m256i &v) {
+	v = _mm256_set1_epi32(PredLoad<int>(value));
+}
+
+__attribute__((target("avx2")))
+static inline void Splat8(const void *value, __m256 &v) {
+	v = _mm256_set1_ps(PredLoad<float>(value));
+}
+
+/*	SSE4.1 filter; V is __m128i for INT and __m128 for FLOAT
+*/
+template <CompOp op, typename T, typename V>
+__attribute__((target("sse4.1")))
+static void FilterSse4(const char *attrs, int stride, int capacity,
+		const void *value, char *bitmap) {
+	V v, a, b;
+	Splat4(value, v);
+	int groups = capacity / 8;
+	for (int k = 0; k < groups; k++) {
+		unsigned char byte = bitmap[k];
+		if (byte == 0) continue;
+		const char *attr = attrs + 8 * k * stride;
+		Load4(attr, stride, a);
+		Load4(attr + 4 * stride, stride, b);
+		int mask = MaskSse4<op>(a, v) | MaskSse4<op>(b, v) << 4;
+		bitmap[k] = byte & reverse.bits[mask];
+	}
+	FilterScalar<op, T>(attrs, stride, capacity, value, bitmap, groups * 8);
+}
+
+/*	AVX2 filter; V is __m256i for INT and __m256 for FLOAT
+*/
+template <CompOp op, typename T, typename V>
+__attribute__((target("avx2")))
+static void FilterAvx2(const char *attrs, int stride, int capacity,
+		const void *value, char *bitmap) {
+	V v, a;
+	Splat8(value, v);
+	__m256i idx = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+			_mm256_set1_epi32(stride));
+	int groups = capacity / 8;
+	for (int k = 0; k < groups; k++) {
+		unsigned char byte = bitmap[k];
+		if (byte == 0) continue;
+		Gather8(attrs + 8 * k * stride, idx, a);
+		bitmap[k] = byte & reverse.bits[MaskAvx2<op>(a, v)];
+	}
+	// Code built without AVX is slowed down by dirty upper halves
+	_mm256_zeroupper();
+	FilterScalar<op, T>(attrs, stride, capacity, value, bitmap, groups * 8);
+}
+
+#endif // RM_X86
+
+/*	The best version of the page filters allowed by the "simd" setting
+	and supported by the processor
+*/
+static int SimdLevel() {
+	int level = RM_SIMD_AVX2;
+	const char *setting = PF_GetConfig("simd");
+	if (setting && strcasecmp(setting, "sse4") == 0) level = RM_SIMD_SSE4;
+	else if (setting && !PF_GetConfigBool("simd", 1)) level = RM_SIMD_OFF;
+#ifdef RM_X86
+	__builtin_cpu_init();
+	if (level == RM_SIMD_AVX2 && !__builtin_cpu_supports("avx2"))
+		level = RM_SIMD_SSE4;
+	if (level == RM_SIMD_SSE4 && !__builtin_cpu_supports("sse4.1"))
+		level = RM_SIMD_OFF;
+#else
+	level = RM_SIMD_OFF;
+#endif
+	return level;
+}
+
+template <CompOp op>
+static RM_PageFilter FilterFor(AttrType type, int level) {
+#ifdef RM_X86
+	if (level == RM_SIMD_AVX2)
+		return type == INT ? &FilterAvx2<op, int, __m256i>
+							: &FilterAvx2<op, float, __m256>;
+	if (level == RM_SIMD_SSE4)
+		return type == INT ? &FilterSse4<op, int, __m128i>
+							: &FilterSse4<op, float, __m128>;
+#endif
+	return type == INT ? &FilterOff<op, int> : &FilterOff<op, float>;
+}
+
+/*	The page filter for attributes of the given type compared by op,
+	NULL if there is none (STRING attributes and NO_OP)
+*/
+RM_PageFilter RM_GetPageFilter(AttrType type, CompOp op) {
+	if (type != INT && type != FLOAT) return NULL;
+	int level = SimdLevel();
+	switch (op) {
+		case EQ_OP: return FilterFor<EQ_OP>(type, level);
+		case NE_OP: return FilterFor<NE_OP>(type, level);
+		case LT_OP: return FilterFor<LT_OP>(type, level);
+		case GT_OP: return FilterFor<GT_OP>(type, level);
+		case LE_OP: return FilterFor<LE_OP>(type, level);
+		case GE_OP: return FilterFor<GE_OP>(type, level);
+		default:    return NULL;
+	}
+}
@@ -27,4 +27,74 @@ RC RM_Record::GetRid (RID &rid) const{
 	if (!bIsAllocated) return RM_INVALID_RECORD;
 	rid = this->rid;
 	return OK_RC;
-}
\ No newline at end of file
+}
+
+RM_RecordView::RM_RecordView() {
+	pf_fh = 0;
+	pnum = -1;
+	page = 0;
+	record = 0;
+	length = 0;
+}
+
+RM_RecordView::~RM_RecordView() {
+	Release();
+}
+
+// Sets pData to the record contents, which stay in the buffer page
+RC RM_RecordView::GetData(const char *&pData) const {
+	if (record == 0) return RM_INVALID_RECORD;
+	pData = record;
+	return OK_RC;
+}
+
+// Return the RID associated with the record
+RC RM_RecordView::GetRid(RID &rid) const {
+	if (record == 0) return RM_INVALID_RECORD;
+	rid = this->rid;
+	return OK_RC;
+}
+
+int RM_RecordView::GetLength() const {
+	return length;
+}
+
+// Unpin the page of the record, if any
+RC RM_RecordView::Release() {
+	RC WARN = RM_INVALID_RECORD, ERR = RM_FILEHANDLE_FATAL; // used by macro
+	record = 0;
+	if (pf_fh == 0) return OK_RC;
+	const PF_FileHandle *fh = pf_fh;
+	pf_fh = 0;
+	RM_ErrorForward(fh->UnpinPage(pnum));
+	return OK_RC;
+}
+
+// Take over a pin of page pnum, releasing the page held so far
+RC RM_RecordView::Hold(const PF_FileHandle &pf_fh, PageNum pnum,
+		char *page) {
+	RC WARN = RM_INVALID_RECORD, ERR = RM_FILEHANDLE_FATAL; // used by macro
+	RM_ErrorForward(Release());
+	this->pf_fh = &pf_fh;
+	this->pnum = pnum;
+	this->page = page;
+	return OK_RC;
+}
+
+RM_RecordBatch::RM_RecordBatch(int capacity) {
+	if (capacity < 1) capacity = 1;
+	this->capacity = capacity;
+	slots = new SlotNum[capacity];
+	count = 0;
+	first_record_offset = 0;
+}
+
+RM_RecordBatch::~RM_RecordBatch() {
+	delete[] slots;
+}
+
+// Unpin the page of the records, if any
+RC RM_RecordBatch::Release() {
+	count = 0;
+	return view.Release();
+}
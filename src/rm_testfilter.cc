@@ -0,0 +1,179 @@
+//
+// File:        rm_testfilter.cc
+// Description: Test of the RM page filters.  Every version of the
+//              filters (AVX2, SSE4.1 and scalar) is run with every
+//              operator over random pages, and must leave the same
+//              bitmap as the scalar one, which must match the records
+//              compared one by one.  The pages have NaNs, both zeros
+//              and infinities among their FLOAT attributes, and slot
+//              counts that leave a last group of fewer than 8.
+//
+
+#include <cstdio>
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <climits>
+#include <cmath>
+#include <vector>
+
+#include "redbase.h"
+#include "pf.h"
+#include "rm.h"
+#include "rm_internal.h"
+
+using namespace std;
+
+//
+// Defines
+//
+#define NUM_PAGES  2000             // random pages for each filter
+
+// Versions of the filters, by the "simd" setting that picks them.  Where
+// the processor lacks one, the next one down is tested again.
+const char *Versions[] = { "on", "sse4", "off" };
+
+// Operators with a page filter
+CompOp Ops[] = { EQ_OP, NE_OP, LT_OP, GT_OP, LE_OP, GE_OP };
+
+// Attribute values, few enough that EQ_OP matches often
+int IntValues[] = { INT_MIN, -2, -1, 0, 1, 2, INT_MAX };
+float FloatValues[] = { -INFINITY, -2.5f, -1.0f, -0.0f, 0.0f, 1.0f, 2.5f,
+                        INFINITY, NAN };
+
+//
+// RandomValue
+//
+// Desc: Put a random INT or FLOAT value at p
+//
+void RandomValue(AttrType type, char *p)
+{
+   if (type == INT) {
+      int v = IntValues[rand() % (sizeof(IntValues) / sizeof(int))];
+      memcpy(p, &v, sizeof(v));
+   }
+   else {
+      float v = FloatValues[rand() % (sizeof(FloatValues) / sizeof(float))];
+      memcpy(p, &v, sizeof(v));
+   }
+}
+
+//
+// Compare
+//
+// Desc: Compare the attribute at a with the value at v, as a scan would
+//
+template <typename T>
+int Compare(CompOp op, const char *a, const char *v)
+{
+   T x, y;
+   memcpy(&x, a, sizeof(T));
+   memcpy(&y, v, sizeof(T));
+   switch (op) {
+   case EQ_OP: return (x == y);
+   case NE_OP: return (x != y);
+   case LT_OP: return (x < y);
+   case GT_OP: return (x > y);
+   case LE_OP: return (x <= y);
+   case GE_OP: return (x >= y);
+   default:    return (1);
+   }
+}
+
+//
+// TestFilters
+//
+// Desc: Run the filter of one version for type and op over random pages
+//       and compare its bitmaps with those of the scalar filter, and
+//       those with the records compared one by one
+// Ret:  the number of pages whose bitmaps differ
+//
+int TestFilters(const char *version, AttrType type, CompOp op)
+{
+   int errors = 0;
+   char value[4];
+
+   setenv("REDBASE_SIMD", version, 1);
+   RM_PageFilter filter = RM_GetPageFilter(type, op);
+   setenv("REDBASE_SIMD", "off", 1);
+   RM_PageFilter filterOff = RM_GetPageFilter(type, op);
+
+   for (int page = 0; page < NUM_PAGES; page++) {
+
+      // Any slot count and record length.  The attributes end where the
+      // page does, so that a load past the last slot would be noticed
+      // by a memory checker.
+      int capacity = 1 + rand() % (page % 4 == 0 ? 1000 : 70);
+      int stride = 4 + rand() % 40;
+      vector<char> attrs((capacity - 1) * stride + 4);
+      for (int i = 0; i < capacity; i++)
+         RandomValue(type, &attrs[i * stride]);
+      RandomValue(type, value);
+
+      // Bitmaps with empty, full and mixed bytes
+      int bytes = (capacity + 7) / 8;
+      vector<char> bitmap(bytes);
+      for (int i = 0; i < bytes; i++)
+         switch (rand() % 4) {
+         case 0:  bitmap[i] = 0; break;
+         case 1:  bitmap[i] = (char)0xFF; break;
+         default: bitmap[i] = (char)rand(); break;
+         }
+
+      // A page has no bits for slots past its capacity
+      if (capacity % 8)
+         bitmap[bytes - 1] &= (char)(0xFF << (8 - capacity % 8));
+
+      // The records compared one by one
+      vector<char> each(bitmap);
+      for (int i = 0; i < capacity; i++) {
+         const char *attr = &attrs[i * stride];
+         if (!(type == INT ? Compare<int>(op, attr, value) :
+                             Compare<float>(op, attr, value)))
+            each[i / 8] &= ~(0x80 >> (i % 8));
+      }
+
+      vector<char> expected(bitmap), got(bitmap);
+      filterOff(&attrs[0], stride, capacity, value, &expected[0]);
+      filter(&attrs[0], stride, capacity, value, &got[0]);
+      if (got != expected || expected != each) {
+         if (errors++ == 0)
+            cout << "\n  simd=" << version << " type=" << type
+                 << " op=" << op << " capacity=" << capacity
+                 << " stride=" << stride << ": bitmaps differ";
+      }
+   }
+
+   return (errors);
+}
+
+//
+// main
+//
+int main(int argc, char *argv[])
+{
+   int errors = 0;
+
+   cout << "Starting RM page filter test\n";
+   srand(1);
+
+#if defined(__x86_64__) || defined(__i386__)
+   __builtin_cpu_init();
+   cout << "AVX2 " << (__builtin_cpu_supports("avx2") ? "" : "not ")
+        << "supported, SSE4.1 "
+        << (__builtin_cpu_supports("sse4.1") ? "" : "not ") << "supported\n";
+#endif
+
+   for (int v = 0; v < (int)(sizeof(Versions) / sizeof(char *)); v++)
+      for (int t = 0; t < 2; t++)
+         for (int o = 0; o < (int)(sizeof(Ops) / sizeof(CompOp)); o++)
+            errors += TestFilters(Versions[v], t == 0 ? INT : FLOAT, Ops[o]);
+
+   if (errors) {
+      cout << "\n" << errors << " pages filtered wrong\n";
+      return (1);
+   }
+
+   cout << "Page filters ok\n";
+   return (0);
+}
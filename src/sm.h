@@ -17,6 +17,13 @@
 #include "ix.h"
 #include "printer.h"  // for DataAttrInfo
 
+// File in the db directory listing the pages in the buffer when the db
+// was last closed (see PF_Manager::DumpBuffer).  Relation names cannot
+// start with a dot.
+#define SM_BUFDUMP ".bufdump"
+
+// Write-ahead log of the db (see PF_Manager::OpenLog)
+#define SM_WAL ".wal"
 
 struct RelationInfo {
   // Default constructor
@@ -62,14 +62,20 @@ RC SM_Manager::Set(const char *paramName, const char *value) {
 /* Steps - 
     1. Change the directory to the directory defined by dbName. Will
         give an error if the directory doesn't exist
-    2. Load the catalog files, by setting the rm filehandle
-    3. 
+    2. Open the write-ahead log, redoing the changes it was left with
+    3. Read back the list of pages in the buffer at the last CloseDb
+    4. Load the catalog files, by setting the rm filehandle
 */
 RC SM_Manager::OpenDb(const char *dbName) {
     RC WARN = SM_OPEN_WARN, ERR = SM_OPEN_ERR;
     if (isOpen) return WARN;
     // change the directory
     SM_ErrorForward(chdir(dbName));
+    // the files of the db are logged from here on
+    SM_ErrorForward(rmman->pf_manager->OpenLog(SM_WAL));
+    // bring back the pages the buffer held when the db was closed; the
+    // db opens without them if the dump cannot be read
+    rmman->pf_manager->RestoreBuffer(SM_BUFDUMP);
     // open the catalog files by setting the handles
     char relcatfile[] = "relcat";
     char attrcatfile[] = "attrcat";
@@ -81,14 +87,18 @@ RC SM_Manager::OpenDb(const char *dbName) {
 
 /* Steps-
     1. Check if a db is open
-    2. Flush the data and index files to disk and close them
+    2. Dump the list of pages in the buffer for the next OpenDb
     3. Flush the catalog files to disk and close them
+    4. Write out the logged files and empty the write-ahead log
 */
 RC SM_Manager::CloseDb() {
     RC WARN = SM_CLOSE_WARN, ERR = SM_CLOSE_ERR;
     if (!isOpen) return WARN;
+    // record the pages in the buffer for the next OpenDb
+    rmman->pf_manager->DumpBuffer(SM_BUFDUMP);
     SM_ErrorForward(rmman->CloseFile(relcat));
     SM_ErrorForward(rmman->CloseFile(attrcat));
+    SM_ErrorForward(rmman->pf_manager->CloseLog());
     SM_ErrorForward(chdir(".."));
     isOpen = false;
     return OK_RC;
@@ -211,7 +221,7 @@ RC SM_Manager::DropTable(const char *relName) {
     // remove the tuples from attrcat
     RM_FileScan attrscan;
     SM_ErrorForward(attrscan.OpenScan(attrcat, STRING, 
-        MAXNAME+1, 0, EQ_OP, (void*) relName, NO_HINT));
+        MAXNAME+1, 0, EQ_OP, (void*) relName, HOT_METADATA));
     DataAttrInfo* dinfo;
     char* dinfodata;
     while(attrscan.GetNextRec(rec) == OK_RC) {
@@ -271,7 +281,7 @@ RC SM_Manager::CreateIndex(const char *relName,
     SM_ErrorForward(ixman->OpenIndex(relName, dinfo.indexNo, ihandle));
     SM_ErrorForward(rmman->OpenFile(relName, relation));
     SM_ErrorForward(fscan.OpenScan(relation, dinfo.attrType, 
-        dinfo.attrLength, dinfo.offset, NO_OP, 0, NO_HINT));
+        dinfo.attrLength, dinfo.offset, NO_OP, 0, SEQUENTIAL_ONCE));
     char *data;
     RID rid;
     while (fscan.GetNextRec(datarec) == OK_RC) {
@@ -420,7 +430,7 @@ RC SM_Manager::Print(const char *relName) {
     DataAttrInfo* attributes = new DataAttrInfo[relinfo.num_attr];
     RM_FileScan attrscan;
     SM_ErrorForward(attrscan.OpenScan(attrcat, STRING, 
-        MAXNAME+1, 0, EQ_OP, (void*) relName, NO_HINT));
+        MAXNAME+1, 0, EQ_OP, (void*) relName, HOT_METADATA));
     char *dinfodata;
     for (int i = 0; i < relinfo.num_attr; i++) {
         SM_ErrorForward(attrscan.GetNextRec(rec));
@@ -441,7 +451,8 @@ RC SM_Manager::Print(const char *relName) {
     char *data;
     RC rc = OK_RC;
 
-    SM_ErrorForward(rfs.OpenScan(rfh, INT, sizeof(int), 0, NO_OP, NULL));
+    SM_ErrorForward(rfs.OpenScan(rfh, INT, sizeof(int), 0, NO_OP, NULL,
+        SEQUENTIAL_ONCE));
 
     // Print each tuple
     while (rc!=RM_EOF) {
@@ -495,7 +506,7 @@ RC SM_Manager::Help() {
 
     RM_FileScan relscan;
     SM_ErrorForward(relscan.OpenScan(relcat, STRING, 
-        MAXNAME+1, 0, NO_OP, 0, NO_HINT));
+        MAXNAME+1, 0, NO_OP, 0, HOT_METADATA));
     char *data;
     char *buffer = new char[MAXNAME+9];
     RelationInfo relinfo;
@@ -576,7 +587,7 @@ RC SM_Manager::Help(const char *relName) {
 
     RM_FileScan attrscan;
     SM_ErrorForward(attrscan.OpenScan(attrcat, STRING, 
-        MAXNAME+1, 0, EQ_OP, (void*) relName, NO_HINT));
+        MAXNAME+1, 0, EQ_OP, (void*) relName, HOT_METADATA));
     char *data;
     char *buffer = new char[2*MAXNAME+18];
     DataAttrInfo dinfo;
@@ -618,7 +629,7 @@ RC SM_Manager::getRelInfo(const char* relName, RM_Record &rec) {
     RC WARN = SM_RELATION_NOT_FOUND, ERR = SM_RELATION_NOT_FOUND;
     RM_FileScan relscan;
     SM_ErrorForward(relscan.OpenScan(relcat, STRING, 
-        MAXNAME+1, 0, EQ_OP, (void*) relName, NO_HINT));
+        MAXNAME+1, 0, EQ_OP, (void*) relName, HOT_METADATA));
     // only one record expected, return an error if none found
     SM_ErrorForward(relscan.GetNextRec(rec));
     SM_ErrorForward(relscan.CloseScan());
@@ -630,7 +641,7 @@ RC SM_Manager::getAttrInfo(const char* relName, const char* attrName,
     RC WARN = SM_ATTRIBUTE_NOT_FOUND, ERR = SM_ATTRIBUTE_NOT_FOUND;
     RM_FileScan attrscan;
     SM_ErrorForward(attrscan.OpenScan(attrcat, STRING, 
-        MAXNAME+1, 0, EQ_OP, (void*) relName, NO_HINT));
+        MAXNAME+1, 0, EQ_OP, (void*) relName, HOT_METADATA));
     bool found = false;
     while(attrscan.GetNextRec(rec) == OK_RC) {
         char* dinfodata;
@@ -652,7 +663,7 @@ RC SM_Manager::getAttributes(const char *relName, vector<DataAttrInfo> &attribut
     RM_FileScan attrscan;
     RM_Record rec;
     SM_ErrorForward(attrscan.OpenScan(attrcat, STRING, 
-        MAXNAME+1, 0, EQ_OP, (void*) relName, NO_HINT));
+        MAXNAME+1, 0, EQ_OP, (void*) relName, HOT_METADATA));
     DataAttrInfo dinfo;
     char *dinfodata;
     bool found = false;
@@ -16,8 +16,10 @@
 // Andre Bergholz, who was the TA for the 2000 offering has written
 // some (or maybe all) of this code.
 
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <new>
 #include "statistics.h"
 
 using namespace std;
@@ -32,6 +34,22 @@ const char *PF_PAGENOTFOUND = "PAGENOTFOUND";
 const char *PF_READPAGE = "READPAGE";           // IO
 const char *PF_WRITEPAGE = "WRITEPAGE";         // IO
 const char *PF_FLUSHPAGES = "FLUSHPAGES";
+const char *PF_READAHEAD = "READAHEAD";         // IO
+const char *PF_FGWRITE = "FGWRITE";             // IO, by page replacement
+const char *PF_BGWRITE = "BGWRITE";             // IO, by background writer
+const char *PF_LOGRECORD = "LOGRECORD";         // write-ahead log records
+const char *PF_LOGSYNC = "LOGSYNC";             // IO, syncs of the log
+const char *PF_CHECKPOINT = "CHECKPOINT";       // checkpoints taken
+const char *PF_CKPTWRITE = "CKPTWRITE";         // IO, by checkpoints
+
+//
+// Keys of the counters, in Stat_Counter order
+//
+static const char **ppsCounterKeys[STAT_NUM_COUNTERS] = {
+   &PF_GETPAGE, &PF_PAGEFOUND, &PF_PAGENOTFOUND, &PF_READPAGE,
+   &PF_WRITEPAGE, &PF_FLUSHPAGES, &PF_READAHEAD, &PF_FGWRITE, &PF_BGWRITE,
+   &PF_LOGRECORD, &PF_LOGSYNC, &PF_CHECKPOINT, &PF_CKPTWRITE
+};
 
 //
 // Statistic class
@@ -107,8 +125,79 @@ Boolean Statistic::operator==(const char *psKey_) const
 //
 // StatisticMgr class
 //
-// This class will track a dynamic list of statistics.
+// This class will track a dynamic list of statistics.  The statistics
+// that have a Stat_Counter are kept in sharded counters instead, and
+// Register, Get, Print and Reset look at those first.
+//
+
+std::atomic<int> StatisticsMgr::nextShard(0);
+
+//
+// Constructor
+//
+// The shards are aligned on a cache line so that no two share one.
+//
+StatisticsMgr::StatisticsMgr()
+{
+   void *p;
+   if (posix_memalign(&p, STAT_CACHE_LINE, STAT_SHARDS * sizeof(Stat_Shard)))
+      throw std::bad_alloc();
+   shards = (Stat_Shard *)p;
+   for (int i = 0; i < STAT_NUM_COUNTERS; i++)
+      Clear(i);
+}
+
+//
+// Destructor
+//
+StatisticsMgr::~StatisticsMgr()
+{
+   free(shards);
+}
+
+//
+// FindCounter
+//
+// Return the counter whose key is psKey, or STAT_NUM_COUNTERS if the
+// statistic is kept in the list.  The PF layer passes the key pointers
+// themselves, so those are tried before the strings are compared.
+//
+int StatisticsMgr::FindCounter(const char *psKey)
+{
+   int i;
+   for (i = 0; i < STAT_NUM_COUNTERS; i++)
+      if (psKey == *ppsCounterKeys[i])
+         return i;
+   for (i = 0; i < STAT_NUM_COUNTERS; i++)
+      if (strcmp(psKey, *ppsCounterKeys[i]) == 0)
+         return i;
+   return STAT_NUM_COUNTERS;
+}
+
+//
+// Sum
+//
+// Return the value of a counter, the total of its shards
+//
+long StatisticsMgr::Sum(int counter) const
+{
+   long lValue = 0;
+   for (int i = 0; i < STAT_SHARDS; i++)
+      lValue += shards[i].values[counter].load(std::memory_order_relaxed);
+   return lValue;
+}
+
+//
+// Clear
+//
+// Set a counter back to 0, as if it had never been counted
 //
+void StatisticsMgr::Clear(int counter)
+{
+   for (int i = 0; i < STAT_SHARDS; i++)
+      shards[i].values[counter] = 0;
+   used[counter] = FALSE;
+}
 
 //
 // Register
@@ -130,6 +219,46 @@ RC StatisticsMgr::Register (const char *psKey, const Stat_Operation op,
    if (psKey==NULL || (op != STAT_ADDONE && piValue == NULL))
       return STAT_INVALID_ARGS;
 
+   int counter = FindCounter(psKey);
+   if (counter < STAT_NUM_COUNTERS && op == STAT_ADDONE) {
+      Add((Stat_Counter)counter);
+      return 0;
+   }
+   if (counter < STAT_NUM_COUNTERS && op == STAT_ADDVALUE) {
+      Add((Stat_Counter)counter, *piValue);
+      return 0;
+   }
+
+   std::lock_guard<std::mutex> lock(mutex);
+
+   // The other operations on a counter work on its total, which is then
+   // kept in the first shard.  Adds made meanwhile by other threads may
+   // be lost.
+   if (counter < STAT_NUM_COUNTERS) {
+      Statistic stat(psKey);
+      stat.iValue = (int)Sum(counter);
+      switch (op) {
+         case STAT_SETVALUE:
+            stat.iValue = *piValue;
+            break;
+         case STAT_MULTVALUE:
+            stat.iValue *= *piValue;
+            break;
+         case STAT_DIVVALUE:
+            stat.iValue = (int) (stat.iValue/(*piValue));
+            break;
+         case STAT_SUBVALUE:
+            stat.iValue -= *piValue;
+            break;
+         default:
+            break;
+      }
+      Clear(counter);
+      shards[0].values[counter] = stat.iValue;
+      used[counter] = TRUE;
+      return 0;
+   }
+
    iCount = llStats.GetLength();
 
    for (i=0; i < iCount; i++) {
@@ -213,6 +342,12 @@ int *StatisticsMgr::Get(const char *psKey)
    int i, iCount;
    Statistic *pStat = NULL;
 
+   int counter = FindCounter(psKey);
+   if (counter < STAT_NUM_COUNTERS)
+      return used[counter] ? new int((int)Sum(counter)) : NULL;
+
+   std::lock_guard<std::mutex> lock(mutex);
+
    iCount = llStats.GetLength();
 
    for (i=0; i < iCount; i++) {
@@ -238,6 +373,12 @@ void StatisticsMgr::Print()
    int i, iCount;
    Statistic *pStat = NULL;
 
+   for (i=0; i < STAT_NUM_COUNTERS; i++)
+      if (used[i])
+         cout << *ppsCounterKeys[i] << "::" << Sum(i) << "\n";
+
+   std::lock_guard<std::mutex> lock(mutex);
+
    iCount = llStats.GetLength();
 
    for (i=0; i < iCount; i++) {
@@ -260,6 +401,15 @@ RC StatisticsMgr::Reset(const char *psKey)
    if (psKey==NULL)
       return STAT_INVALID_ARGS;
 
+   int counter = FindCounter(psKey);
+   if (counter < STAT_NUM_COUNTERS) {
+      if (!used[counter])
+         return STAT_UNKNOWN_KEY;
+      Clear(counter);
+      return 0;
+   }
+
+   std::lock_guard<std::mutex> lock(mutex);
    iCount = llStats.GetLength();
 
    for (i=0; i < iCount; i++) {
@@ -285,6 +435,10 @@ RC StatisticsMgr::Reset(const char *psKey)
 //
 void StatisticsMgr::Reset()
 {
+   for (int i = 0; i < STAT_NUM_COUNTERS; i++)
+      Clear(i);
+
+   std::lock_guard<std::mutex> lock(mutex);
    llStats.Erase();
 }
 
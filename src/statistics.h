@@ -47,6 +47,8 @@ const int STAT_BASE = 9000;
 
 // This include must come after the common defines
 #include "linkedlist.h"    // Template class for the link list
+#include <atomic>
+#include <mutex>
 
 // A single statistic will be tracked by a Statistic class
 class Statistic {
@@ -85,12 +87,54 @@ enum Stat_Operation {
     STAT_SUBVALUE
 };
 
+// Statistics updated on hot paths have a fixed index, and are counted
+// apart from the list.  Their keys are the PF_ keys declared below.
+enum Stat_Counter {
+    PF_STAT_GETPAGE,
+    PF_STAT_PAGEFOUND,
+    PF_STAT_PAGENOTFOUND,
+    PF_STAT_READPAGE,
+    PF_STAT_WRITEPAGE,
+    PF_STAT_FLUSHPAGES,
+    PF_STAT_READAHEAD,
+    PF_STAT_FGWRITE,
+    PF_STAT_BGWRITE,
+    PF_STAT_LOGRECORD,
+    PF_STAT_LOGSYNC,
+    PF_STAT_CHECKPOINT,
+    PF_STAT_CKPTWRITE,
+    STAT_NUM_COUNTERS
+};
+
+// Each thread adds to the counters of one shard, so that threads do not
+// fight over the cache lines of the counters.  A shard is padded to a
+// whole number of cache lines and the shards are aligned on them.
+const int STAT_SHARDS = 16;
+const int STAT_CACHE_LINE = 64;
+
+struct Stat_Shard {
+    std::atomic<long> values[STAT_NUM_COUNTERS];
+    char pad[STAT_CACHE_LINE - (sizeof(std::atomic<long>) *
+                                STAT_NUM_COUNTERS) % STAT_CACHE_LINE];
+};
+
 // The StatisticsMgr will track a group of statistics
 class StatisticsMgr {
 
 public:
-    StatisticsMgr() {};
-    ~StatisticsMgr() {};
+    StatisticsMgr();
+    ~StatisticsMgr();
+
+    // Add iValue to a counter.  Costs one atomic add to the calling
+    // thread's shard, and no lock.  Same as Register with STAT_ADDVALUE
+    // and the key of the counter.
+    void Add(const Stat_Counter counter, const int iValue = 1)
+    {
+        shards[Shard()].values[counter].fetch_add(iValue,
+                                                  std::memory_order_relaxed);
+        if (!used[counter].load(std::memory_order_relaxed))
+            used[counter].store(TRUE, std::memory_order_relaxed);
+    }
 
     // Add a new statistic or register a change to an existing statistic.
     // The piValue for can be NULL, except for those operations that require
@@ -116,7 +160,33 @@ public:
     void Reset();
 
 private:
-    LinkList<Statistic> llStats;
+    StatisticsMgr(const StatisticsMgr &);            // Not copyable
+    StatisticsMgr &operator=(const StatisticsMgr &);
+
+    // Shard of the calling thread, handed out in turn as threads first
+    // count something
+    static int Shard()
+    {
+        static thread_local int shard = -1;
+        if (shard < 0)
+            shard = nextShard.fetch_add(1) % STAT_SHARDS;
+        return shard;
+    }
+    static std::atomic<int> nextShard;
+
+    // Counter with the key psKey, or STAT_NUM_COUNTERS
+    static int FindCounter(const char *psKey);
+    long Sum(int counter) const;                     // Total of the shards
+    void Clear(int counter);                         // Set to 0 and unused
+
+    Stat_Shard *shards;                              // STAT_SHARDS of them
+    std::atomic<char> used[STAT_NUM_COUNTERS];       // TRUE once counted
+
+    LinkList<Statistic> llStats;                     // all other statistics
+
+    // The PF layer registers statistics from its background threads
+    // too, so every method holds this while it looks at llStats
+    std::mutex mutex;
 };
 
 //
@@ -136,6 +206,13 @@ extern const char *PF_PAGENOTFOUND;
 extern const char *PF_READPAGE;         // IO
 extern const char *PF_WRITEPAGE;        // IO
 extern const char *PF_FLUSHPAGES;
+extern const char *PF_READAHEAD;
+extern const char *PF_FGWRITE;
+extern const char *PF_BGWRITE;
+extern const char *PF_LOGRECORD;
+extern const char *PF_LOGSYNC;        // IO
+extern const char *PF_CHECKPOINT;
+extern const char *PF_CKPTWRITE;      // IO
 
 #endif
 